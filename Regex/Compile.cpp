@@ -2,6 +2,7 @@
 #include "Compile.h"
 #include "Common.h"
 #include "Constants.h"
+#include "Dfa.h"
 #include "Execute.h"
 #include "Opcodes.h"
 #include "Regex.h"
@@ -13,6 +14,7 @@
 #include <algorithm>
 #include <cassert>
 #include <cstring>
+#include <vector>
 
 namespace {
 
@@ -118,11 +120,9 @@ bool isQuantifier(char ch) noexcept {
  *--------------------------------------------------------------------*/
 bool init_ansi_classes() noexcept {
 
-	static bool initialized = false;
-
-	if (!initialized) {
-		initialized = true; // Only need to generate character sets once.
-
+	/* Only need to generate character sets once. Being a local static, this
+	   happens exactly once even when regexes are compiled on several threads */
+	static const bool initialized = []() noexcept {
 		constexpr char Underscore = '_';
 		constexpr char Newline    = '\n';
 
@@ -160,9 +160,10 @@ bool init_ansi_classes() noexcept {
 		Word_Char[word_count]     = '\0';
 		Letter_Char[letter_count] = '\0';
 		White_Space[space_count]  = '\0';
-	}
+		return true;
+	}();
 
-	return true;
+	return initialized;
 }
 
 /*----------------------------------------------------------------------*
@@ -602,6 +603,8 @@ uint8_t *back_ref(const char *ch, int *flag_param) {
 
 		emit_byte(paren_no);
 
+		pContext.Has_Back_Refs = true;
+
 		if (is_cross_regex || pContext.Paren_Has_Width[paren_no]) {
 			*flag_param |= HAS_WIDTH;
 		}
@@ -1856,6 +1859,356 @@ uint8_t *chunk(int paren, int *flag_param, len_range &range_param) {
 	return ret_val;
 }
 
+// A string which must appear in every match, at "min" to "max" characters from its start
+struct RequiredLiteral {
+	const char *text;
+	size_t length;
+	size_t min;
+	size_t max;
+};
+
+/**
+ * @brief add_width
+ * @param lhs
+ * @param rhs
+ * @return lhs + rhs, where LITERAL_UNBOUNDED stands for "any number"
+ */
+size_t add_width(size_t lhs, size_t rhs) noexcept {
+	if (lhs == LITERAL_UNBOUNDED || rhs == LITERAL_UNBOUNDED) {
+		return LITERAL_UNBOUNDED;
+	}
+
+	return lhs + rhs;
+}
+
+/*----------------------------------------------------------------------*
+ * measure_sequence
+ *
+ * Follows the nodes from "scan" up to (but not including) "stop", adding
+ * the least and greatest number of characters that they can match to
+ * "min" and "max". Along the way, every EXACTLY string is recorded in
+ * "literals" (if not nullptr) together with its distance from where the
+ * measuring started. Returns false if it meets a construct whose width it
+ * doesn't know how to determine (loops, counters and back references); in
+ * that case, "min" and "max" are meaningless but what was recorded in
+ * "literals" is still correct.
+ *----------------------------------------------------------------------*/
+bool measure_sequence(uint8_t *scan, uint8_t *stop, size_t *min, size_t *max, std::vector<RequiredLiteral> *literals) {
+
+	while (scan != stop) {
+		uint8_t *next = next_ptr(scan);
+
+		switch (GET_OP_CODE(scan)) {
+		case BOL:
+		case EOL:
+		case BOWORD:
+		case EOWORD:
+		case NOT_BOUNDARY:
+		case NOTHING:
+			break;
+
+		case EXACTLY:
+		case SIMILAR: {
+			const auto text   = reinterpret_cast<const char *>(OPERAND(scan));
+			const size_t size = strlen(text);
+
+			if (literals && GET_OP_CODE(scan) == EXACTLY) {
+				literals->push_back({text, size, *min, *max});
+			}
+
+			*min = add_width(*min, size);
+			*max = add_width(*max, size);
+		} break;
+
+		case ANY_OF:
+		case ANY_BUT:
+		case ANY:
+		case EVERY:
+		case DIGIT:
+		case NOT_DIGIT:
+		case LETTER:
+		case NOT_LETTER:
+		case SPACE:
+		case SPACE_NL:
+		case NOT_SPACE:
+		case NOT_SPACE_NL:
+		case WORD_CHAR:
+		case NOT_WORD_CHAR:
+		case IS_DELIM:
+		case NOT_DELIM:
+			*min = add_width(*min, 1);
+			*max = add_width(*max, 1);
+			break;
+
+		// The operand of these is always a SIMPLE node, which matches one character
+		case STAR:
+		case LAZY_STAR:
+			*max = LITERAL_UNBOUNDED;
+			break;
+
+		case PLUS:
+		case LAZY_PLUS:
+			*min = add_width(*min, 1);
+			*max = LITERAL_UNBOUNDED;
+			break;
+
+		case QUESTION:
+		case LAZY_QUESTION:
+			*max = add_width(*max, 1);
+			break;
+
+		case BRACE:
+		case LAZY_BRACE: {
+			const size_t lower = GET_OFFSET(scan + NEXT_PTR_SIZE);
+			const size_t upper = GET_OFFSET(scan + (2 * NEXT_PTR_SIZE));
+
+			*min = add_width(*min, lower);
+			*max = (upper <= REG_INFINITY) ? LITERAL_UNBOUNDED : add_width(*max, upper);
+		} break;
+
+		case BRANCH:
+			if (GET_OP_CODE(next) != BRANCH) { // No choice.
+				next = OPERAND(scan);
+			} else {
+				/* The alternatives all end where the last of them points to.
+				   Any one of them may be the one that matches, so nothing in
+				   them is required. */
+				uint8_t *join = next;
+				while (GET_OP_CODE(join) == BRANCH) {
+					join = next_ptr(join);
+				}
+
+				size_t choice_min = LITERAL_UNBOUNDED;
+				size_t choice_max = 0;
+
+				for (uint8_t *branch = scan; branch != join; branch = next_ptr(branch)) {
+					size_t branch_min = 0;
+					size_t branch_max = 0;
+
+					if (!measure_sequence(OPERAND(branch), join, &branch_min, &branch_max, nullptr)) {
+						return false;
+					}
+
+					choice_min = std::min(choice_min, branch_min);
+					choice_max = std::max(choice_max, branch_max);
+				}
+
+				*min = add_width(*min, choice_min);
+				*max = add_width(*max, choice_max);
+				next = join;
+			}
+			break;
+
+		case POS_AHEAD_OPEN:
+		case NEG_AHEAD_OPEN:
+		case POS_BEHIND_OPEN:
+		case NEG_BEHIND_OPEN:
+			// Zero width, skip over the branches to the closing node
+			if (GET_OP_CODE(scan) == POS_AHEAD_OPEN || GET_OP_CODE(scan) == NEG_AHEAD_OPEN) {
+				next = next_ptr(OPERAND(scan));
+			} else {
+				next = next_ptr(OPERAND(scan) + LENGTH_SIZE);
+			}
+
+			while (GET_OP_CODE(next) == BRANCH) {
+				next = next_ptr(next);
+			}
+
+			next = next_ptr(next);
+			break;
+
+		default:
+			if (GET_OP_CODE(scan) > OPEN && GET_OP_CODE(scan) < CLOSE + MaxSubExpr) {
+				break; // Capturing parentheses are zero width.
+			}
+
+			return false;
+		}
+
+		if (!next) {
+			return false;
+		}
+
+		scan = next;
+	}
+
+	return true;
+}
+
+/*----------------------------------------------------------------------*
+ * starting_bytes
+ *
+ * Adds every byte that a match of the nodes from "scan" up to (but not
+ * including) "stop" can begin with to "set". Returns true if they always
+ * consume a character, false if they may match the empty string, in which
+ * case a match may also begin with whatever follows them. Anything it
+ * can't see through is taken to begin with any byte at all.
+ *----------------------------------------------------------------------*/
+bool starting_bytes(uint8_t *scan, uint8_t *stop, std::bitset<256> *set) {
+
+	auto add_node = [set](uint8_t *node) {
+		std::bitset<256> bytes;
+		if (class_set(node, &bytes)) {
+			*set |= bytes;
+		} else {
+			set->set(); // Depends on the word delimiters
+		}
+	};
+
+	while (scan != stop) {
+		uint8_t *next = next_ptr(scan);
+
+		switch (GET_OP_CODE(scan)) {
+		case BOL:
+		case EOL:
+		case BOWORD:
+		case EOWORD:
+		case NOT_BOUNDARY:
+		case NOTHING:
+			break;
+
+		case EXACTLY:
+		case SIMILAR:
+		case ANY_OF:
+		case ANY_BUT:
+		case ANY:
+		case EVERY:
+		case DIGIT:
+		case NOT_DIGIT:
+		case LETTER:
+		case NOT_LETTER:
+		case SPACE:
+		case SPACE_NL:
+		case NOT_SPACE:
+		case NOT_SPACE_NL:
+		case WORD_CHAR:
+		case NOT_WORD_CHAR:
+		case IS_DELIM:
+		case NOT_DELIM:
+			add_node(scan);
+			return true;
+
+		// The operand of these is always a SIMPLE node, which matches one character
+		case STAR:
+		case LAZY_STAR:
+		case QUESTION:
+		case LAZY_QUESTION:
+			add_node(OPERAND(scan));
+			break;
+
+		case PLUS:
+		case LAZY_PLUS:
+			add_node(OPERAND(scan));
+			return true;
+
+		case BRACE:
+		case LAZY_BRACE:
+			add_node(OPERAND(scan + (2 * NEXT_PTR_SIZE)));
+			if (GET_OFFSET(scan + NEXT_PTR_SIZE) != 0) {
+				return true;
+			}
+			break;
+
+		case BRANCH:
+			if (GET_OP_CODE(next) != BRANCH) { // No choice.
+				next = OPERAND(scan);
+			} else {
+				uint8_t *join = next;
+				while (GET_OP_CODE(join) == BRANCH) {
+					join = next_ptr(join);
+				}
+
+				bool consumes = true;
+				for (uint8_t *branch = scan; branch != join; branch = next_ptr(branch)) {
+					if (!starting_bytes(OPERAND(branch), join, set)) {
+						consumes = false;
+					}
+				}
+
+				if (consumes) {
+					return true;
+				}
+
+				next = join;
+			}
+			break;
+
+		case POS_AHEAD_OPEN:
+		case NEG_AHEAD_OPEN:
+		case POS_BEHIND_OPEN:
+		case NEG_BEHIND_OPEN:
+			// Zero width, skip over the branches to the closing node
+			if (GET_OP_CODE(scan) == POS_AHEAD_OPEN || GET_OP_CODE(scan) == NEG_AHEAD_OPEN) {
+				next = next_ptr(OPERAND(scan));
+			} else {
+				next = next_ptr(OPERAND(scan) + LENGTH_SIZE);
+			}
+
+			while (GET_OP_CODE(next) == BRANCH) {
+				next = next_ptr(next);
+			}
+
+			next = next_ptr(next);
+			break;
+
+		case END:
+			return false;
+
+		default:
+			if (GET_OP_CODE(scan) > OPEN && GET_OP_CODE(scan) < CLOSE + MaxSubExpr) {
+				break; // Capturing parentheses are zero width.
+			}
+
+			// Loops, counters and back references
+			set->set();
+			return true;
+		}
+
+		if (!next) {
+			set->set();
+			return true;
+		}
+
+		scan = next;
+	}
+
+	return false;
+}
+
+/**
+ * @brief find_required_literal
+ * @param program
+ * @param literal
+ * @return true if there is a string which every match of "program" must
+ * contain, in which case the longest one is stored in "literal"
+ */
+bool find_required_literal(uint8_t *program, RequiredLiteral *literal) {
+
+	std::vector<RequiredLiteral> literals;
+	size_t min = 0;
+	size_t max = 0;
+
+	// Stops at END (or anything that can't be measured), either way the literals found so far are required
+	measure_sequence(program + REGEX_START_OFFSET, nullptr, &min, &max, &literals);
+
+	if (literals.empty()) {
+		return false;
+	}
+
+	/* Longer strings are rarer, and can be searched for with fewer false
+	   starts. Between equally long ones, prefer one at a known distance, so
+	   the executor can tell where the match has to begin. */
+	*literal = *std::max_element(literals.begin(), literals.end(), [](const RequiredLiteral &lhs, const RequiredLiteral &rhs) {
+		if (lhs.length != rhs.length) {
+			return lhs.length < rhs.length;
+		}
+
+		return (lhs.max == LITERAL_UNBOUNDED) && (rhs.max != LITERAL_UNBOUNDED);
+	});
+
+	return true;
+}
+
 }
 
 /*----------------------------------------------------------------------*
@@ -1930,6 +2283,7 @@ Regex::Regex(view::string_view exp, int defaultFlags) {
 		pContext.Num_Braces      = 0;
 		pContext.Closed_Parens   = 0;
 		pContext.Paren_Has_Width = 0;
+		pContext.Has_Back_Refs   = false;
 
 		emit_byte(Magic);
 		emit_byte('%'); // Placeholder for num of capturing parentheses.
@@ -1988,4 +2342,27 @@ Regex::Regex(view::string_view exp, int defaultFlags) {
 			re->anchor++;
 		}
 	}
+
+	// A string that every match contains lets the executor skip most of the text.
+	RequiredLiteral literal;
+	if (!re->anchor && find_required_literal(&re->program[0], &literal)) {
+		re->literal.assign(literal.text, literal.length);
+		re->literal_min = literal.min;
+		re->literal_max = literal.max;
+	}
+
+	/* The bytes a match can begin with, so that the executor doesn't have to
+	   try every position. Useful for long alternations, like the ones syntax
+	   highlighting builds from the start patterns of a language. */
+	std::bitset<256> bytes;
+	if (!re->anchor && starting_bytes(&re->program[0] + REGEX_START_OFFSET, nullptr, &bytes) && !bytes.all()) {
+		re->first_bytes       = bytes;
+		re->first_bytes_known = true;
+	}
+
+	// Whether a part of the regex matches only depends on where it is tried, unless it refers back or counts.
+	re->memoize = !pContext.Has_Back_Refs && pContext.Num_Braces == 0;
+
+	// Programs without back references and the like can be searched with a DFA.
+	re->dfa = Dfa::create(re->program);
 }
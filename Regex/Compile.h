@@ -19,6 +19,7 @@ struct ParseContext {
 	std::bitset<64> Paren_Has_Width; // Bit flags indicating ()'s that are known to not match the empty string
 	uint16_t Num_Braces;             // Number of general {m,n} constructs. {m,n} quantifiers of SIMPLE atoms are not included in this count.
 	uint16_t Total_Paren;            // Parentheses, (),  counter.
+	bool Has_Back_Refs;              // Does the regex refer back to parentheses?
 	bool FirstPass;
 	bool Is_Case_Insensitive;
 	bool Match_Newline;
@@ -26,6 +27,6 @@ struct ParseContext {
 	char Brace_Char;
 };
 
-extern ParseContext pContext;
+extern thread_local ParseContext pContext;
 
 #endif
@@ -2,6 +2,7 @@
 #ifndef CONSTANTS_H_
 #define CONSTANTS_H_
 
+#include <cstddef>
 #include <cstdint>
 
 /* The first byte of the Regex internal 'program' is a magic number to help
@@ -22,6 +23,20 @@ constexpr auto MaxSubExpr = 50u;
  */
 constexpr int RecursionLimit = 10000;
 
+/* Once an attempt to match has made this many calls to 'match', it starts
+   remembering where parts of the regex failed, so as not to try them again.
+   This is what keeps nested quantifiers like (a|aa)*b from taking exponential
+   time. The table used for that has up to MemoBits bits, one for each node of
+   the program and position in the text; positions past the end of it are not
+   remembered. */
+constexpr uint32_t MemoThreshold = 1024;
+constexpr size_t MemoBits        = size_t(1) << 23;
+
+/* A reverse search with the DFA looks for the last match in a block of this
+   many positions at the end of the search range, then in blocks twice as
+   large as the one before, until it finds one. */
+constexpr size_t ReverseBlockSize = 4096;
+
 constexpr int OP_CODE_SIZE  = 1;
 constexpr int NEXT_PTR_SIZE = 2;
 constexpr int INDEX_SIZE    = 1;
@@ -30,6 +45,9 @@ constexpr int NODE_SIZE     = NEXT_PTR_SIZE + OP_CODE_SIZE;
 
 constexpr auto REG_INFINITY = 0UL;
 
+// Value of 'literal_max' when a match may contain its literal at any distance from its start.
+constexpr size_t LITERAL_UNBOUNDED = SIZE_MAX;
+
 /* Number of bytes to offset from the beginning of the regex program to the start
    of the actual compiled regex code, i.e. skipping over the MAGIC number and
    the two counters at the front.  */
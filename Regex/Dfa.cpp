@@ -0,0 +1,1142 @@
+
+#include "Dfa.h"
+#include "Common.h"
+#include "Constants.h"
+#include "Opcodes.h"
+#include "Regex.h"
+#include "Util/CharScan.h"
+#include "Util/utils.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+enum NfaType : uint8_t {
+	Consume, // Consumes one byte of the set 'set', then goes to 'out'
+	Split,   // Goes to all of 'count' states listed in 'edges_' from 'out' on
+	Assert,  // Goes to 'out' if the zero width 'assertion' holds
+	Accept,  // A match ends here
+};
+
+// Flags of a DFA state, the first element of its key
+constexpr int32_t PrevNewline   = 1; // The byte before was a newline
+constexpr int32_t PrevDelimiter = 2; // The byte before was a word delimiter
+constexpr int32_t Injecting     = 4; // Matches may still start at the next position
+
+constexpr int32_t KeepGroups = -1; // The groups stay as they were (though newer ones may be dropped)
+constexpr int32_t AddGroup   = -2; // As KeepGroups, and a new group starts at this position
+
+// Limits on the size of the automata, past which the backtracking matcher is used instead
+constexpr size_t MaxNfaStates   = 65536;
+constexpr size_t MaxRepeats     = 1024;
+constexpr size_t MaxDfaStates   = 10000;
+constexpr size_t MaxTransitions = 1u << 18;
+
+/**
+ * @brief next_node
+ * @param node
+ * @return the node after "node", like NEXT_PTR in the backtracking matcher
+ */
+uint8_t *next_node(uint8_t *node) noexcept {
+
+	const uint16_t offset = GET_OFFSET(node);
+
+	if (offset == 0) {
+		return nullptr;
+	}
+
+	if (GET_OP_CODE(node) == BACK) {
+		return node - offset;
+	}
+
+	return node + offset;
+}
+
+/**
+ * @brief is_delimiter
+ * @param table
+ * @param ch
+ * @return true if "ch" is in the delimiter table, tested exactly as the
+ * backtracking matcher tests it
+ */
+bool is_delimiter(const std::bitset<256> &table, char ch) noexcept {
+	auto n = static_cast<unsigned int>(ch);
+	if (n < table.size()) {
+		return table[n];
+	}
+
+	return false;
+}
+
+}
+
+/**
+ * @brief class_set
+ * @param node
+ * @param set
+ * @return true if "node" matches a single character which doesn't depend on
+ * the word delimiters, in which case those characters are stored in "set"
+ */
+bool class_set(uint8_t *node, std::bitset<256> *set) {
+
+	const auto operand = reinterpret_cast<const char *>(OPERAND(node));
+	const uint8_t op   = GET_OP_CODE(node);
+
+	for (int i = 0; i < 256; ++i) {
+		const auto ch = static_cast<char>(i);
+		bool member   = false;
+
+		switch (op) {
+		case EXACTLY:
+			// Compared the same way as the first character of a string in 'match'
+			member = static_cast<uint8_t>(*operand) == ch;
+			break;
+		case SIMILAR:
+			member = static_cast<uint8_t>(*operand) == safe_ctype<tolower>(ch);
+			break;
+		case ANY_OF:
+			member = ::strchr(operand, ch) != nullptr;
+			break;
+		case ANY_BUT:
+			member = ::strchr(operand, ch) == nullptr;
+			break;
+		case ANY:
+			member = ch != '\n';
+			break;
+		case EVERY:
+			member = true;
+			break;
+		case DIGIT:
+			member = safe_ctype<isdigit>(ch);
+			break;
+		case NOT_DIGIT:
+			member = !safe_ctype<isdigit>(ch) && ch != '\n';
+			break;
+		case LETTER:
+			member = safe_ctype<isalpha>(ch);
+			break;
+		case NOT_LETTER:
+			member = !safe_ctype<isalpha>(ch) && ch != '\n';
+			break;
+		case SPACE:
+			member = safe_ctype<isspace>(ch) && ch != '\n';
+			break;
+		case SPACE_NL:
+			member = safe_ctype<isspace>(ch);
+			break;
+		case NOT_SPACE:
+			member = !safe_ctype<isspace>(ch);
+			break;
+		case NOT_SPACE_NL:
+			member = !safe_ctype<isspace>(ch) || ch == '\n';
+			break;
+		case WORD_CHAR:
+			member = safe_ctype<isalnum>(ch) || ch == '_';
+			break;
+		case NOT_WORD_CHAR:
+			member = !safe_ctype<isalnum>(ch) && ch != '_' && ch != '\n';
+			break;
+		default:
+			return false;
+		}
+
+		(*set)[static_cast<size_t>(i)] = member;
+	}
+
+	return true;
+}
+
+/**
+ * @brief Dfa::KeyHash::operator()
+ * @param key
+ * @return
+ */
+size_t Dfa::KeyHash::operator()(const std::vector<int32_t> &key) const noexcept {
+	size_t hash = key.size();
+	for (int32_t value : key) {
+		hash ^= static_cast<size_t>(value) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+	}
+	return hash;
+}
+
+/**
+ * @brief Dfa::create
+ * @param program
+ * @return a DFA for "program", or nullptr if it needs something only the
+ * backtracking matcher can do
+ */
+std::unique_ptr<Dfa> Dfa::create(const std::vector<uint8_t> &program) {
+
+	std::unique_ptr<Dfa> dfa(new Dfa);
+
+	if (!dfa->build(program)) {
+		return nullptr;
+	}
+
+	return dfa;
+}
+
+/**
+ * @brief Dfa::add_state
+ * @param type
+ * @param assertion
+ * @param set
+ * @param out
+ * @return the index of the new NFA state
+ */
+int32_t Dfa::add_state(uint8_t type, uint8_t assertion, uint16_t set, int32_t out) {
+	nfa_.push_back({type, assertion, set, out, 0});
+	return static_cast<int32_t>(nfa_.size() - 1);
+}
+
+/**
+ * @brief Dfa::set_split
+ * @param id
+ * @param targets
+ *
+ * Makes NFA state "id" go to all of "targets" without consuming anything.
+ */
+void Dfa::set_split(int32_t id, const std::vector<int32_t> &targets) {
+	nfa_[static_cast<size_t>(id)] = {Split, 0, 0, static_cast<int32_t>(edges_.size()), static_cast<int32_t>(targets.size())};
+	edges_.insert(edges_.end(), targets.begin(), targets.end());
+}
+
+/**
+ * @brief Dfa::add_set
+ * @param set
+ * @return the index of "set" in the table of byte sets, or -1 if the table is full
+ */
+int32_t Dfa::add_set(const std::bitset<256> &set) {
+
+	auto it = set_index_.find(set);
+	if (it != set_index_.end()) {
+		return it->second;
+	}
+
+	if (sets_.size() > std::numeric_limits<uint16_t>::max()) {
+		return -1;
+	}
+
+	sets_.push_back(set);
+	const auto index = static_cast<int32_t>(sets_.size() - 1);
+	set_index_.emplace(set, index);
+	return index;
+}
+
+/**
+ * @brief Dfa::node_set
+ * @param node
+ * @return the index of the set of bytes which "node" matches one of, -1 if
+ * it doesn't match a single character or the table of sets is full
+ */
+int32_t Dfa::node_set(uint8_t *node) {
+
+	switch (GET_OP_CODE(node)) {
+	case IS_DELIM:
+	case NOT_DELIM:
+		// Filled in by 'reset' once the word delimiters are known
+		if (sets_.size() > std::numeric_limits<uint16_t>::max()) {
+			return -1;
+		}
+
+		uses_delimiter_ = true;
+		sets_.emplace_back();
+		delimiter_sets_.emplace_back(static_cast<uint16_t>(sets_.size() - 1), GET_OP_CODE(node));
+		return static_cast<int32_t>(sets_.size() - 1);
+	default:
+		std::bitset<256> set;
+		if (!class_set(node, &set)) {
+			return -1;
+		}
+
+		return add_set(set);
+	}
+}
+
+/**
+ * @brief Dfa::node_entry
+ * @param node
+ * @return the NFA state which matching "node" begins with
+ */
+int32_t Dfa::node_entry(uint8_t *node) {
+
+	if (!node) {
+		// The backtracking matcher gives up when it runs off the end of a chain
+		if (dead_ < 0) {
+			dead_ = add_state(Split);
+			set_split(dead_, {});
+		}
+
+		return dead_;
+	}
+
+	int32_t &entry = node_states_[static_cast<size_t>(node - program_)];
+	if (entry < 0) {
+		entry = add_state(Split);
+		pending_.push_back(node);
+	}
+
+	return entry;
+}
+
+/**
+ * @brief Dfa::build
+ * @param program
+ * @return true if all of "program" could be turned into an NFA
+ */
+bool Dfa::build(const std::vector<uint8_t> &program) {
+
+	program_ = const_cast<uint8_t *>(program.data());
+	node_states_.assign(program.size(), -1);
+
+	start_ = node_entry(program_ + REGEX_START_OFFSET);
+
+	while (!pending_.empty()) {
+		uint8_t *node = pending_.back();
+		pending_.pop_back();
+
+		if (!build_node(node, node_states_[static_cast<size_t>(node - program_)]) || nfa_.size() > MaxNfaStates) {
+			return false;
+		}
+	}
+
+	// Only needed while building
+	program_     = nullptr;
+	node_states_ = {};
+	pending_     = {};
+	set_index_   = {};
+
+	marks_.assign(nfa_.size(), 0);
+	kernel_marks_.assign(nfa_.size(), 0);
+	return true;
+}
+
+/**
+ * @brief Dfa::build_node
+ * @param node
+ * @param entry
+ * @return true if "node" could be turned into NFA states, beginning with "entry"
+ */
+bool Dfa::build_node(uint8_t *node, int32_t entry) {
+
+	uint8_t *next    = next_node(node);
+	const uint8_t op = GET_OP_CODE(node);
+
+	switch (op) {
+	case END:
+		nfa_[static_cast<size_t>(entry)] = {Accept, 0, 0, -1, 0};
+		return true;
+
+	case BOL:
+	case EOL:
+	case BOWORD:
+	case EOWORD:
+	case NOT_BOUNDARY: {
+		if (op == BOL || op == EOL) {
+			uses_lines_ = true;
+		} else {
+			uses_boundary_  = true;
+			uses_delimiter_ = true;
+		}
+
+		const int32_t out                = node_entry(next);
+		nfa_[static_cast<size_t>(entry)] = {Assert, op, 0, out, 0};
+		return true;
+	}
+
+	case EXACTLY:
+	case SIMILAR: {
+		/* One state per character. Apart from the first, the characters of
+		   an EXACTLY string are compared as bytes. */
+		const auto text    = reinterpret_cast<const char *>(OPERAND(node));
+		const size_t size  = strlen(text);
+		const int32_t out  = node_entry(next);
+		int32_t state      = entry;
+
+		for (size_t i = 0; i < size; ++i) {
+			std::bitset<256> set;
+			if (op == SIMILAR) {
+				for (int ch = 0; ch < 256; ++ch) {
+					set[static_cast<size_t>(ch)] = static_cast<uint8_t>(text[i]) == safe_ctype<tolower>(static_cast<char>(ch));
+				}
+			} else if (i == 0) {
+				class_set(node, &set);
+			} else {
+				set[static_cast<uint8_t>(text[i])] = true;
+			}
+
+			const int32_t index = add_set(set);
+			if (index < 0) {
+				return false;
+			}
+
+			const int32_t following           = (i + 1 < size) ? add_state(Consume) : out;
+			nfa_[static_cast<size_t>(state)] = {Consume, 0, static_cast<uint16_t>(index), following, 0};
+			state                            = following;
+		}
+
+		return size != 0;
+	}
+
+	case ANY_OF:
+	case ANY_BUT:
+	case ANY:
+	case EVERY:
+	case DIGIT:
+	case NOT_DIGIT:
+	case LETTER:
+	case NOT_LETTER:
+	case SPACE:
+	case SPACE_NL:
+	case NOT_SPACE:
+	case NOT_SPACE_NL:
+	case WORD_CHAR:
+	case NOT_WORD_CHAR:
+	case IS_DELIM:
+	case NOT_DELIM: {
+		const int32_t index = node_set(node);
+		if (index < 0) {
+			return false;
+		}
+
+		const int32_t out                = node_entry(next);
+		nfa_[static_cast<size_t>(entry)] = {Consume, 0, static_cast<uint16_t>(index), out, 0};
+		return true;
+	}
+
+	case NOTHING:
+	case BACK:
+		set_split(entry, {node_entry(next)});
+		return true;
+
+	case BRANCH:
+		if (GET_OP_CODE(next) != BRANCH) { // No choice.
+			set_split(entry, {node_entry(OPERAND(node))});
+		} else {
+			std::vector<int32_t> choices;
+			for (uint8_t *branch = node; branch && GET_OP_CODE(branch) == BRANCH; branch = next_node(branch)) {
+				choices.push_back(node_entry(OPERAND(branch)));
+			}
+
+			set_split(entry, choices);
+		}
+		return true;
+
+	case STAR:
+	case LAZY_STAR:
+	case PLUS:
+	case LAZY_PLUS:
+	case QUESTION:
+	case LAZY_QUESTION:
+	case BRACE:
+	case LAZY_BRACE: {
+		// Laziness only changes which match is preferred, not where matches can start
+		uint8_t *operand = OPERAND(node);
+		size_t min       = 0;
+		size_t max       = 0; // 0 for no limit
+
+		switch (op) {
+		case PLUS:
+		case LAZY_PLUS:
+			min = 1;
+			break;
+		case QUESTION:
+		case LAZY_QUESTION:
+			max = 1;
+			break;
+		case BRACE:
+		case LAZY_BRACE:
+			min     = GET_OFFSET(node + NEXT_PTR_SIZE);
+			max     = GET_OFFSET(node + (2 * NEXT_PTR_SIZE));
+			operand = OPERAND(node + (2 * NEXT_PTR_SIZE));
+
+			if (max <= REG_INFINITY) {
+				max = 0;
+			}
+			break;
+		}
+
+		if (min + ((max != 0) ? max - min : 1) > MaxRepeats) {
+			return false;
+		}
+
+		const int32_t index = node_set(operand);
+		if (index < 0) {
+			return false;
+		}
+
+		const auto set    = static_cast<uint16_t>(index);
+		const int32_t out = node_entry(next);
+
+		// Built from the end backwards, each state going on to the one before it
+		int32_t follow = out;
+
+		if (max == 0) {
+			const int32_t loop = add_state(Split);
+			set_split(loop, {add_state(Consume, 0, set, loop), out});
+			follow = loop;
+		} else {
+			for (size_t i = min; i < max; ++i) {
+				const int32_t optional = add_state(Split);
+				set_split(optional, {add_state(Consume, 0, set, follow), out});
+				follow = optional;
+			}
+		}
+
+		for (size_t i = 0; i < min; ++i) {
+			follow = add_state(Consume, 0, set, follow);
+		}
+
+		set_split(entry, {follow});
+		return true;
+	}
+
+	default:
+		// Capturing parentheses don't matter when only looking for where matches start
+		if ((op > OPEN && op < OPEN + MaxSubExpr) || (op > CLOSE && op < CLOSE + MaxSubExpr)) {
+			set_split(entry, {node_entry(next)});
+			return true;
+		}
+
+		// Counting, back references and look-arounds are left to the backtracking matcher
+		return false;
+	}
+}
+
+/**
+ * @brief Dfa::reset
+ * @param delimiters
+ *
+ * Throws away all DFA states, and prepares to build new ones for "delimiters".
+ */
+void Dfa::reset(const std::bitset<256> &delimiters) {
+
+	delimiters_ = delimiters;
+	cached_     = true;
+
+	for (const auto &entry : delimiter_sets_) {
+		std::bitset<256> &set = sets_[entry.first];
+		for (int ch = 0; ch < 256; ++ch) {
+			set[static_cast<size_t>(ch)] = is_delimiter(delimiters_, static_cast<char>(ch)) == (entry.second == IS_DELIM);
+		}
+	}
+
+	/* Bytes which no set, assertion or state flag can tell apart share a
+	   class, and so share the transitions of every state. */
+	std::array<int, 256> classes = {};
+
+	auto refine = [&classes](const std::bitset<256> &set) {
+		std::array<int, 512> renumber;
+		renumber.fill(-1);
+
+		int count = 0;
+		for (size_t ch = 0; ch < 256; ++ch) {
+			int &id = renumber[static_cast<size_t>(classes[ch] * 2) + set[ch]];
+			if (id < 0) {
+				id = count++;
+			}
+
+			classes[ch] = id;
+		}
+	};
+
+	std::bitset<256> newlines;
+	std::bitset<256> delimiters_after;
+	for (int ch = 0; ch < 256; ++ch) {
+		const uint8_t flags                       = flags_after(static_cast<char>(ch));
+		newlines[static_cast<size_t>(ch)]         = (flags & PrevNewline) != 0;
+		delimiters_after[static_cast<size_t>(ch)] = (flags & PrevDelimiter) != 0;
+	}
+
+	refine(newlines);
+	refine(delimiters_after);
+
+	for (const std::bitset<256> &set : sets_) {
+		refine(set);
+	}
+
+	class_bytes_.clear();
+	for (int ch = 0; ch < 256; ++ch) {
+		const auto id = static_cast<size_t>(classes[static_cast<size_t>(ch)]);
+		if (id >= class_bytes_.size()) {
+			class_bytes_.resize(id + 1);
+			class_bytes_[id] = static_cast<uint8_t>(ch);
+		}
+
+		classes_[static_cast<size_t>(ch)] = static_cast<uint8_t>(id);
+	}
+
+	states_.clear();
+	transitions_.clear();
+	maps_.clear();
+	state_index_.clear();
+	map_index_.clear();
+	entry_states_.fill(-1);
+
+	births_.resize(nfa_.size() + 1);
+	next_births_.resize(nfa_.size() + 1);
+}
+
+/**
+ * @brief Dfa::flags_after
+ * @param ch
+ * @return the flags of the states entered after "ch"
+ */
+uint8_t Dfa::flags_after(char ch) const {
+	uint8_t flags = 0;
+
+	if (uses_lines_ && ch == '\n') {
+		flags |= PrevNewline;
+	}
+
+	if (uses_boundary_ && is_delimiter(delimiters_, ch)) {
+		flags |= PrevDelimiter;
+	}
+
+	return flags;
+}
+
+/**
+ * @brief Dfa::assertion_holds
+ * @param assertion
+ * @param ctx
+ * @return
+ */
+bool Dfa::assertion_holds(uint8_t assertion, const Context &ctx) const {
+	switch (assertion) {
+	case BOL:
+		return ctx.prev_nl;
+	case EOL:
+		// At the end, 'match' also accepts a newline which is just past it
+		if (ctx.end) {
+			return ctx.end_eol || *ctx.end == '\n';
+		}
+
+		return ctx.cur_nl;
+	case BOWORD:
+		return ctx.prev_delim && !ctx.cur_delim;
+	case EOWORD:
+		return !ctx.prev_delim && ctx.cur_delim;
+	case NOT_BOUNDARY:
+		return ctx.prev_delim == ctx.cur_delim;
+	default:
+		return false;
+	}
+}
+
+/**
+ * @brief Dfa::next_generation
+ *
+ * Starts a new round of closures; NFA states marked in an earlier round count
+ * as unmarked again.
+ */
+void Dfa::next_generation() {
+	if (++generation_ == 0) {
+		std::fill(marks_.begin(), marks_.end(), 0);
+		std::fill(kernel_marks_.begin(), kernel_marks_.end(), 0);
+		generation_ = 1;
+	}
+}
+
+/**
+ * @brief Dfa::closure
+ * @param first
+ * @param last
+ * @param ctx
+ * @return true if a match ends at the current position, following the states
+ * in [first, last) through everything which consumes no input. The states
+ * which do consume input are stored in 'consumers_'. States marked by earlier
+ * closures of this round are skipped: whatever they lead to has been seen.
+ */
+bool Dfa::closure(const int32_t *first, const int32_t *last, const Context &ctx) {
+
+	bool matched = false;
+
+	consumers_.clear();
+	stack_.assign(std::reverse_iterator<const int32_t *>(last), std::reverse_iterator<const int32_t *>(first));
+
+	while (!stack_.empty()) {
+		const auto id = static_cast<size_t>(stack_.back());
+		stack_.pop_back();
+
+		if (marks_[id] == generation_) {
+			continue;
+		}
+
+		marks_[id] = generation_;
+
+		const NfaState &state = nfa_[id];
+		switch (state.type) {
+		case Consume:
+			consumers_.push_back(static_cast<int32_t>(id));
+			break;
+		case Split:
+			for (int32_t i = state.count - 1; i >= 0; --i) {
+				stack_.push_back(edges_[static_cast<size_t>(state.out + i)]);
+			}
+			break;
+		case Assert:
+			if (assertion_holds(state.assertion, ctx)) {
+				stack_.push_back(state.out);
+			}
+			break;
+		case Accept:
+			matched = true;
+			break;
+		}
+	}
+
+	return matched;
+}
+
+/**
+ * @brief Dfa::step
+ * @param byte
+ * @param key
+ * @return true if any of 'consumers_' accept "byte", in which case the states
+ * they go to are added to "key" as a new group
+ */
+bool Dfa::step(uint8_t byte, std::vector<int32_t> *key) {
+
+	const size_t first = key->size();
+
+	for (int32_t id : consumers_) {
+		const NfaState &state = nfa_[static_cast<size_t>(id)];
+		if (sets_[state.set][byte]) {
+			const auto out = static_cast<size_t>(state.out);
+			if (kernel_marks_[out] != generation_) {
+				kernel_marks_[out] = generation_;
+				key->push_back(state.out);
+			}
+		}
+	}
+
+	if (key->size() == first) {
+		return false;
+	}
+
+	std::sort(key->begin() + static_cast<ptrdiff_t>(first), key->end());
+	key->push_back(-1);
+	return true;
+}
+
+/**
+ * @brief Dfa::find_state
+ * @param key
+ * @return the DFA state for "key", added if it is new, or -1 if there are
+ * too many states already
+ */
+int32_t Dfa::find_state(std::vector<int32_t> key) {
+
+	auto it = state_index_.find(key);
+	if (it != state_index_.end()) {
+		return it->second;
+	}
+
+	if (states_.size() >= MaxDfaStates || (states_.size() + 1) * class_bytes_.size() > MaxTransitions) {
+		return -1;
+	}
+
+	State state;
+	state.flags  = static_cast<uint8_t>(key[0] & (PrevNewline | PrevDelimiter));
+	state.inject = (key[0] & Injecting) != 0;
+	state.groups = static_cast<uint32_t>(std::count(key.begin() + 1, key.end(), -1));
+	state.key    = std::move(key);
+
+	const auto id = static_cast<int32_t>(states_.size());
+	state_index_.emplace(state.key, id);
+	states_.push_back(std::move(state));
+	transitions_.resize(states_.size() * class_bytes_.size());
+	return id;
+}
+
+/**
+ * @brief Dfa::entry_state
+ * @param flags
+ * @return the state a search begins in, when nothing is being matched yet
+ */
+int32_t Dfa::entry_state(uint8_t flags) {
+	int32_t &id = entry_states_[flags];
+	if (id < 0) {
+		id = find_state({flags | Injecting});
+	}
+
+	return id;
+}
+
+/**
+ * @brief Dfa::settled_state
+ * @param id
+ * @return the state "id" becomes once matches may no longer start
+ */
+int32_t Dfa::settled_state(int32_t id) {
+	if (states_[static_cast<size_t>(id)].settled < 0) {
+		std::vector<int32_t> key = states_[static_cast<size_t>(id)].key;
+		key[0] &= ~Injecting;
+
+		const int32_t settled = find_state(std::move(key));
+		if (settled < 0) {
+			return -1;
+		}
+
+		states_[static_cast<size_t>(id)].settled = settled;
+	}
+
+	return states_[static_cast<size_t>(id)].settled;
+}
+
+/*----------------------------------------------------------------------*
+ * Dfa::compute
+ *
+ * Works out the transition of DFA state "id" on the bytes of class "cls".
+ *
+ * A state is a list of groups of NFA states, one group for each position
+ * a match may have started at, oldest first. An NFA state is only kept in
+ * the oldest group it is reached from, since the same match continues from
+ * there whatever the group. When the states of a group reach a match, that
+ * group and all younger ones are dropped, and no more are started: only an
+ * older group can still find a match which starts further left.
+ *----------------------------------------------------------------------*/
+bool Dfa::compute(int32_t id, size_t cls) {
+
+	const uint8_t byte = class_bytes_[cls];
+	const auto ch      = static_cast<char>(byte);
+
+	// Copied, since adding states may move them
+	const std::vector<int32_t> key = states_[static_cast<size_t>(id)].key;
+	const uint8_t flags            = states_[static_cast<size_t>(id)].flags;
+	const bool inject              = states_[static_cast<size_t>(id)].inject;
+	const auto groups              = static_cast<int32_t>(states_[static_cast<size_t>(id)].groups);
+
+	Context ctx;
+	ctx.prev_nl    = (flags & PrevNewline) != 0;
+	ctx.prev_delim = (flags & PrevDelimiter) != 0;
+	ctx.cur_nl     = (ch == '\n');
+	ctx.cur_delim  = is_delimiter(delimiters_, ch);
+	ctx.end        = nullptr;
+	ctx.end_eol    = false;
+
+	next_generation();
+
+	std::vector<int32_t> next_key = {flags_after(ch)};
+	std::vector<int32_t> map;
+	int32_t match = -1;
+
+	size_t first = 1;
+	for (int32_t group = 0; group < groups; ++group) {
+		size_t last = first;
+		while (key[last] != -1) {
+			++last;
+		}
+
+		if (closure(&key[first], &key[last], ctx)) {
+			match = group;
+			break;
+		}
+
+		if (step(byte, &next_key)) {
+			map.push_back(group);
+		}
+
+		first = last + 1;
+	}
+
+	if (match < 0 && inject) {
+		if (closure(&start_, &start_ + 1, ctx)) {
+			match = groups;
+		} else if (step(byte, &next_key)) {
+			map.push_back(groups);
+		}
+	}
+
+	if (match < 0 && inject) {
+		next_key[0] |= Injecting;
+	}
+
+	const int32_t next = find_state(std::move(next_key));
+	if (next < 0) {
+		return false;
+	}
+
+	// Most of the time the groups just carry on, and there is nothing to record
+	int32_t map_id = KeepGroups;
+	for (size_t i = 0; i < map.size(); ++i) {
+		if (map[i] != static_cast<int32_t>(i) || map[i] == groups) {
+			map_id = (i + 1 == map.size() && map[i] == groups) ? AddGroup : 0;
+			break;
+		}
+	}
+
+	if (map_id == 0) {
+		auto it = map_index_.find(map);
+		if (it != map_index_.end()) {
+			map_id = it->second;
+		} else {
+			map_id = static_cast<int32_t>(maps_.size());
+			map_index_.emplace(map, map_id);
+			maps_.push_back(std::move(map));
+		}
+	}
+
+	Transition &transition = transitions_[static_cast<size_t>(id) * class_bytes_.size() + cls];
+	transition.next        = next;
+	transition.match       = match;
+	transition.map         = map_id;
+	return true;
+}
+
+/**
+ * @brief Dfa::end_match
+ * @param id
+ * @param ctx
+ * @param group
+ * @return true if a match of one of the groups of state "id" ends at the end
+ * of the text, in which case the oldest such group is stored in "group"
+ */
+bool Dfa::end_match(int32_t id, const Context &ctx, int32_t *group) {
+
+	const State &state = states_[static_cast<size_t>(id)];
+
+	next_generation();
+
+	size_t first = 1;
+	for (uint32_t i = 0; i < state.groups; ++i) {
+		size_t last = first;
+		while (state.key[last] != -1) {
+			++last;
+		}
+
+		if (closure(&state.key[first], &state.key[last], ctx)) {
+			*group = static_cast<int32_t>(i);
+			return true;
+		}
+
+		first = last + 1;
+	}
+
+	if (state.inject && closure(&start_, &start_ + 1, ctx)) {
+		*group = static_cast<int32_t>(state.groups);
+		return true;
+	}
+
+	return false;
+}
+
+/*----------------------------------------------------------------------*
+ * Dfa::search
+ *
+ * Finds the leftmost position in the input that a match starts at, which
+ * is where the backtracking matcher's search would find its match. Along
+ * with the DFA state, the position each of its groups started at is kept
+ * in 'births_'.
+ *----------------------------------------------------------------------*/
+Dfa::Result Dfa::search(const Regex &re, const DfaInput &input, const char **match_start) {
+
+	if (failed_) {
+		return Failed;
+	}
+
+	if (!cached_ || (uses_delimiter_ && *input.delimiters != delimiters_)) {
+		reset(*input.delimiters);
+	}
+
+	auto fail = [this]() {
+		// Don't keep trying to build a DFA this big for every search
+		failed_ = true;
+		states_      = {};
+		transitions_ = {};
+		maps_        = {};
+		state_index_ = {};
+		map_index_   = {};
+		return Failed;
+	};
+
+	const char *const eos = input.eos;
+
+	// Like the backtracking search, never stop at an 'end' before the start
+	const char *end = input.end;
+	if (end && end < input.start) {
+		end = nullptr;
+	}
+
+	/* Matches start before 'limit', or also at the end of the text if the
+	   search isn't cut short. An anchored search also tries just past a
+	   newline at 'end - 1', so one more position is allowed there. */
+	const bool cut_short = (end && end < eos);
+	const char *limit    = eos;
+	if (cut_short) {
+		limit = re.anchor ? end + 1 : end;
+	}
+
+	auto flags_at = [&](const char *p) {
+		if (p == input.start) {
+			uint8_t flags = 0;
+			if (uses_lines_ && input.prev_is_bol) {
+				flags |= PrevNewline;
+			}
+
+			if (uses_boundary_ && input.prev_is_delim) {
+				flags |= PrevDelimiter;
+			}
+
+			return flags;
+		}
+
+		return flags_after(p[-1]);
+	};
+
+	const char *p     = input.start;
+	const char *found = nullptr;
+	const char *next_literal = nullptr;
+
+	int32_t id = entry_state(flags_at(p));
+	if (id < 0) {
+		return fail();
+	}
+
+	uint32_t groups = 0;
+
+	while (true) {
+		if (p >= limit && states_[static_cast<size_t>(id)].inject && (p < eos || cut_short)) {
+			id = settled_state(id);
+			if (id < 0) {
+				return fail();
+			}
+			continue;
+		}
+
+		if (p >= eos) {
+			Context ctx;
+			ctx.prev_nl    = (states_[static_cast<size_t>(id)].flags & PrevNewline) != 0;
+			ctx.prev_delim = (states_[static_cast<size_t>(id)].flags & PrevDelimiter) != 0;
+			ctx.cur_nl     = false;
+			ctx.cur_delim  = input.succ_is_delim;
+			ctx.end        = p;
+			ctx.end_eol    = input.succ_is_eol;
+
+			int32_t group;
+			if (end_match(id, ctx, &group)) {
+				found = (static_cast<uint32_t>(group) < groups) ? births_[static_cast<size_t>(group)] : p;
+			}
+			break;
+		}
+
+		const State &state = states_[static_cast<size_t>(id)];
+
+		if (state.inject) {
+			if (state.groups == 0) {
+				/* Nothing is being matched, so the same hints which let the
+				   backtracking search skip ahead apply. */
+				const char *candidate = p;
+
+				if (re.anchor) {
+					if (!(state.flags & PrevNewline)) {
+						auto newline = static_cast<const char *>(memchr(p, '\n', static_cast<size_t>(limit - p)));
+						candidate    = newline ? newline + 1 : limit;
+					}
+				} else if (!re.literal.empty()) {
+					if (next_literal == nullptr || next_literal - p < static_cast<ptrdiff_t>(re.literal_min)) {
+						if (static_cast<size_t>(eos - p) < re.literal_min + re.literal.size()) {
+							break;
+						}
+
+						next_literal = find_string(p + re.literal_min, eos, re.literal.data(), re.literal.size());
+						if (next_literal == eos) {
+							break;
+						}
+					}
+
+					if (re.literal_max != LITERAL_UNBOUNDED && static_cast<size_t>(next_literal - p) > re.literal_max) {
+						candidate = next_literal - re.literal_max;
+					}
+				} else if (re.match_start != '\0') {
+					candidate = static_cast<const char *>(memchr(p, re.match_start, static_cast<size_t>(limit - p)));
+					if (!candidate) {
+						break;
+					}
+				}
+
+				if (candidate != p) {
+					p  = candidate;
+					id = entry_state(flags_at(p));
+					if (id < 0) {
+						return fail();
+					}
+					continue;
+				}
+			}
+		} else if (state.groups == 0) {
+			break;
+		}
+
+		const size_t cls        = classes_[static_cast<uint8_t>(*p)];
+		const Transition *trans = &transitions_[static_cast<size_t>(id) * class_bytes_.size() + cls];
+
+		if (trans->next < 0) {
+			if (!compute(id, cls)) {
+				return fail();
+			}
+
+			trans = &transitions_[static_cast<size_t>(id) * class_bytes_.size() + cls];
+		}
+
+		if (trans->match >= 0) {
+			found = (static_cast<uint32_t>(trans->match) < groups) ? births_[static_cast<size_t>(trans->match)] : p;
+		}
+
+		const auto previous = static_cast<int32_t>(groups);
+
+		id     = trans->next;
+		groups = states_[static_cast<size_t>(id)].groups;
+
+		if (trans->map == AddGroup) {
+			births_[groups - 1] = p;
+		} else if (trans->map != KeepGroups) {
+			const std::vector<int32_t> &map = maps_[static_cast<size_t>(trans->map)];
+			for (size_t i = 0; i < map.size(); ++i) {
+				next_births_[i] = (map[i] == previous) ? p : births_[static_cast<size_t>(map[i])];
+			}
+
+			births_.swap(next_births_);
+		}
+
+		++p;
+	}
+
+	if (!found) {
+		return NoMatch;
+	}
+
+	*match_start = found;
+	return Match;
+}
+
+/**
+ * @brief Dfa::memory_usage
+ * @return roughly how many bytes the NFA and the states built so far take up
+ */
+size_t Dfa::memory_usage() const {
+	size_t bytes = sizeof(Dfa);
+
+	bytes += nfa_.capacity() * sizeof(NfaState);
+	bytes += edges_.capacity() * sizeof(int32_t);
+	bytes += sets_.capacity() * sizeof(std::bitset<256>);
+	bytes += transitions_.capacity() * sizeof(Transition);
+
+	// Every state's key is stored twice, once more in the index
+	for (const State &state : states_) {
+		bytes += sizeof(State) + 2 * state.key.capacity() * sizeof(int32_t);
+	}
+
+	for (const std::vector<int32_t> &map : maps_) {
+		bytes += 2 * map.capacity() * sizeof(int32_t);
+	}
+
+	bytes += (marks_.capacity() + kernel_marks_.capacity()) * sizeof(uint32_t);
+	bytes += (stack_.capacity() + consumers_.capacity()) * sizeof(int32_t);
+	bytes += (births_.capacity() + next_births_.capacity()) * sizeof(const char *);
+	return bytes;
+}
@@ -0,0 +1,160 @@
+
+#ifndef DFA_H_
+#define DFA_H_
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class Regex;
+
+// The bytes that a node which matches a single character accepts
+bool class_set(uint8_t *node, std::bitset<256> *set);
+
+/* Everything 'Dfa::search' needs to know about a forward search. The fields
+ * mirror the state 'ExecRE' sets up for the backtracking matcher, so that both
+ * agree on where matches may start and what the assertions see at the edges
+ * of the text. */
+struct DfaInput {
+	const char *start       = nullptr; // First position a match may start at
+	const char *end         = nullptr; // Matches may not start past this (nullptr for no limit)
+	const char *eos         = nullptr; // Logical end of the text, matches can't extend past it
+	bool prev_is_bol        = false;   // Is 'start' at the beginning of a line?
+	bool prev_is_delim      = false;   // Is 'start' preceded by a word delimiter?
+	bool succ_is_eol        = false;   // Is 'eos' at the end of a line?
+	bool succ_is_delim      = false;   // Is 'eos' followed by a word delimiter?
+	const std::bitset<256> *delimiters = nullptr;
+};
+
+/* A lazily built DFA for programs without back references, look-arounds or
+ * counted {m,n} groups. It can't tell where sub-expressions begin and end, but
+ * it finds the leftmost position a match starts at in time linear in the
+ * length of the text, so the backtracking matcher only has to be run once,
+ * from that position, to fill in the details. */
+class Dfa {
+public:
+	enum Result {
+		Match,   // A match starts at the position returned
+		NoMatch, // No match can start anywhere in the search range
+		Failed,  // The DFA grew too large; use the backtracking matcher
+	};
+
+public:
+	static std::unique_ptr<Dfa> create(const std::vector<uint8_t> &program);
+
+public:
+	Dfa(const Dfa &) = delete;
+	Dfa &operator=(const Dfa &) = delete;
+	~Dfa()                      = default;
+
+private:
+	Dfa() = default;
+
+public:
+	Result search(const Regex &re, const DfaInput &input, const char **match_start);
+	size_t memory_usage() const;
+
+private:
+	struct NfaState {
+		uint8_t type;      // One of the NfaType values
+		uint8_t assertion; // The opcode of an assertion
+		uint16_t set;      // Index of the bytes a consuming state accepts
+		int32_t out;       // Next state, or first edge of a split
+		int32_t count;     // Number of edges of a split
+	};
+
+	struct Transition {
+		int32_t next  = -1; // -1 until this transition has been computed
+		int32_t match = -1; // Index of the group which matched before the byte, if any
+		int32_t map   = -1; // How the groups of the next state relate to this one's
+	};
+
+	struct State {
+		std::vector<int32_t> key; // Flags, then the NFA states of each group, each group ending with -1
+		uint32_t groups = 0;
+		uint8_t flags   = 0;
+		bool inject     = false;
+		int32_t settled = -1; // The same state once matches may no longer start
+	};
+
+	struct Context {
+		bool prev_nl;
+		bool prev_delim;
+		bool cur_nl;
+		bool cur_delim;
+		const char *end; // Set when at the end of the text, see 'assertion_holds'
+		bool end_eol;
+	};
+
+	struct KeyHash {
+		size_t operator()(const std::vector<int32_t> &key) const noexcept;
+	};
+
+private:
+	int32_t add_state(uint8_t type, uint8_t assertion = 0, uint16_t set = 0, int32_t out = -1);
+	void set_split(int32_t id, const std::vector<int32_t> &targets);
+	int32_t add_set(const std::bitset<256> &set);
+	int32_t node_set(uint8_t *node);
+	int32_t node_entry(uint8_t *node);
+	bool build(const std::vector<uint8_t> &program);
+	bool build_node(uint8_t *node, int32_t entry);
+
+	bool assertion_holds(uint8_t assertion, const Context &ctx) const;
+	void next_generation();
+	bool closure(const int32_t *first, const int32_t *last, const Context &ctx);
+	bool step(uint8_t byte, std::vector<int32_t> *key);
+	int32_t find_state(std::vector<int32_t> key);
+	int32_t entry_state(uint8_t flags);
+	int32_t settled_state(int32_t id);
+	bool compute(int32_t id, size_t cls);
+	bool end_match(int32_t id, const Context &ctx, int32_t *group);
+	void reset(const std::bitset<256> &delimiters);
+	uint8_t flags_after(char ch) const;
+
+private:
+	// Only used while building the NFA
+	uint8_t *program_ = nullptr;
+	std::vector<int32_t> node_states_; // The entry state of each node, by offset into the program
+	std::vector<uint8_t *> pending_;
+	std::unordered_map<std::bitset<256>, int32_t> set_index_;
+
+private:
+	// The program as an NFA, built once by 'create'
+	std::vector<NfaState> nfa_;
+	std::vector<int32_t> edges_;
+	std::vector<std::bitset<256>> sets_;
+	std::vector<std::pair<uint16_t, uint8_t>> delimiter_sets_; // Sets of \y and \Y, with their opcode
+	int32_t start_       = -1;
+	int32_t dead_        = -1;    // Where a chain of nodes runs out without a match
+	bool uses_lines_     = false; // Does the program contain ^ or $?
+	bool uses_boundary_  = false; // Does the program contain <, > or \B?
+	bool uses_delimiter_ = false; // Does anything depend on the word delimiters?
+
+	// The DFA, built as searches need it for the current word delimiters
+	std::bitset<256> delimiters_;
+	bool cached_ = false;
+	bool failed_ = false;
+	std::array<uint8_t, 256> classes_;
+	std::vector<uint8_t> class_bytes_;
+	std::vector<State> states_;
+	std::vector<Transition> transitions_;
+	std::vector<std::vector<int32_t>> maps_;
+	std::unordered_map<std::vector<int32_t>, int32_t, KeyHash> state_index_;
+	std::unordered_map<std::vector<int32_t>, int32_t, KeyHash> map_index_;
+	std::array<int32_t, 4> entry_states_;
+
+	// Work space
+	std::vector<uint32_t> marks_;
+	std::vector<uint32_t> kernel_marks_;
+	uint32_t generation_ = 0;
+	std::vector<int32_t> stack_;
+	std::vector<int32_t> consumers_;
+	std::vector<const char *> births_;
+	std::vector<const char *> next_births_;
+};
+
+#endif
@@ -3,9 +3,11 @@
 #include "Common.h"
 #include "Compile.h"
 #include "Constants.h"
+#include "Dfa.h"
 #include "Opcodes.h"
 #include "Regex.h"
 #include "RegexError.h"
+#include "Util/CharScan.h"
 #include "Util/Compiler.h"
 #include "Util/utils.h"
 
@@ -17,8 +19,8 @@
 
 namespace {
 
-bool match(uint8_t *prog, size_t *branch_index_param);
-bool attempt(Regex *prog, const char *string);
+bool match(ExecuteContext &ctx, uint8_t *prog, size_t *branch_index_param);
+bool attempt(ExecuteContext &ctx, Regex *prog, const char *string);
 
 /* The next_ptr () function can consume up to 30% of the time during matching
    because it is called an immense number of times (an average of 25
@@ -49,16 +51,17 @@ FORCE_INLINE inline uint8_t *NEXT_PTR(uint8_t *ptr) noexcept {
 
 /**
  * @brief end_of_string
+ * @param ctx
  * @param ptr
  * @return
  */
-FORCE_INLINE inline bool end_of_string(const char *ptr) noexcept {
+FORCE_INLINE inline bool end_of_string(const ExecuteContext &ctx, const char *ptr) noexcept {
 
-	if (eContext.End_Of_String != nullptr && ptr >= eContext.End_Of_String) {
+	if (ctx.End_Of_String != nullptr && ptr >= ctx.End_Of_String) {
 		return true;
 	}
 
-	if (ptr >= eContext.Real_End_Of_String) {
+	if (ptr >= ctx.Real_End_Of_String) {
 		return true;
 	}
 
@@ -85,13 +88,14 @@ FORCE_INLINE inline uint16_t get_upper(uint8_t *p) noexcept {
 
 /**
  * @brief is_delimiter
+ * @param ctx
  * @param ch
  * @return
  */
-bool is_delimiter(int ch) noexcept {
+bool is_delimiter(const ExecuteContext &ctx, int ch) noexcept {
 	auto n = static_cast<unsigned int>(ch);
-	if (n < eContext.Current_Delimiters.size()) {
-		return eContext.Current_Delimiters[n];
+	if (n < ctx.Current_Delimiters.size()) {
+		return ctx.Current_Delimiters[n];
 	}
 
 	return false;
@@ -99,15 +103,16 @@ bool is_delimiter(int ch) noexcept {
 
 /**
  * @brief greedy_consume
+ * @param ctx
  * @param input
  * @param max
  * @param pred
  * @return
  */
 template <class Pred>
-uint32_t greedy_consume(const char *input, uint32_t max, Pred pred) {
+uint32_t greedy_consume(const ExecuteContext &ctx, const char *input, uint32_t max, Pred pred) {
 	uint32_t count = 0;
-	while (count < max && !end_of_string(input) && pred(*input)) {
+	while (count < max && !end_of_string(ctx, input) && pred(*input)) {
 		++count;
 		++input;
 	}
@@ -127,89 +132,89 @@ uint32_t greedy_consume(const char *input, uint32_t max, Pred pred) {
  *
  * Returns the actual number of matches.
  *----------------------------------------------------------------------*/
-uint32_t greedy(uint8_t *p, uint32_t max) {
+uint32_t greedy(ExecuteContext &ctx, uint8_t *p, uint32_t max) {
 
 	uint32_t count = 0;
 
-	const char *const input_str = eContext.Reg_Input;
+	const char *const input_str = ctx.Reg_Input;
 	const uint8_t *operand      = OPERAND(p); // Literal char or start of class characters.
 	const uint32_t max_cmp      = (max > 0) ? max : std::numeric_limits<uint32_t>::max();
 
 	switch (GET_OP_CODE(p)) {
 	case ANY:
 		// Race to the end of the line or string. Dot DOESN'T match newline.
-		count = greedy_consume(input_str, max_cmp, [](char ch) { return ch != '\n'; });
+		count = greedy_consume(ctx, input_str, max_cmp, [](char ch) { return ch != '\n'; });
 		break;
 	case EVERY:
 		// Race to the end of the line or string. Dot DOES match newline.
-		count = greedy_consume(input_str, max_cmp, [](char ch) { (void)ch; return true; });
+		count = greedy_consume(ctx, input_str, max_cmp, [](char ch) { (void)ch; return true; });
 		break;
 	case EXACTLY:
 		// Count occurrences of single character operand.
-		count = greedy_consume(input_str, max_cmp, [operand](char ch) { return *operand == ch; });
+		count = greedy_consume(ctx, input_str, max_cmp, [operand](char ch) { return *operand == ch; });
 		break;
 	case SIMILAR:
 		// Case insensitive version of EXACTLY
-		count = greedy_consume(input_str, max_cmp, [operand](char ch) { return *operand == safe_ctype<tolower>(ch); });
+		count = greedy_consume(ctx, input_str, max_cmp, [operand](char ch) { return *operand == safe_ctype<tolower>(ch); });
 		break;
 	case ANY_OF:
 		// [...] character class.
-		count = greedy_consume(input_str, max_cmp, [operand](char ch) { return ::strchr(reinterpret_cast<const char *>(operand), ch) != nullptr; });
+		count = greedy_consume(ctx, input_str, max_cmp, [operand](char ch) { return ::strchr(reinterpret_cast<const char *>(operand), ch) != nullptr; });
 		break;
 	case ANY_BUT:
 		/* [^...] Negated character class- does NOT normally match newline
 		 * (\n added usually to operand at compile time.) */
-		count = greedy_consume(input_str, max_cmp, [operand](char ch) { return ::strchr(reinterpret_cast<const char *>(operand), ch) == nullptr; });
+		count = greedy_consume(ctx, input_str, max_cmp, [operand](char ch) { return ::strchr(reinterpret_cast<const char *>(operand), ch) == nullptr; });
 		break;
 	case IS_DELIM:
 		/* \y (not a word delimiter char)
 		 * NOTE: '\n' and '\0' are always word delimiters. */
-		count = greedy_consume(input_str, max_cmp, is_delimiter);
+		count = greedy_consume(ctx, input_str, max_cmp, [&ctx](char ch) { return is_delimiter(ctx, ch); });
 		break;
 	case NOT_DELIM:
 		/* \Y (not a word delimiter char)
 		 * NOTE: '\n' and '\0' are always word delimiters. */
-		count = greedy_consume(input_str, max_cmp, [](char ch) { return !is_delimiter(ch); });
+		count = greedy_consume(ctx, input_str, max_cmp, [&ctx](char ch) { return !is_delimiter(ctx, ch); });
 		break;
 	case WORD_CHAR:
 		// \w (word character, alpha-numeric or underscore)
-		count = greedy_consume(input_str, max_cmp, [](char ch) { return (safe_ctype<isalnum>(ch) || ch == '_'); });
+		count = greedy_consume(ctx, input_str, max_cmp, [](char ch) { return (safe_ctype<isalnum>(ch) || ch == '_'); });
 		break;
 	case NOT_WORD_CHAR:
 		// \W (NOT a word character)
-		count = greedy_consume(input_str, max_cmp, [](char ch) { return !safe_ctype<isalnum>(ch) && ch != '_' && ch != '\n'; });
+		count = greedy_consume(ctx, input_str, max_cmp, [](char ch) { return !safe_ctype<isalnum>(ch) && ch != '_' && ch != '\n'; });
 		break;
 	case DIGIT:
 		// same as [0123456789]
-		count = greedy_consume(input_str, max_cmp, [](char ch) { return safe_ctype<isdigit>(ch); });
+		count = greedy_consume(ctx, input_str, max_cmp, [](char ch) { return safe_ctype<isdigit>(ch); });
 		break;
 	case NOT_DIGIT:
 		// same as [^0123456789]
-		count = greedy_consume(input_str, max_cmp, [](char ch) { return !safe_ctype<isdigit>(ch) && ch != '\n'; });
+		count = greedy_consume(ctx, input_str, max_cmp, [](char ch) { return !safe_ctype<isdigit>(ch) && ch != '\n'; });
 		break;
 	case SPACE:
 		// same as [ \t\r\f\v]-- doesn't match newline.
-		count = greedy_consume(input_str, max_cmp, [](char ch) { return safe_ctype<isspace>(ch) && ch != '\n'; });
+		count = greedy_consume(ctx, input_str, max_cmp, [](char ch) { return safe_ctype<isspace>(ch) && ch != '\n'; });
 		break;
 	case SPACE_NL:
 		// same as [\n \t\r\f\v]-- matches newline.
-		count = greedy_consume(input_str, max_cmp, [](char ch) { return safe_ctype<isspace>(ch); });
+		count = greedy_consume(ctx, input_str, max_cmp, [](char ch) { return safe_ctype<isspace>(ch); });
 		break;
 	case NOT_SPACE:
 		// same as [^\n \t\r\f\v]-- doesn't match newline.
-		count = greedy_consume(input_str, max_cmp, [](char ch) { return !safe_ctype<isspace>(ch); });
+		count = greedy_consume(ctx, input_str, max_cmp, [](char ch) { return !safe_ctype<isspace>(ch); });
 		break;
 	case NOT_SPACE_NL:
 		// same as [^ \t\r\f\v]-- matches newline.
-		count = greedy_consume(input_str, max_cmp, [](char ch) { return (!safe_ctype<isspace>(ch) || ch == '\n'); });
+		count = greedy_consume(ctx, input_str, max_cmp, [](char ch) { return (!safe_ctype<isspace>(ch) || ch == '\n'); });
 		break;
 	case LETTER:
 		// same as [a-zA-Z]
-		count = greedy_consume(input_str, max_cmp, [](char ch) { return safe_ctype<isalpha>(ch); });
+		count = greedy_consume(ctx, input_str, max_cmp, [](char ch) { return safe_ctype<isalpha>(ch); });
 		break;
 	case NOT_LETTER:
 		// same as [^a-zA-Z]
-		count = greedy_consume(input_str, max_cmp, [](char ch) { return !safe_ctype<isalpha>(ch) && ch != '\n'; });
+		count = greedy_consume(ctx, input_str, max_cmp, [](char ch) { return !safe_ctype<isalpha>(ch) && ch != '\n'; });
 		break;
 	default:
 		/* Called inappropriately.  Only atoms that are SIMPLE should generate
@@ -220,10 +225,29 @@ uint32_t greedy(uint8_t *p, uint32_t max) {
 	}
 
 	// Point to character just after last matched character.
-	eContext.Reg_Input = input_str + count;
+	ctx.Reg_Input = input_str + count;
 	return count;
 }
 
+/**
+ * @brief fails_at_once
+ * @param ctx
+ * @param node
+ * @return true if "node" is a string whose first character doesn't match
+ * the input, which is how most alternatives of a list of keywords fail.
+ * Those can then be passed over without a call to 'match'.
+ */
+FORCE_INLINE inline bool fails_at_once(const ExecuteContext &ctx, uint8_t *node) noexcept {
+	switch (GET_OP_CODE(node)) {
+	case EXACTLY:
+		return end_of_string(ctx, ctx.Reg_Input) || *OPERAND(node) != *ctx.Reg_Input;
+	case SIMILAR:
+		return end_of_string(ctx, ctx.Reg_Input) || safe_ctype<tolower>(*ctx.Reg_Input) != *OPERAND(node);
+	default:
+		return false;
+	}
+}
+
 /*----------------------------------------------------------------------*
  * match - main matching routine
  *
@@ -234,28 +258,28 @@ uint32_t greedy(uint8_t *p, uint32_t max) {
  * (that don't need to know whether the rest of the match failed) by a
  * loop instead of by recursion.  Returns 0 failure, 1 success.
  *----------------------------------------------------------------------*/
-#define MATCH_RETURN(X)             \
-	do {                            \
-		--eContext.Recursion_Count; \
-		return (X);                 \
+#define MATCH_RETURN(X)        \
+	do {                       \
+		--ctx.Recursion_Count; \
+		return (X);            \
 	} while (0)
 
-#define CHECK_RECURSION_LIMIT()                  \
-	do {                                         \
-		if (eContext.Recursion_Limit_Exceeded) { \
-			MATCH_RETURN(false);                 \
-		}                                        \
+#define CHECK_RECURSION_LIMIT()             \
+	do {                                    \
+		if (ctx.Recursion_Limit_Exceeded) { \
+			MATCH_RETURN(false);            \
+		}                                   \
 	} while (0)
 
-bool match(uint8_t *prog, size_t *branch_index_param) {
+bool match_nodes(ExecuteContext &ctx, uint8_t *prog, size_t *branch_index_param) {
 
-	if (++eContext.Recursion_Count > RecursionLimit) {
+	if (++ctx.Recursion_Count > RecursionLimit) {
 		// Prevent duplicate errors
-		if (!eContext.Recursion_Limit_Exceeded) {
+		if (!ctx.Recursion_Limit_Exceeded) {
 			reg_error("recursion limit exceeded, please respecify expression");
 		}
 
-		eContext.Recursion_Limit_Exceeded = true;
+		ctx.Recursion_Limit_Exceeded = true;
 		MATCH_RETURN(false);
 	}
 
@@ -273,9 +297,9 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 				size_t branch_index_local = 0;
 
 				do {
-					const char *save = eContext.Reg_Input;
+					const char *save = ctx.Reg_Input;
 
-					if (match(OPERAND(scan), nullptr)) {
+					if (!fails_at_once(ctx, OPERAND(scan)) && match(ctx, OPERAND(scan), nullptr)) {
 						if (branch_index_param) {
 							*branch_index_param = branch_index_local;
 						}
@@ -286,8 +310,8 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 
 					++branch_index_local;
 
-					eContext.Reg_Input = save; // Backtrack.
-					scan               = NEXT_PTR(scan);
+					ctx.Reg_Input = save; // Backtrack.
+					scan          = NEXT_PTR(scan);
 				} while (scan != nullptr && GET_OP_CODE(scan) == BRANCH);
 
 				MATCH_RETURN(false); // NOT REACHED
@@ -298,22 +322,22 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 			uint8_t *opnd = OPERAND(scan);
 
 			// Inline the first character, for speed.
-			if (end_of_string(eContext.Reg_Input) || *opnd != *eContext.Reg_Input) {
+			if (end_of_string(ctx, ctx.Reg_Input) || *opnd != *ctx.Reg_Input) {
 				MATCH_RETURN(false);
 			}
 
 			const auto str   = reinterpret_cast<const char *>(opnd);
 			const size_t len = strlen(str);
 
-			if (eContext.End_Of_String != nullptr && eContext.Reg_Input + len > eContext.End_Of_String) {
+			if (ctx.End_Of_String != nullptr && ctx.Reg_Input + len > ctx.End_Of_String) {
 				MATCH_RETURN(false);
 			}
 
-			if (len > 1 && strncmp(str, eContext.Reg_Input, len) != 0) {
+			if (len > 1 && strncmp(str, ctx.Reg_Input, len) != 0) {
 				MATCH_RETURN(false);
 			}
 
-			eContext.Reg_Input += len;
+			ctx.Reg_Input += len;
 		} break;
 
 		case SIMILAR: {
@@ -323,25 +347,25 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 			/* Note: the SIMILAR operand was converted to lower case during
 				   regex compile. */
 			while ((test = *opnd++) != '\0') {
-				if (end_of_string(eContext.Reg_Input) || safe_ctype<tolower>(*eContext.Reg_Input++) != test) {
+				if (end_of_string(ctx, ctx.Reg_Input) || safe_ctype<tolower>(*ctx.Reg_Input++) != test) {
 					MATCH_RETURN(false);
 				}
 			}
 		} break;
 
 		case BOL: // '^' (beginning of line anchor)
-			if (eContext.Reg_Input == eContext.Start_Of_String) {
-				if (eContext.Prev_Is_BOL) {
+			if (ctx.Reg_Input == ctx.Start_Of_String) {
+				if (ctx.Prev_Is_BOL) {
 					break;
 				}
-			} else if (eContext.Reg_Input[-1] == '\n') {
+			} else if (ctx.Reg_Input[-1] == '\n') {
 				break;
 			}
 
 			MATCH_RETURN(false);
 
 		case EOL: // '$' anchor matches end of line and end of string
-			if ((end_of_string(eContext.Reg_Input) && eContext.Succ_Is_EOL) || *eContext.Reg_Input == '\n') {
+			if ((end_of_string(ctx, ctx.Reg_Input) && ctx.Succ_Is_EOL) || *ctx.Reg_Input == '\n') {
 				break;
 			}
 
@@ -351,18 +375,18 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 					 /* Check to see if the current character is not a delimiter and the preceding character is. */
 			{
 				bool prev_is_delim;
-				if (eContext.Reg_Input == eContext.Start_Of_String) {
-					prev_is_delim = eContext.Prev_Is_Delim;
+				if (ctx.Reg_Input == ctx.Start_Of_String) {
+					prev_is_delim = ctx.Prev_Is_Delim;
 				} else {
-					prev_is_delim = is_delimiter(eContext.Reg_Input[-1]);
+					prev_is_delim = is_delimiter(ctx, ctx.Reg_Input[-1]);
 				}
 
 				if (prev_is_delim) {
 					bool current_is_delim;
-					if (end_of_string(eContext.Reg_Input)) {
-						current_is_delim = eContext.Succ_Is_Delim;
+					if (end_of_string(ctx, ctx.Reg_Input)) {
+						current_is_delim = ctx.Succ_Is_Delim;
 					} else {
-						current_is_delim = is_delimiter(*eContext.Reg_Input);
+						current_is_delim = is_delimiter(ctx, *ctx.Reg_Input);
 					}
 
 					if (!current_is_delim) {
@@ -377,18 +401,18 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 					 /* Check to see if the current character is a delimiter and the preceding character is not. */
 			{
 				bool prev_is_delim;
-				if (eContext.Reg_Input == eContext.Start_Of_String) {
-					prev_is_delim = eContext.Prev_Is_Delim;
+				if (ctx.Reg_Input == ctx.Start_Of_String) {
+					prev_is_delim = ctx.Prev_Is_Delim;
 				} else {
-					prev_is_delim = is_delimiter(eContext.Reg_Input[-1]);
+					prev_is_delim = is_delimiter(ctx, ctx.Reg_Input[-1]);
 				}
 
 				if (!prev_is_delim) {
 					bool current_is_delim;
-					if (end_of_string(eContext.Reg_Input)) {
-						current_is_delim = eContext.Succ_Is_Delim;
+					if (end_of_string(ctx, ctx.Reg_Input)) {
+						current_is_delim = ctx.Succ_Is_Delim;
 					} else {
-						current_is_delim = is_delimiter(*eContext.Reg_Input);
+						current_is_delim = is_delimiter(ctx, *ctx.Reg_Input);
 					}
 
 					if (current_is_delim) {
@@ -404,16 +428,16 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 			bool prev_is_delim;
 			bool current_is_delim;
 
-			if (eContext.Reg_Input == eContext.Start_Of_String) {
-				prev_is_delim = eContext.Prev_Is_Delim;
+			if (ctx.Reg_Input == ctx.Start_Of_String) {
+				prev_is_delim = ctx.Prev_Is_Delim;
 			} else {
-				prev_is_delim = is_delimiter(eContext.Reg_Input[-1]);
+				prev_is_delim = is_delimiter(ctx, ctx.Reg_Input[-1]);
 			}
 
-			if (end_of_string(eContext.Reg_Input)) {
-				current_is_delim = eContext.Succ_Is_Delim;
+			if (end_of_string(ctx, ctx.Reg_Input)) {
+				current_is_delim = ctx.Succ_Is_Delim;
 			} else {
-				current_is_delim = is_delimiter(*eContext.Reg_Input);
+				current_is_delim = is_delimiter(ctx, *ctx.Reg_Input);
 			}
 
 			if (!(prev_is_delim ^ current_is_delim)) {
@@ -423,143 +447,143 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 			MATCH_RETURN(false);
 
 		case IS_DELIM: // \y (A word delimiter character.)
-			if (!end_of_string(eContext.Reg_Input) && is_delimiter(*eContext.Reg_Input)) {
-				eContext.Reg_Input++;
+			if (!end_of_string(ctx, ctx.Reg_Input) && is_delimiter(ctx, *ctx.Reg_Input)) {
+				ctx.Reg_Input++;
 				break;
 			}
 
 			MATCH_RETURN(false);
 
 		case NOT_DELIM: // \Y (NOT a word delimiter character.)
-			if (!end_of_string(eContext.Reg_Input) && !is_delimiter(*eContext.Reg_Input)) {
-				eContext.Reg_Input++;
+			if (!end_of_string(ctx, ctx.Reg_Input) && !is_delimiter(ctx, *ctx.Reg_Input)) {
+				ctx.Reg_Input++;
 				break;
 			}
 
 			MATCH_RETURN(false);
 
 		case WORD_CHAR: // \w (word character; alpha-numeric or underscore)
-			if (!end_of_string(eContext.Reg_Input) && (safe_ctype<isalnum>(*eContext.Reg_Input) || *eContext.Reg_Input == '_')) {
-				eContext.Reg_Input++;
+			if (!end_of_string(ctx, ctx.Reg_Input) && (safe_ctype<isalnum>(*ctx.Reg_Input) || *ctx.Reg_Input == '_')) {
+				ctx.Reg_Input++;
 				break;
 			}
 
 			MATCH_RETURN(false);
 
 		case NOT_WORD_CHAR: // \W (NOT a word character)
-			if (end_of_string(eContext.Reg_Input) || safe_ctype<isalnum>(*eContext.Reg_Input) || *eContext.Reg_Input == '_' || *eContext.Reg_Input == '\n') {
+			if (end_of_string(ctx, ctx.Reg_Input) || safe_ctype<isalnum>(*ctx.Reg_Input) || *ctx.Reg_Input == '_' || *ctx.Reg_Input == '\n') {
 				MATCH_RETURN(false);
 			}
 
-			eContext.Reg_Input++;
+			ctx.Reg_Input++;
 			break;
 
 		case ANY: // '.' (matches any character EXCEPT newline)
-			if (end_of_string(eContext.Reg_Input) || *eContext.Reg_Input == '\n') {
+			if (end_of_string(ctx, ctx.Reg_Input) || *ctx.Reg_Input == '\n') {
 				MATCH_RETURN(false);
 			}
 
-			eContext.Reg_Input++;
+			ctx.Reg_Input++;
 			break;
 
 		case EVERY: // '.' (matches any character INCLUDING newline)
-			if (end_of_string(eContext.Reg_Input)) {
+			if (end_of_string(ctx, ctx.Reg_Input)) {
 				MATCH_RETURN(false);
 			}
 
-			eContext.Reg_Input++;
+			ctx.Reg_Input++;
 			break;
 
 		case DIGIT: // \d, same as [0123456789]
-			if (end_of_string(eContext.Reg_Input) || !safe_ctype<isdigit>(*eContext.Reg_Input)) {
+			if (end_of_string(ctx, ctx.Reg_Input) || !safe_ctype<isdigit>(*ctx.Reg_Input)) {
 				MATCH_RETURN(false);
 			}
 
-			eContext.Reg_Input++;
+			ctx.Reg_Input++;
 			break;
 
 		case NOT_DIGIT: // \D, same as [^0123456789]
-			if (end_of_string(eContext.Reg_Input) || safe_ctype<isdigit>(*eContext.Reg_Input) || *eContext.Reg_Input == '\n') {
+			if (end_of_string(ctx, ctx.Reg_Input) || safe_ctype<isdigit>(*ctx.Reg_Input) || *ctx.Reg_Input == '\n') {
 				MATCH_RETURN(false);
 			}
 
-			eContext.Reg_Input++;
+			ctx.Reg_Input++;
 			break;
 
 		case LETTER: // \l, same as [a-zA-Z]
-			if (end_of_string(eContext.Reg_Input) || !safe_ctype<isalpha>(*eContext.Reg_Input)) {
+			if (end_of_string(ctx, ctx.Reg_Input) || !safe_ctype<isalpha>(*ctx.Reg_Input)) {
 				MATCH_RETURN(false);
 			}
 
-			eContext.Reg_Input++;
+			ctx.Reg_Input++;
 			break;
 
 		case NOT_LETTER: // \L, same as [^0123456789]
-			if (end_of_string(eContext.Reg_Input) || safe_ctype<isalpha>(*eContext.Reg_Input) || *eContext.Reg_Input == '\n') {
+			if (end_of_string(ctx, ctx.Reg_Input) || safe_ctype<isalpha>(*ctx.Reg_Input) || *ctx.Reg_Input == '\n') {
 				MATCH_RETURN(false);
 			}
 
-			eContext.Reg_Input++;
+			ctx.Reg_Input++;
 			break;
 
 		case SPACE: // \s, same as [ \t\r\f\v]
-			if (end_of_string(eContext.Reg_Input) || !safe_ctype<isspace>(*eContext.Reg_Input) || *eContext.Reg_Input == '\n') {
+			if (end_of_string(ctx, ctx.Reg_Input) || !safe_ctype<isspace>(*ctx.Reg_Input) || *ctx.Reg_Input == '\n') {
 				MATCH_RETURN(false);
 			}
 
-			eContext.Reg_Input++;
+			ctx.Reg_Input++;
 			break;
 
 		case SPACE_NL: // \s, same as [\n \t\r\f\v]
-			if (end_of_string(eContext.Reg_Input) || !safe_ctype<isspace>(*eContext.Reg_Input)) {
+			if (end_of_string(ctx, ctx.Reg_Input) || !safe_ctype<isspace>(*ctx.Reg_Input)) {
 				MATCH_RETURN(false);
 			}
 
-			eContext.Reg_Input++;
+			ctx.Reg_Input++;
 			break;
 
 		case NOT_SPACE: // \S, same as [^\n \t\r\f\v]
-			if (end_of_string(eContext.Reg_Input) || safe_ctype<isspace>(*eContext.Reg_Input)) {
+			if (end_of_string(ctx, ctx.Reg_Input) || safe_ctype<isspace>(*ctx.Reg_Input)) {
 				MATCH_RETURN(false);
 			}
 
-			eContext.Reg_Input++;
+			ctx.Reg_Input++;
 			break;
 
 		case NOT_SPACE_NL: // \S, same as [^ \t\r\f\v]
-			if (end_of_string(eContext.Reg_Input) || (safe_ctype<isspace>(*eContext.Reg_Input) && *eContext.Reg_Input != '\n')) {
+			if (end_of_string(ctx, ctx.Reg_Input) || (safe_ctype<isspace>(*ctx.Reg_Input) && *ctx.Reg_Input != '\n')) {
 				MATCH_RETURN(false);
 			}
 
-			eContext.Reg_Input++;
+			ctx.Reg_Input++;
 			break;
 
 		case ANY_OF: // [...] character class.
-			if (end_of_string(eContext.Reg_Input)) {
+			if (end_of_string(ctx, ctx.Reg_Input)) {
 				MATCH_RETURN(false); /* Needed because strchr () considers \0
 										as a member of the character set. */
 			}
 
-			if (::strchr(reinterpret_cast<char *>(OPERAND(scan)), *eContext.Reg_Input) == nullptr) {
+			if (::strchr(reinterpret_cast<char *>(OPERAND(scan)), *ctx.Reg_Input) == nullptr) {
 				MATCH_RETURN(false);
 			}
 
-			eContext.Reg_Input++;
+			ctx.Reg_Input++;
 			break;
 
 		case ANY_BUT: /* [^...] Negated character class-- does NOT normally
 					  match newline (\n added usually to operand at compile
 					  time.) */
 
-			if (end_of_string(eContext.Reg_Input)) {
+			if (end_of_string(ctx, ctx.Reg_Input)) {
 				MATCH_RETURN(false); // See comment for ANY_OF.
 			}
 
-			if (::strchr(reinterpret_cast<char *>(OPERAND(scan)), *eContext.Reg_Input) != nullptr) {
+			if (::strchr(reinterpret_cast<char *>(OPERAND(scan)), *ctx.Reg_Input) != nullptr) {
 				MATCH_RETURN(false);
 			}
 
-			eContext.Reg_Input++;
+			ctx.Reg_Input++;
 			break;
 
 		case NOTHING:
@@ -633,19 +657,19 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 				next_op = OPERAND(scan + (2 * NEXT_PTR_SIZE));
 			}
 
-			save = eContext.Reg_Input;
+			save = ctx.Reg_Input;
 
 			if (lazy) {
 				if (min > 0) {
-					num_matched = greedy(next_op, min);
+					num_matched = greedy(ctx, next_op, min);
 				}
 			} else {
-				num_matched = greedy(next_op, max);
+				num_matched = greedy(ctx, next_op, max);
 			}
 
 			while (min <= num_matched && num_matched <= max) {
-				if (next_char == '\0' || (!end_of_string(eContext.Reg_Input) && next_char == *eContext.Reg_Input)) {
-					if (match(next, nullptr)) {
+				if (next_char == '\0' || (!end_of_string(ctx, ctx.Reg_Input) && next_char == *ctx.Reg_Input)) {
+					if (match(ctx, next, nullptr)) {
 						MATCH_RETURN(true);
 					}
 
@@ -655,7 +679,10 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 				// Couldn't or didn't match.
 
 				if (lazy) {
-					if (!greedy(next_op, 1)) {
+					// The failed attempt may have moved on, inch forward from where we were
+					ctx.Reg_Input = save + num_matched;
+
+					if (!greedy(ctx, next_op, 1)) {
 						MATCH_RETURN(false);
 					}
 
@@ -666,7 +693,7 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 					break;
 				}
 
-				eContext.Reg_Input = save + num_matched;
+				ctx.Reg_Input = save + num_matched;
 			}
 
 			MATCH_RETURN(false);
@@ -675,23 +702,23 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 		break;
 
 		case END:
-			if (eContext.Extent_Ptr_FW == nullptr || (eContext.Reg_Input - eContext.Extent_Ptr_FW) > 0) {
-				eContext.Extent_Ptr_FW = eContext.Reg_Input;
+			if (ctx.Extent_Ptr_FW == nullptr || (ctx.Reg_Input - ctx.Extent_Ptr_FW) > 0) {
+				ctx.Extent_Ptr_FW = ctx.Reg_Input;
 			}
 
 			MATCH_RETURN(true); // Success!
 			break;
 
 		case INIT_COUNT:
-			eContext.BraceCounts[*OPERAND(scan)] = 0;
+			ctx.BraceCounts[*OPERAND(scan)] = 0;
 			break;
 
 		case INC_COUNT:
-			eContext.BraceCounts[*OPERAND(scan)]++;
+			ctx.BraceCounts[*OPERAND(scan)]++;
 			break;
 
 		case TEST_COUNT:
-			if (eContext.BraceCounts[*OPERAND(scan)] < static_cast<uint32_t>(GET_OFFSET(scan + NEXT_PTR_SIZE + INDEX_SIZE))) {
+			if (ctx.BraceCounts[*OPERAND(scan)] < static_cast<uint32_t>(GET_OFFSET(scan + NEXT_PTR_SIZE + INDEX_SIZE))) {
 				next = scan + NODE_SIZE + INDEX_SIZE + NEXT_PTR_SIZE;
 			}
 			break;
@@ -709,16 +736,16 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 
 #ifdef ENABLE_CROSS_REGEX_BACKREF
 			if (GET_OP_CODE(scan) == X_REGEX_BR || GET_OP_CODE(scan) == X_REGEX_BR_CI) {
-				if (eContext.Cross_Regex_Backref == nullptr) {
+				if (ctx.Cross_Regex_Backref == nullptr) {
 					MATCH_RETURN(0);
 				}
 
-				captured = eContext.Cross_Regex_Backref->startp[paren_no];
-				finish   = eContext.Cross_Regex_Backref->endp[paren_no];
+				captured = ctx.Cross_Regex_Backref->startp[paren_no];
+				finish   = ctx.Cross_Regex_Backref->endp[paren_no];
 			} else {
 #endif
-				captured = eContext.Back_Ref_Start[paren_no];
-				finish   = eContext.Back_Ref_End[paren_no];
+				captured = ctx.Back_Ref_Start[paren_no];
+				finish   = ctx.Back_Ref_End[paren_no];
 #ifdef ENABLE_CROSS_REGEX_BACKREF
 			}
 #endif
@@ -734,13 +761,13 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 				if (GET_OP_CODE(scan) == BACK_REF_CI) {
 #endif
 					while (captured < finish) {
-						if (end_of_string(eContext.Reg_Input) || safe_ctype<tolower>(*captured++) != safe_ctype<tolower>(*eContext.Reg_Input++)) {
+						if (end_of_string(ctx, ctx.Reg_Input) || safe_ctype<tolower>(*captured++) != safe_ctype<tolower>(*ctx.Reg_Input++)) {
 							MATCH_RETURN(false);
 						}
 					}
 				} else {
 					while (captured < finish) {
-						if (end_of_string(eContext.Reg_Input) || *captured++ != *eContext.Reg_Input++) {
+						if (end_of_string(ctx, ctx.Reg_Input) || *captured++ != *ctx.Reg_Input++) {
 							MATCH_RETURN(false);
 						}
 					}
@@ -755,14 +782,16 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 		case POS_AHEAD_OPEN:
 		case NEG_AHEAD_OPEN: {
 
-			const char *save = eContext.Reg_Input;
+			const char *save = ctx.Reg_Input;
 
 			/* Temporarily ignore the logical end of the string, to allow
 			   lookahead past the end. */
-			const char *saved_end  = eContext.End_Of_String;
-			eContext.End_Of_String = nullptr;
+			const char *saved_end = ctx.End_Of_String;
+			ctx.End_Of_String     = nullptr;
 
-			const bool answer = match(next, nullptr); // Does the look-ahead regex match?
+			++ctx.Look_Around_Depth;
+			const bool answer = match(ctx, next, nullptr); // Does the look-ahead regex match?
+			--ctx.Look_Around_Depth;
 
 			CHECK_RECURSION_LIMIT();
 
@@ -775,12 +804,12 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 				   may need more text than it matches to accomplish a
 				   re-match. */
 
-				if (eContext.Extent_Ptr_FW == nullptr || (eContext.Reg_Input - eContext.Extent_Ptr_FW) > 0) {
-					eContext.Extent_Ptr_FW = eContext.Reg_Input;
+				if (ctx.Extent_Ptr_FW == nullptr || (ctx.Reg_Input - ctx.Extent_Ptr_FW) > 0) {
+					ctx.Extent_Ptr_FW = ctx.Reg_Input;
 				}
 
-				eContext.Reg_Input     = save;      // Backtrack to look-ahead start.
-				eContext.End_Of_String = saved_end; // Restore logical end.
+				ctx.Reg_Input     = save;      // Backtrack to look-ahead start.
+				ctx.End_Of_String = saved_end; // Restore logical end.
 
 				/* Jump to the node just after the (?=...) or (?!...)
 				   Construct. */
@@ -793,8 +822,8 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 
 				next = NEXT_PTR(next); // Skip the LOOK_AHEAD_CLOSE
 			} else {
-				eContext.Reg_Input     = save;      // Backtrack to look-ahead start.
-				eContext.End_Of_String = saved_end; // Restore logical end.
+				ctx.Reg_Input     = save;      // Backtrack to look-ahead start.
+				ctx.End_Of_String = saved_end; // Restore logical end.
 
 				MATCH_RETURN(false);
 			}
@@ -808,13 +837,13 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 			bool found = false;
 			const char *saved_end;
 
-			save      = eContext.Reg_Input;
-			saved_end = eContext.End_Of_String;
+			save      = ctx.Reg_Input;
+			saved_end = ctx.End_Of_String;
 
 			/* Prevent overshoot (greedy matching could end past the
 			   current position) by tightening the matching boundary.
 			   Lookahead inside lookbehind can still cross that boundary. */
-			eContext.End_Of_String = eContext.Reg_Input;
+			ctx.End_Of_String = ctx.Reg_Input;
 
 			const uint16_t lower = get_lower(scan);
 			const uint16_t upper = get_upper(scan);
@@ -825,20 +854,22 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 			   is not constant: we have to make sure the expression doesn't
 			   match for _any_ of the starting positions. */
 			for (uint32_t offset = lower; offset <= upper; ++offset) {
-				eContext.Reg_Input = save - offset;
+				ctx.Reg_Input = save - offset;
 
-				if (eContext.Reg_Input < eContext.Look_Behind_To) {
+				if (ctx.Reg_Input < ctx.Look_Behind_To) {
 					// No need to look any further
 					break;
 				}
 
-				const bool answer = match(next, nullptr); // Does the look-behind regex match?
+				++ctx.Look_Around_Depth;
+				const bool answer = match(ctx, next, nullptr); // Does the look-behind regex match?
+				--ctx.Look_Around_Depth;
 
 				CHECK_RECURSION_LIMIT();
 
 				/* The match must have ended at the current position;
 				   otherwise it is invalid */
-				if (answer && eContext.Reg_Input == save) {
+				if (answer && ctx.Reg_Input == save) {
 					// It matched, exactly far enough
 					found = true;
 
@@ -850,8 +881,8 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 					   leading look-behind may need more text than it matches
 					   to accomplish a re-match. */
 
-					if (eContext.Extent_Ptr_BW == nullptr || (eContext.Extent_Ptr_BW - (save - offset)) > 0) {
-						eContext.Extent_Ptr_BW = save - offset;
+					if (ctx.Extent_Ptr_BW == nullptr || (ctx.Extent_Ptr_BW - (save - offset)) > 0) {
+						ctx.Extent_Ptr_BW = save - offset;
 					}
 
 					break;
@@ -859,8 +890,8 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 			}
 
 			// Always restore the position and the logical string end.
-			eContext.Reg_Input     = save;
-			eContext.End_Of_String = saved_end;
+			ctx.Reg_Input     = save;
+			ctx.End_Of_String = saved_end;
 
 			if ((GET_OP_CODE(scan) == POS_BEHIND_OPEN) ? found : !found) {
 				/* The look-behind matches, so we must jump to the next
@@ -891,19 +922,19 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 			if ((GET_OP_CODE(scan) > OPEN) && (GET_OP_CODE(scan) < OPEN + MaxSubExpr)) {
 
 				uint8_t no       = GET_OP_CODE(scan) - OPEN;
-				const char *save = eContext.Reg_Input;
+				const char *save = ctx.Reg_Input;
 
 				if (no < 10) {
-					eContext.Back_Ref_Start[no] = save;
-					eContext.Back_Ref_End[no]   = nullptr;
+					ctx.Back_Ref_Start[no] = save;
+					ctx.Back_Ref_End[no]   = nullptr;
 				}
 
-				if (match(next, nullptr)) {
+				if (match(ctx, next, nullptr)) {
 					/* Do not set 'Start_Ptr_Ptr' if some later invocation (think
 					   recursion) of the same parentheses already has. */
 
-					if (eContext.Start_Ptr_Ptr[no] == nullptr) {
-						eContext.Start_Ptr_Ptr[no] = save;
+					if (ctx.Start_Ptr_Ptr[no] == nullptr) {
+						ctx.Start_Ptr_Ptr[no] = save;
 					}
 
 					MATCH_RETURN(true);
@@ -913,18 +944,18 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 			} else if ((GET_OP_CODE(scan) > CLOSE) && (GET_OP_CODE(scan) < CLOSE + MaxSubExpr)) {
 
 				uint8_t no       = GET_OP_CODE(scan) - CLOSE;
-				const char *save = eContext.Reg_Input;
+				const char *save = ctx.Reg_Input;
 
 				if (no < 10) {
-					eContext.Back_Ref_End[no] = save;
+					ctx.Back_Ref_End[no] = save;
 				}
 
-				if (match(next, nullptr)) {
+				if (match(ctx, next, nullptr)) {
 					/* Do not set 'End_Ptr_Ptr' if some later invocation of the
 					   same parentheses already has. */
 
-					if (eContext.End_Ptr_Ptr[no] == nullptr) {
-						eContext.End_Ptr_Ptr[no] = save;
+					if (ctx.End_Ptr_Ptr[no] == nullptr) {
+						ctx.End_Ptr_Ptr[no] = save;
 					}
 
 					MATCH_RETURN(true);
@@ -949,32 +980,100 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 	MATCH_RETURN(false);
 }
 
+/*----------------------------------------------------------------------*
+ * match
+ *
+ * Once an attempt has called this often enough to look expensive, each
+ * node found not to match at a position is remembered, and not tried
+ * there again. Whether a node matches only depends on where it is tried,
+ * except with back references and counted {m,n} groups (which 'Memoize'
+ * rules out) and inside look-arounds, which move the end of the string.
+ *----------------------------------------------------------------------*/
+bool match(ExecuteContext &ctx, uint8_t *prog, size_t *branch_index_param) {
+
+	if (!ctx.Memoize || ctx.Look_Around_Depth != 0 || ++ctx.Match_Calls < MemoThreshold) {
+		return match_nodes(ctx, prog, branch_index_param);
+	}
+
+	const auto position = static_cast<size_t>(ctx.Reg_Input - ctx.Memo_Start);
+	if (ctx.Reg_Input < ctx.Memo_Start || position >= ctx.Memo_Width) {
+		return match_nodes(ctx, prog, branch_index_param);
+	}
+
+	std::vector<uint64_t> &memo = ctx.Scratch->memo;
+
+	// Only allocated once an attempt gets expensive
+	if (memo.size() < ctx.Memo_Size) {
+		memo.resize(ctx.Memo_Size);
+	}
+
+	const size_t bit    = static_cast<size_t>(prog - ctx.Program) * ctx.Memo_Width + position;
+	const uint64_t mask = uint64_t(1) << (bit % 64);
+	const size_t word   = bit / 64;
+
+	if (memo[word] & mask) {
+		return false;
+	}
+
+	if (match_nodes(ctx, prog, branch_index_param)) {
+		return true;
+	}
+
+	// Giving up on the recursion limit says nothing about the node
+	if (!ctx.Recursion_Limit_Exceeded) {
+		if (memo[word] == 0) {
+			ctx.Scratch->memo_used.push_back(word);
+		}
+
+		memo[word] |= mask;
+	}
+
+	return false;
+}
+
 /*----------------------------------------------------------------------*
  * attempt - try match at specific point, returns: false failure, true success
  *----------------------------------------------------------------------*/
-bool attempt(Regex *prog, const char *string) {
+bool attempt(ExecuteContext &ctx, Regex *prog, const char *string) {
 
 	size_t branch_index = 0; // Must be set to zero !
 
-	eContext.Reg_Input     = string;
-	eContext.Start_Ptr_Ptr = prog->startp.begin();
-	eContext.End_Ptr_Ptr   = prog->endp.begin();
+	ctx.Reg_Input     = string;
+	ctx.Start_Ptr_Ptr = prog->startp.begin();
+	ctx.End_Ptr_Ptr   = prog->endp.begin();
 
 	// Reset the recursion counter.
-	eContext.Recursion_Count = 0;
+	ctx.Recursion_Count = 0;
+
+	// Forget what failed in the last attempt.
+	ctx.Match_Calls = 0;
+	if (ctx.Memoize) {
+		for (size_t word : ctx.Scratch->memo_used) {
+			ctx.Scratch->memo[word] = 0;
+		}
+
+		ctx.Scratch->memo_used.clear();
+
+		const char *const end = ctx.End_Of_String && ctx.End_Of_String < ctx.Real_End_Of_String ? ctx.End_Of_String : ctx.Real_End_Of_String;
+		const size_t length   = (end > string) ? static_cast<size_t>(end - string) : 0;
+
+		ctx.Memo_Start = string;
+		ctx.Memo_Width = std::min(length + 1, MemoBits / prog->program.size());
+		ctx.Memo_Size  = (ctx.Memo_Width * prog->program.size() + 63) / 64;
+	}
 
 	// Overhead due to capturing parentheses.
-	eContext.Extent_Ptr_BW = string;
-	eContext.Extent_Ptr_FW = nullptr;
+	ctx.Extent_Ptr_BW = string;
+	ctx.Extent_Ptr_FW = nullptr;
 
-	std::fill_n(prog->startp.begin(), eContext.Total_Paren + 1, nullptr);
-	std::fill_n(prog->endp.begin(), eContext.Total_Paren + 1, nullptr);
+	std::fill_n(prog->startp.begin(), ctx.Total_Paren + 1, nullptr);
+	std::fill_n(prog->endp.begin(), ctx.Total_Paren + 1, nullptr);
 
-	if (match((&prog->program[0] + REGEX_START_OFFSET), &branch_index)) {
+	if (match(ctx, (&prog->program[0] + REGEX_START_OFFSET), &branch_index)) {
 		prog->startp[0]  = string;
-		prog->endp[0]    = eContext.Reg_Input;     // <-- One char AFTER
-		prog->extentpBW  = eContext.Extent_Ptr_BW; //     matched string!
-		prog->extentpFW  = eContext.Extent_Ptr_FW;
+		prog->endp[0]    = ctx.Reg_Input;     // <-- One char AFTER
+		prog->extentpBW  = ctx.Extent_Ptr_BW; //     matched string!
+		prog->extentpFW  = ctx.Extent_Ptr_FW;
 		prog->top_branch = branch_index;
 
 		return true;
@@ -1035,6 +1134,35 @@ look_behind_to start             end           match_to
  */
 bool Regex::ExecRE(const char *start, const char *end, bool reverse, int prev_char, int succ_char, const char *delimiters, const char *look_behind_to, const char *match_to, const char *string_end) {
 
+	// If caller has supplied delimiters, make a delimiter table
+	return ExecRE(
+		start,
+		end,
+		reverse,
+		prev_char,
+		succ_char,
+		delimiters ? Regex::makeDelimiterTable(delimiters) : Regex::Default_Delimiters,
+		look_behind_to,
+		match_to,
+		string_end,
+		nullptr);
+}
+
+/**
+ * @brief Regex::ExecRE
+ * @param string
+ * @param end
+ * @param reverse
+ * @param prev_char
+ * @param succ_char
+ * @param delimiters
+ * @param look_behind_to
+ * @param match_to
+ * @param scratch
+ * @return
+ */
+bool Regex::ExecRE(const char *start, const char *end, bool reverse, int prev_char, int succ_char, const std::bitset<256> &delimiters, const char *look_behind_to, const char *match_to, const char *string_end, RegexScratch *scratch) {
+
 	Regex *const re = this;
 
 	// Check validity of program.
@@ -1046,15 +1174,24 @@ bool Regex::ExecRE(const char *start, const char *end, bool reverse, int prev_ch
 	const char *str;
 	bool ret_val = false;
 
-	// If caller has supplied delimiters, make a delimiter table
-	eContext.Current_Delimiters = delimiters ? Regex::makeDelimiterTable(delimiters) : Regex::Default_Delimiters;
+	// All of the state of this search, private to this call
+	ExecuteContext ctx;
+
+	// Without the caller's scratch, whatever memory is needed only lasts for this call
+	RegexScratch local_scratch;
+	if (!scratch) {
+		scratch = &local_scratch;
+	}
+
+	ctx.Scratch            = scratch;
+	ctx.Current_Delimiters = delimiters;
 
 	// Remember the logical and physical end of the string.
-	eContext.End_Of_String      = match_to;
-	eContext.Real_End_Of_String = string_end;
+	ctx.End_Of_String      = match_to;
+	ctx.Real_End_Of_String = string_end;
 
 	if (!end && reverse) {
-		for (end = start; !end_of_string(end); end++) {
+		for (end = start; !end_of_string(ctx, end); end++) {
 		}
 		succ_char = '\n';
 	} else if (!end) {
@@ -1062,23 +1199,29 @@ bool Regex::ExecRE(const char *start, const char *end, bool reverse, int prev_ch
 	}
 
 	// Remember the beginning of the string for matching BOL
-	eContext.Start_Of_String = start;
-	eContext.Look_Behind_To  = (look_behind_to ? look_behind_to : start);
+	ctx.Start_Of_String = start;
+	ctx.Look_Behind_To  = (look_behind_to ? look_behind_to : start);
 
-	eContext.Prev_Is_BOL   = (prev_char == '\n') || (prev_char == -1);
-	eContext.Succ_Is_EOL   = (succ_char == '\n') || (succ_char == -1);
-	eContext.Prev_Is_Delim = (prev_char == -1) || eContext.Current_Delimiters[static_cast<uint8_t>(prev_char)];
-	eContext.Succ_Is_Delim = (succ_char == -1) || eContext.Current_Delimiters[static_cast<uint8_t>(succ_char)];
+	ctx.Prev_Is_BOL   = (prev_char == '\n') || (prev_char == -1);
+	ctx.Succ_Is_EOL   = (succ_char == '\n') || (succ_char == -1);
+	ctx.Prev_Is_Delim = (prev_char == -1) || ctx.Current_Delimiters[static_cast<uint8_t>(prev_char)];
+	ctx.Succ_Is_Delim = (succ_char == -1) || ctx.Current_Delimiters[static_cast<uint8_t>(succ_char)];
 
-	eContext.Total_Paren = re->program[1];
-	eContext.Num_Braces  = re->program[2];
+	ctx.Total_Paren = re->program[1];
+	ctx.Num_Braces  = re->program[2];
+	ctx.Program     = &re->program[0];
+	ctx.Memoize     = re->memoize;
 
 	// Reset the recursion detection flag
-	eContext.Recursion_Limit_Exceeded = false;
+	ctx.Recursion_Limit_Exceeded = false;
 
-	// Allocate memory for {m,n} construct counting variables if need be.
-	if (eContext.Num_Braces > 0) {
-		eContext.BraceCounts = std::make_unique<uint32_t[]>(eContext.Num_Braces);
+	// Make room for {m,n} construct counting variables if need be.
+	if (ctx.Num_Braces > 0) {
+		if (scratch->brace_counts.size() < ctx.Num_Braces) {
+			scratch->brace_counts.resize(ctx.Num_Braces);
+		}
+
+		ctx.BraceCounts = scratch->brace_counts.data();
 	}
 
 	/* Initialize the first nine (9) capturing parentheses start and end
@@ -1089,8 +1232,8 @@ bool Regex::ExecRE(const char *start, const char *end, bool reverse, int prev_ch
 	std::fill_n(re->startp.begin(), 9, start);
 	std::fill_n(re->endp.begin(), 9, start);
 
-	auto checked_return = [](bool value) {
-		if (eContext.Recursion_Limit_Exceeded) {
+	auto checked_return = [&ctx](bool value) {
+		if (ctx.Recursion_Limit_Exceeded) {
 			return false;
 		}
 
@@ -1098,17 +1241,51 @@ bool Regex::ExecRE(const char *start, const char *end, bool reverse, int prev_ch
 	};
 
 	if (!reverse) { // Forward Search
+		if (re->dfa) {
+			/* Find where the leftmost match starts in one pass, then only try
+			   to match from there to fill in the sub-expressions. */
+			DfaInput input;
+			input.start         = start;
+			input.end           = end;
+			input.eos           = (ctx.End_Of_String != nullptr && ctx.End_Of_String < ctx.Real_End_Of_String) ? ctx.End_Of_String : ctx.Real_End_Of_String;
+			input.prev_is_bol   = ctx.Prev_Is_BOL;
+			input.prev_is_delim = ctx.Prev_Is_Delim;
+			input.succ_is_eol   = ctx.Succ_Is_EOL;
+			input.succ_is_delim = ctx.Succ_Is_Delim;
+			input.delimiters    = &ctx.Current_Delimiters;
+
+			const char *match_start = nullptr;
+			switch (re->dfa->search(*re, input, &match_start)) {
+			case Dfa::Match:
+				if (attempt(ctx, re, match_start)) {
+					return checked_return(true);
+				}
+
+				if (ctx.Recursion_Limit_Exceeded) {
+					return checked_return(false);
+				}
+
+				// Shouldn't happen, but the searches below will have the final word
+				break;
+			case Dfa::NoMatch:
+				return checked_return(false);
+			case Dfa::Failed:
+				// Grew too large for this program, search the usual way
+				break;
+			}
+		}
+
 		if (re->anchor) {
 			// Search is anchored at BOL
-			if (attempt(re, start)) {
+			if (attempt(ctx, re, start)) {
 				ret_val = true;
 				return checked_return(ret_val);
 			}
 
-			for (str = start; !end_of_string(str) && str != end && !eContext.Recursion_Limit_Exceeded; str++) {
+			for (str = start; !end_of_string(ctx, str) && str != end && !ctx.Recursion_Limit_Exceeded; str++) {
 
 				if (*str == '\n') {
-					if (attempt(re, str + 1)) {
+					if (attempt(ctx, re, str + 1)) {
 						ret_val = true;
 						break;
 					}
@@ -1117,12 +1294,53 @@ bool Regex::ExecRE(const char *start, const char *end, bool reverse, int prev_ch
 
 			return checked_return(ret_val);
 
+		} else if (!re->literal.empty()) {
+			/* We know a string that every match contains, at a limited
+			   distance from where it starts. Only try where the nearest
+			   occurrence of it could belong to a match. */
+			const char *literal_end = ctx.Real_End_Of_String;
+			if (ctx.End_Of_String != nullptr && ctx.End_Of_String < literal_end) {
+				literal_end = ctx.End_Of_String;
+			}
+
+			const char *found = nullptr;
+
+			for (str = start; !end_of_string(ctx, str) && str != end && !ctx.Recursion_Limit_Exceeded; str++) {
+
+				if (found == nullptr || found - str < static_cast<ptrdiff_t>(re->literal_min)) {
+					if (static_cast<size_t>(literal_end - str) < re->literal_min + re->literal.size()) {
+						break;
+					}
+
+					found = find_string(str + re->literal_min, literal_end, re->literal.data(), re->literal.size());
+					if (found == literal_end) {
+						break;
+					}
+				}
+
+				if (re->literal_max != LITERAL_UNBOUNDED && static_cast<size_t>(found - str) > re->literal_max) {
+					// Skip ahead to where the literal is close enough, unless that is past the end of the search
+					const char *next = found - re->literal_max;
+					if (end != nullptr && next >= end) {
+						break;
+					}
+
+					str = next;
+				}
+
+				if (attempt(ctx, re, str)) {
+					ret_val = true;
+					break;
+				}
+			}
+
+			return checked_return(ret_val);
 		} else if (re->match_start != '\0') {
 			// We know what char match must start with.
-			for (str = start; !end_of_string(str) && str != end && !eContext.Recursion_Limit_Exceeded; str++) {
+			for (str = start; !end_of_string(ctx, str) && str != end && !ctx.Recursion_Limit_Exceeded; str++) {
 
 				if (*str == static_cast<uint8_t>(re->match_start)) {
-					if (attempt(re, str)) {
+					if (attempt(ctx, re, str)) {
 						ret_val = true;
 						break;
 					}
@@ -1132,9 +1350,14 @@ bool Regex::ExecRE(const char *start, const char *end, bool reverse, int prev_ch
 			return checked_return(ret_val);
 		} else {
 			// General case
-			for (str = start; !end_of_string(str) && str != end && !eContext.Recursion_Limit_Exceeded; str++) {
+			for (str = start; !end_of_string(ctx, str) && str != end && !ctx.Recursion_Limit_Exceeded; str++) {
 
-				if (attempt(re, str)) {
+				// A match can't begin with a byte no alternative of the regex begins with
+				if (re->first_bytes_known && !re->first_bytes[static_cast<uint8_t>(*str)]) {
+					continue;
+				}
+
+				if (attempt(ctx, re, str)) {
 					ret_val = true;
 					break;
 				}
@@ -1142,11 +1365,11 @@ bool Regex::ExecRE(const char *start, const char *end, bool reverse, int prev_ch
 
 			// Beware of a single $ matching \0
 #if 1 // NOTE(eteran): possible fix for issue #97
-			if (!eContext.Recursion_Limit_Exceeded && !ret_val && end_of_string(str)) {
+			if (!ctx.Recursion_Limit_Exceeded && !ret_val && end_of_string(ctx, str)) {
 #else
-			if (!eContext.Recursion_Limit_Exceeded && !ret_val && end_of_string(str) && str != end) {
+			if (!ctx.Recursion_Limit_Exceeded && !ret_val && end_of_string(ctx, str) && str != end) {
 #endif
-				if (attempt(re, str)) {
+				if (attempt(ctx, re, str)) {
 					ret_val = true;
 				}
 			}
@@ -1156,32 +1379,156 @@ bool Regex::ExecRE(const char *start, const char *end, bool reverse, int prev_ch
 	} else { // Search reverse, same as forward, but loops run backward
 
 		// Make sure that we don't start matching beyond the logical end
-		if (eContext.End_Of_String != nullptr && end > eContext.End_Of_String) {
-			end = eContext.End_Of_String;
+		if (ctx.End_Of_String != nullptr && end > ctx.End_Of_String) {
+			end = ctx.End_Of_String;
+		}
+
+		if (re->dfa && end >= start) {
+			/* The DFA only finds where the leftmost match starts, so search
+			   forward through a block at the end of the range, keeping the
+			   last match found, and only go back to an earlier block when
+			   that one has none. This costs about as much as a forward
+			   search for a match the same distance away. */
+			DfaInput input;
+			input.eos           = (ctx.End_Of_String != nullptr && ctx.End_Of_String < ctx.Real_End_Of_String) ? ctx.End_Of_String : ctx.Real_End_Of_String;
+			input.succ_is_eol   = ctx.Succ_Is_EOL;
+			input.succ_is_delim = ctx.Succ_Is_Delim;
+			input.delimiters    = &ctx.Current_Delimiters;
+
+			const char *last   = end; // The last position a match may start at in this block
+			size_t block       = ReverseBlockSize;
+			Dfa::Result result = Dfa::NoMatch;
+
+			while (true) {
+				const char *first = (static_cast<size_t>(last - start) > block) ? last - block : start;
+				const char *found = nullptr;
+
+				// Let matches start up to 'last', an anchored search already allows one position past 'end'
+				if (last >= input.eos) {
+					input.end = nullptr;
+				} else {
+					input.end = re->anchor ? last : last + 1;
+				}
+
+				for (const char *from = first;;) {
+					input.start         = from;
+					input.prev_is_bol   = (from == start) ? ctx.Prev_Is_BOL : from[-1] == '\n';
+					input.prev_is_delim = (from == start) ? ctx.Prev_Is_Delim : ctx.Current_Delimiters[static_cast<uint8_t>(from[-1])];
+
+					const char *match_start = nullptr;
+					result = re->dfa->search(*re, input, &match_start);
+					if (result != Dfa::Match) {
+						break;
+					}
+
+					// When 'last' is just before the end of the text, the DFA also tries the end itself
+					if (match_start > last) {
+						result = Dfa::NoMatch;
+						break;
+					}
+
+					found = match_start;
+					if (match_start >= last) {
+						break;
+					}
+
+					from = match_start + 1;
+				}
+
+				if (result == Dfa::Failed) {
+					// Grew too large for this program, search the rest the usual way
+					break;
+				}
+
+				if (found) {
+					if (attempt(ctx, re, found)) {
+						return checked_return(true);
+					}
+
+					if (ctx.Recursion_Limit_Exceeded) {
+						return checked_return(false);
+					}
+
+					// Shouldn't happen, but the searches below will have the final word
+					break;
+				}
+
+				if (first == start) {
+					return checked_return(false);
+				}
+
+				last = first - 1;
+				block *= 2;
+			}
+
+			end = last;
 		}
 
 		if (re->anchor) {
 			// Search is anchored at BOL
-			for (str = (end - 1); str >= start && !eContext.Recursion_Limit_Exceeded; str--) {
+			for (str = (end - 1); str >= start && !ctx.Recursion_Limit_Exceeded; str--) {
 				if (*str == '\n') {
-					if (attempt(re, str + 1)) {
+					if (attempt(ctx, re, str + 1)) {
 						ret_val = true;
 						return checked_return(ret_val);
 					}
 				}
 			}
 
-			if (!eContext.Recursion_Limit_Exceeded && attempt(re, start)) {
+			if (!ctx.Recursion_Limit_Exceeded && attempt(ctx, re, start)) {
 				ret_val = true;
 				return checked_return(ret_val);
 			}
 
+			return checked_return(ret_val);
+		} else if (!re->literal.empty()) {
+			/* Only try where the nearest occurrence of the literal that every
+			   match contains could belong to a match, like the forward search
+			   but looking for the last occurrence instead of the first. */
+			const char *literal_end = ctx.Real_End_Of_String;
+			if (ctx.End_Of_String != nullptr && ctx.End_Of_String < literal_end) {
+				literal_end = ctx.End_Of_String;
+			}
+
+			const size_t length = re->literal.size();
+			const char *found   = nullptr;
+
+			for (str = end; str >= start && !ctx.Recursion_Limit_Exceeded; str--) {
+
+				if (found == nullptr || (re->literal_max != LITERAL_UNBOUNDED && found - str > static_cast<ptrdiff_t>(re->literal_max))) {
+					// The last occurrence which isn't too far from "str" to be part of a match starting there
+					const char *limit = literal_end;
+					if (re->literal_max != LITERAL_UNBOUNDED && static_cast<size_t>(literal_end - str) > re->literal_max + length) {
+						limit = str + re->literal_max + length;
+					}
+
+					if (static_cast<size_t>(limit - start) < re->literal_min + length) {
+						break;
+					}
+
+					found = rfind_string(start + re->literal_min, limit, re->literal.data(), length);
+					if (found == limit) {
+						break;
+					}
+				}
+
+				if (found - str < static_cast<ptrdiff_t>(re->literal_min)) {
+					// Skip back to where the literal is far enough
+					str = found - re->literal_min;
+				}
+
+				if (attempt(ctx, re, str)) {
+					ret_val = true;
+					break;
+				}
+			}
+
 			return checked_return(ret_val);
 		} else if (re->match_start != '\0') {
 			// We know what char match must start with.
-			for (str = end; str >= start && !eContext.Recursion_Limit_Exceeded; str--) {
+			for (str = end; str >= start && !ctx.Recursion_Limit_Exceeded; str--) {
 				if (*str == static_cast<uint8_t>(re->match_start)) {
-					if (attempt(re, str)) {
+					if (attempt(ctx, re, str)) {
 						ret_val = true;
 						break;
 					}
@@ -1191,8 +1538,12 @@ bool Regex::ExecRE(const char *start, const char *end, bool reverse, int prev_ch
 			return checked_return(ret_val);
 		} else {
 			// General case
-			for (str = end; str >= start && !eContext.Recursion_Limit_Exceeded; str--) {
-				if (attempt(re, str)) {
+			for (str = end; str >= start && !ctx.Recursion_Limit_Exceeded; str--) {
+				if (re->first_bytes_known && !re->first_bytes[static_cast<uint8_t>(*str)]) {
+					continue;
+				}
+
+				if (attempt(ctx, re, str)) {
 					ret_val = true;
 					break;
 				}
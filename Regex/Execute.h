@@ -12,40 +12,49 @@
 // #define ENABLE_CROSS_REGEX_BACKREF
 
 class Regex;
+struct RegexScratch;
 
-// Global work variables for 'ExecRE'.
+/* Work variables for 'ExecRE'. Each call to 'ExecRE' keeps its matching
+ * state in its own context, so any number of searches (with different
+ * 'Regex' objects) may run at the same time on different threads. */
 
 template <size_t N>
 using array_iterator = typename std::array<const char *, N>::iterator;
 
 struct ExecuteContext {
-	std::unique_ptr<uint32_t[]> BraceCounts;     // Define a pointer to an array to hold general (...){m,n} counts.
-	const char *Reg_Input;                       // String-input pointer.
-	const char *Start_Of_String;                 // Beginning of input, for ^ and < checks.
-	const char *End_Of_String;                   // Logical end of input
-	const char *Real_End_Of_String;              // Point that the string truly ends and we may not pass safely
-	const char *Look_Behind_To;                  // Position till were look behind can safely check back
-	array_iterator<MaxSubExpr> Start_Ptr_Ptr;    // Pointer to 'startp' array.
-	array_iterator<MaxSubExpr> End_Ptr_Ptr;      // Ditto for 'endp'.
-	const char *Extent_Ptr_FW;                   // Forward extent pointer
-	const char *Extent_Ptr_BW;                   // Backward extent pointer
-	std::array<const char *, 10> Back_Ref_Start; // Back_Ref_Start [0] and
-	std::array<const char *, 10> Back_Ref_End;   // Back_Ref_End [0] are not used. This simplifies indexing.
-	int Recursion_Count;                         // Recursion counter
+	uint32_t *BraceCounts                       = nullptr; // Define a pointer to an array to hold general (...){m,n} counts.
+	const char *Reg_Input                       = nullptr; // String-input pointer.
+	const char *Start_Of_String                 = nullptr; // Beginning of input, for ^ and < checks.
+	const char *End_Of_String                   = nullptr; // Logical end of input
+	const char *Real_End_Of_String              = nullptr; // Point that the string truly ends and we may not pass safely
+	const char *Look_Behind_To                  = nullptr; // Position till were look behind can safely check back
+	array_iterator<MaxSubExpr> Start_Ptr_Ptr    = {};      // Pointer to 'startp' array.
+	array_iterator<MaxSubExpr> End_Ptr_Ptr      = {};      // Ditto for 'endp'.
+	const char *Extent_Ptr_FW                   = nullptr; // Forward extent pointer
+	const char *Extent_Ptr_BW                   = nullptr; // Backward extent pointer
+	std::array<const char *, 10> Back_Ref_Start = {};      // Back_Ref_Start [0] and
+	std::array<const char *, 10> Back_Ref_End   = {};      // Back_Ref_End [0] are not used. This simplifies indexing.
+	int Recursion_Count                         = 0;       // Recursion counter
+	const uint8_t *Program                      = nullptr; // Start of the program, for numbering its nodes
+	RegexScratch *Scratch                       = nullptr; // Where 'BraceCounts' and the memo live
+	const char *Memo_Start                      = nullptr; // Position of the first column of the memo
+	size_t Memo_Width                           = 0;       // Number of positions the memo covers
+	size_t Memo_Size                            = 0;       // Number of words the memo needs for this attempt
+	uint32_t Match_Calls                        = 0;       // Calls to 'match' during this attempt
+	int Look_Around_Depth                       = 0;       // Nesting of look-aheads and look-behinds
 
 #ifdef ENABLE_CROSS_REGEX_BACKREF
-	Regex *Cross_Regex_Backref;
+	Regex *Cross_Regex_Backref = nullptr;
 #endif
-	uint8_t Num_Braces;  // Number of general {m,n} constructs. {m,n} quantifiers of SIMPLE atoms are not included in this count.
-	uint8_t Total_Paren; // Parentheses, (),  counter.
-	bool Prev_Is_BOL;
-	bool Succ_Is_EOL;
-	bool Prev_Is_Delim;
-	bool Succ_Is_Delim;
-	bool Recursion_Limit_Exceeded;       // Recursion limit exceeded flag
-	std::bitset<256> Current_Delimiters; // Current delimiter table
+	uint8_t Num_Braces                  = 0;     // Number of general {m,n} constructs. {m,n} quantifiers of SIMPLE atoms are not included in this count.
+	uint8_t Total_Paren                 = 0;     // Parentheses, (),  counter.
+	bool Prev_Is_BOL                    = false;
+	bool Succ_Is_EOL                    = false;
+	bool Prev_Is_Delim                  = false;
+	bool Succ_Is_Delim                  = false;
+	bool Recursion_Limit_Exceeded       = false; // Recursion limit exceeded flag
+	bool Memoize                        = false; // May failures be remembered in the memo?
+	std::bitset<256> Current_Delimiters = {};    // Current delimiter table
 };
 
-extern ExecuteContext eContext;
-
 #endif
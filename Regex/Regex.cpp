@@ -80,6 +80,7 @@
 #include "Regex.h"
 #include "Common.h"
 #include "Compile.h"
+#include "Dfa.h"
 #include "Execute.h"
 
 #include <cassert>
@@ -87,8 +88,8 @@
 // Default table for determining whether a character is a word delimiter.
 std::bitset<256> Regex::Default_Delimiters;
 
-ExecuteContext eContext;
-ParseContext pContext;
+// Each thread gets its own, so that regexes can be compiled on several at once
+thread_local ParseContext pContext;
 
 /* The "internal use only" fields in `Regex.h' are present to pass info from
  * `CompileRE' to `ExecRE' which permits the execute phase to run lots faster on
@@ -96,9 +97,21 @@ ParseContext pContext;
  *
  *   match_start     Character that must begin a match; '\0' if none obvious.
  *   anchor          Is the match anchored (at beginning-of-line only)?
+ *   literal         Text that every match must contain; empty if none obvious.
+ *   literal_min     Least and greatest distance from the start of a match to
+ *   literal_max     where 'literal' appears in it (LITERAL_UNBOUNDED if any).
+ *   memoize         Can ExecRE remember where parts of the regex failed?
+ *   dfa             Finds where matches start without backtracking; nullptr
+ *                   if the program needs back references or the like.
  *
  * `match_start' and `anchor' permit very fast decisions on suitable starting
- * points for a match, considerably reducing the work done by ExecRE. */
+ * points for a match, considerably reducing the work done by ExecRE. Likewise,
+ * ExecRE only tries to match where 'literal' can be found at the right
+ * distance, which it can look for much faster than it can try to match.
+ * When there is a `dfa', ExecRE lets it find the start of the leftmost match
+ * in one pass over the text, and only tries to match from there. With
+ * `memoize', a costly attempt at a match never tries the same part of the
+ * regex at the same position twice, so it can't take exponential time. */
 
 /* A node is one char of opcode followed by two chars of NEXT pointer plus
  * any operands.  NEXT pointers are stored as two 8-bit pieces, high order
@@ -109,6 +122,11 @@ ParseContext pContext;
  * Using two bytes for NEXT_PTR_SIZE is vast overkill for most things,
  * but allows patterns to get big without disasters. */
 
+/**
+ * @brief Regex::~Regex
+ */
+Regex::~Regex() = default;
+
 /**
  * @brief Regex::execute
  * @param string
@@ -188,6 +206,56 @@ bool Regex::execute(view::string_view string, size_t offset, size_t end_offset,
 		&string[string.size()]);
 }
 
+/**
+ * @brief Regex::execute
+ * @param string
+ * @param offset
+ * @param end_offset
+ * @param delimiters
+ * @param scratch
+ * @param reverse
+ * @return
+ */
+bool Regex::execute(view::string_view string, size_t offset, size_t end_offset, const std::bitset<256> &delimiters, RegexScratch *scratch, bool reverse) {
+	return execute(
+		string,
+		offset,
+		end_offset,
+		(offset == 0) ? -1 : string[offset - 1],
+		(end_offset == string.size()) ? -1 : string[end_offset],
+		delimiters,
+		scratch,
+		reverse);
+}
+
+/**
+ * @brief Regex::execute
+ * @param string
+ * @param offset
+ * @param end_offset
+ * @param prev
+ * @param succ
+ * @param delimiters
+ * @param scratch
+ * @param reverse
+ * @return
+ */
+bool Regex::execute(view::string_view string, size_t offset, size_t end_offset, int prev, int succ, const std::bitset<256> &delimiters, RegexScratch *scratch, bool reverse) {
+	assert(offset <= end_offset);
+	assert(end_offset <= string.size());
+	return ExecRE(
+		&string[offset],
+		&string[end_offset],
+		reverse,
+		prev,
+		succ,
+		delimiters,
+		&string[0],
+		&string[string.size()],
+		&string[string.size()],
+		scratch);
+}
+
 /*----------------------------------------------------------------------*
  * SetDefaultWordDelimiters
  *
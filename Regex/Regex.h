@@ -10,6 +10,7 @@
 #include <bitset>
 #include <cstdint>
 #include <memory>
+#include <string>
 #include <vector>
 
 /* Flags for CompileRE default settings (Markus Schwarzenberg) */
@@ -19,12 +20,24 @@ enum RE_DEFAULT_FLAG {
 	/* REDFLT_MATCH_NEWLINE = 2    Currently not used. */
 };
 
+class Dfa;
+
+/* Memory that 'ExecRE' needs for some regexes. Callers which search over and
+ * over, like syntax highlighting, can keep one and hand it to every call so
+ * that it isn't allocated anew each time. It may only be used by one search
+ * at a time, but it doesn't matter which regexes those searches use. */
+struct RegexScratch {
+	std::vector<uint32_t> brace_counts; /* Internal use only. */
+	std::vector<uint64_t> memo;         /* Internal use only. */
+	std::vector<size_t> memo_used;      /* Internal use only. */
+};
+
 class Regex {
 public:
 	Regex(view::string_view exp, int defaultFlags);
 	Regex(const Regex &) = delete;
 	Regex &operator=(const Regex &) = delete;
-	~Regex()                        = default;
+	~Regex();
 
 public:
 	/**
@@ -41,6 +54,14 @@ public:
 	 */
 	bool ExecRE(const char *string, const char *end, bool reverse, int prev_char, int succ_char, const char *delimiters, const char *look_behind_to, const char *match_to, const char *string_end);
 
+	/**
+	 * Like the above, but nothing needs to be set up for each call.
+	 *
+	 * @param delimiters     Word delimiter table, see 'makeDelimiterTable'
+	 * @param scratch        Memory to reuse from earlier calls (nullptr to allocate what is needed)
+	 */
+	bool ExecRE(const char *string, const char *end, bool reverse, int prev_char, int succ_char, const std::bitset<256> &delimiters, const char *look_behind_to, const char *match_to, const char *string_end, RegexScratch *scratch);
+
 	/**
 	 * Match a 'Regex' structure against a string.
 	 *
@@ -96,6 +117,32 @@ public:
 	 */
 	bool execute(view::string_view string, size_t offset, size_t end_offset, int prev, int succ, const char *delimiters, bool reverse = false);
 
+	/**
+	 * Match a 'Regex' structure against a string. Will only match things between offset and end_offset
+	 *
+	 * @param string     Text to search within
+	 * @param offset     Offset into the string to begin search
+	 * @param end_offset Offset into the string to end search
+	 * @param delimiters Word delimiter table, see 'makeDelimiterTable'
+	 * @param scratch    Memory to reuse from earlier calls (nullptr to allocate what is needed)
+	 * @param reverse    Backward search.
+	 */
+	bool execute(view::string_view string, size_t offset, size_t end_offset, const std::bitset<256> &delimiters, RegexScratch *scratch, bool reverse = false);
+
+	/**
+	 * Match a 'Regex' structure against a string. Will only match things between offset and end_offset
+	 *
+	 * @param string     Text to search within
+	 * @param offset     Offset into the string to begin search
+	 * @param end_offset Offset into the string to end search
+	 * @param prev       Character immediately prior to 'string'.  Set to '\n' or -1 if true beginning of text.
+	 * @param succ       Character immediately after 'end'.  Set to '\n' or -1 if true beginning of text.
+	 * @param delimiters Word delimiter table, see 'makeDelimiterTable'
+	 * @param scratch    Memory to reuse from earlier calls (nullptr to allocate what is needed)
+	 * @param reverse    Backward search.
+	 */
+	bool execute(view::string_view string, size_t offset, size_t end_offset, int prev, int succ, const std::bitset<256> &delimiters, RegexScratch *scratch, bool reverse = false);
+
 	/**
 	 * Perform substitutions after a 'Regex' match.
 	 *
@@ -125,6 +172,13 @@ public:
 	size_t top_branch                           = 0;       /* Zero-based index of the top branch that matches. Used by syntax highlighting only. */
 	char match_start                            = '\0';    /* Internal use only. */
 	char anchor                                 = '\0';    /* Internal use only. */
+	size_t literal_min                          = 0;       /* Internal use only. */
+	size_t literal_max                          = 0;       /* Internal use only. */
+	bool memoize                                = false;   /* Internal use only. */
+	bool first_bytes_known                      = false;   /* Internal use only. */
+	std::bitset<256> first_bytes;                          /* Internal use only. */
+	std::string literal;                                   /* Internal use only. */
+	std::unique_ptr<Dfa> dfa;                              /* Internal use only. */
 	std::vector<uint8_t> program;
 
 public:
@@ -0,0 +1,215 @@
+
+#include "RegexCache.h"
+#include "Dfa.h"
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace RegexCache {
+namespace {
+
+// Bounds on what the cache keeps, the least recently used regexes go first
+constexpr size_t MaxEntries = 64;
+constexpr size_t MaxBytes   = 8 * 1024 * 1024;
+
+struct Entry {
+	std::string key;
+	std::unique_ptr<Regex> regex;
+	RegexScratch scratch;
+	size_t bytes;
+};
+
+std::mutex CacheMutex;
+std::list<Entry> Entries; // Most recently used first
+std::unordered_map<std::string, std::list<Entry>::iterator> Index;
+size_t TotalBytes = 0;
+size_t Hits       = 0;
+size_t Misses     = 0;
+
+/**
+ * @brief make_key
+ * @param regex
+ * @param defaultFlags
+ * @return what a compiled regex is looked up by
+ */
+std::string make_key(view::string_view regex, int defaultFlags) {
+	std::string key = std::to_string(defaultFlags);
+	key.push_back(':');
+	key.append(regex.data(), regex.size());
+	return key;
+}
+
+/**
+ * @brief memory_usage
+ * @param regex
+ * @param scratch
+ * @param key
+ * @return roughly how many bytes keeping "regex" in the cache takes up
+ */
+size_t memory_usage(const Regex &regex, const RegexScratch &scratch, const std::string &key) {
+	size_t bytes = sizeof(Entry) + sizeof(Regex) + 2 * key.capacity();
+
+	bytes += regex.program.capacity();
+	bytes += regex.literal.capacity();
+	bytes += scratch.brace_counts.capacity() * sizeof(uint32_t);
+	bytes += scratch.memo.capacity() * sizeof(uint64_t);
+	bytes += scratch.memo_used.capacity() * sizeof(size_t);
+
+	if (regex.dfa) {
+		bytes += regex.dfa->memory_usage();
+	}
+
+	return bytes;
+}
+
+/**
+ * @brief evict
+ *
+ * Drops the least recently used regexes until the cache is within its
+ * bounds. 'CacheMutex' must be held.
+ */
+void evict() {
+	while (!Entries.empty() && (Entries.size() > MaxEntries || TotalBytes > MaxBytes)) {
+		Entry &entry = Entries.back();
+		TotalBytes -= entry.bytes;
+		Index.erase(entry.key);
+		Entries.pop_back();
+	}
+}
+
+/**
+ * @brief give_back
+ * @param regex
+ * @param scratch
+ * @param key
+ *
+ * Puts a regex which is no longer in use back into the cache, unless another
+ * copy of it got there first.
+ */
+void give_back(std::unique_ptr<Regex> regex, RegexScratch scratch, std::string key) {
+
+	const size_t bytes = memory_usage(*regex, scratch, key);
+	if (bytes > MaxBytes) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(CacheMutex);
+
+	if (Index.find(key) != Index.end()) {
+		return;
+	}
+
+	Entries.push_front(Entry{std::move(key), std::move(regex), std::move(scratch), bytes});
+	Index.emplace(Entries.front().key, Entries.begin());
+	TotalBytes += bytes;
+
+	evict();
+}
+
+}
+
+/**
+ * @brief Lease::Lease
+ * @param regex
+ * @param scratch
+ * @param key
+ */
+Lease::Lease(std::unique_ptr<Regex> regex, RegexScratch scratch, std::string key)
+	: regex_(std::move(regex)), scratch_(std::move(scratch)), key_(std::move(key)) {
+}
+
+/**
+ * @brief Lease::operator=
+ * @param other
+ * @return
+ */
+Lease &Lease::operator=(Lease &&other) noexcept {
+	if (this != &other) {
+		release();
+		regex_   = std::move(other.regex_);
+		scratch_ = std::move(other.scratch_);
+		key_     = std::move(other.key_);
+	}
+
+	return *this;
+}
+
+/**
+ * @brief Lease::~Lease
+ */
+Lease::~Lease() {
+	release();
+}
+
+/**
+ * @brief Lease::release
+ */
+void Lease::release() {
+	if (regex_) {
+		give_back(std::move(regex_), std::move(scratch_), std::move(key_));
+	}
+}
+
+/**
+ * @brief acquire
+ * @param regex
+ * @param defaultFlags
+ * @return "regex" compiled with "defaultFlags", for the caller's sole use
+ * until the lease ends. Throws RegexError if it doesn't compile.
+ */
+Lease acquire(view::string_view regex, int defaultFlags) {
+
+	std::string key = make_key(regex, defaultFlags);
+
+	{
+		std::lock_guard<std::mutex> lock(CacheMutex);
+
+		auto it = Index.find(key);
+		if (it != Index.end()) {
+			const std::list<Entry>::iterator entry = it->second;
+			Lease lease(std::move(entry->regex), std::move(entry->scratch), std::move(key));
+
+			TotalBytes -= entry->bytes;
+			Index.erase(it);
+			Entries.erase(entry);
+			++Hits;
+			return lease;
+		}
+
+		++Misses;
+	}
+
+	return Lease(std::make_unique<Regex>(regex, defaultFlags), RegexScratch(), std::move(key));
+}
+
+/**
+ * @brief statistics
+ * @return how well the cache has been doing, and what it holds
+ */
+Statistics statistics() {
+	std::lock_guard<std::mutex> lock(CacheMutex);
+
+	Statistics stats;
+	stats.hits    = Hits;
+	stats.misses  = Misses;
+	stats.entries = Entries.size();
+	stats.bytes   = TotalBytes;
+	return stats;
+}
+
+/**
+ * @brief clear
+ *
+ * Forgets every compiled regex waiting in the cache, regexes currently out
+ * are still returned to it when their leases end.
+ */
+void clear() {
+	std::lock_guard<std::mutex> lock(CacheMutex);
+
+	Entries.clear();
+	Index.clear();
+	TotalBytes = 0;
+}
+
+}
@@ -0,0 +1,63 @@
+
+#ifndef REGEX_CACHE_H_
+#define REGEX_CACHE_H_
+
+#include "Regex.h"
+#include "Util/string_view.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+/* A process wide cache of compiled regular expressions, so that searching for
+ * the same pattern again and again (Find Again, incremental search, a macro
+ * calling search() in a loop) doesn't compile it every time.
+ *
+ * A 'Regex' holds the results of its last search, so two searches can't share
+ * one. Instead, 'acquire' hands out a compiled regex for the caller's sole use
+ * and it goes back into the cache when the lease ends. Asking for a pattern
+ * which is already out compiles another copy of it. The word delimiters are
+ * given to each search rather than to the compiler, so they aren't part of
+ * what a compiled regex is looked up by. Each regex comes with a scratch for
+ * its searches to reuse. */
+namespace RegexCache {
+
+struct Statistics {
+	size_t hits    = 0; // Patterns found compiled in the cache
+	size_t misses  = 0; // Patterns which had to be compiled
+	size_t entries = 0; // Compiled regexes waiting in the cache
+	size_t bytes   = 0; // Roughly how much memory those take up
+};
+
+class Lease {
+public:
+	Lease() = default;
+	Lease(std::unique_ptr<Regex> regex, RegexScratch scratch, std::string key);
+	Lease(Lease &&other) noexcept = default;
+	Lease &operator=(Lease &&other) noexcept;
+	Lease(const Lease &) = delete;
+	Lease &operator=(const Lease &) = delete;
+	~Lease();
+
+public:
+	Regex &operator*() const { return *regex_; }
+	Regex *operator->() const { return regex_.get(); }
+	Regex *get() const { return regex_.get(); }
+	RegexScratch *scratch() { return &scratch_; }
+
+private:
+	void release();
+
+private:
+	std::unique_ptr<Regex> regex_;
+	RegexScratch scratch_;
+	std::string key_;
+};
+
+Lease acquire(view::string_view regex, int defaultFlags);
+Statistics statistics();
+void clear();
+
+}
+
+#endif
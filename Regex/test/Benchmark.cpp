@@ -0,0 +1,491 @@
+#include "HighlightPatterns.h"
+#include "Regex.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace {
+
+/* The corpora used when no file is given, each one a bit of what some of the
+ * highlight patterns are meant for, repeated until it is CorpusSize bytes */
+constexpr const char SampleC[] = R"SAMPLE(#include <stdio.h>
+#include "config.h"
+
+/* Returns the number of lines in the buffer, or -1 on error */
+static int count_lines(const char *buffer, size_t length) {
+	int lines = 0;
+	for (size_t i = 0; i < length; ++i) {
+		if (buffer[i] == '\n') {
+			++lines;
+		}
+	}
+	return lines > 0x7fff ? -1 : lines; // clamp
+}
+
+#define MAX_NAME 64
+typedef struct node {
+	struct node *next;
+	char name[MAX_NAME];
+	double weight; /* 1.5e-3 by default */
+} node_t;
+
+int main(int argc, char *argv[]) {
+	node_t *head = NULL;
+	if (argc < 2 && argv[0] != NULL) {
+		fprintf(stderr, "usage: %s <file>\n", argv[0]);
+		return 1;
+	}
+	switch (argv[1][0]) {
+	case 'a': head = load(argv[1], 'a'); break;
+	default:  head = load(argv[1], '\0'); break;
+	}
+	return count_lines(argv[1], strlen(argv[1])) != 0;
+}
+)SAMPLE";
+
+constexpr const char SampleShell[] = R"SAMPLE(#!/bin/sh
+# build every source file, stopping at the first failure
+PREFIX=${PREFIX:-/usr/local}
+for f in *.c; do
+	echo "compiling $f" && cc -O2 -c "$f" -o "${f%.c}.o" || exit 1
+done
+
+if [ -n "$DESTDIR" ] && [ "$#" -gt 0 ]; then
+	install -m 755 nedit "$DESTDIR$PREFIX/bin/" 2>/dev/null
+fi
+
+case "$1" in
+	clean) rm -f *.o core ;;
+	test)  ./run_tests.sh --verbose $(ls tests/*.txt) ;;
+	*)     echo 'usage: build.sh [clean|test]' >&2 ;;
+esac
+
+while read -r line; do
+	count=$((count + 1))
+	export LAST_LINE="$line"
+done < "${HOME}/.neditrc"
+)SAMPLE";
+
+constexpr const char SampleXml[] = R"SAMPLE(<?xml version="1.0" encoding="UTF-8"?>
+<!DOCTYPE config SYSTEM "config.dtd">
+<!-- settings for the build -->
+<config version="2" xmlns:x="http://example.com/ns">
+	<entry key="font" value="Courier 10" x:default="true"/>
+	<entry key="tabs">4</entry>
+	<script><![CDATA[ if (a < b && c > d) { run(); } ]]></script>
+	<text>Some &amp; more &lt;escaped&gt; text &#169; &#x20AC;</text>
+</config>
+<html><head><title>Test &amp; Page</title></head>
+<body class="main" onload="init()"><p>Some <b>bold</b> text</p>
+<a href="index.html#top" style="color: #ff0000">top</a></body></html>
+)SAMPLE";
+
+constexpr const char SampleLog[] = R"SAMPLE(2023-04-01 12:00:01.123 INFO  [main] server.c:42 listening on 0.0.0.0:8080
+2023-04-01 12:00:02.456 DEBUG [worker-3] request GET /index.html HTTP/1.1 from 192.168.1.20
+2023-04-01 12:00:02.789 WARN  [worker-3] slow response: 1532 ms for /api/v1/items?id=17&sort=asc
+2023-04-01 12:00:03.001 ERROR [worker-1] connection reset by peer (errno=104) user="admin"
+Apr  1 12:00:04 host kernel: [12345.678901] eth0: link up, 1000 Mbps, full duplex
+Apr  1 12:00:05 host sshd[2211]: Accepted publickey for root from 10.0.0.5 port 52144 ssh2
+127.0.0.1 - - [01/Apr/2023:12:00:06 +0000] "POST /login HTTP/1.1" 302 512 "-" "Mozilla/5.0"
+)SAMPLE";
+
+constexpr size_t CorpusSize = 64 * 1024;
+
+// Compiling is timed this many times over, it is too quick to time only once
+constexpr int CompileRepeat = 20;
+
+enum class Format {
+	Text,
+	Json,
+	Csv,
+};
+
+struct Corpus {
+	std::string name;
+	std::string text;
+};
+
+struct Run {
+	size_t matches;
+	double seconds;
+	double worst; // The longest a single search took, in seconds
+};
+
+struct Result {
+	view::string_view pattern;
+	double compile; // Average time to compile, in seconds
+	std::vector<Run> runs; // One for each corpus
+};
+
+/**
+ * @brief load_text
+ * @param filename
+ * @param text
+ * @return true if the file could be read
+ */
+bool load_text(const char *filename, std::string *text) {
+	std::ifstream file(filename, std::ios::binary);
+	if (!file) {
+		return false;
+	}
+
+	text->assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	return true;
+}
+
+/**
+ * @brief make_corpus
+ * @param name
+ * @param sample
+ * @return a corpus of "sample" repeated until it is CorpusSize bytes
+ */
+Corpus make_corpus(const char *name, const char *sample) {
+	Corpus corpus;
+	corpus.name = name;
+	while (corpus.text.size() < CorpusSize) {
+		corpus.text.append(sample);
+	}
+
+	return corpus;
+}
+
+/**
+ * @brief time_compile
+ * @param pattern
+ * @return how long compiling "pattern" takes on average, in seconds
+ */
+double time_compile(view::string_view pattern) {
+	const auto start = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < CompileRepeat; ++i) {
+		Regex re(pattern, REDFLT_STANDARD);
+	}
+
+	const auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double>(end - start).count() / CompileRepeat;
+}
+
+/**
+ * @brief find_all
+ * @param re
+ * @param text
+ * @return the number of matches of "re" found by searching forward through
+ * "text", and how long that took
+ */
+Run find_all(Regex &re, view::string_view text) {
+	Run run = {0, 0, 0};
+	size_t offset = 0;
+
+	while (offset <= text.size()) {
+		const auto start   = std::chrono::steady_clock::now();
+		const bool found   = re.execute(text, offset);
+		const auto end     = std::chrono::steady_clock::now();
+		const double taken = std::chrono::duration<double>(end - start).count();
+
+		run.seconds += taken;
+		run.worst = std::max(run.worst, taken);
+
+		if (!found) {
+			break;
+		}
+
+		++run.matches;
+
+		const auto match_start = static_cast<size_t>(re.startp[0] - text.data());
+		const auto match_end   = static_cast<size_t>(re.endp[0] - text.data());
+		offset                 = (match_end > match_start) ? match_end : match_start + 1;
+	}
+
+	return run;
+}
+
+/**
+ * @brief megabytes_per_second
+ * @param bytes
+ * @param seconds
+ * @return
+ */
+double megabytes_per_second(size_t bytes, double seconds) {
+	return (seconds > 0) ? static_cast<double>(bytes) / (1024 * 1024) / seconds : 0;
+}
+
+/**
+ * @brief json_string
+ * @param s
+ * @return "s" as a quoted JSON string, bytes outside of ASCII are taken to be Latin-1
+ */
+std::string json_string(view::string_view s) {
+	std::string out = "\"";
+
+	for (char ch : s) {
+		const auto byte = static_cast<uint8_t>(ch);
+		if (ch == '"' || ch == '\\') {
+			out.push_back('\\');
+			out.push_back(ch);
+		} else if (byte < 0x20 || byte >= 0x7f) {
+			char buf[8];
+			snprintf(buf, sizeof(buf), "\\u%04x", byte);
+			out.append(buf);
+		} else {
+			out.push_back(ch);
+		}
+	}
+
+	out.push_back('"');
+	return out;
+}
+
+/**
+ * @brief csv_string
+ * @param s
+ * @return "s" quoted for a CSV field
+ */
+std::string csv_string(view::string_view s) {
+	std::string out = "\"";
+
+	for (char ch : s) {
+		if (ch == '"') {
+			out.push_back('"');
+		}
+		out.push_back(ch);
+	}
+
+	out.push_back('"');
+	return out;
+}
+
+/**
+ * @brief write_text
+ * @param corpora
+ * @param results
+ *
+ * A summary for people, with the patterns which took the longest
+ */
+void write_text(const std::vector<Corpus> &corpora, std::vector<Result> results) {
+
+	double total_compile = 0;
+	for (const Result &result : results) {
+		total_compile += result.compile;
+	}
+
+	std::cout << "patterns : " << results.size() << '\n';
+	std::cout << "compile  : " << std::fixed << std::setprecision(3) << total_compile * 1000 << " ms\n";
+
+	for (size_t i = 0; i < corpora.size(); ++i) {
+		size_t matches = 0;
+		double seconds = 0;
+		double worst   = 0;
+
+		for (const Result &result : results) {
+			matches += result.runs[i].matches;
+			seconds += result.runs[i].seconds;
+			worst = std::max(worst, result.runs[i].worst);
+		}
+
+		std::cout << '\n';
+		std::cout << "corpus   : " << corpora[i].name << " (" << corpora[i].text.size() << " bytes)\n";
+		std::cout << "matches  : " << matches << '\n';
+		std::cout << "time     : " << std::fixed << std::setprecision(3) << seconds << " s\n";
+		std::cout << "speed    : " << std::fixed << std::setprecision(1) << megabytes_per_second(corpora[i].text.size() * results.size(), seconds) << " MB/s\n";
+		std::cout << "worst    : " << std::fixed << std::setprecision(3) << worst * 1000 << " ms\n";
+	}
+
+	auto total_seconds = [](const Result &result) {
+		double seconds = 0;
+		for (const Run &run : result.runs) {
+			seconds += run.seconds;
+		}
+		return seconds;
+	};
+
+	std::sort(results.begin(), results.end(), [&total_seconds](const Result &lhs, const Result &rhs) {
+		return total_seconds(lhs) > total_seconds(rhs);
+	});
+
+	std::cout << "\nslowest patterns:\n";
+	for (size_t i = 0; i < std::min<size_t>(10, results.size()); ++i) {
+		std::string pattern = results[i].pattern.to_string();
+		if (pattern.size() > 72) {
+			pattern = pattern.substr(0, 69) + "...";
+		}
+
+		std::cout << std::fixed << std::setprecision(3) << std::setw(8) << total_seconds(results[i]) << " s  " << pattern << '\n';
+	}
+}
+
+/**
+ * @brief write_json
+ * @param corpora
+ * @param results
+ *
+ * Every measurement, for comparing one build with another. Times are in
+ * microseconds.
+ */
+void write_json(const std::vector<Corpus> &corpora, const std::vector<Result> &results) {
+
+	std::cout << "{\n";
+	std::cout << "  \"corpora\": [";
+	for (size_t i = 0; i < corpora.size(); ++i) {
+		std::cout << (i ? ", " : "") << "{\"name\": " << json_string(corpora[i].name) << ", \"bytes\": " << corpora[i].text.size() << '}';
+	}
+	std::cout << "],\n";
+
+	std::cout << "  \"patterns\": [\n";
+	for (size_t i = 0; i < results.size(); ++i) {
+		const Result &result = results[i];
+
+		std::cout << "    {\"index\": " << i << ", \"pattern\": " << json_string(result.pattern);
+		std::cout << std::fixed << std::setprecision(3) << ", \"compile_us\": " << result.compile * 1e6 << ", \"runs\": [";
+
+		for (size_t j = 0; j < result.runs.size(); ++j) {
+			const Run &run = result.runs[j];
+			std::cout << (j ? ", " : "") << "{\"corpus\": " << json_string(corpora[j].name);
+			std::cout << ", \"matches\": " << run.matches;
+			std::cout << std::fixed << std::setprecision(3);
+			std::cout << ", \"time_us\": " << run.seconds * 1e6;
+			std::cout << ", \"worst_us\": " << run.worst * 1e6;
+			std::cout << ", \"mb_per_s\": " << megabytes_per_second(corpora[j].text.size(), run.seconds) << '}';
+		}
+
+		std::cout << "]}" << (i + 1 < results.size() ? "," : "") << '\n';
+	}
+	std::cout << "  ]\n";
+	std::cout << "}\n";
+}
+
+/**
+ * @brief write_csv
+ * @param corpora
+ * @param results
+ *
+ * Every measurement, one line for each pattern and corpus. Times are in
+ * microseconds.
+ */
+void write_csv(const std::vector<Corpus> &corpora, const std::vector<Result> &results) {
+
+	std::cout << "index,corpus,compile_us,matches,time_us,worst_us,mb_per_s,pattern\n";
+
+	for (size_t i = 0; i < results.size(); ++i) {
+		const Result &result = results[i];
+
+		for (size_t j = 0; j < result.runs.size(); ++j) {
+			const Run &run = result.runs[j];
+			std::cout << i << ',' << csv_string(corpora[j].name) << ',';
+			std::cout << std::fixed << std::setprecision(3) << result.compile * 1e6 << ',';
+			std::cout << run.matches << ',';
+			std::cout << run.seconds * 1e6 << ',';
+			std::cout << run.worst * 1e6 << ',';
+			std::cout << megabytes_per_second(corpora[j].text.size(), run.seconds) << ',';
+			std::cout << csv_string(result.pattern) << '\n';
+		}
+	}
+}
+
+void usage(const char *program) {
+	std::cerr << "usage: " << program << " [--format text|json|csv] [--corpus c|shell|xml|log]... [file]...\n";
+}
+
+}
+
+/**
+ * Times how long every highlight pattern takes to compile, and to find all of
+ * its matches in each of a few synthetic corpora (or in the files given on
+ * the command line). The results are written as a summary, or as JSON or CSV
+ * for comparing one build with another.
+ */
+int main(int argc, char *argv[]) {
+
+	const Corpus builtin[] = {
+		make_corpus("c", SampleC),
+		make_corpus("shell", SampleShell),
+		make_corpus("xml", SampleXml),
+		make_corpus("log", SampleLog),
+	};
+
+	Format format = Format::Text;
+	std::vector<Corpus> corpora;
+
+	for (int i = 1; i < argc; ++i) {
+		if (std::strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+			const char *name = argv[++i];
+			if (std::strcmp(name, "text") == 0) {
+				format = Format::Text;
+			} else if (std::strcmp(name, "json") == 0) {
+				format = Format::Json;
+			} else if (std::strcmp(name, "csv") == 0) {
+				format = Format::Csv;
+			} else {
+				usage(argv[0]);
+				return -1;
+			}
+		} else if (std::strcmp(argv[i], "--corpus") == 0 && i + 1 < argc) {
+			const char *name = argv[++i];
+			auto it          = std::find_if(std::begin(builtin), std::end(builtin), [name](const Corpus &corpus) {
+				return corpus.name == name;
+			});
+
+			if (it == std::end(builtin)) {
+				usage(argv[0]);
+				return -1;
+			}
+
+			corpora.push_back(*it);
+		} else if (argv[i][0] == '-') {
+			usage(argv[0]);
+			return -1;
+		} else {
+			Corpus corpus;
+			corpus.name = argv[i];
+			if (!load_text(argv[i], &corpus.text)) {
+				std::cerr << "Could not read " << argv[i] << std::endl;
+				return -1;
+			}
+
+			corpora.push_back(std::move(corpus));
+		}
+	}
+
+	if (corpora.empty()) {
+		corpora.assign(std::begin(builtin), std::end(builtin));
+	}
+
+	Regex::SetDefaultWordDelimiters(".,/\\`'!|@#%^&*()-=+{}[]\":;<>?");
+
+	std::vector<Result> results;
+	results.reserve(sizeof(HighlightPatterns) / sizeof(HighlightPatterns[0]));
+
+	for (const Test &test : HighlightPatterns) {
+		Result result;
+		result.pattern = test.input;
+		result.compile = time_compile(test.input);
+
+		Regex re(test.input, REDFLT_STANDARD);
+		for (const Corpus &corpus : corpora) {
+			result.runs.push_back(find_all(re, corpus.text));
+		}
+
+		results.push_back(std::move(result));
+	}
+
+	switch (format) {
+	case Format::Text:
+		write_text(corpora, results);
+		break;
+	case Format::Json:
+		write_json(corpora, results);
+		break;
+	case Format::Csv:
+		write_csv(corpora, results);
+		break;
+	}
+
+	return 0;
+}
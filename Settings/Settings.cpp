@@ -115,6 +115,8 @@ bool findReplaceUsesSelection;
 bool focusOnRaise;
 bool forceOSConversion;
 bool honorSymlinks;
+bool backgroundSave;
+bool syncOnSave;
 bool stickyCaseSenseButton;
 bool typingHidesPointer;
 bool undoModifiesSelection;
@@ -322,6 +324,8 @@ void loadPreferences(bool isServer) {
 	focusOnRaise                 = settings.value(tr("nedit.focusOnRaise"), false).toBool();
 	forceOSConversion            = settings.value(tr("nedit.forceOSConversion"), true).toBool();
 	honorSymlinks                = settings.value(tr("nedit.honorSymlinks"), true).toBool();
+	backgroundSave               = settings.value(tr("nedit.backgroundSave"), false).toBool();
+	syncOnSave                   = settings.value(tr("nedit.syncOnSave"), true).toBool();
 
 	if (isServer && serverName.isEmpty()) {
 		serverName = randomString(8);
@@ -419,6 +423,8 @@ void importSettings(const QString &filename) {
 	focusOnRaise                 = settings.value(tr("nedit.focusOnRaise"), focusOnRaise).toBool();
 	forceOSConversion            = settings.value(tr("nedit.forceOSConversion"), forceOSConversion).toBool();
 	honorSymlinks                = settings.value(tr("nedit.honorSymlinks"), honorSymlinks).toBool();
+	backgroundSave               = settings.value(tr("nedit.backgroundSave"), backgroundSave).toBool();
+	syncOnSave                   = settings.value(tr("nedit.syncOnSave"), syncOnSave).toBool();
 }
 
 /**
@@ -503,6 +509,8 @@ bool savePreferences() {
 	settings.setValue(tr("nedit.focusOnRaise"), focusOnRaise);
 	settings.setValue(tr("nedit.forceOSConversion"), forceOSConversion);
 	settings.setValue(tr("nedit.honorSymlinks"), honorSymlinks);
+	settings.setValue(tr("nedit.backgroundSave"), backgroundSave);
+	settings.setValue(tr("nedit.syncOnSave"), syncOnSave);
 
 	settings.sync();
 	return settings.status() == QSettings::NoError;
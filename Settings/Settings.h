@@ -110,6 +110,8 @@ extern bool findReplaceUsesSelection;
 extern bool focusOnRaise;
 extern bool forceOSConversion;
 extern bool honorSymlinks;
+extern bool backgroundSave;
+extern bool syncOnSave;
 extern bool stickyCaseSenseButton;
 extern bool typingHidesPointer;
 extern bool undoModifiesSelection;
@@ -0,0 +1,647 @@
+
+#include "Util/CharScan.h"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CHAR_SCAN_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define CHAR_SCAN_AVX2
+#include <immintrin.h>
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace {
+
+struct Kernels {
+	size_t (*count)(const char *, const char *, char);
+	const char *(*find)(const char *, const char *, char);
+	const char *(*find2)(const char *, const char *, char, char);
+	const char *(*rfind)(const char *, const char *, char);
+	const char *(*findString)(const char *, const char *, const char *, size_t);
+	const char *(*findStringNoCase)(const char *, const char *, const char *, size_t);
+	const char *(*rfindStringNoCase)(const char *, const char *, const char *, size_t);
+};
+
+/*
+** Plain C++ versions, used when nothing better is available and for the
+** ends of the runs which don't fill a whole vector
+*/
+size_t countScalar(const char *first, const char *last, char ch) {
+	return static_cast<size_t>(std::count(first, last, ch));
+}
+
+const char *findScalar(const char *first, const char *last, char ch) {
+	return std::find(first, last, ch);
+}
+
+const char *find2Scalar(const char *first, const char *last, char ch1, char ch2) {
+	return std::find_if(first, last, [ch1, ch2](char ch) { return ch == ch1 || ch == ch2; });
+}
+
+const char *rfindScalar(const char *first, const char *last, char ch) {
+	for (const char *it = last; it != first;) {
+		if (*--it == ch) {
+			return it;
+		}
+	}
+	return last;
+}
+
+const char *findStringScalar(const char *first, const char *last, const char *needle, size_t length) {
+
+	if (length == 0) {
+		return first;
+	}
+
+	if (static_cast<size_t>(last - first) < length) {
+		return last;
+	}
+
+	// one past the last place where the needle would still fit
+	const char *const end = last - length + 1;
+
+	for (const char *it = findScalar(first, end, needle[0]); it != end; it = findScalar(it + 1, end, needle[0])) {
+		if (std::memcmp(it + 1, needle + 1, length - 1) == 0) {
+			return it;
+		}
+	}
+
+	return last;
+}
+
+/*
+** Whether the "length" characters at "text" match those at "needle", which
+** is in lower case, ignoring the case of ASCII letters
+*/
+bool equalNoCase(const char *text, const char *needle, size_t length) {
+	for (size_t i = 0; i < length; ++i) {
+		if (ascii_tolower(text[i]) != needle[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+const char *findStringNoCaseScalar(const char *first, const char *last, const char *needle, size_t length) {
+
+	if (length == 0) {
+		return first;
+	}
+
+	if (static_cast<size_t>(last - first) < length) {
+		return last;
+	}
+
+	// one past the last place where the needle would still fit
+	const char *const end = last - length + 1;
+
+	for (const char *it = first; it != end; ++it) {
+		if (ascii_tolower(*it) == needle[0] && equalNoCase(it + 1, needle + 1, length - 1)) {
+			return it;
+		}
+	}
+
+	return last;
+}
+
+const char *rfindStringNoCaseScalar(const char *first, const char *last, const char *needle, size_t length) {
+
+	if (length == 0) {
+		return last;
+	}
+
+	if (static_cast<size_t>(last - first) < length) {
+		return last;
+	}
+
+	for (const char *it = last - length + 1; it != first;) {
+		--it;
+		if (ascii_tolower(*it) == needle[0] && equalNoCase(it + 1, needle + 1, length - 1)) {
+			return it;
+		}
+	}
+
+	return last;
+}
+
+/*
+** What to OR each character of the text with before comparing it with "ch",
+** a character of a lower case needle. Setting bit 5 turns an upper case
+** letter into the lower case one and leaves a lower case letter alone, and
+** nothing else becomes a letter that way, so it is only done for letters.
+*/
+char foldMask(char ch) {
+	return (ch >= 'a' && ch <= 'z') ? 0x20 : 0x00;
+}
+
+#ifdef CHAR_SCAN_SSE2
+
+/*
+** Index of the lowest/highest set bit of a non-zero mask
+*/
+int lowestBit(uint32_t mask) {
+#if defined(__GNUC__)
+	return __builtin_ctz(mask);
+#else
+	int n = 0;
+	while (!(mask & 1)) {
+		mask >>= 1;
+		++n;
+	}
+	return n;
+#endif
+}
+
+int highestBit(uint32_t mask) {
+#if defined(__GNUC__)
+	return 31 - __builtin_clz(mask);
+#else
+	int n = 31;
+	while (!(mask & 0x80000000u)) {
+		mask <<= 1;
+		--n;
+	}
+	return n;
+#endif
+}
+
+/*
+** Matches are accumulated in per-byte counters (a match is -1, so
+** subtracting it counts up), which are summed with psadbw before they can
+** overflow
+*/
+size_t countSSE2(const char *first, const char *last, char ch) {
+
+	const __m128i needle = _mm_set1_epi8(ch);
+	const __m128i zero   = _mm_setzero_si128();
+	size_t count         = 0;
+
+	while (last - first >= 16) {
+		__m128i counters  = zero;
+		const auto blocks = std::min<ptrdiff_t>((last - first) / 16, 255);
+
+		for (ptrdiff_t i = 0; i < blocks; ++i, first += 16) {
+			const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(first));
+			counters            = _mm_sub_epi8(counters, _mm_cmpeq_epi8(chunk, needle));
+		}
+
+		const __m128i sums = _mm_sad_epu8(counters, zero);
+		count += static_cast<size_t>(_mm_cvtsi128_si32(sums) + _mm_extract_epi16(sums, 4));
+	}
+
+	return count + countScalar(first, last, ch);
+}
+
+const char *findSSE2(const char *first, const char *last, char ch) {
+
+	const __m128i needle = _mm_set1_epi8(ch);
+
+	for (; last - first >= 16; first += 16) {
+		const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(first));
+		if (const auto mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle)))) {
+			return first + lowestBit(mask);
+		}
+	}
+
+	return findScalar(first, last, ch);
+}
+
+const char *find2SSE2(const char *first, const char *last, char ch1, char ch2) {
+
+	const __m128i needle1 = _mm_set1_epi8(ch1);
+	const __m128i needle2 = _mm_set1_epi8(ch2);
+
+	for (; last - first >= 16; first += 16) {
+		const __m128i chunk   = _mm_loadu_si128(reinterpret_cast<const __m128i *>(first));
+		const __m128i matches = _mm_or_si128(_mm_cmpeq_epi8(chunk, needle1), _mm_cmpeq_epi8(chunk, needle2));
+		if (const auto mask = static_cast<uint32_t>(_mm_movemask_epi8(matches))) {
+			return first + lowestBit(mask);
+		}
+	}
+
+	return find2Scalar(first, last, ch1, ch2);
+}
+
+const char *rfindSSE2(const char *first, const char *last, char ch) {
+
+	const __m128i needle = _mm_set1_epi8(ch);
+
+	const char *it = last;
+	while (it - first >= 16) {
+		it -= 16;
+		const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(it));
+		if (const auto mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle)))) {
+			return it + highestBit(mask);
+		}
+	}
+
+	const char *match = rfindScalar(first, it, ch);
+	return (match == it) ? last : match;
+}
+
+/*
+** Looks for the first and last characters of the needle at the right
+** distance from each other a vector at a time, and only compares the rest
+** where both are found. This skips almost all of the text even when the
+** first character alone is common.
+*/
+const char *findStringSSE2(const char *first, const char *last, const char *needle, size_t length) {
+
+	if (length < 2) {
+		return (length == 0) ? first : findSSE2(first, last, needle[0]);
+	}
+
+	if (static_cast<size_t>(last - first) < length) {
+		return last;
+	}
+
+	const __m128i head    = _mm_set1_epi8(needle[0]);
+	const __m128i tail    = _mm_set1_epi8(needle[length - 1]);
+	const char *const end = last - length + 1;
+
+	const char *it = first;
+	for (; end - it >= 16; it += 16) {
+		const __m128i heads = _mm_loadu_si128(reinterpret_cast<const __m128i *>(it));
+		const __m128i tails = _mm_loadu_si128(reinterpret_cast<const __m128i *>(it + length - 1));
+		auto mask           = static_cast<uint32_t>(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(heads, head), _mm_cmpeq_epi8(tails, tail))));
+
+		while (mask) {
+			const char *candidate = it + lowestBit(mask);
+			if (std::memcmp(candidate + 1, needle + 1, length - 2) == 0) {
+				return candidate;
+			}
+			mask &= mask - 1;
+		}
+	}
+
+	return findStringScalar(it, last, needle, length);
+}
+
+/*
+** Like findStringSSE2, folding the case of the first and last characters of
+** each candidate as they are compared
+*/
+const char *findStringNoCaseSSE2(const char *first, const char *last, const char *needle, size_t length) {
+
+	if (length == 0) {
+		return first;
+	}
+
+	if (static_cast<size_t>(last - first) < length) {
+		return last;
+	}
+
+	const __m128i head     = _mm_set1_epi8(needle[0]);
+	const __m128i headFold = _mm_set1_epi8(foldMask(needle[0]));
+	const __m128i tail     = _mm_set1_epi8(needle[length - 1]);
+	const __m128i tailFold = _mm_set1_epi8(foldMask(needle[length - 1]));
+	const char *const end  = last - length + 1;
+
+	const char *it = first;
+	for (; end - it >= 16; it += 16) {
+		const __m128i heads = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(it)), headFold);
+		const __m128i tails = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(it + length - 1)), tailFold);
+		auto mask           = static_cast<uint32_t>(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(heads, head), _mm_cmpeq_epi8(tails, tail))));
+
+		while (mask) {
+			const char *candidate = it + lowestBit(mask);
+			if (length < 3 || equalNoCase(candidate + 1, needle + 1, length - 2)) {
+				return candidate;
+			}
+			mask &= mask - 1;
+		}
+	}
+
+	return findStringNoCaseScalar(it, last, needle, length);
+}
+
+const char *rfindStringNoCaseSSE2(const char *first, const char *last, const char *needle, size_t length) {
+
+	if (length == 0) {
+		return last;
+	}
+
+	if (static_cast<size_t>(last - first) < length) {
+		return last;
+	}
+
+	const __m128i head     = _mm_set1_epi8(needle[0]);
+	const __m128i headFold = _mm_set1_epi8(foldMask(needle[0]));
+	const __m128i tail     = _mm_set1_epi8(needle[length - 1]);
+	const __m128i tailFold = _mm_set1_epi8(foldMask(needle[length - 1]));
+
+	// one past the last place where the needle would still fit
+	const char *it = last - length + 1;
+	while (it - first >= 16) {
+		it -= 16;
+		const __m128i heads = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(it)), headFold);
+		const __m128i tails = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(it + length - 1)), tailFold);
+		auto mask           = static_cast<uint32_t>(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(heads, head), _mm_cmpeq_epi8(tails, tail))));
+
+		while (mask) {
+			const int bit         = highestBit(mask);
+			const char *candidate = it + bit;
+			if (length < 3 || equalNoCase(candidate + 1, needle + 1, length - 2)) {
+				return candidate;
+			}
+			mask &= ~(1u << bit);
+		}
+	}
+
+	// what is left are the places before "it"
+	const char *const rest = it + length - 1;
+	const char *match      = rfindStringNoCaseScalar(first, rest, needle, length);
+	return (match == rest) ? last : match;
+}
+
+#endif
+
+#ifdef CHAR_SCAN_AVX2
+
+TARGET_AVX2 size_t countAVX2(const char *first, const char *last, char ch) {
+
+	const __m256i needle = _mm256_set1_epi8(ch);
+	const __m256i zero   = _mm256_setzero_si256();
+	size_t count         = 0;
+
+	while (last - first >= 32) {
+		__m256i counters  = zero;
+		const auto blocks = std::min<ptrdiff_t>((last - first) / 32, 255);
+
+		for (ptrdiff_t i = 0; i < blocks; ++i, first += 32) {
+			const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first));
+			counters            = _mm256_sub_epi8(counters, _mm256_cmpeq_epi8(chunk, needle));
+		}
+
+		const __m256i sums = _mm256_sad_epu8(counters, zero);
+		count += static_cast<size_t>(_mm256_extract_epi64(sums, 0) + _mm256_extract_epi64(sums, 1) + _mm256_extract_epi64(sums, 2) + _mm256_extract_epi64(sums, 3));
+	}
+
+	return count + countSSE2(first, last, ch);
+}
+
+TARGET_AVX2 const char *findAVX2(const char *first, const char *last, char ch) {
+
+	const __m256i needle = _mm256_set1_epi8(ch);
+
+	for (; last - first >= 32; first += 32) {
+		const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first));
+		if (const auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle)))) {
+			return first + lowestBit(mask);
+		}
+	}
+
+	return findSSE2(first, last, ch);
+}
+
+TARGET_AVX2 const char *find2AVX2(const char *first, const char *last, char ch1, char ch2) {
+
+	const __m256i needle1 = _mm256_set1_epi8(ch1);
+	const __m256i needle2 = _mm256_set1_epi8(ch2);
+
+	for (; last - first >= 32; first += 32) {
+		const __m256i chunk   = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first));
+		const __m256i matches = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, needle1), _mm256_cmpeq_epi8(chunk, needle2));
+		if (const auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(matches))) {
+			return first + lowestBit(mask);
+		}
+	}
+
+	return find2SSE2(first, last, ch1, ch2);
+}
+
+TARGET_AVX2 const char *rfindAVX2(const char *first, const char *last, char ch) {
+
+	const __m256i needle = _mm256_set1_epi8(ch);
+
+	const char *it = last;
+	while (it - first >= 32) {
+		it -= 32;
+		const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(it));
+		if (const auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle)))) {
+			return it + highestBit(mask);
+		}
+	}
+
+	const char *match = rfindSSE2(first, it, ch);
+	return (match == it) ? last : match;
+}
+
+TARGET_AVX2 const char *findStringAVX2(const char *first, const char *last, const char *needle, size_t length) {
+
+	if (length < 2) {
+		return (length == 0) ? first : findAVX2(first, last, needle[0]);
+	}
+
+	if (static_cast<size_t>(last - first) < length) {
+		return last;
+	}
+
+	const __m256i head    = _mm256_set1_epi8(needle[0]);
+	const __m256i tail    = _mm256_set1_epi8(needle[length - 1]);
+	const char *const end = last - length + 1;
+
+	const char *it = first;
+	for (; end - it >= 32; it += 32) {
+		const __m256i heads = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(it));
+		const __m256i tails = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(it + length - 1));
+		auto mask           = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(heads, head), _mm256_cmpeq_epi8(tails, tail))));
+
+		while (mask) {
+			const char *candidate = it + lowestBit(mask);
+			if (std::memcmp(candidate + 1, needle + 1, length - 2) == 0) {
+				return candidate;
+			}
+			mask &= mask - 1;
+		}
+	}
+
+	return findStringSSE2(it, last, needle, length);
+}
+
+TARGET_AVX2 const char *findStringNoCaseAVX2(const char *first, const char *last, const char *needle, size_t length) {
+
+	if (length == 0) {
+		return first;
+	}
+
+	if (static_cast<size_t>(last - first) < length) {
+		return last;
+	}
+
+	const __m256i head     = _mm256_set1_epi8(needle[0]);
+	const __m256i headFold = _mm256_set1_epi8(foldMask(needle[0]));
+	const __m256i tail     = _mm256_set1_epi8(needle[length - 1]);
+	const __m256i tailFold = _mm256_set1_epi8(foldMask(needle[length - 1]));
+	const char *const end  = last - length + 1;
+
+	const char *it = first;
+	for (; end - it >= 32; it += 32) {
+		const __m256i heads = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(it)), headFold);
+		const __m256i tails = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(it + length - 1)), tailFold);
+		auto mask           = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(heads, head), _mm256_cmpeq_epi8(tails, tail))));
+
+		while (mask) {
+			const char *candidate = it + lowestBit(mask);
+			if (length < 3 || equalNoCase(candidate + 1, needle + 1, length - 2)) {
+				return candidate;
+			}
+			mask &= mask - 1;
+		}
+	}
+
+	return findStringNoCaseSSE2(it, last, needle, length);
+}
+
+#endif
+
+/**
+ * @brief selectKernels
+ * @return the fastest implementation supported by the CPU we are running on
+ */
+Kernels selectKernels() {
+#ifdef CHAR_SCAN_AVX2
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		return {countAVX2, findAVX2, find2AVX2, rfindAVX2, findStringAVX2, findStringNoCaseAVX2, rfindStringNoCaseSSE2};
+	}
+#endif
+
+#ifdef CHAR_SCAN_SSE2
+	return {countSSE2, findSSE2, find2SSE2, rfindSSE2, findStringSSE2, findStringNoCaseSSE2, rfindStringNoCaseSSE2};
+#else
+	return {countScalar, findScalar, find2Scalar, rfindScalar, findStringScalar, findStringNoCaseScalar, rfindStringNoCaseScalar};
+#endif
+}
+
+const Kernels &kernels() {
+	static const Kernels k = selectKernels();
+	return k;
+}
+
+}
+
+/**
+ * @brief count_char
+ * @param first
+ * @param last
+ * @param ch
+ * @return the number of occurrences of "ch" in [first, last)
+ */
+size_t count_char(const char *first, const char *last, char ch) noexcept {
+	return kernels().count(first, last, ch);
+}
+
+/**
+ * @brief find_char
+ * @param first
+ * @param last
+ * @param ch
+ * @return the first occurrence of "ch" in [first, last)
+ */
+const char *find_char(const char *first, const char *last, char ch) noexcept {
+	return kernels().find(first, last, ch);
+}
+
+/**
+ * @brief find_char
+ * @param first
+ * @param last
+ * @param ch1
+ * @param ch2
+ * @return the first occurrence of either "ch1" or "ch2" in [first, last)
+ */
+const char *find_char(const char *first, const char *last, char ch1, char ch2) noexcept {
+	return kernels().find2(first, last, ch1, ch2);
+}
+
+/**
+ * @brief rfind_char
+ * @param first
+ * @param last
+ * @param ch
+ * @return the last occurrence of "ch" in [first, last)
+ */
+const char *rfind_char(const char *first, const char *last, char ch) noexcept {
+	return kernels().rfind(first, last, ch);
+}
+
+/**
+ * @brief find_string
+ * @param first
+ * @param last
+ * @param needle
+ * @param length
+ * @return the start of the first occurrence of the "length" characters at
+ * "needle" in [first, last)
+ */
+const char *find_string(const char *first, const char *last, const char *needle, size_t length) noexcept {
+	return kernels().findString(first, last, needle, length);
+}
+
+/**
+ * @brief rfind_string
+ * @param first
+ * @param last
+ * @param needle
+ * @param length
+ * @return the start of the last occurrence of the "length" characters at
+ * "needle" in [first, last)
+ */
+const char *rfind_string(const char *first, const char *last, const char *needle, size_t length) noexcept {
+
+	if (length == 0) {
+		return last;
+	}
+
+	if (static_cast<size_t>(last - first) < length) {
+		return last;
+	}
+
+	// one past the last place where the needle would still fit
+	const char *const end = last - length + 1;
+
+	for (const char *it = end;;) {
+		const char *const match = kernels().rfind(first, it, needle[0]);
+		if (match == it) {
+			return last;
+		}
+
+		if (std::memcmp(match + 1, needle + 1, length - 1) == 0) {
+			return match;
+		}
+
+		it = match;
+	}
+}
+
+/**
+ * @brief find_string_nocase
+ * @param first
+ * @param last
+ * @param needle
+ * @param length
+ * @return the start of the first occurrence of the "length" lower case
+ * characters at "needle" in [first, last), ignoring the case of ASCII letters
+ */
+const char *find_string_nocase(const char *first, const char *last, const char *needle, size_t length) noexcept {
+	return kernels().findStringNoCase(first, last, needle, length);
+}
+
+/**
+ * @brief rfind_string_nocase
+ * @param first
+ * @param last
+ * @param needle
+ * @param length
+ * @return the start of the last occurrence of the "length" lower case
+ * characters at "needle" in [first, last), ignoring the case of ASCII letters
+ */
+const char *rfind_string_nocase(const char *first, const char *last, const char *needle, size_t length) noexcept {
+	return kernels().rfindStringNoCase(first, last, needle, length);
+}
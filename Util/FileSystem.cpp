@@ -1,14 +1,18 @@
 
 #include "Util/FileSystem.h"
+#include "Util/CharScan.h"
 #include "Util/ClearCase.h"
 #include "Util/FileFormats.h"
 
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <iterator>
+#include <memory>
 
 #include <QDir>
 #include <QFileInfo>
+#include <QIODevice>
 
 namespace {
 
@@ -20,6 +24,14 @@ namespace {
 constexpr int FORMAT_SAMPLE_LINES = 5;
 constexpr int FORMAT_SAMPLE_CHARS = 2000;
 
+/* Files are read in blocks of this size by ReadTextFile, which keeps the
+   converted text hot in the cache while the line endings are converted */
+constexpr int64_t READ_BLOCK_SIZE = 1024 * 1024;
+
+/* Text which needs its line endings converted is passed on to the device by
+   WriteTextFile in blocks of up to this size */
+constexpr int64_t WRITE_BLOCK_SIZE = 64 * 1024;
+
 }
 
 /**
@@ -121,7 +133,8 @@ FileFormats FormatOfFile(view::string_view text) {
 
 	const auto end = std::min(text.end(), text.begin() + FORMAT_SAMPLE_CHARS);
 
-	for (auto it = text.begin(); it != end; ++it) {
+	// only line ending characters are of interest, so skip ahead to each one
+	for (auto it = find_char(text.begin(), end, '\n', '\r'); it != end; it = find_char(std::next(it), end, '\n', '\r')) {
 		if (*it == '\n') {
 			nNewlines++;
 			if (it == text.begin() || *std::prev(it) != '\r') {
@@ -131,7 +144,7 @@ FileFormats FormatOfFile(view::string_view text) {
 			if (nNewlines >= FORMAT_SAMPLE_LINES) {
 				return FileFormats::Dos;
 			}
-		} else if (*it == '\r') {
+		} else {
 			nReturns++;
 		}
 	}
@@ -276,3 +289,134 @@ QString ReadAnyTextFile(const QString &fileName, bool forceNL) {
 		return {};
 	}
 }
+
+/*
+** Reads up to "capacity" characters from "device" directly into "text", one
+** block at a time. If "format" isn't null, the format of the file is detected
+** from the first block and stored there, and DOS and Macintosh line endings
+** are converted to Unix ones in place as each block arrives, so the text is
+** only ever held in memory once. Returns the length of the converted text, or
+** -1 if reading failed.
+*/
+int64_t ReadTextFile(QIODevice *device, char *text, int64_t capacity, FileFormats *format) {
+
+	int64_t length    = 0; // characters of converted text
+	int64_t bytesRead = 0; // characters read from the device
+	char pendingCR    = '\0';
+
+	if (format) {
+		// what an empty file is taken to be
+		*format = FileFormats::Unix;
+	}
+
+	while (bytesRead < capacity) {
+
+		/* conversion only ever shrinks the text, so each block can be read
+		   in right after the text converted so far, following any '\r' which
+		   was held back in case the block started with its '\n' */
+		char *const block   = text + length;
+		int64_t blockLength = 0;
+
+		if (pendingCR) {
+			block[blockLength++] = pendingCR;
+		}
+
+		const qint64 n = device->read(block + blockLength, std::min(READ_BLOCK_SIZE, capacity - bytesRead));
+		if (n < 0) {
+			return -1;
+		}
+
+		if (n == 0) {
+			// the file got shorter since its size was checked
+			break;
+		}
+
+		bytesRead += n;
+		blockLength += n;
+
+		if (format) {
+			if (bytesRead == n) {
+				*format = FormatOfFile(view::string_view(block, static_cast<size_t>(blockLength)));
+			}
+
+			switch (*format) {
+			case FileFormats::Dos:
+				ConvertFromDos(block, &blockLength, &pendingCR);
+				break;
+			case FileFormats::Mac:
+				ConvertFromMac(block, blockLength);
+				break;
+			case FileFormats::Unix:
+				break;
+			}
+		}
+
+		length += blockLength;
+	}
+
+	// a '\r' at the very end of the file has no '\n' to pair with
+	if (pendingCR) {
+		text[length++] = pendingCR;
+	}
+
+	return length;
+}
+
+/*
+** Writes "text" to "device", converting its line endings from Unix to
+** "format" on the way. Converted text is passed on in blocks of a fixed size,
+** so it is never held in memory in full, and Unix format text is written
+** directly. The conversion of each newline stands alone, which means that a
+** text stored in several pieces may be written one piece at a time. Returns
+** false if writing failed.
+*/
+bool WriteTextFile(QIODevice *device, view::string_view text, FileFormats format) {
+
+	if (format == FileFormats::Unix) {
+		const auto length = static_cast<int64_t>(text.size());
+		return length == 0 || device->write(text.data(), length) == length;
+	}
+
+	const auto block = std::make_unique<char[]>(WRITE_BLOCK_SIZE);
+	int64_t used     = 0;
+
+	auto flush = [&]() {
+		const bool written = (used == 0 || device->write(block.get(), used) == used);
+		used               = 0;
+		return written;
+	};
+
+	const char *it  = text.begin();
+	const char *end = text.end();
+
+	while (it != end) {
+		const char *eol = find_char(it, end, '\n');
+
+		// copy everything up to the end of the line unchanged
+		while (it != eol) {
+			const int64_t n = std::min<int64_t>(eol - it, WRITE_BLOCK_SIZE - used);
+			std::memcpy(block.get() + used, it, static_cast<size_t>(n));
+			used += n;
+			it += n;
+
+			if (used == WRITE_BLOCK_SIZE && !flush()) {
+				return false;
+			}
+		}
+
+		if (eol != end) {
+			if (used + 2 > WRITE_BLOCK_SIZE && !flush()) {
+				return false;
+			}
+
+			block[static_cast<size_t>(used++)] = '\r';
+			if (format == FileFormats::Dos) {
+				block[static_cast<size_t>(used++)] = '\n';
+			}
+
+			++it;
+		}
+	}
+
+	return flush();
+}
@@ -0,0 +1,79 @@
+
+#ifndef UTIL_CHAR_SCAN_H_
+#define UTIL_CHAR_SCAN_H_
+
+#include <algorithm>
+#include <cstddef>
+
+/* Scanning of contiguous runs of characters. The char versions are
+ * vectorized: the best implementation that the CPU supports (AVX2, SSE2 or
+ * plain C++) is picked at runtime, the first time one of them is called.
+ * The generic versions are used for any other character type.
+ *
+ * Like the standard algorithms, the find functions return "last" when
+ * there is no match.
+ *
+ * The nocase string searches expect the needle in lower case, and match
+ * ASCII letters in the text in either case. Other characters must match
+ * exactly.
+ */
+size_t count_char(const char *first, const char *last, char ch) noexcept;
+const char *find_char(const char *first, const char *last, char ch) noexcept;
+const char *find_char(const char *first, const char *last, char ch1, char ch2) noexcept;
+const char *rfind_char(const char *first, const char *last, char ch) noexcept;
+const char *find_string(const char *first, const char *last, const char *needle, size_t length) noexcept;
+const char *rfind_string(const char *first, const char *last, const char *needle, size_t length) noexcept;
+const char *find_string_nocase(const char *first, const char *last, const char *needle, size_t length) noexcept;
+const char *rfind_string_nocase(const char *first, const char *last, const char *needle, size_t length) noexcept;
+
+template <class Ch>
+constexpr Ch ascii_tolower(Ch ch) noexcept {
+	return (ch >= Ch('A') && ch <= Ch('Z')) ? static_cast<Ch>(ch - Ch('A') + Ch('a')) : ch;
+}
+
+template <class Ch>
+size_t count_char(const Ch *first, const Ch *last, Ch ch) noexcept {
+	return static_cast<size_t>(std::count(first, last, ch));
+}
+
+template <class Ch>
+const Ch *find_char(const Ch *first, const Ch *last, Ch ch) noexcept {
+	return std::find(first, last, ch);
+}
+
+template <class Ch>
+const Ch *find_char(const Ch *first, const Ch *last, Ch ch1, Ch ch2) noexcept {
+	return std::find_if(first, last, [ch1, ch2](Ch ch) { return ch == ch1 || ch == ch2; });
+}
+
+template <class Ch>
+const Ch *find_string(const Ch *first, const Ch *last, const Ch *needle, size_t length) noexcept {
+	return std::search(first, last, needle, needle + length);
+}
+
+template <class Ch>
+const Ch *rfind_string(const Ch *first, const Ch *last, const Ch *needle, size_t length) noexcept {
+	return std::find_end(first, last, needle, needle + length);
+}
+
+template <class Ch>
+const Ch *find_string_nocase(const Ch *first, const Ch *last, const Ch *needle, size_t length) noexcept {
+	return std::search(first, last, needle, needle + length, [](Ch a, Ch b) { return ascii_tolower(a) == b; });
+}
+
+template <class Ch>
+const Ch *rfind_string_nocase(const Ch *first, const Ch *last, const Ch *needle, size_t length) noexcept {
+	return std::find_end(first, last, needle, needle + length, [](Ch a, Ch b) { return ascii_tolower(a) == b; });
+}
+
+template <class Ch>
+const Ch *rfind_char(const Ch *first, const Ch *last, Ch ch) noexcept {
+	for (const Ch *it = last; it != first;) {
+		if (*--it == ch) {
+			return it;
+		}
+	}
+	return last;
+}
+
+#endif
@@ -6,8 +6,10 @@
 #include <QString>
 #include <QtGlobal>
 #include <boost/optional.hpp>
+#include <cstdint>
 #include <string>
 
+class QIODevice;
 enum class FileFormats : int;
 
 struct PathInfo {
@@ -19,6 +21,8 @@ FileFormats FormatOfFile(view::string_view text);
 QString GetTrailingPathComponents(const QString &path, int components);
 QString NormalizePathname(const QString &pathname);
 QString ReadAnyTextFile(const QString &fileName, bool forceNL);
+int64_t ReadTextFile(QIODevice *device, char *text, int64_t capacity, FileFormats *format);
+bool WriteTextFile(QIODevice *device, view::string_view text, FileFormats format);
 PathInfo parseFilename(const QString &fullname);
 
 // std::string based convesions
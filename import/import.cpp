@@ -522,6 +522,8 @@ int main(int argc, char *argv[]) {
 	Settings::focusOnRaise                 = false;
 	Settings::forceOSConversion            = true;
 	Settings::honorSymlinks                = true;
+	Settings::backgroundSave               = false;
+	Settings::syncOnSave                   = true;
 	Settings::stickyCaseSenseButton        = true;
 	Settings::typingHidesPointer           = false;
 	Settings::undoModifiesSelection        = true;
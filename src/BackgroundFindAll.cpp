@@ -0,0 +1,98 @@
+
+#include "BackgroundFindAll.h"
+#include "ChunkedSearch.h"
+#include "Search.h"
+
+#include <algorithm>
+
+namespace {
+
+// text shorter than this isn't worth splitting between threads
+constexpr int64_t MinChunkSize = 1024 * 1024;
+
+// more chunks than threads, so that one chunk full of matches doesn't leave the other threads idle
+constexpr int ChunksPerThread = 4;
+
+// how much text is searched between checks for cancellation
+constexpr int64_t BlockSize = 256 * 1024;
+
+}
+
+/**
+ * @brief BackgroundFindAll::BackgroundFindAll
+ * @param text the text to search
+ * @param searchString
+ * @param searchType
+ * @param delimiters the word delimiters of the document the text came from
+ * @param parent
+ */
+BackgroundFindAll::BackgroundFindAll(text_snapshot<char> text, const QString &searchString, SearchType searchType, const QString &delimiters, QObject *parent)
+	: QThread(parent), text_(std::move(text)), searchString_(searchString), searchType_(searchType), delimiters_(delimiters) {
+}
+
+/**
+ * @brief BackgroundFindAll::~BackgroundFindAll
+ */
+BackgroundFindAll::~BackgroundFindAll() {
+	cancel();
+	wait();
+}
+
+/**
+ * @brief BackgroundFindAll::cancel
+ *
+ * Asks the search to stop at the next match, may be called from any thread
+ */
+void BackgroundFindAll::cancel() {
+	canceled_ = true;
+}
+
+/**
+ * @brief BackgroundFindAll::canceled
+ * @return
+ */
+bool BackgroundFindAll::canceled() const {
+	return canceled_;
+}
+
+/**
+ * @brief BackgroundFindAll::takeMatches
+ * @return the non-empty matches found, in ascending order, once the search has finished
+ */
+std::vector<TextRange> BackgroundFindAll::takeMatches() {
+	return std::move(matches_);
+}
+
+/**
+ * @brief BackgroundFindAll::run
+ */
+void BackgroundFindAll::run() {
+
+	/* literal searches read the snapshot in place, but a regular expression
+	   needs the text in one piece, which costs a copy unless it is already */
+	std::string storage;
+	text_segments<char> text;
+	if (Search::isRegexType(searchType_)) {
+		text.append(text_.segments().to_view(&storage));
+	} else {
+		text = text_.segments();
+	}
+
+	const int64_t length    = text.size();
+	const int64_t maxChunks = std::max(1, QThread::idealThreadCount()) * ChunksPerThread;
+	const int64_t nChunks   = std::min(maxChunks, length / MinChunkSize);
+
+	auto search = [this, &text](int64_t from, int64_t to, const ChunkedSearch::MatchCallback &func) {
+		Search::ForEachMatch(text, searchString_, searchType_, delimiters_, from, to, [&func](const Search::Result &match) {
+			return func({TextCursor(match.start), TextCursor(match.end)});
+		});
+	};
+
+	matches_ = ChunkedSearch::FindAll(length, nChunks, BlockSize, search, &canceled_);
+
+	// empty matches have nothing to highlight
+	matches_.erase(std::remove_if(matches_.begin(), matches_.end(), [](const TextRange &range) {
+					   return range.start == range.end;
+				   }),
+				   matches_.end());
+}
@@ -0,0 +1,51 @@
+
+#ifndef BACKGROUND_FIND_ALL_H_
+#define BACKGROUND_FIND_ALL_H_
+
+#include "SearchType.h"
+#include "TextRange.h"
+#include "text_snapshot.h"
+
+#include <QString>
+#include <QThread>
+
+#include <atomic>
+#include <vector>
+
+/*
+** Finds every match of a search string in a snapshot of a document on a
+** thread of its own, so that Find All doesn't freeze the user interface. The
+** text is split into chunks which are searched in parallel, and the matches
+** are then stitched back together into exactly the list a single search from
+** the start of the text would have found. Literal searches read the snapshot
+** in place. The destructor cancels the search and waits for the thread to
+** finish.
+*/
+class BackgroundFindAll : public QThread {
+	Q_OBJECT
+
+public:
+	BackgroundFindAll(text_snapshot<char> text, const QString &searchString, SearchType searchType, const QString &delimiters, QObject *parent = nullptr);
+	~BackgroundFindAll() override;
+
+public:
+	bool canceled() const;
+	std::vector<TextRange> takeMatches();
+	void cancel();
+
+protected:
+	void run() override;
+
+private:
+	text_snapshot<char> text_;
+	QString searchString_;
+	SearchType searchType_;
+	QString delimiters_;
+	std::atomic<bool> canceled_{false};
+
+private:
+	// only written by the thread, and read once it has finished
+	std::vector<TextRange> matches_;
+};
+
+#endif
@@ -0,0 +1,162 @@
+
+#include "BackgroundSave.h"
+#include "Util/FileSystem.h"
+
+#include <QFileInfo>
+#include <QTemporaryFile>
+#include <qplatformdefs.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace {
+
+// how much text is written between progress reports
+constexpr int64_t ProgressBlockSize = 8 * 1024 * 1024;
+
+}
+
+/**
+ * @brief BackgroundSave::BackgroundSave
+ * @param text the text to save
+ * @param fileName the file to replace, which must already exist
+ * @param format the line endings to save with
+ * @param mode the permissions to give the new file
+ * @param group the group to give the new file
+ * @param sync if true, the new file is flushed to disk before it replaces the old one, and the directory after
+ * @param parent
+ */
+BackgroundSave::BackgroundSave(text_snapshot<char> text, const QString &fileName, FileFormats format, int mode, int group, bool sync, QObject *parent)
+	: QThread(parent), text_(std::move(text)), fileName_(fileName), format_(format), mode_(mode), group_(group), sync_(sync) {
+}
+
+/**
+ * @brief BackgroundSave::~BackgroundSave
+ */
+BackgroundSave::~BackgroundSave() {
+	wait();
+}
+
+/**
+ * @brief BackgroundSave::errorString
+ * @return a description of why the save failed
+ */
+QString BackgroundSave::errorString() const {
+	return errorString_;
+}
+
+/**
+ * @brief BackgroundSave::status
+ * @return
+ */
+BackgroundSave::Status BackgroundSave::status() const {
+	return status_;
+}
+
+/**
+ * @brief BackgroundSave::fail
+ * @param status
+ * @param error
+ */
+void BackgroundSave::fail(Status status, const QString &error) {
+	status_      = status;
+	errorString_ = error;
+}
+
+/**
+ * @brief BackgroundSave::run
+ */
+void BackgroundSave::run() {
+
+	const QFileInfo target(fileName_);
+
+	// the temporary file has to be on the same file system for the rename to be atomic
+	QTemporaryFile file(QStringLiteral("%1/.%2.XXXXXX").arg(target.absolutePath(), target.fileName()));
+	if (!file.open()) {
+		fail(OpenFailed, file.errorString());
+		return;
+	}
+
+#ifdef Q_OS_UNIX
+	/* give the new file the group and permissions of the one it replaces,
+	   in that order since changing the group may clear the set-group-ID bit */
+	if (::fchown(file.handle(), static_cast<uid_t>(-1), static_cast<gid_t>(group_)) != 0) {
+		fail(OpenFailed, QString::fromLatin1(strerror(errno)));
+		return;
+	}
+
+	if (::fchmod(file.handle(), static_cast<mode_t>(mode_)) != 0) {
+		fail(OpenFailed, QString::fromLatin1(strerror(errno)));
+		return;
+	}
+#else
+	Q_UNUSED(mode_)
+	Q_UNUSED(group_)
+#endif
+
+	const int64_t total = text_.size();
+
+	for (int64_t pos = 0; pos < total; pos += ProgressBlockSize) {
+		const int64_t end = std::min(total, pos + ProgressBlockSize);
+
+		bool written = true;
+		text_.for_each_segment(pos, end, [&](const char *data, int64_t length) {
+			written = written && WriteTextFile(&file, view::string_view(data, static_cast<size_t>(length)), format_);
+		});
+
+		if (!written) {
+			fail(WriteFailed, file.errorString());
+			return;
+		}
+
+		Q_EMIT progress(end, total);
+	}
+
+	if (!file.flush()) {
+		fail(WriteFailed, file.errorString());
+		return;
+	}
+
+#ifdef Q_OS_UNIX
+	if (sync_ && ::fsync(file.handle()) != 0) {
+		fail(WriteFailed, QString::fromLatin1(strerror(errno)));
+		return;
+	}
+#else
+	Q_UNUSED(sync_)
+#endif
+
+	file.close();
+
+	if (::rename(QFile::encodeName(file.fileName()).constData(), QFile::encodeName(fileName_).constData()) != 0) {
+		fail(WriteFailed, QString::fromLatin1(strerror(errno)));
+		return;
+	}
+
+	// it isn't temporary any more
+	file.setAutoRemove(false);
+
+#ifdef Q_OS_UNIX
+	/* the rename is only on disk once the directory is, some file systems
+	   can't sync a directory, in which case there's nothing more to do */
+	if (sync_) {
+		const int dir = QT_OPEN(QFile::encodeName(target.absolutePath()).constData(), QT_OPEN_RDONLY);
+		if (dir == -1) {
+			fail(WriteFailed, QString::fromLatin1(strerror(errno)));
+			return;
+		}
+
+		const int result = ::fsync(dir);
+		const int error  = errno;
+		QT_CLOSE(dir);
+
+		if (result != 0 && error != EINVAL) {
+			fail(WriteFailed, QString::fromLatin1(strerror(error)));
+			return;
+		}
+	}
+#endif
+
+	status_ = Saved;
+}
@@ -0,0 +1,63 @@
+
+#ifndef BACKGROUND_SAVE_H_
+#define BACKGROUND_SAVE_H_
+
+#include "Util/FileFormats.h"
+#include "text_snapshot.h"
+
+#include <QString>
+#include <QThread>
+
+/*
+** Writes a snapshot of a document to disk on a thread of its own, so that
+** saving a large file doesn't freeze the user interface. The text goes to a
+** temporary file next to the target, which is then renamed over it, so the
+** file on disk is always either the old version or the complete new one.
+** The new file is given the permissions and group of the old one, so it is up
+** to the caller to see that the directory is writable and the group can be
+** kept.
+** The destructor waits for the thread to finish.
+*/
+class BackgroundSave : public QThread {
+	Q_OBJECT
+
+public:
+	enum Status {
+		Running,
+		Saved,
+		OpenFailed,
+		WriteFailed
+	};
+
+public:
+	BackgroundSave(text_snapshot<char> text, const QString &fileName, FileFormats format, int mode, int group, bool sync, QObject *parent = nullptr);
+	~BackgroundSave() override;
+
+Q_SIGNALS:
+	void progress(qint64 written, qint64 total);
+
+public:
+	QString errorString() const;
+	Status status() const;
+
+protected:
+	void run() override;
+
+private:
+	void fail(Status status, const QString &error);
+
+private:
+	text_snapshot<char> text_;
+	QString fileName_;
+	FileFormats format_;
+	int mode_;  // permission bits
+	int group_; // group ID
+	bool sync_;
+
+private:
+	// only written by the thread, and read once it has finished
+	Status status_ = Running;
+	QString errorString_;
+};
+
+#endif
@@ -0,0 +1,65 @@
+
+#include "BackgroundSearch.h"
+
+/**
+ * @brief BackgroundSearch::BackgroundSearch
+ * @param text the text to search
+ * @param searchString
+ * @param direction
+ * @param searchType
+ * @param wrap
+ * @param beginPos
+ * @param delimiters the word delimiters of the document the text came from
+ * @param searched how much of the text a search given up already got through, see Search::SearchSnapshot
+ * @param parent
+ */
+BackgroundSearch::BackgroundSearch(text_snapshot<char> text, const QString &searchString, Direction direction, SearchType searchType, WrapMode wrap, int64_t beginPos, const QString &delimiters, int64_t searched, QObject *parent)
+	: QThread(parent), text_(std::move(text)), searchString_(searchString), direction_(direction), searchType_(searchType), wrap_(wrap), beginPos_(beginPos), delimiters_(delimiters), searched_(searched) {
+}
+
+/**
+ * @brief BackgroundSearch::~BackgroundSearch
+ */
+BackgroundSearch::~BackgroundSearch() {
+	cancel();
+	wait();
+}
+
+/**
+ * @brief BackgroundSearch::cancel
+ *
+ * Asks the search to stop at the next block of text, may be called from any
+ * thread
+ */
+void BackgroundSearch::cancel() {
+	canceled_ = true;
+}
+
+/**
+ * @brief BackgroundSearch::canceled
+ * @return
+ */
+bool BackgroundSearch::canceled() const {
+	return canceled_;
+}
+
+/**
+ * @brief BackgroundSearch::result
+ * @return the match found, once the search has finished
+ */
+boost::optional<Search::Result> BackgroundSearch::result() const {
+	return result_;
+}
+
+/**
+ * @brief BackgroundSearch::run
+ */
+void BackgroundSearch::run() {
+
+	auto progress = [this](int64_t) {
+		return !canceled_;
+	};
+
+	bool gaveUp = false;
+	result_     = Search::SearchSnapshot(text_, searchString_, direction_, searchType_, wrap_, beginPos_, delimiters_, progress, &searched_, &gaveUp);
+}
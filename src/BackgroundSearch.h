@@ -0,0 +1,56 @@
+
+#ifndef BACKGROUND_SEARCH_H_
+#define BACKGROUND_SEARCH_H_
+
+#include "Direction.h"
+#include "Search.h"
+#include "SearchType.h"
+#include "WrapMode.h"
+#include "text_snapshot.h"
+
+#include <QString>
+#include <QThread>
+
+#include <boost/optional.hpp>
+
+#include <atomic>
+
+/*
+** Finds the next match of a search string in a snapshot of a document on a
+** thread of its own, for incremental searches of documents too big to search
+** between keystrokes. The search carries on from wherever a search given up
+** on the GUI thread got to. The destructor cancels the search and waits for
+** the thread to finish.
+*/
+class BackgroundSearch : public QThread {
+	Q_OBJECT
+
+public:
+	BackgroundSearch(text_snapshot<char> text, const QString &searchString, Direction direction, SearchType searchType, WrapMode wrap, int64_t beginPos, const QString &delimiters, int64_t searched, QObject *parent = nullptr);
+	~BackgroundSearch() override;
+
+public:
+	bool canceled() const;
+	boost::optional<Search::Result> result() const;
+	void cancel();
+
+protected:
+	void run() override;
+
+private:
+	text_snapshot<char> text_;
+	QString searchString_;
+	Direction direction_;
+	SearchType searchType_;
+	WrapMode wrap_;
+	int64_t beginPos_;
+	QString delimiters_;
+	int64_t searched_;
+	std::atomic<bool> canceled_{false};
+
+private:
+	// only written by the thread, and read once it has finished
+	boost::optional<Search::Result> result_;
+};
+
+#endif
@@ -0,0 +1,166 @@
+
+#include "ChunkedSearch.h"
+
+#include <QRunnable>
+#include <QThreadPool>
+
+#include <algorithm>
+
+namespace {
+
+struct Chunk {
+	int64_t start = 0;
+	int64_t end   = 0;
+	std::vector<TextRange> matches;
+};
+
+/*
+** Hands "func" the matches a forward search from "from" finds which begin
+** before "to", searching a block at a time, so that the search can be given
+** up part way through even when it finds nothing. Returns false if "func"
+** stopped it, if it was canceled, or if it found a match which reaches the
+** end of the text, since a search doesn't go on after that.
+*/
+bool searchInBlocks(int64_t length, int64_t blockSize, const ChunkedSearch::RangeSearch &search, int64_t from, int64_t to, const std::atomic<bool> *canceled, const ChunkedSearch::MatchCallback &func) {
+
+	while (from < to) {
+
+		if (*canceled) {
+			return false;
+		}
+
+		const int64_t blockEnd = std::min(to, from + blockSize);
+		int64_t next           = blockEnd;
+		bool stopped           = false;
+
+		search(from, blockEnd, [&](const TextRange &match) {
+			// start next after match unless match was empty, then endPos+1
+			next = std::max<int64_t>(next, (match.start == match.end) ? to_integer(match.end) + 1 : to_integer(match.end));
+
+			if (!func(match) || match.end == length) {
+				stopped = true;
+				return false;
+			}
+
+			return true;
+		});
+
+		if (stopped) {
+			return false;
+		}
+
+		from = next;
+	}
+
+	return true;
+}
+
+/*
+** Searches one chunk of the text. The search can see all of the text, so a
+** match may run on past the end of the chunk, but only those which begin in
+** it are kept.
+*/
+class ChunkSearch : public QRunnable {
+public:
+	ChunkSearch(int64_t length, int64_t blockSize, const ChunkedSearch::RangeSearch &search, Chunk *chunk, const std::atomic<bool> *canceled)
+		: length_(length), blockSize_(blockSize), search_(search), chunk_(chunk), canceled_(canceled) {
+	}
+
+public:
+	void run() override {
+		searchInBlocks(length_, blockSize_, search_, chunk_->start, chunk_->end, canceled_, [this](const TextRange &match) {
+			chunk_->matches.push_back(match);
+			return true;
+		});
+	}
+
+private:
+	int64_t length_;
+	int64_t blockSize_;
+	const ChunkedSearch::RangeSearch &search_;
+	Chunk *chunk_;
+	const std::atomic<bool> *canceled_;
+};
+
+}
+
+/*
+** Finds every match in a text of the given length, which "search" searches,
+** by splitting it into "nChunks" chunks, searching them in parallel, and
+** then stitching the matches back together into exactly the list a single
+** search from the start of the text would have found. Each search goes
+** through no more than "blockSize" characters at a time between checks for
+** "canceled", and nothing is found if it is set.
+*/
+std::vector<TextRange> ChunkedSearch::FindAll(int64_t length, int64_t nChunks, int64_t blockSize, const RangeSearch &search, const std::atomic<bool> *canceled) {
+
+	nChunks = std::max<int64_t>(1, nChunks);
+
+	// the last chunk reaches one past the end, for an empty match at the very end of the text
+	std::vector<Chunk> chunks(static_cast<size_t>(nChunks));
+	for (int64_t i = 0; i < nChunks; ++i) {
+		Chunk &chunk = chunks[static_cast<size_t>(i)];
+		chunk.start  = (length * i) / nChunks;
+		chunk.end    = (i + 1 == nChunks) ? length + 1 : (length * (i + 1)) / nChunks;
+	}
+
+	if (nChunks == 1) {
+		ChunkSearch(length, blockSize, search, &chunks[0], canceled).run();
+	} else {
+		QThreadPool pool;
+		for (Chunk &chunk : chunks) {
+			pool.start(new ChunkSearch(length, blockSize, search, &chunk, canceled));
+		}
+
+		pool.waitForDone();
+	}
+
+	/* Each chunk was searched from its start, but a search of the whole text
+	   may have been part way through a match which began in an earlier chunk
+	   at that point. Where that happened, the first few matches of the chunk
+	   can be different, so search again from where the whole search would
+	   have carried on, until it comes to a match the chunk found too. From
+	   there on the two searches find the same matches. */
+	std::vector<TextRange> matches;
+	int64_t resume = 0;
+
+	for (Chunk &chunk : chunks) {
+
+		if (*canceled) {
+			break;
+		}
+
+		if (resume <= chunk.start) {
+			matches.insert(matches.end(), chunk.matches.begin(), chunk.matches.end());
+		} else {
+			searchInBlocks(length, blockSize, search, resume, chunk.end, canceled, [&matches, &chunk](const TextRange &match) {
+				auto it = std::lower_bound(chunk.matches.begin(), chunk.matches.end(), match);
+				if (it != chunk.matches.end() && *it == match) {
+					matches.insert(matches.end(), it, chunk.matches.end());
+					return false;
+				}
+
+				matches.push_back(match);
+				return true;
+			});
+		}
+
+		if (!matches.empty()) {
+			const TextRange &last = matches.back();
+
+			// a search doesn't go on after a match which reaches the end of the text
+			if (last.end == length) {
+				break;
+			}
+
+			// start next after match unless match was empty, then endPos+1
+			resume = (last.start == last.end) ? to_integer(last.end) + 1 : to_integer(last.end);
+		}
+	}
+
+	if (*canceled) {
+		matches.clear();
+	}
+
+	return matches;
+}
@@ -0,0 +1,25 @@
+
+#ifndef CHUNKED_SEARCH_H_
+#define CHUNKED_SEARCH_H_
+
+#include "TextRange.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace ChunkedSearch {
+
+/* Given each match found by a RangeSearch, returns false to stop the search */
+using MatchCallback = std::function<bool(const TextRange &match)>;
+
+/* A forward search from "from", which hands "func" the matches it finds that
+ * begin before "to", one at a time and in order, like Search::ForEachMatch */
+using RangeSearch = std::function<void(int64_t from, int64_t to, const MatchCallback &func)>;
+
+std::vector<TextRange> FindAll(int64_t length, int64_t nChunks, int64_t blockSize, const RangeSearch &search, const std::atomic<bool> *canceled);
+
+}
+
+#endif
@@ -4,8 +4,8 @@
 #include "MainWindow.h"
 #include "Preferences.h"
 #include "Regex.h"
+#include "RegexCache.h"
 #include "Search.h"
-#include "Util/regex.h"
 
 #include <QClipboard>
 #include <QKeyEvent>
@@ -34,6 +34,7 @@ DialogFind::DialogFind(MainWindow *window, DocumentWidget *document, Qt::WindowF
  */
 void DialogFind::connectSlots() {
 	connect(ui.buttonFind, &QPushButton::clicked, this, &DialogFind::buttonFind_clicked);
+	connect(ui.buttonFindAll, &QPushButton::clicked, this, &DialogFind::buttonFindAll_clicked);
 	connect(ui.checkRegex, &QCheckBox::toggled, this, &DialogFind::checkRegex_toggled);
 	connect(ui.checkCase, &QCheckBox::toggled, this, &DialogFind::checkCase_toggled);
 	connect(ui.checkKeep, &QCheckBox::toggled, this, &DialogFind::checkKeep_toggled);
@@ -118,6 +119,7 @@ void DialogFind::checkKeep_toggled(bool checked) {
 void DialogFind::updateFindButton() {
 	bool buttonState = !ui.textFind->text().isEmpty();
 	ui.buttonFind->setEnabled(buttonState);
+	ui.buttonFindAll->setEnabled(buttonState);
 }
 
 /**
@@ -231,6 +233,31 @@ void DialogFind::buttonFind_clicked() {
 	}
 }
 
+/**
+ * @brief DialogFind::buttonFindAll_clicked
+ */
+void DialogFind::buttonFindAll_clicked() {
+
+	// fetch find string and type from the dialog
+	boost::optional<Fields> fields = readFields();
+	if (!fields) {
+		return;
+	}
+
+	// Set the initial focus of the dialog back to the search string
+	ui.textFind->setFocus();
+
+	// find every match and mark them
+	window_->action_Find_All(
+		document_,
+		fields->searchString,
+		fields->searchType);
+
+	if (!keepDialog()) {
+		hide();
+	}
+}
+
 /*
 ** Fetch and verify (particularly regular expression) search and replace
 ** strings and search type from the Find dialog.  If the strings are ok,
@@ -255,7 +282,7 @@ boost::optional<DialogFind::Fields> DialogFind::readFields() {
 		/* If the search type is a regular expression, test compile it
 		   immediately and present error messages */
 		try {
-			auto compiledRE = make_regex(findText, regexDefault);
+			auto compiledRE = RegexCache::acquire(findText.toStdString(), regexDefault);
 		} catch (const RegexError &e) {
 			QMessageBox::warning(
 				this,
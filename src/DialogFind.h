@@ -46,6 +46,7 @@ private:
 private:
 	void textFind_textChanged(const QString &text);
 	void buttonFind_clicked();
+	void buttonFindAll_clicked();
 	void checkRegex_toggled(bool checked);
 	void checkCase_toggled(bool checked);
 	void checkKeep_toggled(bool checked);
@@ -5,8 +5,22 @@
 #include "DocumentWidget.h"
 #include "MainWindow.h"
 #include "Preferences.h"
+#include "ReplaceAllJob.h"
+#include "TextBuffer.h"
 
+#include <QEventLoop>
 #include <QMessageBox>
+#include <QProgressDialog>
+#include <QThreadPool>
+
+#include <memory>
+
+namespace {
+
+// how long (msec) the search takes before a progress dialog appears
+constexpr int ProgressDelay = 500;
+
+}
 
 /**
  * @brief DialogMultiReplace::DialogMultiReplace
@@ -95,35 +109,65 @@ void DialogMultiReplace::buttonReplace_clicked() {
 	// Set the initial focus of the dialog back to the search string
 	replace_->ui.textFind->setFocus();
 
+	std::vector<PendingReplace> pending;
+
+	/* First check again whether the files are still writable. If the file
+	 * status has changed or the file was locked in the mean time, we just
+	 * skip the window. */
+	for (QModelIndex index : selections) {
+		if (DocumentWidget *writeableDocument = model_->itemFromIndex(index)) {
+			if (!writeableDocument->lockReasons().isAnyLocked()) {
+				PendingReplace file;
+				file.document = writeableDocument;
+				pending.push_back(std::move(file));
+			}
+		}
+	}
+
+	// Nothing is changed if the user gives up while the files are searched
+	if (!findReplacements(pending, fields->searchString, fields->replaceString, fields->searchType)) {
+		return;
+	}
+
 	bool replaceFailed  = true;
 	bool noWritableLeft = true;
 
 	// Perform the replacements and mark the selected files (history)
-	for (QModelIndex index : selections) {
-		if (DocumentWidget *writeableDocument = model_->itemFromIndex(index)) {
+	for (PendingReplace &file : pending) {
+		DocumentWidget *writeableDocument = file.document;
 
-			/* First check again whether the file is still writable. If the
-			 * file status has changed or the file was locked in the mean time,
-			 * we just skip the window. */
-			if (!writeableDocument->lockReasons().isAnyLocked()) {
-				noWritableLeft                    = false;
-				writeableDocument->multiFileBusy_ = true; // Avoid multi-beep/dialog
-				writeableDocument->replaceFailed_ = false;
+		// the document may have been closed or locked during the search
+		if (writeableDocument && !writeableDocument->lockReasons().isAnyLocked()) {
+			noWritableLeft                    = false;
+			writeableDocument->multiFileBusy_ = true; // Avoid multi-beep/dialog
+			writeableDocument->replaceFailed_ = false;
 
-				if (MainWindow *win = MainWindow::fromDocument(writeableDocument)) {
+			if (MainWindow *win = MainWindow::fromDocument(writeableDocument)) {
+				if (writeableDocument->buffer()->BufRevision() == file.revision) {
+					win->action_Replace_All(
+						writeableDocument,
+						fields->searchString,
+						fields->replaceString,
+						fields->searchType,
+						file.replacements);
+				} else {
+					// it changed since it was searched, so search it again
 					win->action_Replace_All(
 						writeableDocument,
 						fields->searchString,
 						fields->replaceString,
 						fields->searchType);
 				}
+			}
 
-				writeableDocument->multiFileBusy_ = false;
-				if (!writeableDocument->replaceFailed_) {
-					replaceFailed = false;
-				}
+			writeableDocument->multiFileBusy_ = false;
+			if (!writeableDocument->replaceFailed_) {
+				replaceFailed = false;
 			}
 		}
+
+		// don't hold on to the replacements longer than needed
+		std::vector<TextDelta>().swap(file.replacements);
 	}
 
 	if (!replace_->keepDialog()) {
@@ -147,6 +191,85 @@ void DialogMultiReplace::buttonReplace_clicked() {
 	}
 }
 
+/**
+ * @brief DialogMultiReplace::findReplacements
+ * @param pending the documents to search, and where their replacements are put
+ * @param searchString
+ * @param replaceString
+ * @param searchType
+ * @return false if the user canceled the search
+ *
+ * Works out what Replace All would do to each of the documents, searching
+ * snapshots of them on a pool of threads so that all of them are searched at
+ * once, while a progress dialog shows how far along it is. None of the
+ * documents are changed here.
+ */
+bool DialogMultiReplace::findReplacements(std::vector<PendingReplace> &pending, const QString &searchString, const QString &replaceString, SearchType searchType) {
+
+	if (pending.empty()) {
+		return true;
+	}
+
+	const int total = static_cast<int>(pending.size());
+
+	QProgressDialog progress(tr("Searching %1 files...").arg(total), tr("Cancel"), 0, total, this);
+	progress.setWindowModality(Qt::ApplicationModal);
+	progress.setMinimumDuration(ProgressDelay);
+
+	QThreadPool pool;
+	QEventLoop loop;
+	std::vector<std::unique_ptr<ReplaceAllJob>> jobs;
+	int finished  = 0;
+	bool canceled = false;
+
+	for (size_t i = 0; i < pending.size(); ++i) {
+		PendingReplace &file = pending[i];
+		TextBuffer *buffer   = file.document->buffer();
+
+		auto job = std::make_unique<ReplaceAllJob>(buffer->BufSnapshot(), searchString, replaceString, searchType, file.document->getWindowDelimiters());
+
+		// the results come back on this thread, which is the only one to touch "pending"
+		connect(job.get(), &ReplaceAllJob::finished, &loop, [&, i]() {
+			PendingReplace &done = pending[i];
+			done.replacements    = jobs[i]->takeReplacements();
+
+			const QString name = done.document ? done.document->filename() : QString();
+
+			++finished;
+			progress.setLabelText(tr("Searched %1 of %2 files\n%3: %4 matches").arg(finished).arg(total).arg(name).arg(done.replacements.size()));
+			progress.setValue(finished);
+
+			if (finished == total) {
+				loop.quit();
+			}
+		});
+
+		file.revision = buffer->BufRevision();
+		jobs.push_back(std::move(job));
+	}
+
+	connect(&progress, &QProgressDialog::canceled, &loop, [&]() {
+		canceled = true;
+		pool.clear();
+		for (const std::unique_ptr<ReplaceAllJob> &job : jobs) {
+			job->cancel();
+		}
+
+		loop.quit();
+	});
+
+	for (const std::unique_ptr<ReplaceAllJob> &job : jobs) {
+		pool.start(job.get());
+	}
+
+	loop.exec();
+
+	// the jobs still running after a cancel have to finish before they go away
+	pool.waitForDone();
+
+	return !canceled;
+}
+
 /**
  * @brief DialogMultiReplace::uploadFileListItems
  */
@@ -3,8 +3,14 @@
 #define DIALOG_MULTI_REPLACE_H_
 
 #include "Dialog.h"
+#include "SearchType.h"
+#include "UndoInfo.h"
 #include "ui_DialogMultiReplace.h"
 
+#include <QPointer>
+
+#include <vector>
+
 class DialogReplace;
 class DocumentModel;
 class DocumentWidget;
@@ -17,6 +23,15 @@ public:
 	~DialogMultiReplace() override = default;
 
 private:
+	// What Replace All will do to one of the selected documents
+	struct PendingReplace {
+		QPointer<DocumentWidget> document;
+		uint64_t revision = 0; // of the document's buffer when it was searched
+		std::vector<TextDelta> replacements;
+	};
+
+private:
+	bool findReplacements(std::vector<PendingReplace> &pending, const QString &searchString, const QString &replaceString, SearchType searchType);
 	void checkShowPaths_toggled(bool checked);
 	void buttonDeselectAll_clicked();
 	void buttonSelectAll_clicked();
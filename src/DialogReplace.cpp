@@ -5,8 +5,8 @@
 #include "MainWindow.h"
 #include "Preferences.h"
 #include "Regex.h"
+#include "RegexCache.h"
 #include "Search.h"
-#include "Util/regex.h"
 
 #include <QClipboard>
 #include <QKeyEvent>
@@ -588,7 +588,7 @@ boost::optional<DialogReplace::Fields> DialogReplace::readFields() {
 		/* If the search type is a regular expression, test compile it
 		   immediately and present error messages */
 		try {
-			auto compiledRE = make_regex(replaceText, regexDefault);
+			auto compiledRE = RegexCache::acquire(replaceText.toStdString(), regexDefault);
 		} catch (const RegexError &e) {
 			QMessageBox::warning(this, tr("Search String"), tr("Please respecify the search string:\n%1").arg(QString::fromLatin1(e.what())));
 			return boost::none;
@@ -55,6 +55,7 @@ struct DocumentInfo {
 	bool matchSyntaxBased               = false;                   // Use syntax info to show matching
 	bool wasSelected                    = false;                   // last selection state (for dim/undim of selection related menu items
 	bool ignoreModify                   = false;                   // ignore modifications to text area
+	bool undoRecordedByCaller           = false;                   // modifications are being recorded for undo by whoever is making them
 	WrapStyle wrapMode                  = WrapStyle::Default;      // line wrap style: None, Newline or Continuous
 	IndentStyle indentStyle             = IndentStyle::Default;    // whether/how to auto indent
 	ShowMatchingStyle showMatchingStyle = ShowMatchingStyle::None; // How to show matching parens: None, Delimeter, or Range
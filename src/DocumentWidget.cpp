@@ -1,5 +1,7 @@
 
 #include "DocumentWidget.h"
+#include "BackgroundFindAll.h"
+#include "BackgroundSave.h"
 #include "CommandRecorder.h"
 #include "DialogDuplicateTags.h"
 #include "DialogMoveDocument.h"
@@ -50,8 +52,13 @@
 #include <QTimer>
 #include <qplatformdefs.h>
 
+#include <algorithm>
 #include <chrono>
 
+#ifdef Q_OS_LINUX
+#include <sys/xattr.h>
+#endif
+
 // NOTE(eteran): generally, this class reaches out to MainWindow FAR too much
 // it would be better to create some fundamental signals that MainWindow could
 // listen on and update itself as needed. This would reduce a lot fo the heavy
@@ -84,6 +91,15 @@ constexpr int BannerWaitTime = 6000;
 
 constexpr int FlashInterval = 1500;
 
+// how many characters replaceTextDeltas rewrites with each change to the buffer
+constexpr int64_t ReplaceChunkSize = 1024 * 1024;
+
+// the name of the range set which holds the matches of a Find All
+const auto FindAllRangesetName = QLatin1String("find_all");
+
+// how long (msec) the text must go unchanged before a Find All is searched for again
+constexpr int FindAllRestartDelay = 500;
+
 enum : int {
 	ACCUMULATE        = 1,
 	ERROR_DIALOGS     = 2,
@@ -136,6 +152,35 @@ bool isAdministrator() {
 #endif
 }
 
+#ifdef Q_OS_UNIX
+/**
+ * @brief canKeepGroup
+ * @param file the file to be replaced
+ * @param dir the directory a new file to replace it would be created in
+ * @return true if a new file can be given the group of the one it replaces
+ */
+bool canKeepGroup(const QT_STATBUF &file, const QT_STATBUF &dir) {
+
+	// a new file gets the group of a set-group-ID directory
+	if ((dir.st_mode & S_ISGID) ? dir.st_gid == file.st_gid : ::getegid() == file.st_gid) {
+		return true;
+	}
+
+	// otherwise it can be given any group its owner is a member of
+	const int count = ::getgroups(0, nullptr);
+	if (count <= 0) {
+		return false;
+	}
+
+	std::vector<gid_t> groups(static_cast<size_t>(count));
+	if (::getgroups(count, groups.data()) < 0) {
+		return false;
+	}
+
+	return std::find(groups.begin(), groups.end(), file.st_gid) != groups.end();
+}
+#endif
+
 /**
  * @brief errorString
  * @param error
@@ -515,6 +560,12 @@ DocumentWidget::DocumentWidget(std::shared_ptr<DocumentInfo> &info_ptr, QWidget
 		eraseFlash();
 	});
 
+	findAllTimer_ = new QTimer(this);
+	findAllTimer_->setInterval(FindAllRestartDelay);
+	findAllTimer_->setSingleShot(true);
+
+	connect(findAllTimer_, &QTimer::timeout, this, &DocumentWidget::startFindAll);
+
 	auto area = createTextArea(info_->buffer);
 
 	info_->buffer->BufAddModifyCB(modifiedCB, this);
@@ -595,6 +646,12 @@ DocumentWidget::DocumentWidget(const QString &name, QWidget *parent, Qt::WindowF
 		eraseFlash();
 	});
 
+	findAllTimer_ = new QTimer(this);
+	findAllTimer_->setInterval(FindAllRestartDelay);
+	findAllTimer_->setSingleShot(true);
+
+	connect(findAllTimer_, &QTimer::timeout, this, &DocumentWidget::startFindAll);
+
 	auto area = createTextArea(info_->buffer);
 
 	info_->buffer->BufAddModifyCB(modifiedCB, this);
@@ -933,6 +990,34 @@ void DocumentWidget::updateMarkTable(TextCursor pos, int64_t nInserted, int64_t
 	}
 }
 
+/*
+** Keep the matches of the last Find All up to date across changes to the
+** underlying buffer. A match which the change touches may no longer be one,
+** so it is dropped, and those after the change move along with the text
+*/
+void DocumentWidget::updateFindAllResults(TextCursor pos, int64_t nInserted, int64_t nDeleted) {
+
+	const TextCursor endDeleted = pos + nDeleted;
+
+	// the first match which ends after the change begins
+	auto first = std::partition_point(findAllResults_.begin(), findAllResults_.end(), [pos](const TextRange &match) {
+		return match.end <= pos;
+	});
+
+	/* the first match which begins after the change ends. A pure insertion only
+	   touches a match it lands inside of, not one which begins where it is */
+	auto last = std::partition_point(first, findAllResults_.end(), [endDeleted](const TextRange &match) {
+		return match.start < endDeleted;
+	});
+
+	first = findAllResults_.erase(first, last);
+
+	for (auto it = first; it != findAllResults_.end(); ++it) {
+		it->start += nInserted - nDeleted;
+		it->end += nInserted - nDeleted;
+	}
+}
+
 /**
  * @brief DocumentWidget::modifiedCallback
  * @param pos
@@ -953,9 +1038,20 @@ void DocumentWidget::modifiedCallback(TextCursor pos, int64_t nInserted, int64_t
 
 	const bool selected = info_->buffer->primary.hasSelection();
 
-	// update the table of bookmarks
+	// update the table of bookmarks, and the matches of a Find All
 	if (!info_->ignoreModify) {
 		updateMarkTable(pos, nInserted, nDeleted);
+		updateFindAllResults(pos, nInserted, nDeleted);
+	}
+
+	// the matches of a Find All have moved along with the text
+	if (findAllLabel_ != 0 && (nInserted != 0 || nDeleted != 0)) {
+		updateFindAllMarkers();
+	}
+
+	// put off searching again for a Find All until the typing stops
+	if (findAllTimer_->isActive()) {
+		findAllTimer_->start();
 	}
 
 	MainWindow *win = MainWindow::fromDocument(this);
@@ -991,7 +1087,14 @@ void DocumentWidget::modifiedCallback(TextCursor pos, int64_t nInserted, int64_t
 
 	/* Save information for undoing this operation (this call also counts
 	   characters and editing operations for triggering autosave */
-	saveUndoInformation(pos, nInserted, nDeleted, deletedText);
+	if (!info_->undoRecordedByCaller) {
+		saveUndoInformation(pos, nInserted, nDeleted, deletedText);
+	}
+
+	// a save running in the background no longer has the latest text
+	if (backgroundSave_) {
+		modifiedDuringSave_ = true;
+	}
 
 	// Trigger automatic backup if operation or character limits reached
 	if (info_->autoSave && (info_->autoSaveCharCount > AutoSaveCharLimit || info_->autoSaveOpCount > AutoSaveOpLimit)) {
@@ -1746,6 +1849,157 @@ void DocumentWidget::trimUndoList(size_t maxLength) {
 	info_->undo.erase(it, info_->undo.end());
 }
 
+/*
+** Replace a number of ranges of the text as one editing operation. Each delta
+** gives a range of the current text and what to put in its place, and they
+** must be in ascending order without overlapping. Rather than rewriting
+** everything from the first range to the last in one go, the buffer is
+** changed roughly ReplaceChunkSize characters at a time, and the operation is
+** recorded for undo as the list of deltas which reverse it instead of a copy
+** of all of the text in between.
+**
+** If given, "progress" is called with the number of deltas applied so far
+** after each chunk, and can return false to stop early. The replacements made
+** up to then stay in place and can be undone. If something else changes the
+** text while "progress" runs, the rest of the deltas no longer describe it,
+** so they are given up in the same way. Returns the range spanned by the
+** replaced text, or nothing if no replacements were made.
+**
+** Inside a macro's batch, the buffer holds back its modify notifications
+** until the batch ends, and then reports everything changed during it as one
+** replacement, which modifiedCallback records for undo like any other. The
+** replacements are then left to be recorded that way, rather than also
+** being recorded here.
+*/
+boost::optional<TextRange> DocumentWidget::replaceTextDeltas(const std::vector<TextDelta> &deltas, const std::function<bool(size_t)> &progress) {
+
+	if (deltas.empty()) {
+		return boost::none;
+	}
+
+	TextBuffer *buffer    = info_->buffer.get();
+	const bool batched    = buffer->BufInBatch();
+	const bool isUndo     = (!info_->undo.empty() && info_->undo.front().inUndo);
+	const bool isRedo     = (!info_->redo.empty() && info_->redo.front().inUndo);
+	const bool wasChanged = info_->fileChanged;
+
+	// as in saveUndoInformation, a new edit makes the redo list invalid
+	if (!batched && !(isUndo || isRedo) && !info_->redo.empty()) {
+		clearRedoList();
+	}
+
+	std::vector<TextDelta> reverse; // the deltas which undo the replacements made so far
+	reverse.reserve(deltas.size());
+
+	int64_t shift = 0; // how much longer the text has grown so far
+	size_t i      = 0;
+
+	/* the undo record for the replacements, once it has been added, and how
+	   many of them it holds. It goes on growing as more are made */
+	UndoInfo *record = nullptr;
+	size_t recorded  = 0;
+
+	auto recordUndo = [&]() {
+		const TextRange range = {reverse.front().startPos, reverse.back().startPos + reverse.back().length};
+
+		if (record) {
+			record->endPos = range.end;
+			record->deltas.insert(record->deltas.end(), std::make_move_iterator(reverse.begin() + static_cast<ptrdiff_t>(recorded)), std::make_move_iterator(reverse.end()));
+			recorded = reverse.size();
+			return;
+		}
+
+		UndoInfo undo(MULTI_REPLACE, range.start, range.end);
+		undo.deltas.assign(std::make_move_iterator(reverse.begin()), std::make_move_iterator(reverse.end()));
+
+		++info_->autoSaveOpCount;
+
+		// see saveUndoInformation
+		if (!wasChanged) {
+			undo.restoresToSaved = true;
+
+			for (UndoInfo &u : info_->undo) {
+				u.restoresToSaved = false;
+			}
+
+			for (UndoInfo &u : info_->redo) {
+				u.restoresToSaved = false;
+			}
+		}
+
+		if (isUndo) {
+			addRedoItem(std::move(undo));
+			record = &info_->redo.front();
+		} else {
+			addUndoItem(std::move(undo));
+			record = &info_->undo.front();
+		}
+
+		recorded = reverse.size();
+	};
+
+	while (i < deltas.size()) {
+
+		const TextCursor chunkStart = deltas[i].startPos;
+		TextCursor chunkEnd         = chunkStart;
+		std::string chunk;
+
+		/* gather replacements, and the text between them, until the next one
+		   would make the chunk too big. There is always at least one */
+		do {
+			const TextDelta &delta = deltas[i];
+
+			chunk.append(buffer->BufGetRange(chunkEnd + shift, delta.startPos + shift));
+
+			TextDelta undo;
+			undo.startPos = chunkStart + shift + static_cast<int64_t>(chunk.size());
+			undo.length   = static_cast<int64_t>(delta.text.size());
+			undo.text     = buffer->BufGetRange(delta.startPos + shift, delta.startPos + shift + delta.length);
+			reverse.push_back(std::move(undo));
+
+			chunk.append(delta.text);
+			chunkEnd = delta.startPos + delta.length;
+			++i;
+		} while (i < deltas.size() && static_cast<int64_t>(chunk.size() + deltas[i].text.size()) + (deltas[i].startPos - chunkEnd) <= ReplaceChunkSize);
+
+		{
+			// cleared again even if the replacement throws
+			info_->undoRecordedByCaller = !batched;
+			auto _ = gsl::finally([this] { info_->undoRecordedByCaller = false; });
+
+			buffer->BufReplace(chunkStart + shift, chunkEnd + shift, chunk);
+		}
+
+		shift += static_cast<int64_t>(chunk.size()) - (chunkEnd - chunkStart);
+
+		if (!progress || i == deltas.size()) {
+			continue;
+		}
+
+		/* "progress" may let other things edit the text, so what has been done
+		   so far is recorded for undo ahead of them. If they do change it, the
+		   rest of the deltas no longer describe it, and have to be given up */
+		if (!batched) {
+			recordUndo();
+		}
+
+		const uint64_t revision = buffer->BufRevision();
+		if (!progress(i) || buffer->BufRevision() != revision) {
+			break;
+		}
+	}
+
+	const TextRange range = {reverse.front().startPos, reverse.back().startPos + reverse.back().length};
+
+	/* if the text was changed while "progress" ran, what was done before then
+	   is already recorded, and the record may even have been undone since */
+	if (!batched && reverse.size() != recorded) {
+		recordUndo();
+	}
+
+	return range;
+}
+
 void DocumentWidget::undo() {
 
 	MainWindow *win = MainWindow::fromDocument(this);
@@ -1753,6 +2007,10 @@ void DocumentWidget::undo() {
 		return;
 	}
 
+	/* Changes made during a batch aren't recorded for undo until it ends, and
+	   the undo itself has to be seen immediately */
+	endMacroBatches();
+
 	if (info_->undo.empty()) {
 		return;
 	}
@@ -1767,20 +2025,26 @@ void DocumentWidget::undo() {
 	undo.inUndo = true;
 
 	// use the saved undo information to reverse changes
-	info_->buffer->BufReplace(undo.startPos, undo.endPos, undo.oldText);
+	TextRange restored;
+	if (undo.type == MULTI_REPLACE) {
+		restored = *replaceTextDeltas(undo.deltas, nullptr);
+	} else {
+		info_->buffer->BufReplace(undo.startPos, undo.endPos, undo.oldText);
+		restored = {undo.startPos, undo.startPos + static_cast<int64_t>(undo.oldText.size())};
+	}
 
-	const auto restoredTextLength = static_cast<int64_t>(undo.oldText.size());
+	const int64_t restoredTextLength = restored.end - restored.start;
 	if (!info_->buffer->primary.hasSelection() || Preferences::GetPrefUndoModifiesSelection()) {
 		/* position the cursor in the focus pane after the changed text
 		   to show the user where the undo was done */
 		if (QPointer<TextArea> area = win->lastFocus()) {
-			area->TextSetCursorPos(undo.startPos + restoredTextLength);
+			area->TextSetCursorPos(restored.end);
 		}
 	}
 
 	if (Preferences::GetPrefUndoModifiesSelection()) {
 		if (restoredTextLength > 0) {
-			info_->buffer->BufSelect(undo.startPos, undo.startPos + restoredTextLength);
+			info_->buffer->BufSelect(restored.start, restored.end);
 		} else {
 			info_->buffer->BufUnselect();
 		}
@@ -1810,6 +2074,10 @@ void DocumentWidget::redo() {
 		return;
 	}
 
+	/* Changes made during a batch aren't recorded for undo until it ends, and
+	   the undo itself has to be seen immediately */
+	endMacroBatches();
+
 	if (info_->redo.empty()) {
 		return;
 	}
@@ -1822,21 +2090,27 @@ void DocumentWidget::redo() {
 	redo.inUndo = true;
 
 	// use the saved redo information to reverse changes
-	info_->buffer->BufReplace(redo.startPos, redo.endPos, redo.oldText);
+	TextRange restored;
+	if (redo.type == MULTI_REPLACE) {
+		restored = *replaceTextDeltas(redo.deltas, nullptr);
+	} else {
+		info_->buffer->BufReplace(redo.startPos, redo.endPos, redo.oldText);
+		restored = {redo.startPos, redo.startPos + static_cast<int64_t>(redo.oldText.size())};
+	}
 
-	const auto restoredTextLength = static_cast<int64_t>(redo.oldText.size());
+	const int64_t restoredTextLength = restored.end - restored.start;
 	if (!info_->buffer->primary.hasSelection() || Preferences::GetPrefUndoModifiesSelection()) {
 		/* position the cursor in the focus pane after the changed text
 		   to show the user where the undo was done */
 		if (QPointer<TextArea> area = win->lastFocus()) {
-			area->TextSetCursorPos(redo.startPos + restoredTextLength);
+			area->TextSetCursorPos(restored.end);
 		}
 	}
 
 	if (Preferences::GetPrefUndoModifiesSelection()) {
 
 		if (restoredTextLength > 0) {
-			info_->buffer->BufSelect(redo.startPos, redo.startPos + restoredTextLength);
+			info_->buffer->BufSelect(restored.start, restored.end);
 		} else {
 			info_->buffer->BufUnselect();
 		}
@@ -1934,6 +2208,11 @@ void DocumentWidget::checkForChangesToFile() {
 		return;
 	}
 
+	// the file is being replaced by a save running in the background
+	if (backgroundSave_) {
+		return;
+	}
+
 	// If last check was very recent, don't impact performance
 	auto timestamp = std::chrono::high_resolution_clock::now();
 	if (this == lastCheckWindow && (timestamp - lastCheckTime) < CheckInterval) {
@@ -2018,7 +2297,7 @@ void DocumentWidget::checkForChangesToFile() {
 			}
 
 			if (save) {
-				saveDocument();
+				saveDocument(/*background=*/false);
 			}
 		}
 
@@ -2243,6 +2522,8 @@ void DocumentWidget::revertToSaved() {
 		return;
 	}
 
+	waitForBackgroundSave();
+
 	// Can't revert untitled windows
 	if (!info_->filenameSet) {
 		QMessageBox::warning(
@@ -2342,26 +2623,32 @@ bool DocumentWidget::writeBackupFile() {
 		return false;
 	}
 
-	// get the text buffer contents
-	std::string fileString = info_->buffer->BufGetAll();
+	auto _ = gsl::finally([fp] { ::fclose(fp); });
+
+	QFile file;
+	file.open(fp, QIODevice::WriteOnly);
+
+	// write out the text straight from the buffer
+	const TextBuffer::segments_type text = info_->buffer->BufGetSegments();
+
+	bool written = std::all_of(text.segments().begin(), text.segments().end(), [&file](view::string_view segment) {
+		return WriteTextFile(&file, segment, FileFormats::Unix);
+	});
 
 	// add a terminating newline if the file doesn't already have one
-	if (Preferences::GetPrefAppendLF()) {
-		if (!fileString.empty() && fileString.back() != '\n') {
-			fileString.append("\n");
+	if (written && Preferences::GetPrefAppendLF()) {
+		if (!text.empty() && text[text.size() - 1] != '\n') {
+			written = (file.write("\n", 1) == 1);
 		}
 	}
 
-	auto _ = gsl::finally([fp] { ::fclose(fp); });
-
-	// write out the file
-	::fwrite(fileString.data(), 1, fileString.size(), fp);
-	if (::ferror(fp)) {
+	if (!written || !file.flush()) {
 		QMessageBox::critical(
 			this,
 			tr("Error saving Backup"),
-			tr("Error while saving backup for %1:\n%2\nAutomatic backup is now off").arg(info_->filename, errorString(errno)));
+			tr("Error while saving backup for %1:\n%2\nAutomatic backup is now off").arg(info_->filename, file.errorString()));
 
+		file.close();
 		QFile::remove(name);
 		info_->autoSave = false;
 		return false;
@@ -2372,9 +2659,14 @@ bool DocumentWidget::writeBackupFile() {
 
 /**
  * @brief DocumentWidget::saveDocument
+ * @param background if true, and the file is suitable, the file is written on
+ * a separate thread and this returns as soon as that has started
  * @return
  */
-bool DocumentWidget::saveDocument() {
+bool DocumentWidget::saveDocument(bool background) {
+
+	// only one save at a time
+	waitForBackgroundSave();
 
 	// Try to ensure our information is up-to-date
 	checkForChangesToFile();
@@ -2423,15 +2715,22 @@ bool DocumentWidget::saveDocument() {
 		return false;
 	}
 
-	const bool status = doSave();
-	if (status) {
+	const bool status = doSave(background);
+
+	// if the save is still running, the backup goes once it has succeeded
+	if (status && !backgroundSave_) {
 		removeBackupFile();
 	}
 
 	return status;
 }
 
-bool DocumentWidget::doSave() {
+/**
+ * @brief DocumentWidget::doSave
+ * @param background
+ * @return
+ */
+bool DocumentWidget::doSave(bool background) {
 
 	QString fullname = fullPath();
 
@@ -2463,44 +2762,25 @@ bool DocumentWidget::doSave() {
 		info_->buffer->BufAppend('\n');
 	}
 
+	if (background && startBackgroundSave(fullname)) {
+		return true;
+	}
+
 	// open the file
 	QFile file(fullname);
 	if (!file.open(QIODevice::WriteOnly)) {
-		QMessageBox messageBox(this);
-		messageBox.setWindowTitle(tr("Error saving File"));
-		messageBox.setIcon(QMessageBox::Warning);
-		messageBox.setText(tr("Unable to save %1:\n%2\n\nSave as a new file?").arg(info_->filename, file.errorString()));
-
-		QPushButton *buttonSaveAs = messageBox.addButton(tr("Save As..."), QMessageBox::AcceptRole);
-		QPushButton *buttonCancel = messageBox.addButton(QMessageBox::Cancel);
-		Q_UNUSED(buttonCancel)
-
-		messageBox.exec();
-		if (messageBox.clickedButton() == buttonSaveAs) {
-			// empty string signals a prompt for filename
-			return saveDocumentAs(QString(), /*addWrap=*/false);
-		}
-
-		return false;
+		return offerSaveAs(file.errorString());
 	}
 
-	// get the text buffer contents and its length
-	std::string text = info_->buffer->BufGetAll();
+	/* write the text straight from the buffer, if the file is to be saved in
+	   DOS or Macintosh format, the line endings are converted on the way */
+	const TextBuffer::segments_type text = info_->buffer->BufGetSegments();
 
-	// If the file is to be saved in DOS or Macintosh format, reconvert
-	switch (info_->fileFormat) {
-	case FileFormats::Dos:
-		ConvertToDos(text);
-		break;
-	case FileFormats::Mac:
-		ConvertToMac(text);
-		break;
-	default:
-		break;
-	}
+	const bool written = std::all_of(text.segments().begin(), text.segments().end(), [this, &file](view::string_view segment) {
+		return WriteTextFile(&file, segment, info_->fileFormat);
+	});
 
-	// write to the file
-	if (file.write(text.data(), static_cast<int64_t>(text.size())) == -1) {
+	if (!written || !file.flush()) {
 		QMessageBox::critical(this, tr("Error saving File"), tr("%1 not saved:\n%2").arg(info_->filename, file.errorString()));
 		file.close();
 		file.remove();
@@ -2509,8 +2789,40 @@ bool DocumentWidget::doSave() {
 
 	// success, file was written
 	setWindowModified(false);
+	updateFileInfo(fullname);
+	return true;
+}
+
+/*
+** Tells the user that the file couldn't be saved, and offers to save it
+** under a different name instead
+*/
+bool DocumentWidget::offerSaveAs(const QString &error) {
+
+	QMessageBox messageBox(this);
+	messageBox.setWindowTitle(tr("Error saving File"));
+	messageBox.setIcon(QMessageBox::Warning);
+	messageBox.setText(tr("Unable to save %1:\n%2\n\nSave as a new file?").arg(info_->filename, error));
+
+	QPushButton *buttonSaveAs = messageBox.addButton(tr("Save As..."), QMessageBox::AcceptRole);
+	QPushButton *buttonCancel = messageBox.addButton(QMessageBox::Cancel);
+	Q_UNUSED(buttonCancel)
+
+	messageBox.exec();
+	if (messageBox.clickedButton() == buttonSaveAs) {
+		// empty string signals a prompt for filename
+		return saveDocumentAs(QString(), /*addWrap=*/false);
+	}
+
+	return false;
+}
+
+/*
+** Records the modification time and identity of the file which was just
+** saved, so that later changes made to it by other programs can be noticed
+*/
+void DocumentWidget::updateFileInfo(const QString &fullname) {
 
-	// update the modification time
 	QT_STATBUF statbuf;
 	if (QT_STAT(fullname.toUtf8().data(), &statbuf) == 0) {
 		info_->lastModTime = statbuf.st_mtime;
@@ -2524,10 +2836,374 @@ bool DocumentWidget::doSave() {
 		info_->dev         = 0;
 		info_->ino         = 0;
 	}
+}
+
+/*
+** Starts writing the document to "fullname" on a separate thread, so that
+** editing can go on while a large file is saved. The new text goes to a
+** temporary file which then replaces the original. That gives the file a
+** new inode, so files for which this would make a difference are left to
+** doSave. Returns false if the file wasn't suitable.
+*/
+bool DocumentWidget::startBackgroundSave(const QString &fullname) {
+#ifdef Q_OS_UNIX
+	QT_STATBUF statbuf;
+	if (QT_STAT(fullname.toUtf8().data(), &statbuf) != 0) {
+		return false;
+	}
+
+	// replacing the file mustn't change its owner or break any other links to it
+	if (!S_ISREG(statbuf.st_mode) || statbuf.st_nlink != 1 || statbuf.st_uid != ::geteuid()) {
+		return false;
+	}
+
+	// replace the file a symbolic link points at, not the link itself
+	const QFileInfo target(QFileInfo(fullname).canonicalFilePath());
+	if (target.filePath().isEmpty()) {
+		return false;
+	}
+
+	/* the new file is written next to the old one, which is only possible
+	   if the directory is writable, not just the file */
+	const QByteArray dir = QFile::encodeName(target.absolutePath());
+	QT_STATBUF dirbuf;
+	if (::access(dir.constData(), W_OK) != 0 || QT_STAT(dir.constData(), &dirbuf) != 0) {
+		return false;
+	}
+
+	// replacing the file mustn't change its group either
+	if (!canKeepGroup(statbuf, dirbuf)) {
+		return false;
+	}
+
+#ifdef Q_OS_LINUX
+	// there's no knowing how to carry over extended attributes such as ACLs
+	if (::listxattr(QFile::encodeName(target.filePath()).constData(), nullptr, 0) > 0) {
+		return false;
+	}
+#endif
+
+	backgroundSave_     = new BackgroundSave(info_->buffer->BufSnapshot(), target.filePath(), info_->fileFormat, static_cast<int>(statbuf.st_mode & 07777), static_cast<int>(statbuf.st_gid), Preferences::GetPrefSyncOnSave(), this);
+	modifiedDuringSave_ = false;
+
+	connect(backgroundSave_, &BackgroundSave::progress, this, [this](qint64 written, qint64 total) {
+		// don't hide any other message
+		if (modeMessageDisplayed() && !saveBannerIsUp_) {
+			return;
+		}
+
+		saveBannerIsUp_ = true;
+		setModeMessage(tr("Saving %1... %2%").arg(info_->filename).arg(total != 0 ? (written * 100) / total : 100));
+	});
+
+	connect(backgroundSave_, &BackgroundSave::finished, this, &DocumentWidget::backgroundSaveFinished);
+
+	backgroundSave_->start();
+	return true;
+#else
+	Q_UNUSED(fullname)
+	return false;
+#endif
+}
+
+/*
+** Called on the GUI thread once a save running in the background is over,
+** brings the state of the document up to date with the result
+*/
+void DocumentWidget::backgroundSaveFinished() {
+
+	// it may have been dealt with already by waitForBackgroundSave
+	if (!backgroundSave_ || !backgroundSave_->isFinished()) {
+		return;
+	}
+
+	BackgroundSave *save = backgroundSave_;
+	backgroundSave_      = nullptr;
+	save->deleteLater();
+
+	if (saveBannerIsUp_) {
+		saveBannerIsUp_ = false;
+		clearModeMessage();
+	}
+
+	switch (save->status()) {
+	case BackgroundSave::Saved:
+		updateFileInfo(fullPath());
+
+		if (!modifiedDuringSave_) {
+			setWindowModified(false);
+			removeBackupFile();
+		} else {
+			// nothing in the undo history gets back to what is on disk now
+			for (UndoInfo &u : info_->undo) {
+				u.restoresToSaved = false;
+			}
+
+			for (UndoInfo &u : info_->redo) {
+				u.restoresToSaved = false;
+			}
+		}
+		break;
+	case BackgroundSave::OpenFailed:
+		offerSaveAs(save->errorString());
+		break;
+	case BackgroundSave::WriteFailed:
+	case BackgroundSave::Running:
+		QMessageBox::critical(this, tr("Error saving File"), tr("%1 not saved:\n%2").arg(info_->filename, save->errorString()));
+		break;
+	}
+}
+
+/*
+** If a save is running in the background, waits for it to finish and deals
+** with the result before anything else touches the file
+*/
+void DocumentWidget::waitForBackgroundSave() {
+	if (backgroundSave_) {
+		backgroundSave_->wait();
+		backgroundSaveFinished();
+	}
+}
+
+/*
+** Finds every match of "searchString" in the document on a separate thread.
+** When the search is over, the matches are highlighted with a range set of
+** their own, which later edits keep up to date like any other range set, and
+** are marked beside the vertical scroll bars. A Find All which is still
+** running is abandoned.
+*/
+void DocumentWidget::findAll(const QString &searchString, SearchType searchType) {
+	findAllString_ = searchString;
+	findAllType_   = searchType;
+	startFindAll();
+}
+
+/*
+** Starts searching a snapshot of the text for the matches of the last Find All
+*/
+void DocumentWidget::startFindAll() {
+
+	cancelFindAll();
+
+	findAllRevision_ = info_->buffer->BufRevision();
+	findAll_         = new BackgroundFindAll(info_->buffer->BufSnapshot(), findAllString_, findAllType_, getWindowDelimiters(), this);
+
+	connect(findAll_, &BackgroundFindAll::finished, this, &DocumentWidget::findAllFinished);
+
+	findAll_->start();
+}
+
+/*
+** Abandons the Find All running in the background, if any, without waiting
+** for it. It deletes itself once it notices.
+*/
+void DocumentWidget::cancelFindAll() {
+
+	findAllTimer_->stop();
+
+	if (findAll_) {
+		BackgroundFindAll *search = findAll_;
+		findAll_                  = nullptr;
+
+		disconnect(search, nullptr, this, nullptr);
+		connect(search, &BackgroundFindAll::finished, search, &QObject::deleteLater);
+		search->cancel();
+
+		// it may have finished before it could be told to delete itself
+		if (search->isFinished()) {
+			search->deleteLater();
+		}
+	}
+}
+
+/*
+** Called on the GUI thread once a Find All running in the background is over,
+** keeps the matches it found, and puts them into the Find All range set to
+** highlight them
+*/
+void DocumentWidget::findAllFinished() {
+
+	// it may have been abandoned after it had finished
+	if (sender() != findAll_) {
+		return;
+	}
+
+	BackgroundFindAll *search = findAll_;
+	findAll_                  = nullptr;
+	search->deleteLater();
+
+	/* the text has changed since the search took its snapshot, so look again
+	   once it stops changing. Until then, the matches found last time go on
+	   moving along with the text */
+	if (info_->buffer->BufRevision() != findAllRevision_) {
+		findAllTimer_->start();
+		return;
+	}
+
+	std::vector<TextRange> matches = search->takeMatches();
+	if (matches.empty()) {
+		clearFindAll();
+		QApplication::beep();
+		return;
+	}
+
+	Rangeset *rangeset = findAllRangeset();
+	if (!rangeset) {
+		if (!rangesetTable_) {
+			rangesetTable_ = std::make_unique<RangesetTable>(info_->buffer.get());
+		}
+
+		if (rangesetTable_->rangesetsAvailable() == 0) {
+			QApplication::beep();
+			return;
+		}
+
+		findAllLabel_ = rangesetTable_->RangesetCreate();
+		rangeset      = rangesetTable_->RangesetFetch(findAllLabel_);
+		rangeset->setName(FindAllRangesetName);
+	}
+
+	// redraw everything the old matches and the new ones cover, once
+	TextCursor first = matches.front().start;
+	TextCursor last  = matches.back().end;
+	if (boost::optional<TextRange> span = rangeset->RangesetSpan()) {
+		first = std::min(first, span->start);
+		last  = std::max(last, span->end);
+	}
+
+	rangeset->ranges_.clear();
+	rangeset->setColor(info_->buffer.get(), Preferences::GetPrefColorName(HILITE_BG_COLOR));
+
+	/* a range set merges ranges which touch, so matches which follow on
+	   from each other become one range */
+	for (const TextRange &match : matches) {
+		if (!rangeset->ranges_.empty() && rangeset->ranges_.back().end == match.start) {
+			rangeset->ranges_.back().end = match.end;
+		} else {
+			rangeset->ranges_.push_back(match);
+		}
+	}
+
+	rangeset->last_index_ = 0;
+
+	// kept as they are too, for stepping through them and counting them
+	findAllResults_ = std::move(matches);
+
+	info_->buffer->BufCheckDisplay(first, last);
+	updateFindAllMarkers();
+}
+
+/*
+** Forgets the matches of the last Find All, and stops any which is running
+*/
+void DocumentWidget::clearFindAll() {
+
+	cancelFindAll();
+
+	if (Rangeset *rangeset = findAllRangeset()) {
+		const boost::optional<TextRange> span = rangeset->RangesetSpan();
+		rangesetTable_->forgetLabel(findAllLabel_);
+
+		if (span) {
+			info_->buffer->BufCheckDisplay(span->start, span->end);
+		}
+	}
+
+	findAllLabel_ = 0;
+	findAllResults_.clear();
+	updateFindAllMarkers();
+}
+
+/**
+ * @brief DocumentWidget::findAllResults
+ * @return the matches of the last Find All, in order, and not merged as they are in its range set
+ */
+const std::vector<TextRange> &DocumentWidget::findAllResults() const {
+	return findAllResults_;
+}
+
+/**
+ * @brief DocumentWidget::findAllRangeset
+ * @return the range set holding the matches of the last Find All, or nullptr if there is none
+ */
+Rangeset *DocumentWidget::findAllRangeset() const {
+
+	if (findAllLabel_ == 0 || !rangesetTable_) {
+		return nullptr;
+	}
+
+	// a macro may have destroyed it, and even given its label to another range set
+	Rangeset *rangeset = rangesetTable_->RangesetFetch(findAllLabel_);
+	if (!rangeset || rangeset->name_ != FindAllRangesetName) {
+		return nullptr;
+	}
+
+	return rangeset;
+}
+
+/*
+** Selects the next match of the last Find All after the cursor, or the one
+** before it, and returns false (with a beep) if there is no such match
+*/
+bool DocumentWidget::selectFindAllMatch(TextArea *area, Direction direction, WrapMode wrap) {
+
+	if (!findAllRangeset() || findAllResults_.empty()) {
+		QApplication::beep();
+		return false;
+	}
+
+	const std::vector<TextRange> &ranges = findAllResults_;
+	const TextCursor cursorPos           = area->cursorPos();
+
+	std::vector<TextRange>::const_iterator match;
+	if (direction == Direction::Forward) {
+		// the first match which begins at or after the cursor
+		match = std::partition_point(ranges.begin(), ranges.end(), [cursorPos](const TextRange &range) {
+			return range.start < cursorPos;
+		});
+
+		if (match == ranges.end()) {
+			if (wrap == WrapMode::NoWrap) {
+				QApplication::beep();
+				return false;
+			}
+
+			match = ranges.begin();
+		}
+	} else {
+		// the last match which ends before the cursor
+		match = std::partition_point(ranges.begin(), ranges.end(), [cursorPos](const TextRange &range) {
+			return range.end < cursorPos;
+		});
 
+		if (match == ranges.begin()) {
+			if (wrap == WrapMode::NoWrap) {
+				QApplication::beep();
+				return false;
+			}
+
+			match = ranges.end();
+		}
+
+		--match;
+	}
+
+	info_->buffer->BufSelect(match->start, match->end);
+	makeSelectionVisible(area);
+	area->TextSetCursorPos(match->end);
 	return true;
 }
 
+/*
+** Redraws the vertical scroll bars, so that they mark where the matches of the
+** last Find All are now
+*/
+void DocumentWidget::updateFindAllMarkers() {
+	for (TextArea *area : textPanes()) {
+		area->verticalScrollBar()->update();
+	}
+}
+
 /**
  * @brief DocumentWidget::saveDocumentAs
  * @param newName
@@ -2541,6 +3217,8 @@ bool DocumentWidget::saveDocumentAs(const QString &newName, bool addWrap) {
 		return false;
 	}
 
+	waitForBackgroundSave();
+
 	QString fullname;
 
 	if (newName.isNull()) {
@@ -2565,7 +3243,7 @@ bool DocumentWidget::saveDocumentAs(const QString &newName, bool addWrap) {
 			return false;
 		}
 
-		return doSave();
+		return doSave(/*background=*/false);
 	}
 
 	// If the file is open in another window, make user close it.
@@ -2604,7 +3282,7 @@ bool DocumentWidget::saveDocumentAs(const QString &newName, bool addWrap) {
 	info_->gid      = 0;
 
 	info_->lockReasons.clear();
-	const int retVal = doSave();
+	const int retVal = doSave(/*background=*/false);
 	Q_EMIT updateWindowReadOnly(this);
 	refreshTabState();
 
@@ -2862,7 +3540,7 @@ bool DocumentWidget::closeFileAndWindow(CloseMode preResponse) {
 		switch (response) {
 		case QMessageBox::Yes:
 			// Save
-			if (saveDocument()) {
+			if (saveDocument(/*background=*/false)) {
 				closeDocument();
 			} else {
 				return false;
@@ -3164,19 +3842,31 @@ bool DocumentWidget::doOpen(const QString &name, const QString &path, int flags)
 		// TODO(eteran): error checking on this open?
 		file.open(fp, QIODevice::ReadOnly);
 
-		std::string text;
+		struct ReadContext {
+			QFile *file;
+			FileFormats *format;
+		};
 
-		if (file.size() != 0) {
-			uchar *memory = file.map(0, file.size());
-			if (!memory) {
-				info_->filenameSet = false; // Temp. prevent check for changes.
-				QMessageBox::critical(this, tr("Error while opening File"), tr("Error reading %1\n%2").arg(name, file.errorString()));
-				info_->filenameSet = true;
-				return false;
-			}
+		/* Read the file straight into the buffer, detecting and converting
+		 * DOS and Macintosh format files on the way in */
+		FileFormats format  = info_->fileFormat;
+		ReadContext context = {&file, Preferences::GetPrefForceOSConversion() ? &format : nullptr};
 
-			text = std::string{reinterpret_cast<char *>(memory), static_cast<size_t>(file.size())};
-			file.unmap(memory);
+		auto readFile = [](char *text, int64_t capacity, void *user) {
+			auto ctx = static_cast<ReadContext *>(user);
+			return ReadTextFile(ctx->file, text, capacity, ctx->format);
+		};
+
+		// Display the file contents in the text widget
+		info_->ignoreModify = true;
+		const bool loaded   = info_->buffer->BufSetAll(file.size(), readFile, &context);
+		info_->ignoreModify = false;
+
+		if (!loaded) {
+			info_->filenameSet = false; // Temp. prevent check for changes.
+			QMessageBox::critical(this, tr("Error while opening File"), tr("Error reading %1\n%2").arg(name, file.errorString()));
+			info_->filenameSet = true;
+			return false;
 		}
 
 		/* Any errors that happen after this point leave the window in a
@@ -3189,26 +3879,7 @@ bool DocumentWidget::doOpen(const QString &name, const QString &path, int flags)
 		info_->dev         = statbuf.st_dev;
 		info_->ino         = statbuf.st_ino;
 		info_->fileMissing = false;
-
-		// Detect and convert DOS and Macintosh format files
-		if (Preferences::GetPrefForceOSConversion()) {
-			info_->fileFormat = FormatOfFile(text);
-			switch (info_->fileFormat) {
-			case FileFormats::Dos:
-				ConvertFromDos(text);
-				break;
-			case FileFormats::Mac:
-				ConvertFromMac(text);
-				break;
-			case FileFormats::Unix:
-				break;
-			}
-		}
-
-		// Display the file contents in the text widget
-		info_->ignoreModify = true;
-		info_->buffer->BufSetAll(text);
-		info_->ignoreModify = false;
+		info_->fileFormat  = format;
 
 		// Set window title and file changed flag
 		if ((flags & EditFlags::PREF_READ_ONLY) != 0) {
@@ -3388,6 +4059,9 @@ void DocumentWidget::executeNewlineMacro(SmartIndentEvent *event) {
 
 		--(winData->inNewLineMacro);
 
+		// smart indent macros run to completion, don't leave their batches open
+		endMacroBatches();
+
 		// Process errors in macro execution
 		if (stat == MACRO_PREEMPT || stat == MACRO_ERROR) {
 			QMessageBox::critical(
@@ -3475,6 +4149,9 @@ void DocumentWidget::executeModMacro(SmartIndentEvent *event) {
 
 		--(winData->inModMacro);
 
+		// smart indent macros run to completion, don't leave their batches open
+		endMacroBatches();
+
 		// Process errors in macro execution
 		if (stat == MACRO_PREEMPT || stat == MACRO_ERROR) {
 			QMessageBox::critical(
@@ -5013,7 +5690,7 @@ void DocumentWidget::doShellMenuCmd(MainWindow *inWindow, TextArea *area, const
 
 	// If the command requires the file be saved first, save it
 	if (saveFirst) {
-		if (!saveDocument()) {
+		if (!saveDocument(/*background=*/false)) {
 			if (input != FROM_NONE) {
 				return;
 			}
@@ -5258,19 +5935,108 @@ void DocumentWidget::runMacro(Program *prog) {
 		finishMacroCmdExecution();
 		break;
 	case MACRO_TIME_LIMIT:
+		suspendMacroBatches();
 		resumeMacroExecution();
 		break;
 	case MACRO_PREEMPT:
+		suspendMacroBatches();
 		break;
 	}
 }
 
+/**
+ * @brief DocumentWidget::beginMacroBatch
+ *
+ * Holds back the redisplay and re-highlighting of this document until the
+ * matching endMacroBatch, on behalf of a macro's begin_batch()
+ */
+void DocumentWidget::beginMacroBatch() {
+	if (!macroBatchesSuspended_) {
+		info_->buffer->BufBeginBatch();
+	}
+
+	++macroBatchDepth_;
+}
+
+/**
+ * @brief DocumentWidget::endMacroBatch
+ */
+void DocumentWidget::endMacroBatch() {
+	if (macroBatchDepth_ > 0) {
+		--macroBatchDepth_;
+
+		if (!macroBatchesSuspended_) {
+			info_->buffer->BufEndBatch();
+		}
+	}
+}
+
+/**
+ * @brief DocumentWidget::endMacroBatches
+ *
+ * Ends any batches a macro left open on this document
+ */
+void DocumentWidget::endMacroBatches() {
+	while (macroBatchDepth_ > 0) {
+		endMacroBatch();
+	}
+
+	macroBatchesSuspended_ = false;
+}
+
+/**
+ * @brief DocumentWidget::suspendMacroBatches
+ *
+ * Ends the batches macros have open on every document for the time being,
+ * bringing the text areas up to date, but remembers them so that
+ * resumeMacroBatches can open them again. Done whenever a macro lets the
+ * event loop run, or uses something which relies on the text areas.
+ */
+void DocumentWidget::suspendMacroBatches() {
+	for (DocumentWidget *document : allDocuments()) {
+		if (document->macroBatchesSuspended_) {
+			continue;
+		}
+
+		for (int i = 0; i < document->macroBatchDepth_; ++i) {
+			document->info_->buffer->BufEndBatch();
+		}
+
+		document->macroBatchesSuspended_ = true;
+	}
+}
+
+/**
+ * @brief DocumentWidget::resumeMacroBatches
+ *
+ * Opens the batches suspendMacroBatches ended again
+ */
+void DocumentWidget::resumeMacroBatches() {
+	for (DocumentWidget *document : allDocuments()) {
+		if (!document->macroBatchesSuspended_) {
+			continue;
+		}
+
+		for (int i = 0; i < document->macroBatchDepth_; ++i) {
+			document->info_->buffer->BufBeginBatch();
+		}
+
+		document->macroBatchesSuspended_ = false;
+	}
+}
+
 /*
 ** Clean up after the execution of a macro command: free memory, and restore
 ** the user interface state.
 */
 void DocumentWidget::finishMacroCmdExecution() {
 
+	/* A macro may have opened batches on any document, and the changes made in
+	   them aren't shown until they end */
+	for (DocumentWidget *document : DocumentWidget::allDocuments()) {
+		document->endMacroBatches();
+	}
+
 	const bool closeOnCompletion = macroCmdData_->closeOnCompletion;
 
 	// Cancel pending timeout and work proc
@@ -5312,6 +6078,10 @@ DocumentWidget::MacroContinuationCode DocumentWidget::continueWorkProc() {
 		return MacroContinuationCode::Stop;
 	}
 
+	/* the batches the macro had open were ended while the event loop ran,
+	   so that the text areas were up to date for it */
+	resumeMacroBatches();
+
 	QString errMsg;
 	DataValue result;
 	const ExecReturnCodes stat = continueMacro(macroCmdData_->context, &result, &errMsg);
@@ -5325,9 +6095,11 @@ DocumentWidget::MacroContinuationCode DocumentWidget::continueWorkProc() {
 		finishMacroCmdExecution();
 		return MacroContinuationCode::Stop;
 	case MACRO_PREEMPT:
+		suspendMacroBatches();
 		return MacroContinuationCode::Stop;
 	case MACRO_TIME_LIMIT:
 		// Macro exceeded time slice, re-schedule it
+		suspendMacroBatches();
 		return MacroContinuationCode::Continue;
 	}
 
@@ -5846,9 +6618,11 @@ void DocumentWidget::handleUnparsedRegion(TextBuffer *styleBuf, TextCursor pos)
 		}
 	}
 
-	// Copy the buffer range into a string
-	std::string str    = buf->BufGetRange(beginSafety, endSafety);
-	const char *string = &str[0];
+	/* Get the buffer range as a string. This reads the buffer in place, and
+	   only copies when the range isn't stored contiguously */
+	std::string storage;
+	const view::string_view str = buf->BufGetSegments(beginSafety, endSafety).to_view(&storage);
+	const char *string          = str.data();
 
 	std::string styleStr    = styleBuf->BufGetRange(beginSafety, endSafety);
 	char *const styleString = &styleStr[0];
@@ -5857,9 +6631,13 @@ void DocumentWidget::handleUnparsedRegion(TextBuffer *styleBuf, TextCursor pos)
 	// Parse it with pass 2 patterns
 	int prev_char = Highlight::getPrevChar(buf, beginSafety);
 	Highlight::ParseContext ctx;
-	ctx.prev_char  = &prev_char;
-	ctx.delimiters = documentDelimiters();
-	ctx.text       = str;
+	ctx.prev_char = &prev_char;
+	ctx.text      = str;
+
+	const QString delimiters = documentDelimiters();
+	if (!delimiters.isNull()) {
+		ctx.delimiters = Regex::makeDelimiterTable(delimiters.toStdString());
+	}
 
 	Highlight::parseString(
 		&pass2Patterns[0],
@@ -5919,10 +6697,14 @@ void DocumentWidget::startHighlighting(Verbosity verbosity) {
 		int prev_char = -1;
 		Highlight::ParseContext ctx;
 		ctx.prev_char         = &prev_char;
-		ctx.delimiters        = documentDelimiters();
 		ctx.text              = info_->buffer->BufAsString();
 		const char *stringPtr = &ctx.text[0];
 
+		const QString delimiters = documentDelimiters();
+		if (!delimiters.isNull()) {
+			ctx.delimiters = Regex::makeDelimiterTable(delimiters.toStdString());
+		}
+
 		Highlight::parseString(
 			&highlightData->pass1Patterns[0],
 			stringPtr,
@@ -6877,24 +7659,22 @@ void DocumentWidget::addMark(TextArea *area, QChar label) {
 }
 
 void DocumentWidget::selectNumberedLine(TextArea *area, int64_t lineNum) {
-	int i;
+
 	TextCursor lineStart = {};
 
-	// count lines to find the start and end positions for the selection
+	// find the start and end positions for the selection
 	if (lineNum < 1) {
 		lineNum = 1;
 	}
 
-	auto lineEnd = TextCursor(-1);
-
-	for (i = 1; i <= lineNum && lineEnd < info_->buffer->length(); i++) {
-		lineStart = lineEnd + 1;
-		lineEnd   = info_->buffer->BufEndOfLine(lineStart);
-	}
+	const int64_t totalLines = info_->buffer->BufCountLines(info_->buffer->BufStartOfBuffer(), info_->buffer->BufEndOfBuffer()) + 1;
 
 	// highlight the line
-	if (i > lineNum) {
+	if (lineNum <= totalLines) {
 		// Line was found
+		lineStart                = info_->buffer->BufCountForwardNLines(info_->buffer->BufStartOfBuffer(), lineNum - 1);
+		const TextCursor lineEnd = info_->buffer->BufEndOfLine(lineStart);
+
 		if (lineEnd < info_->buffer->length()) {
 			info_->buffer->BufSelect(lineStart, lineEnd + 1);
 		} else {
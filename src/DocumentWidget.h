@@ -14,13 +14,16 @@
 #include "MenuData.h"
 #include "MenuItem.h"
 #include "RangesetTable.h"
+#include "SearchType.h"
 #include "ShowMatchingStyle.h"
 #include "Tags.h"
 #include "TextBufferFwd.h"
+#include "TextRange.h"
 #include "UndoInfo.h"
 #include "Util/FileFormats.h"
 #include "Util/string_view.h"
 #include "Verbosity.h"
+#include "WrapMode.h"
 #include "WrapStyle.h"
 
 #include "ui_DocumentWidget.h"
@@ -33,8 +36,12 @@
 
 #include <boost/optional.hpp>
 
+#include <functional>
+
 #include <sys/stat.h>
 
+class BackgroundFindAll;
+class BackgroundSave;
 class HighlightPattern;
 class MainWindow;
 class PatternSet;
@@ -96,6 +103,8 @@ public:
 	static DocumentWidget *editExistingFile(DocumentWidget *inDocument, const QString &name, const QString &path, int flags, const QString &geometry, bool iconic, const QString &languageMode, bool tabbed, bool background);
 	static DocumentWidget *fromArea(TextArea *area);
 	static std::vector<DocumentWidget *> allDocuments();
+	static void resumeMacroBatches();
+	static void suspendMacroBatches();
 
 public:
 	void action_Set_Fonts(const QString &fontName);
@@ -121,10 +130,12 @@ public:
 	QString highlightNameOfCode(size_t hCode) const;
 	QString highlightStyleOfCode(size_t hCode) const;
 	QString path() const;
+	Rangeset *findAllRangeset() const;
 	ShowMatchingStyle showMatchingStyle() const;
 	TextArea *firstPane() const;
 	TextBuffer *buffer() const;
 	WrapStyle wrapMode() const;
+	const std::vector<TextRange> &findAllResults() const;
 	bool backlightChars() const;
 	bool checkReadOnly() const;
 	bool fileChanged() const;
@@ -140,9 +151,11 @@ public:
 	bool overstrike() const;
 	bool readMacroFile(const QString &fileName, bool warnNotExist);
 	bool readMacroString(const QString &string, const QString &errIn);
+	bool selectFindAllMatch(TextArea *area, Direction direction, WrapMode wrap);
 	bool showStatisticsLine() const;
 	bool useTabs() const;
 	bool userLocked() const;
+	boost::optional<TextRange> replaceTextDeltas(const std::vector<TextDelta> &deltas, const std::function<bool(size_t)> &progress);
 	dev_t device() const;
 	ino_t inode() const;
 	int findDefinitionHelperCommon(TextArea *area, const QString &value, Tags::SearchMode search_type);
@@ -157,16 +170,21 @@ public:
 	std::vector<TextArea *> textPanes() const;
 	void abortShellCommand();
 	void addMark(TextArea *area, QChar label);
+	void beginMacroBatch();
 	void beginSmartIndent(Verbosity verbosity);
 	void cancelMacroOrLearn();
 	void checkForChangesToFile();
+	void clearFindAll();
 	void clearModeMessage();
 	void closePane();
 	void doMacro(const QString &macro, const QString &errInName);
 	void editTaggedLocation(TextArea *area, int i);
+	void endMacroBatch();
+	void endMacroBatches();
 	void endSmartIndent();
 	void execAP(TextArea *area, const QString &command);
 	void executeShellCommand(TextArea *area, const QString &command, CommandSource source);
+	void findAll(const QString &searchString, SearchType searchType);
 	void findDefinition(TextArea *area, const QString &tagName);
 	void findDefinitionCalltip(TextArea *area, const QString &tipName);
 	void findDefinitionHelper(TextArea *area, const QString &arg, Tags::SearchMode search_type);
@@ -232,12 +250,14 @@ private:
 	bool closeFileAndWindow(CloseMode preResponse);
 	bool compareDocumentToFile(const QString &fileName) const;
 	bool doOpen(const QString &name, const QString &path, int flags);
-	bool doSave();
+	bool doSave(bool background);
 	bool fileWasModifiedExternally() const;
 	bool includeFile(const QString &name);
 	bool macroWindowCloseActions();
-	bool saveDocument();
+	bool offerSaveAs(const QString &error);
+	bool saveDocument(bool background);
 	bool saveDocumentAs(const QString &newName, bool addWrap);
+	bool startBackgroundSave(const QString &fullname);
 	bool writeBackupFile();
 	bool writeBckVersion();
 	boost::optional<TextCursor> findMatchingChar(char toMatch, Style styleToMatch, TextCursor charPos, TextCursor startLimit, TextCursor endLimit);
@@ -252,7 +272,9 @@ private:
 	void addWrapNewlines();
 	void appendDeletedText(view::string_view deletedText, int64_t deletedLen, Direction direction);
 	void attachHighlightToWidget(TextArea *area);
+	void backgroundSaveFinished();
 	void beginLearn();
+	void cancelFindAll();
 	void cancelLearning();
 	void clearRedoList();
 	void clearUndoList();
@@ -267,6 +289,7 @@ private:
 	void executeModMacro(SmartIndentEvent *event);
 	void executeNewlineMacro(SmartIndentEvent *event);
 	void filterSelection(const QString &command, CommandSource source);
+	void findAllFinished();
 	void finishLearning();
 	void flashMatchingChar(TextArea *area);
 	void freeHighlightingData();
@@ -286,9 +309,14 @@ private:
 	void saveUndoInformation(TextCursor pos, int64_t nInserted, int64_t nDeleted, view::string_view deletedText);
 	void setModeMessage(const QString &message);
 	void setWindowModified(bool modified);
+	void startFindAll();
 	void trimUndoList(size_t maxLength);
 	void undo();
+	void waitForBackgroundSave();
 	void unloadLanguageModeTipsFile();
+	void updateFileInfo(const QString &fullname);
+	void updateFindAllMarkers();
+	void updateFindAllResults(TextCursor pos, int64_t nInserted, int64_t nDeleted);
 	void updateMarkTable(TextCursor pos, int64_t nInserted, int64_t nDeleted);
 	void updateSelectionSensitiveMenu(QMenu *menu, const gsl::span<MenuData> &menuList, bool enabled);
 	void updateSelectionSensitiveMenus(bool enabled);
@@ -315,10 +343,28 @@ private:
 private:
 	QSplitter *splitter_;
 	QFont font_;
-	QString backlightCharTypes_; // what backlighting to use
-	QString modeMessage_;        // stats line banner content for learn and shell command executing modes
-	QTimer *flashTimer_;         // timer for getting rid of highlighted matching paren.
-	bool backlightChars_;        // is char backlighting turned on?
+	QString backlightCharTypes_;         // what backlighting to use
+	QString modeMessage_;                // stats line banner content for learn and shell command executing modes
+	QTimer *flashTimer_;                 // timer for getting rid of highlighted matching paren.
+	bool backlightChars_;                // is char backlighting turned on?
+	int macroBatchDepth_        = 0;     // number of modification batches opened by macros and not yet ended
+	bool macroBatchesSuspended_ = false; // are those batches ended for now, while the macro isn't running?
+
+private:
+	BackgroundSave *backgroundSave_ = nullptr; // the save running in the background, if any
+	bool modifiedDuringSave_        = false;   // has the text changed since the running save took its snapshot?
+	bool saveBannerIsUp_            = false;   // is the stats line showing the progress of the save?
+
+private:
+	BackgroundFindAll *findAll_ = nullptr;             // the Find All running in the background, if any
+	QString findAllString_;                            // what the last Find All searched for
+	SearchType findAllType_     = SearchType::Literal; // and how
+	uint64_t findAllRevision_   = 0;                   // the revision of the text the running Find All is searching
+	int findAllLabel_           = 0;                   // the range set holding the matches of the last Find All, 0 if none
+	std::vector<TextRange> findAllResults_;            // those matches, in order, as the range set merges the ones which touch
+	QTimer *findAllTimer_       = nullptr;             // for searching again once the text stops changing
+
+private:
 	std::map<QChar, Bookmark> markTable_;
 	std::unique_ptr<ShellCommandData> shellCmdData_; // when a shell command is executing, info. about it, otherwise, nullptr
 	Ui::DocumentWidget ui;
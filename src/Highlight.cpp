@@ -345,12 +345,13 @@ TextCursor parseBufferRange(const HighlightData *pass1Patterns, const std::uniqu
 		endSafety = std::min(buf->BufEndOfBuffer(), buf->BufEndOfLine(endParse) + 1);
 	}
 
-	// copy the buffer range into a string
+	/* get the buffer range as a string. This reads the buffer in place, and
+	   only copies when the range isn't stored contiguously */
+	std::string storage;
+	const view::string_view str = buf->BufGetSegments(beginSafety, endSafety).to_view(&storage);
+	std::string styleStr        = styleBuf->BufGetRange(beginSafety, endSafety);
 
-	std::string str      = buf->BufGetRange(beginSafety, endSafety);
-	std::string styleStr = styleBuf->BufGetRange(beginSafety, endSafety);
-
-	const char *const string   = &str[0];
+	const char *const string   = str.data();
 	char *const styleString    = &styleStr[0];
 	const char *const match_to = string + str.size();
 
@@ -1147,19 +1148,17 @@ bool parseString(const HighlightData *pattern, const char *&string_ptr, char *&s
 
 	const std::unique_ptr<Regex> &subPatternRE = pattern->subPatternRE;
 
-	const QByteArray delimitersString = ctx->delimiters.toLatin1();
-	const char *delimitersPtr         = ctx->delimiters.isNull() ? nullptr : delimitersString.data();
-
 	while (subPatternRE->ExecRE(
 		stringPtr,
 		string_ptr + length + 1,
 		false,
 		*ctx->prev_char,
 		next_char,
-		delimitersPtr,
+		ctx->delimiters,
 		look_behind_to,
 		match_to,
-		ctx->text.end())) {
+		ctx->text.end(),
+		&ctx->scratch)) {
 
 		/* Beware of the case where only one real branch exists, but that
 		   branch has sub-branches itself. In that case the top_branch refers
@@ -1194,10 +1193,11 @@ bool parseString(const HighlightData *pattern, const char *&string_ptr, char *&s
 									false,
 									savedPrevChar,
 									next_char,
-									delimitersPtr,
+									ctx->delimiters,
 									look_behind_to,
 									match_to,
-									ctx->text.end())) {
+									ctx->text.end(),
+									&ctx->scratch)) {
 								qCritical("NEdit: Internal error, failed to recover end match in parseString");
 								return false;
 							}
@@ -1293,10 +1293,11 @@ bool parseString(const HighlightData *pattern, const char *&string_ptr, char *&s
 							false,
 							savedPrevChar,
 							next_char,
-							delimitersPtr,
+							ctx->delimiters,
 							look_behind_to,
 							match_to,
-							ctx->text.end())) {
+							ctx->text.end(),
+							&ctx->scratch)) {
 						qCritical("NEdit: Internal error, failed to recover start match in parseString");
 						return false;
 					}
@@ -2,12 +2,14 @@
 #ifndef HIGHLIGHT_H_
 #define HIGHLIGHT_H_
 
+#include "Regex.h"
 #include "TextBufferFwd.h"
 #include "TextCursor.h"
 #include "Util/QtHelper.h"
 #include "Util/string_view.h"
 
 #include <boost/optional.hpp>
+#include <bitset>
 #include <memory>
 #include <vector>
 
@@ -46,8 +48,9 @@ namespace Highlight {
 Q_DECLARE_NAMESPACE_TR(Highlight)
 
 struct ParseContext {
-	int *prev_char = nullptr;
-	QString delimiters;
+	int *prev_char                = nullptr;
+	std::bitset<256> delimiters   = Regex::Default_Delimiters; // Word delimiter table for every search of the parse
+	mutable RegexScratch scratch;                              // Reused by every search of the parse
 	view::string_view text;
 };
 
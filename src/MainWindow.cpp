@@ -1,5 +1,6 @@
 
 #include "MainWindow.h"
+#include "BackgroundSearch.h"
 #include "CommandRecorder.h"
 #include "DialogAbout.h"
 #include "DialogColors.h"
@@ -29,6 +30,7 @@
 #include "PatternSet.h"
 #include "Preferences.h"
 #include "Regex.h"
+#include "RegexCache.h"
 #include "Search.h"
 #include "Settings.h"
 #include "SignalBlocker.h"
@@ -38,7 +40,6 @@
 #include "Util/ClearCase.h"
 #include "Util/FileSystem.h"
 #include "Util/algorithm.h"
-#include "Util/regex.h"
 #include "Util/utils.h"
 #include "WindowMenuEvent.h"
 #include "nedit.h"
@@ -50,11 +51,14 @@
 #include <QInputDialog>
 #include <QMessageBox>
 #include <QMimeData>
+#include <QProgressDialog>
 #include <QShortcut>
 #include <QToolTip>
 #include <qplatformdefs.h>
 
+#include <algorithm>
 #include <cmath>
+#include <memory>
 
 #ifdef Q_OS_LINUX
 #include <QLibrary>
@@ -68,6 +72,17 @@ qint64 busyStartTime = 0;
 
 QPointer<DocumentWidget> lastFocusDocument;
 
+// documents at least this big show a progress dialog during Replace All
+constexpr size_t ReplaceAllProgressSize = 16 * 1024 * 1024;
+
+// how finely that dialog reports progress, and how long (msec) it waits before appearing
+constexpr int ReplaceAllProgressSteps = 1000;
+constexpr int ReplaceAllProgressDelay = 500;
+
+/* how much text an incremental search goes through between keystrokes, any
+   more is searched in the background so that typing doesn't stall */
+constexpr int64_t ISearchSyncSize = 4 * 1024 * 1024;
+
 QVector<QString> PrevOpen;
 
 /*
@@ -2726,7 +2741,7 @@ void MainWindow::editIFind_textChanged(const QString &text) {
 	   correct syntax doesn't match) */
 	if (Search::isRegexType(searchType)) {
 		try {
-			auto compiledRE = make_regex(text, Search::defaultRegexFlags(searchType));
+			auto compiledRE = RegexCache::acquire(text.toStdString(), Search::defaultRegexFlags(searchType));
 		} catch (const RegexError &) {
 			return;
 		}
@@ -3037,6 +3052,7 @@ void MainWindow::endISearch() {
 
 	// Forget the starting position used for the current run of searches
 	iSearchStartPos_ = TextCursor(-1);
+	cancelISearchJob();
 
 	// Mark the end of incremental search history overwriting
 	Search::saveSearchHistory(QString(), QString(), SearchType::Literal, /*isIncremental=*/false);
@@ -4828,7 +4844,7 @@ void MainWindow::action_Save(DocumentWidget *document) {
 		return;
 	}
 
-	document->saveDocument();
+	document->saveDocument(Preferences::GetPrefBackgroundSave());
 }
 
 /**
@@ -5501,6 +5517,47 @@ void MainWindow::action_Find(DocumentWidget *document, const QString &string, Di
 	}
 }
 
+/**
+ * @brief MainWindow::action_Find_All
+ * @param document
+ * @param string
+ * @param type
+ */
+void MainWindow::action_Find_All(DocumentWidget *document, const QString &string, SearchType type) {
+
+	emit_event("find_all", string, to_string(type));
+
+	// Save a copy of string in the search history
+	Search::saveSearchHistory(string, QString(), type, /*isIncremental=*/false);
+
+	document->findAll(string, type);
+}
+
+/**
+ * @brief MainWindow::action_Find_All_Clear
+ * @param document
+ */
+void MainWindow::action_Find_All_Clear(DocumentWidget *document) {
+
+	emit_event("find_all_clear");
+	document->clearFindAll();
+}
+
+/**
+ * @brief MainWindow::action_Find_All_Next
+ * @param document
+ * @param direction
+ * @param wrap
+ */
+void MainWindow::action_Find_All_Next(DocumentWidget *document, Direction direction, WrapMode wrap) {
+
+	emit_event("find_all_next", to_string(direction), to_string(wrap));
+
+	if (QPointer<TextArea> area = lastFocus()) {
+		document->selectFindAllMatch(area, direction, wrap);
+	}
+}
+
 /**
  * @brief MainWindow::action_Find_triggered
  */
@@ -5666,6 +5723,28 @@ void MainWindow::action_Replace_All(DocumentWidget *document, const QString &sea
 	}
 }
 
+/**
+ * @brief MainWindow::action_Replace_All
+ * @param document
+ * @param searchString
+ * @param replaceString
+ * @param type
+ * @param replacements what searching "document" for "searchString" found, worked out ahead of time
+ */
+void MainWindow::action_Replace_All(DocumentWidget *document, const QString &searchString, const QString &replaceString, SearchType type, const std::vector<TextDelta> &replacements) {
+
+	emit_event("replace_all", searchString, replaceString, to_string(type));
+
+	if (document->checkReadOnly()) {
+		return;
+	}
+
+	if (QPointer<TextArea> area = lastFocus()) {
+		Search::saveSearchHistory(searchString, replaceString, type, /*isIncremental=*/false);
+		applyReplaceAll(document, area, replacements, nullptr);
+	}
+}
+
 /**
  * @brief MainWindow::action_Show_Tip
  * @param document
@@ -6072,9 +6151,6 @@ bool MainWindow::searchWindow(DocumentWidget *document, const QString &searchStr
 		return false;
 	}
 
-	// get the entire text buffer from the text area widget
-	view::string_view fileString = buffer->BufAsString();
-
 	/* If we're already outside the boundaries, we must consider wrapping
 	   immediately (Note: fileEnd+1 is a valid starting position. Consider
 	   searching for $ at the end of a file ending with \n.) */
@@ -6088,7 +6164,7 @@ bool MainWindow::searchWindow(DocumentWidget *document, const QString &searchStr
 	if (iSearchStartPos_ == -1) { // normal search
 
 		found = !outsideBounds && Search::SearchString(
-									  fileString,
+									  buffer,
 									  searchString,
 									  direction,
 									  searchType,
@@ -6131,7 +6207,7 @@ bool MainWindow::searchWindow(DocumentWidget *document, const QString &searchStr
 					}
 
 					found = Search::SearchString(
-						fileString,
+						buffer,
 						searchString,
 						direction,
 						searchType,
@@ -6160,7 +6236,7 @@ bool MainWindow::searchWindow(DocumentWidget *document, const QString &searchStr
 					}
 
 					found = Search::SearchString(
-						fileString,
+						buffer,
 						searchString,
 						direction,
 						searchType,
@@ -6186,7 +6262,7 @@ bool MainWindow::searchWindow(DocumentWidget *document, const QString &searchStr
 		}
 
 		found = !outsideBounds && Search::SearchString(
-									  fileString,
+									  buffer,
 									  searchString,
 									  direction,
 									  searchType,
@@ -6297,6 +6373,9 @@ bool MainWindow::searchAndSelect(DocumentWidget *document, TextArea *area, const
 */
 bool MainWindow::searchAndSelectIncremental(DocumentWidget *document, TextArea *area, const QString &searchString, Direction direction, SearchType searchType, WrapMode searchWrap, bool continued) {
 
+	// a search still running for an earlier search string is of no more use
+	cancelISearchJob();
+
 	/* If there's a search in progress, start the search from the original
 	   starting position, otherwise search from the cursor position. */
 	if (!continued || iSearchStartPos_ == -1) {
@@ -6334,13 +6413,144 @@ bool MainWindow::searchAndSelectIncremental(DocumentWidget *document, TextArea *
 		--beginPos;
 	}
 
-	Search::Result searchResult;
+	TextBuffer *buffer = document->buffer();
 
-	// do the search.  SearchWindow does appropriate dialogs and beeps
-	if (!searchWindow(document, searchString, direction, searchType, searchWrap, to_integer(beginPos), &searchResult)) {
+	ISearch search;
+	search.document     = document;
+	search.area         = area;
+	search.searchString = searchString;
+	search.direction    = direction;
+	search.searchType   = searchType;
+	search.searchWrap   = searchWrap;
+	search.wrap         = searchWrap;
+	search.beginPos     = to_integer(beginPos);
+	search.searchPos    = to_integer(beginPos);
+	search.revision     = buffer->BufRevision();
+
+	/* If we're already outside the boundaries, we must consider wrapping
+	   immediately, as searchWindow does */
+	if (direction == Direction::Backward && search.beginPos < 0) {
+		if (searchWrap == WrapMode::NoWrap) {
+			QApplication::beep();
+			return false;
+		}
+
+		search.beginPos  = buffer->length();
+		search.searchPos = search.beginPos;
+	}
+
+	/* When the search string only adds to the end of the last one, it can't
+	   match anywhere before the last match, so carry on from there instead
+	   of starting over */
+	if (iSearchCanResume(search)) {
+		if (!iSearchLastMatch_) {
+			QApplication::beep();
+			return false;
+		}
+
+		search.searchPos = *iSearchLastMatch_;
+
+		// if the last match was found after wrapping, there's nothing left to wrap to
+		const bool wrapped = (direction == Direction::Forward) ? (search.searchPos < search.beginPos) : (search.searchPos > search.beginPos);
+		if (wrapped) {
+			search.wrap = WrapMode::NoWrap;
+		}
+	}
+
+	/* Small documents are searched here and now, as is anything a macro asks
+	   for, since the macro expects to find the match selected when it goes
+	   on. Otherwise, as much as there is time for between keystrokes is
+	   searched here, and what is left of the document is searched in the
+	   background */
+	if (buffer->length() <= ISearchSyncSize || document->macroCmdData_) {
+		return iSearchFinished(search, Search::SearchString(buffer, searchString, direction, searchType, search.wrap, search.searchPos, document->getWindowDelimiters()));
+	}
+
+	const TextBuffer::snapshot_type snapshot = buffer->BufSnapshot();
+
+	// a regular expression search can't be given up part way through
+	if (!Search::isRegexType(searchType)) {
+
+		auto progress = [](int64_t scanned) {
+			return scanned < ISearchSyncSize;
+		};
+
+		bool gaveUp;
+		boost::optional<Search::Result> result = Search::SearchSnapshot(snapshot, searchString, direction, searchType, search.wrap, search.searchPos, document->getWindowDelimiters(), progress, &search.searched, &gaveUp);
+		if (!gaveUp) {
+			return iSearchFinished(search, result);
+		}
+	}
+
+	startISearchJob(search);
+
+	// the match will be selected once the search has found it
+	return false;
+}
+
+/*
+** Searches the rest of the document for an incremental search on a thread of
+** its own. A regular expression search can't be stopped part way through, so
+** while an abandoned search is still running, only the latest search is kept
+** to be started once it has stopped, rather than having them pile up.
+*/
+void MainWindow::startISearchJob(const ISearch &search) {
+
+	if (iSearchJob_) {
+		iSearchPending_ = search;
+		return;
+	}
+
+	DocumentWidget *document = search.document;
+
+	iSearchJob_       = new BackgroundSearch(document->buffer()->BufSnapshot(), search.searchString, search.direction, search.searchType, search.wrap, search.searchPos, document->getWindowDelimiters(), search.searched, this);
+	iSearchJobSearch_ = search;
+
+	connect(iSearchJob_, &BackgroundSearch::finished, this, &MainWindow::iSearchJobFinished);
+	iSearchJob_->start();
+}
+
+/*
+** Whether an incremental search can carry on from the match of the last
+** incremental search to finish, rather than start over. That's so when it
+** searches the same unchanged text from the same place for a literal string
+** which begins with the last search string, since any match of the new string
+** is a match of the old one too.
+*/
+bool MainWindow::iSearchCanResume(const ISearch &search) const {
+
+	if (search.searchType != SearchType::Literal && search.searchType != SearchType::CaseSense) {
+		return false;
+	}
+
+	return iSearchLast_.document == search.document &&
+		   iSearchLast_.revision == search.revision &&
+		   iSearchLast_.beginPos == search.beginPos &&
+		   iSearchLast_.direction == search.direction &&
+		   iSearchLast_.searchType == search.searchType &&
+		   iSearchLast_.searchWrap == search.searchWrap &&
+		   search.searchString.startsWith(iSearchLast_.searchString, Qt::CaseSensitive);
+}
+
+/*
+** Selects the match an incremental search found, or beeps if there was none,
+** and remembers it so that the next search may carry on from it.
+*/
+bool MainWindow::iSearchFinished(const ISearch &search, const boost::optional<Search::Result> &result) {
+
+	iSearchLast_      = search;
+	iSearchLastMatch_ = boost::none;
+
+	if (!result) {
+		QApplication::beep();
 		return false;
 	}
 
+	iSearchLastMatch_ = result->start;
+	iSearchTryBeepOnWrap(search.direction, TextCursor(search.beginPos), TextCursor(result->start));
+
+	Search::Result searchResult = *result;
+
 	auto startPos = TextCursor(searchResult.start);
 	auto endPos   = TextCursor(searchResult.end);
 
@@ -6349,8 +6559,8 @@ bool MainWindow::searchAndSelectIncremental(DocumentWidget *document, TextArea *
 	/* if the search matched an empty string (possible with regular exps)
 	   beginning at the start of the search, go to the next occurrence,
 	   otherwise repeated finds will get "stuck" at zero-length matches */
-	if (direction == Direction::Forward && beginPos == startPos && beginPos == endPos) {
-		if (!searchWindow(document, searchString, direction, searchType, searchWrap, to_integer(beginPos + 1), &searchResult)) {
+	if (search.direction == Direction::Forward && search.beginPos == searchResult.start && search.beginPos == searchResult.end) {
+		if (!searchWindow(search.document, search.searchString, search.direction, search.searchType, search.searchWrap, search.beginPos + 1, &searchResult)) {
 			return false;
 		}
 
@@ -6361,12 +6571,60 @@ bool MainWindow::searchAndSelectIncremental(DocumentWidget *document, TextArea *
 	iSearchLastBeginPos_ = startPos;
 
 	// select the text found string
-	document->buffer()->BufSelect(startPos, endPos);
-	document->makeSelectionVisible(area);
-	area->TextSetCursorPos(endPos);
+	search.document->buffer()->BufSelect(startPos, endPos);
+	search.document->makeSelectionVisible(search.area);
+	search.area->TextSetCursorPos(endPos);
 	return true;
 }
 
+/*
+** Abandons the incremental search running in the background, if any, along
+** with any search waiting for it to stop. It is kept track of until it has
+** stopped, so that no more than one is ever running.
+*/
+void MainWindow::cancelISearchJob() {
+
+	iSearchPending_ = boost::none;
+
+	if (iSearchJob_) {
+		iSearchJob_->cancel();
+	}
+}
+
+/*
+** Called on the GUI thread once an incremental search running in the
+** background is over, selects the match it found
+*/
+void MainWindow::iSearchJobFinished() {
+
+	if (sender() != iSearchJob_) {
+		return;
+	}
+
+	BackgroundSearch *job = iSearchJob_;
+	iSearchJob_           = nullptr;
+	job->deleteLater();
+
+	// the document has gone, or what was found isn't there any more
+	auto stillValid = [](const ISearch &search) {
+		return search.document && search.area && search.document->buffer()->BufRevision() == search.revision;
+	};
+
+	if (!job->canceled() && stillValid(iSearchJobSearch_)) {
+		iSearchFinished(iSearchJobSearch_, job->result());
+	}
+
+	// now that it has stopped, the latest search waiting for it can start
+	if (iSearchPending_) {
+		const ISearch search = *iSearchPending_;
+		iSearchPending_      = boost::none;
+
+		if (stillValid(search)) {
+			startISearchJob(search);
+		}
+	}
+}
+
 /*
 ** Replace selection with "replaceString" and search for string "searchString"
 ** in window "window", using algorithm "searchType" and direction "direction"
@@ -6915,9 +7173,6 @@ bool MainWindow::prefOrUserCancelsSubst(DocumentWidget *document) {
 */
 bool MainWindow::replaceAll(DocumentWidget *document, TextArea *area, const QString &searchString, const QString &replaceString, SearchType searchType) {
 
-	int64_t copyStart;
-	int64_t copyEnd;
-
 	// reject empty string
 	if (searchString.isEmpty()) {
 		return false;
@@ -6933,16 +7188,72 @@ bool MainWindow::replaceAll(DocumentWidget *document, TextArea *area, const QStr
 
 	QString delimieters = document->getWindowDelimiters();
 
-	boost::optional<std::string> newFileString = Search::ReplaceAllInString(
-		fileString,
-		searchString,
-		replaceString,
-		searchType,
-		&copyStart,
-		&copyEnd,
-		delimieters);
+	/* replacing everything in a very large document can take a while, so show
+	   how far along it is and let the user give up. The first half of the
+	   dialog's range is for finding the matches, the second for replacing
+	   them */
+	std::unique_ptr<QProgressDialog> progress;
+	if (fileString.size() >= ReplaceAllProgressSize) {
+		progress = std::make_unique<QProgressDialog>(tr("Replacing..."), tr("Cancel"), 0, ReplaceAllProgressSteps, this);
+		progress->setWindowModality(Qt::WindowModal);
+		progress->setMinimumDuration(ReplaceAllProgressDelay);
+	}
+
+	auto reportProgress = [&progress](int64_t done, int64_t total, int offset) {
+		if (!progress) {
+			return true;
+		}
+
+		const int value = offset + static_cast<int>(done * (ReplaceAllProgressSteps / 2) / std::max<int64_t>(total, 1));
+		if (value != progress->value()) {
+			progress->setValue(value);
+		}
+
+		return !progress->wasCanceled();
+	};
+
+	/* work out what each match is to be replaced with, keeping just the
+	   replacements rather than a new copy of the text around them */
+	std::vector<TextDelta> deltas;
+	const auto fileSize     = static_cast<int64_t>(fileString.size());
+	const uint64_t revision = buffer->BufRevision();
+
+	Search::ForEachReplacement(fileString, searchString, replaceString, searchType, delimieters, [&](const Search::Result &match, std::string &&replacement) {
+		TextDelta delta;
+		delta.startPos = TextCursor(match.start);
+		delta.length   = match.end - match.start;
+		delta.text     = std::move(replacement);
+		deltas.push_back(std::move(delta));
+
+		/* showing the progress lets other things run, and if one of them
+		   changes the text, "fileString" and the matches found so far are
+		   out of date, so the search can't go on */
+		return reportProgress(match.end, fileSize, 0) && buffer->BufRevision() == revision;
+	});
+
+	if (buffer->BufRevision() != revision) {
+		QApplication::beep();
+		return false;
+	}
+
+	if (progress && progress->wasCanceled()) {
+		return false;
+	}
+
+	/* make the replacements a chunk at a time. If the user cancels part way,
+	   what has been replaced so far stays, and can be undone */
+	return applyReplaceAll(document, area, deltas, [&](size_t done) {
+		return reportProgress(static_cast<int64_t>(done), static_cast<int64_t>(deltas.size()), ReplaceAllProgressSteps / 2);
+	});
+}
+
+/*
+** Make the replacements found by a Replace All in "document", or let the user
+** know that there weren't any. "progress" is passed on to replaceTextDeltas.
+*/
+bool MainWindow::applyReplaceAll(DocumentWidget *document, TextArea *area, const std::vector<TextDelta> &replacements, const std::function<bool(size_t)> &progress) {
 
-	if (!newFileString) {
+	if (replacements.empty()) {
 		if (document->multiFileBusy_) {
 			// only needed during multi-file replacements
 			document->replaceFailed_ = true;
@@ -6968,11 +7279,10 @@ bool MainWindow::replaceAll(DocumentWidget *document, TextArea *area, const QStr
 		return false;
 	}
 
-	// replace the contents of the text widget with the substituted text
-	buffer->BufReplace(TextCursor(copyStart), TextCursor(copyEnd), *newFileString);
+	const boost::optional<TextRange> replaced = document->replaceTextDeltas(replacements, progress);
 
 	// Move the cursor to the end of the last replacement
-	area->TextSetCursorPos(TextCursor(copyStart + static_cast<int64_t>(newFileString->size())));
+	area->TextSetCursorPos(replaced->end);
 	return true;
 }
 
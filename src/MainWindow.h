@@ -10,12 +10,14 @@
 #include "Search.h"
 #include "SearchType.h"
 #include "TextCursor.h"
+#include "UndoInfo.h"
 #include "Util/FileFormats.h"
 #include "WrapMode.h"
 #include "WrapStyle.h"
 #include "userCmds.h"
 
 #include <gsl/span>
+#include <functional>
 #include <vector>
 
 #include <QFileDialog>
@@ -26,6 +28,7 @@
 #include "ui_MainWindow.h"
 
 class TextArea;
+class BackgroundSearch;
 struct PathInfo;
 class DocumentWidget;
 class DialogReplace;
@@ -64,6 +67,7 @@ private:
 	bool eventFilter(QObject *object, QEvent *event) override;
 
 public:
+	bool applyReplaceAll(DocumentWidget *document, TextArea *area, const std::vector<TextDelta> &replacements, const std::function<bool(size_t)> &progress);
 	bool checkPrefsChangesSaved();
 	bool closeAllDocumentsInWindow();
 	bool execNamedBGMenuCmd(DocumentWidget *document, TextArea *area, const QString &name, CommandSource source);
@@ -123,6 +127,29 @@ private:
 	QFileInfoList openFileHelperLocal(DocumentWidget *document, const QRegularExpressionMatch &match, QString *searchPath, QString *searchName) const;
 	QFileInfoList openFileHelperString(DocumentWidget *document, const QString &text, QString *searchPath, QString *searchName) const;
 
+private:
+	/* One search of an incremental search, which may be carried on from the
+	   match of the search before it */
+	struct ISearch {
+		QPointer<DocumentWidget> document;
+		QPointer<TextArea> area;
+		QString searchString;
+		Direction direction   = Direction::Forward;
+		SearchType searchType = SearchType::Literal;
+		WrapMode searchWrap   = WrapMode::NoWrap; // whether the search as a whole wraps
+		WrapMode wrap         = WrapMode::NoWrap; // whether the part still to search wraps
+		int64_t beginPos      = 0;                // where the search as a whole begins
+		int64_t searchPos     = 0;                // where the part still to search begins
+		int64_t searched      = 0;                // how much of that part has been searched already
+		uint64_t revision     = 0;                // the revision of the text being searched
+	};
+
+	bool iSearchCanResume(const ISearch &search) const;
+	bool iSearchFinished(const ISearch &search, const boost::optional<Search::Result> &result);
+	void cancelISearchJob();
+	void iSearchJobFinished();
+	void startISearchJob(const ISearch &search);
+
 public:
 	static bool closeAllFilesAndWindows();
 	static DocumentWidget *editNewFile(MainWindow *window, const QString &geometry, bool iconic, const QString &languageMode);
@@ -180,6 +207,9 @@ public:
 	void action_Find_Definition(DocumentWidget *document, const QString &argument);
 	void action_Find_Dialog(DocumentWidget *document, Direction direction, SearchType type, bool keepDialog);
 	void action_Find(DocumentWidget *document, const QString &string, Direction direction, SearchType type, WrapMode searchWrap);
+	void action_Find_All(DocumentWidget *document, const QString &string, SearchType type);
+	void action_Find_All_Clear(DocumentWidget *document);
+	void action_Find_All_Next(DocumentWidget *document, Direction direction, WrapMode wrap);
 	void action_Find_Incremental(DocumentWidget *document, const QString &searchString, Direction direction, SearchType searchType, WrapMode searchWraps, bool isContinue);
 	void action_Find_Selection(DocumentWidget *document, Direction direction, SearchType type, WrapMode wrap);
 	void action_Goto_Line_Number(DocumentWidget *document);
@@ -214,6 +244,7 @@ public:
 	void action_Repeat_Macro(DocumentWidget *document, const QString &macro, int how);
 	void action_Replace_Again(DocumentWidget *document, Direction direction, WrapMode wrap);
 	void action_Replace_All(DocumentWidget *document, const QString &searchString, const QString &replaceString, SearchType type);
+	void action_Replace_All(DocumentWidget *document, const QString &searchString, const QString &replaceString, SearchType type, const std::vector<TextDelta> &replacements);
 	void action_Replace_Dialog(DocumentWidget *document, Direction direction, SearchType type, bool keepDialog);
 	void action_Replace(DocumentWidget *document, const QString &searchString, const QString &replaceString, Direction direction, SearchType type, WrapMode wrap);
 	void action_Replace_Find(DocumentWidget *document, const QString &searchString, const QString &replaceString, Direction direction, SearchType searchType, WrapMode searchWraps);
@@ -443,6 +474,13 @@ private:
 	TextCursor iSearchLastBeginPos_ = {};             // beg. pos. last match of current i.s.
 	TextCursor iSearchStartPos_     = TextCursor(-1); // start pos. of current incr. search
 
+private:
+	BackgroundSearch *iSearchJob_ = nullptr;    // the incremental search running in the background, if any
+	ISearch iSearchJobSearch_;                  // what it is searching for
+	boost::optional<ISearch> iSearchPending_;   // the search to start once it has stopped, if any
+	ISearch iSearchLast_;                       // the last incremental search to finish
+	boost::optional<int64_t> iSearchLastMatch_; // the start of the match it found, if any
+
 public:
 	Ui::MainWindow ui;
 };
@@ -0,0 +1,97 @@
+
+#include "MarkerScrollBar.h"
+#include "DocumentWidget.h"
+#include "Rangeset.h"
+#include "TextArea.h"
+#include "TextBuffer.h"
+#include "X11Colors.h"
+
+#include <QPainter>
+#include <QStyleOptionSlider>
+
+#include <algorithm>
+
+namespace {
+
+// how many pixels high a marker is
+constexpr int MarkerHeight = 2;
+
+// how faint a marker standing for a single match is, and how much stronger each further match makes it
+constexpr int MinMarkerAlpha  = 128;
+constexpr int MarkerAlphaStep = 32;
+
+}
+
+/**
+ * @brief MarkerScrollBar::MarkerScrollBar
+ * @param area
+ */
+MarkerScrollBar::MarkerScrollBar(TextArea *area)
+	: QScrollBar(Qt::Vertical, area), area_(area) {
+}
+
+/**
+ * @brief MarkerScrollBar::paintEvent
+ * @param event
+ *
+ * The markers are placed by line number in the buffer, so with continuous
+ * wrap on they are only roughly where the slider would be for those lines.
+ */
+void MarkerScrollBar::paintEvent(QPaintEvent *event) {
+
+	QScrollBar::paintEvent(event);
+
+	const Rangeset *rangeset = area_->document_->findAllRangeset();
+	if (!rangeset) {
+		return;
+	}
+
+	// the range set merges matches which touch, so count them from the list of them
+	const std::vector<TextRange> &matches = area_->document_->findAllResults();
+	if (matches.empty()) {
+		return;
+	}
+
+	QStyleOptionSlider option;
+	initStyleOption(&option);
+	const QRect groove = style()->subControlRect(QStyle::CC_ScrollBar, &option, QStyle::SC_ScrollBarGroove, this);
+	if (groove.height() <= 0) {
+		return;
+	}
+
+	const TextBuffer *buffer   = area_->buffer_;
+	const TextCursor bufferEnd = buffer->BufEndOfBuffer();
+	const int64_t nLines       = buffer->BufCountLines(buffer->BufStartOfBuffer(), bufferEnd) + 1;
+	const QColor color         = X11Colors::fromString(rangeset->color_name_).darker();
+
+	QPainter painter(this);
+
+	TextCursor rowStart = buffer->BufStartOfBuffer();
+	int64_t rowLine     = 0;
+
+	for (int y = 0; y < groove.height(); y += MarkerHeight) {
+
+		const int64_t nextLine  = (static_cast<int64_t>(y + MarkerHeight) * nLines) / groove.height();
+		const TextCursor rowEnd = (nextLine >= nLines) ? bufferEnd : buffer->BufCountForwardNLines(rowStart, nextLine - rowLine);
+
+		// the matches don't overlap, so they are in order of their ends as well as their starts
+		auto first = std::partition_point(matches.begin(), matches.end(), [rowStart](const TextRange &match) {
+			return match.end <= rowStart;
+		});
+
+		auto last = std::partition_point(first, matches.end(), [rowEnd](const TextRange &match) {
+			return match.start < rowEnd;
+		});
+
+		if (rowStart != rowEnd && first != last) {
+			const auto count = std::distance(first, last);
+
+			QColor marker = color;
+			marker.setAlpha(static_cast<int>(std::min<int64_t>(255, MinMarkerAlpha + (count - 1) * MarkerAlphaStep)));
+			painter.fillRect(groove.left(), groove.top() + y, groove.width(), MarkerHeight, marker);
+		}
+
+		rowStart = rowEnd;
+		rowLine  = nextLine;
+	}
+}
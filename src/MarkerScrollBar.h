@@ -0,0 +1,28 @@
+
+#ifndef MARKER_SCROLL_BAR_H_
+#define MARKER_SCROLL_BAR_H_
+
+#include <QScrollBar>
+
+class TextArea;
+
+/*
+** The vertical scroll bar of a text area, which marks where in the document
+** the matches of the last Find All are, so that they can be seen at a glance
+** and jumped to by dragging the slider. The more matches there are in the
+** lines a marker stands for, the stronger it is drawn.
+*/
+class MarkerScrollBar : public QScrollBar {
+	Q_OBJECT
+public:
+	explicit MarkerScrollBar(TextArea *area);
+	~MarkerScrollBar() override = default;
+
+protected:
+	void paintEvent(QPaintEvent *event) override;
+
+private:
+	TextArea *area_;
+};
+
+#endif
@@ -1165,6 +1165,14 @@ bool GetPrefHonorSymlinks() {
 	return Settings::honorSymlinks;
 }
 
+bool GetPrefBackgroundSave() {
+	return Settings::backgroundSave;
+}
+
+bool GetPrefSyncOnSave() {
+	return Settings::syncOnSave;
+}
+
 TruncSubstitution GetPrefTruncSubstitution() {
 	return Settings::truncSubstitution;
 }
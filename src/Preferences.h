@@ -35,6 +35,7 @@ bool GetPrefAlwaysCheckRelTagsSpecs();
 bool GetPrefAppendLF();
 bool GetPrefAutoSave();
 bool GetPrefAutoScroll();
+bool GetPrefBackgroundSave();
 bool GetPrefBacklightChars();
 bool GetPrefBeepOnSearchWrap();
 bool GetPrefFindReplaceUsesSelection();
@@ -48,6 +49,7 @@ bool GetPrefRepositionDialogs();
 bool GetPrefSaveOldVersion();
 bool GetPrefSearchDlogs();
 bool GetPrefSortTabs();
+bool GetPrefSyncOnSave();
 bool GetPrefTabBar();
 bool GetPrefUndoModifiesSelection();
 bool GetPrefWarnExit();
@@ -0,0 +1,95 @@
+
+#include "ReplaceAllJob.h"
+#include "Search.h"
+
+#include <QSemaphore>
+
+#include <algorithm>
+
+namespace {
+
+/* how many megabytes of text the jobs may have copied at once, so that
+   searching many documents in parallel doesn't take as much memory as all of
+   them put together */
+constexpr int CopyBudget = 256;
+
+// how long (msec) to wait for the budget before checking for cancellation
+constexpr int CopyWaitTime = 50;
+
+QSemaphore copyBudget(CopyBudget);
+
+}
+
+/**
+ * @brief ReplaceAllJob::ReplaceAllJob
+ * @param text the text to search
+ * @param searchString
+ * @param replaceString
+ * @param searchType
+ * @param delimiters the word delimiters of the document the text came from
+ * @param parent
+ */
+ReplaceAllJob::ReplaceAllJob(text_snapshot<char> text, const QString &searchString, const QString &replaceString, SearchType searchType, const QString &delimiters, QObject *parent)
+	: QObject(parent), text_(std::move(text)), searchString_(searchString), replaceString_(replaceString), searchType_(searchType), delimiters_(delimiters) {
+
+	// the job is owned by whoever started it, not by the pool
+	setAutoDelete(false);
+}
+
+/**
+ * @brief ReplaceAllJob::cancel
+ *
+ * Asks the job to stop at the next match, may be called from any thread
+ */
+void ReplaceAllJob::cancel() {
+	canceled_ = true;
+}
+
+/**
+ * @brief ReplaceAllJob::takeReplacements
+ * @return the replacements found, in ascending order, once the job has finished
+ */
+std::vector<TextDelta> ReplaceAllJob::takeReplacements() {
+	return std::move(replacements_);
+}
+
+/**
+ * @brief ReplaceAllJob::run
+ */
+void ReplaceAllJob::run() {
+
+	/* the searches need the text in one piece, which only takes a copy when
+	   it is split up. A document bigger than the whole budget gets it all */
+	const int64_t megabyte = 1024 * 1024;
+	const int units        = text_.segments().contiguous() ? 0 : static_cast<int>(std::min<int64_t>(CopyBudget, (text_.size() + megabyte - 1) / megabyte));
+
+	while (!copyBudget.tryAcquire(units, CopyWaitTime)) {
+		if (canceled_) {
+			Q_EMIT finished();
+			return;
+		}
+	}
+
+	std::string storage;
+	const view::string_view text = text_.segments().to_view(&storage);
+
+	Search::ForEachReplacement(text, searchString_, replaceString_, searchType_, delimiters_, [this](const Search::Result &match, std::string &&replacement) {
+		TextDelta delta;
+		delta.startPos = TextCursor(match.start);
+		delta.length   = match.end - match.start;
+		delta.text     = std::move(replacement);
+		replacements_.push_back(std::move(delta));
+
+		return !canceled_;
+	});
+
+	// the copy isn't needed any more
+	storage = std::string();
+	copyBudget.release(units);
+
+	if (canceled_) {
+		replacements_.clear();
+	}
+
+	Q_EMIT finished();
+}
@@ -0,0 +1,55 @@
+
+#ifndef REPLACE_ALL_JOB_H_
+#define REPLACE_ALL_JOB_H_
+
+#include "SearchType.h"
+#include "UndoInfo.h"
+#include "text_snapshot.h"
+
+#include <QObject>
+#include <QRunnable>
+#include <QString>
+
+#include <atomic>
+#include <vector>
+
+/*
+** Works out the replacements Replace All would make in a snapshot of a
+** document, on a thread from a pool, so that many documents can be searched
+** at once without freezing the user interface. Nothing is changed here, the
+** replacements are handed to DocumentWidget::replaceTextDeltas on the main
+** thread once the job has finished, provided the document hasn't changed
+** since the snapshot was taken. Where the text has to be copied to be searched,
+** the jobs share a budget for the copies they may hold at once.
+*/
+class ReplaceAllJob : public QObject, public QRunnable {
+	Q_OBJECT
+
+public:
+	ReplaceAllJob(text_snapshot<char> text, const QString &searchString, const QString &replaceString, SearchType searchType, const QString &delimiters, QObject *parent = nullptr);
+	~ReplaceAllJob() override = default;
+
+Q_SIGNALS:
+	void finished();
+
+public:
+	void cancel();
+	std::vector<TextDelta> takeReplacements();
+
+public:
+	void run() override;
+
+private:
+	text_snapshot<char> text_;
+	QString searchString_;
+	QString replaceString_;
+	SearchType searchType_;
+	QString delimiters_;
+	std::atomic<bool> canceled_{false};
+
+private:
+	// only written by the thread, and read once it has finished
+	std::vector<TextDelta> replacements_;
+};
+
+#endif
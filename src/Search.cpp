@@ -5,8 +5,10 @@
 #include "MainWindow.h"
 #include "Preferences.h"
 #include "Regex.h"
+#include "RegexCache.h"
 #include "TextBuffer.h"
 #include "TruncSubstitution.h"
+#include "Util/CharScan.h"
 #include "Util/String.h"
 #include "Util/algorithm.h"
 #include "Util/utils.h"
@@ -16,21 +18,35 @@
 #include <gsl/gsl_util>
 
 #include <algorithm>
+#include <bitset>
 #include <cctype>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <limits>
 
 namespace {
 
 // Maximum length of search string history
 constexpr int MAX_SEARCH_HISTORY = 100;
 
+// how much text searchLiteralInBlocks searches between asking whether to go on
+constexpr int64_t LiteralBlockSize = 1024 * 1024;
+
 // History mechanism for search and replace strings
 Search::HistoryEntry SearchReplaceHistory[MAX_SEARCH_HISTORY];
 int NHist     = 0;
 int HistStart = 0;
 
+/**
+ * @brief makeDelimiterTable
+ * @param delimiters
+ * @return the word delimiter table for "delimiters", or the default one if it is nullptr
+ */
+std::bitset<256> makeDelimiterTable(const char *delimiters) {
+	return delimiters ? Regex::makeDelimiterTable(delimiters) : Regex::Default_Delimiters;
+}
+
 /**
  * @brief forwardRegexSearch
  * @param string
@@ -44,10 +60,12 @@ int HistStart = 0;
 boost::optional<Search::Result> forwardRegexSearch(view::string_view string, view::string_view searchString, WrapMode wrap, int64_t beginPos, const char *delimiters, int defaultFlags) {
 
 	try {
-		Regex compiledRE(searchString, defaultFlags);
+		RegexCache::Lease lease               = RegexCache::acquire(searchString, defaultFlags);
+		Regex &compiledRE                     = *lease;
+		const std::bitset<256> delimiterTable = makeDelimiterTable(delimiters);
 
 		// search from beginPos to end of string
-		if (compiledRE.execute(string, static_cast<size_t>(beginPos), delimiters, false)) {
+		if (compiledRE.execute(string, static_cast<size_t>(beginPos), string.size(), delimiterTable, lease.scratch(), false)) {
 
 			Search::Result result;
 			result.start    = compiledRE.startp[0] - &string[0];
@@ -63,7 +81,7 @@ boost::optional<Search::Result> forwardRegexSearch(view::string_view string, vie
 		}
 
 		// search from the beginning of the string to beginPos
-		if (compiledRE.execute(string, 0, static_cast<size_t>(beginPos), delimiters, false)) {
+		if (compiledRE.execute(string, 0, static_cast<size_t>(beginPos), delimiterTable, lease.scratch(), false)) {
 
 			Search::Result result;
 			result.start    = compiledRE.startp[0] - &string[0];
@@ -83,6 +101,45 @@ boost::optional<Search::Result> forwardRegexSearch(view::string_view string, vie
 	}
 }
 
+/*
+** Forward search of "string" for the first match of the regular expression
+** "searchString" which begins in [beginPos, endPos). A match may run on past
+** "endPos", but no match is tried after it.
+*/
+boost::optional<Search::Result> forwardRegexSearchTo(view::string_view string, view::string_view searchString, int64_t beginPos, int64_t endPos, const char *delimiters, int defaultFlags) {
+
+	const auto length = static_cast<int64_t>(string.size());
+	endPos            = std::min(endPos, length);
+
+	if (beginPos > endPos) {
+		return boost::none;
+	}
+
+	try {
+		RegexCache::Lease lease               = RegexCache::acquire(searchString, defaultFlags);
+		Regex &compiledRE                     = *lease;
+		const std::bitset<256> delimiterTable = makeDelimiterTable(delimiters);
+
+		// the text still goes on after "endPos", as far as the match is concerned
+		const int prevChar = (beginPos == 0) ? -1 : string[static_cast<size_t>(beginPos) - 1];
+
+		if (compiledRE.execute(string, static_cast<size_t>(beginPos), static_cast<size_t>(endPos), prevChar, -1, delimiterTable, lease.scratch(), false)) {
+
+			Search::Result result;
+			result.start    = compiledRE.startp[0] - &string[0];
+			result.end      = compiledRE.endp[0] - &string[0];
+			result.extentFW = compiledRE.extentpFW - &string[0];
+			result.extentBW = compiledRE.extentpBW - &string[0];
+			return result;
+		}
+
+		return boost::none;
+	} catch (const RegexError &e) {
+		Q_UNUSED(e)
+		return boost::none;
+	}
+}
+
 /**
  * @brief backwardRegexSearch
  * @param string
@@ -96,12 +153,14 @@ boost::optional<Search::Result> forwardRegexSearch(view::string_view string, vie
 boost::optional<Search::Result> backwardRegexSearch(view::string_view string, view::string_view searchString, WrapMode wrap, int64_t beginPos, const char *delimiters, int defaultFlags) {
 
 	try {
-		Regex compiledRE(searchString, defaultFlags);
+		RegexCache::Lease lease               = RegexCache::acquire(searchString, defaultFlags);
+		Regex &compiledRE                     = *lease;
+		const std::bitset<256> delimiterTable = makeDelimiterTable(delimiters);
 
 		// search from beginPos to start of file.  A negative begin pos
 		// says begin searching from the far end of the file.
 		if (beginPos >= 0) {
-			if (compiledRE.execute(string, 0, static_cast<size_t>(beginPos), -1, -1, delimiters, true)) {
+			if (compiledRE.execute(string, 0, static_cast<size_t>(beginPos), -1, -1, delimiterTable, lease.scratch(), true)) {
 
 				Search::Result result;
 				result.start    = compiledRE.startp[0] - &string[0];
@@ -122,7 +181,7 @@ boost::optional<Search::Result> backwardRegexSearch(view::string_view string, vi
 			beginPos = 0;
 		}
 
-		if (compiledRE.execute(string, static_cast<size_t>(beginPos), delimiters, true)) {
+		if (compiledRE.execute(string, static_cast<size_t>(beginPos), string.size(), delimiterTable, lease.scratch(), true)) {
 			Search::Result result;
 			result.start    = compiledRE.startp[0] - &string[0];
 			result.end      = compiledRE.endp[0] - &string[0];
@@ -164,6 +223,194 @@ boost::optional<Search::Result> searchRegex(view::string_view string, view::stri
 	Q_UNREACHABLE();
 }
 
+/*
+** Calls "func" for each position in [first, last) in order, stopping at
+** (and returning) the first result it produces
+*/
+template <class Iter, class Func>
+boost::optional<Search::Result> scanForward(Iter first, Iter last, Func &&func) {
+	for (auto it = first; it != last; ++it) {
+		if (boost::optional<Search::Result> result = func(it)) {
+			return result;
+		}
+	}
+
+	return boost::none;
+}
+
+/*
+** Calls "func" for each position in [first, last) in reverse order, stopping
+** at (and returning) the first result it produces
+*/
+template <class Iter, class Func>
+boost::optional<Search::Result> scanBackward(Iter first, Iter last, Func &&func) {
+	for (auto it = last; it != first;) {
+		--it;
+		if (boost::optional<Search::Result> result = func(it)) {
+			return result;
+		}
+	}
+
+	return boost::none;
+}
+
+/*
+** A literal search string, matched against a contiguous run of text at a
+** time with the vectorized string searches of CharScan. A case insensitive
+** matcher only folds ASCII letters, so it can't be used if the locale folds
+** other characters of the search string as well.
+*/
+class LiteralMatcher {
+public:
+	LiteralMatcher(view::string_view searchString, Qt::CaseSensitivity caseSensitivity)
+		: caseSensitivity_(caseSensitivity) {
+
+		if (caseSensitivity == Qt::CaseSensitive) {
+			needle_ = searchString.to_string();
+			usable_ = true;
+		} else {
+			needle_.reserve(searchString.size());
+			std::transform(searchString.begin(), searchString.end(), std::back_inserter(needle_), [](char ch) {
+				return ascii_tolower(ch);
+			});
+
+			usable_ = std::all_of(searchString.begin(), searchString.end(), [](char ch) {
+				const char lower = ascii_tolower(ch);
+				const char upper = (lower >= 'a' && lower <= 'z') ? static_cast<char>(lower - 'a' + 'A') : lower;
+				return safe_ctype<tolower>(ch) == lower && safe_ctype<toupper>(ch) == upper;
+			});
+		}
+	}
+
+public:
+	bool usable() const {
+		return usable_;
+	}
+
+	int64_t length() const {
+		return static_cast<int64_t>(needle_.size());
+	}
+
+	/* The position of the first match which begins in [from, to), or of the
+	   last one when searching backward, or -1 if there is none. "accept" may
+	   turn down a match, and the search then goes on past it */
+	template <class Text, class Accept>
+	int64_t find(const Text &text, int64_t from, int64_t to, Direction direction, Accept &&accept) const {
+		while (from < to) {
+			const int64_t pos = find(text, from, to, direction);
+			if (pos == -1 || accept(pos)) {
+				return pos;
+			}
+
+			if (direction == Direction::Forward) {
+				from = pos + 1;
+			} else {
+				to = pos;
+			}
+		}
+
+		return -1;
+	}
+
+	int64_t find(view::string_view text, int64_t from, int64_t to, Direction direction) const {
+
+		// a match may run on past "to", but not past the end of the text
+		const int64_t limit = std::min(to + length() - 1, static_cast<int64_t>(text.size()));
+		if (limit - from < length()) {
+			return -1;
+		}
+
+		const char *first = text.data() + from;
+		const char *last  = text.data() + limit;
+		const char *match;
+
+		if (direction == Direction::Forward) {
+			match = (caseSensitivity_ == Qt::CaseSensitive) ? find_string(first, last, needle_.data(), needle_.size()) : find_string_nocase(first, last, needle_.data(), needle_.size());
+		} else {
+			match = (caseSensitivity_ == Qt::CaseSensitive) ? rfind_string(first, last, needle_.data(), needle_.size()) : rfind_string_nocase(first, last, needle_.data(), needle_.size());
+		}
+
+		return (match == last) ? -1 : from + (match - first);
+	}
+
+	/* Each run of the text is searched in place, and the few places at the
+	   end of a run where a match would carry on into the next one are
+	   compared a character at a time */
+	int64_t find(const text_segments<char> &text, int64_t from, int64_t to, Direction direction) const {
+
+		if (from >= to) {
+			return -1;
+		}
+
+		if (direction == Direction::Forward) {
+			for (size_t index = text.segment_index(from); index < text.segment_count(); ++index) {
+				const int64_t start = text.segment_start(index);
+				if (start >= to) {
+					break;
+				}
+
+				const view::string_view segment = text.segment(index);
+				const int64_t end               = start + static_cast<int64_t>(segment.size());
+
+				const int64_t match = find(segment, std::max(from, start) - start, std::min(to, end) - start, direction);
+				if (match != -1) {
+					return start + match;
+				}
+
+				for (int64_t pos = std::max({from, start, end - length() + 1}); pos < std::min(to, end); ++pos) {
+					if (matchesAt(text, pos)) {
+						return pos;
+					}
+				}
+			}
+		} else {
+			for (size_t index = text.segment_index(to - 1) + 1; index-- > 0;) {
+				const int64_t start             = text.segment_start(index);
+				const view::string_view segment = text.segment(index);
+				const int64_t end               = start + static_cast<int64_t>(segment.size());
+				if (end <= from) {
+					break;
+				}
+
+				for (int64_t pos = std::min(to, end); pos-- > std::max({from, start, end - length() + 1});) {
+					if (matchesAt(text, pos)) {
+						return pos;
+					}
+				}
+
+				const int64_t match = find(segment, std::max(from, start) - start, std::min(to, end) - start, direction);
+				if (match != -1) {
+					return start + match;
+				}
+			}
+		}
+
+		return -1;
+	}
+
+private:
+	bool matchesAt(const text_segments<char> &text, int64_t pos) const {
+
+		if (pos + length() > text.size()) {
+			return false;
+		}
+
+		for (int64_t i = 0; i < length(); ++i) {
+			const char ch = text[pos + i];
+			if (((caseSensitivity_ == Qt::CaseSensitive) ? ch : ascii_tolower(ch)) != needle_[static_cast<size_t>(i)]) {
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+private:
+	std::string needle_; // in lower case for a case insensitive search
+	Qt::CaseSensitivity caseSensitivity_;
+	bool usable_ = false;
+};
+
 /**
  * @brief searchLiteral
  * @param string
@@ -173,29 +420,36 @@ boost::optional<Search::Result> searchRegex(view::string_view string, view::stri
  * @param wrap
  * @param beginPos
  * @return
+ *
+ * "string" may be either a view::string_view or a TextBuffer::segments_type,
+ * so that a document can be searched without making its text contiguous
  */
-boost::optional<Search::Result> searchLiteral(view::string_view string, view::string_view searchString, Direction direction, WrapMode wrap, int64_t beginPos, Qt::CaseSensitivity caseSensitivity) {
+template <class Text>
+boost::optional<Search::Result> searchLiteral(const Text &string, view::string_view searchString, Direction direction, WrapMode wrap, int64_t beginPos, Qt::CaseSensitivity caseSensitivity) {
+
+	using iterator = typename Text::const_iterator;
 
 	if (searchString.empty()) {
 		return boost::none;
 	}
 
+	const LiteralMatcher matcher(searchString, caseSensitivity);
+
 	std::string lcString;
 	std::string ucString;
 
-	if (caseSensitivity == Qt::CaseSensitive) {
-		lcString = searchString.to_string();
-		ucString = searchString.to_string();
-	} else {
+	// only needed when the matcher can't fold the case of the search string
+	if (!matcher.usable()) {
 		ucString = to_upper(searchString);
 		lcString = to_lower(searchString);
 	}
 
+	const auto size  = static_cast<int64_t>(string.size());
 	const auto first = string.begin();
-	const auto mid   = first + beginPos;
+	const auto mid   = qBound<int64_t>(0, beginPos, size);
 	const auto last  = string.end();
 
-	auto do_search = [&](view::string_view::iterator it) -> boost::optional<Search::Result> {
+	auto do_search = [&](iterator it) -> boost::optional<Search::Result> {
 		if (*it == ucString[0] || *it == lcString[0]) {
 			// matched first character
 			auto ucPtr   = ucString.begin();
@@ -210,8 +464,8 @@ boost::optional<Search::Result> searchLiteral(view::string_view string, view::st
 				if (ucPtr == ucString.end()) {
 					// matched whole string
 					Search::Result result;
-					result.start    = it - string.begin();
-					result.end      = tempPtr - string.begin();
+					result.start    = it - first;
+					result.end      = tempPtr - first;
 					result.extentBW = result.start;
 					result.extentFW = result.end;
 					return result;
@@ -222,13 +476,30 @@ boost::optional<Search::Result> searchLiteral(view::string_view string, view::st
 		return boost::none;
 	};
 
+	// searches the places in [from, to), in the given order
+	auto scan = [&](int64_t from, int64_t to, Direction order) -> boost::optional<Search::Result> {
+		if (!matcher.usable()) {
+			return (order == Direction::Forward) ? scanForward(first + from, first + to, do_search) : scanBackward(first + from, first + to, do_search);
+		}
+
+		const int64_t pos = matcher.find(string, from, to, order);
+		if (pos == -1) {
+			return boost::none;
+		}
+
+		Search::Result result;
+		result.start    = pos;
+		result.end      = pos + matcher.length();
+		result.extentBW = result.start;
+		result.extentFW = result.end;
+		return result;
+	};
+
 	if (direction == Direction::Forward) {
 
 		// search from beginPos to end of string
-		for (auto it = mid; it != last; ++it) {
-			if (boost::optional<Search::Result> result = do_search(it)) {
-				return result;
-			}
+		if (boost::optional<Search::Result> result = scan(mid, size, Direction::Forward)) {
+			return result;
 		}
 
 		if (wrap == WrapMode::NoWrap) {
@@ -236,23 +507,15 @@ boost::optional<Search::Result> searchLiteral(view::string_view string, view::st
 		}
 
 		// search from start of file to beginPos
-		for (auto it = first; it != mid; ++it) {
-			if (boost::optional<Search::Result> result = do_search(it)) {
-				return result;
-			}
-		}
-
-		return boost::none;
+		return scan(0, mid, Direction::Forward);
 	} else {
 		// Direction::Backward
 		// search from beginPos to start of file.  A negative begin pos
 		// says begin searching from the far end of the file
 
 		if (beginPos >= 0) {
-			for (auto it = mid; it >= first; --it) {
-				if (boost::optional<Search::Result> result = do_search(it)) {
-					return result;
-				}
+			if (boost::optional<Search::Result> result = scan(0, std::min(mid + 1, size), Direction::Backward)) {
+				return result;
 			}
 		}
 
@@ -261,13 +524,7 @@ boost::optional<Search::Result> searchLiteral(view::string_view string, view::st
 		}
 
 		// search from end of file to beginPos
-		for (auto it = last; it >= mid; --it) {
-			if (boost::optional<Search::Result> result = do_search(it)) {
-				return result;
-			}
-		}
-
-		return boost::none;
+		return scan(mid, size, Direction::Backward);
 	}
 }
 
@@ -285,22 +542,32 @@ boost::optional<Search::Result> searchLiteral(view::string_view string, view::st
 **  will suffice in that case.
 **
 */
-boost::optional<Search::Result> searchLiteralWord(view::string_view string, view::string_view searchString, Direction direction, WrapMode wrap, int64_t beginPos, const char *delimiters, Qt::CaseSensitivity caseSensitivity) {
+template <class Text>
+boost::optional<Search::Result> searchLiteralWord(const Text &string, view::string_view searchString, Direction direction, WrapMode wrap, int64_t beginPos, const char *delimiters, Qt::CaseSensitivity caseSensitivity) {
+
+	using iterator = typename Text::const_iterator;
 
 	if (searchString.empty()) {
 		return boost::none;
 	}
 
+	const LiteralMatcher matcher(searchString, caseSensitivity);
+
 	std::string lcString;
 	std::string ucString;
 	bool cignore_L = false;
 	bool cignore_R = false;
 
+	const auto size  = static_cast<int64_t>(string.size());
 	const auto first = string.begin();
-	const auto mid   = first + beginPos;
+	const auto mid   = qBound<int64_t>(0, beginPos, size);
 	const auto last  = string.end();
 
-	auto do_search_word = [&](const view::string_view::iterator it) -> boost::optional<Search::Result> {
+	auto is_delimiter = [&delimiters](char ch) {
+		return safe_ctype<isspace>(ch) || ::strchr(delimiters, ch);
+	};
+
+	auto do_search_word = [&](const iterator it) -> boost::optional<Search::Result> {
 		if (*it == ucString[0] || *it == lcString[0]) {
 
 			// matched first character
@@ -313,14 +580,13 @@ boost::optional<Search::Result> searchLiteralWord(view::string_view string, view
 				++ucPtr;
 				++lcPtr;
 
-				if (ucPtr == ucString.end() &&                                                        // matched whole string
-					(cignore_R || safe_ctype<isspace>(*tempPtr) || ::strchr(delimiters, *tempPtr)) && // next char right delimits word ?
-					(cignore_L || it == string.begin() ||                                             // border case
-					 safe_ctype<isspace>(it[-1]) || ::strchr(delimiters, it[-1]))) {                  // next char left delimits word ?
+				if (ucPtr == ucString.end() &&                                     // matched whole string
+					(cignore_R || tempPtr == last || is_delimiter(*tempPtr)) &&    // next char right delimits word ?
+					(cignore_L || it == first || is_delimiter(*std::prev(it)))) { // next char left delimits word ?
 
 					Search::Result result;
-					result.start    = it - string.begin();
-					result.end      = tempPtr - string.begin();
+					result.start    = it - first;
+					result.end      = tempPtr - first;
 					result.extentBW = result.start;
 					result.extentFW = result.end;
 					return result;
@@ -336,24 +602,49 @@ boost::optional<Search::Result> searchLiteralWord(view::string_view string, view
 		return boost::none;
 	};
 
+	// whether the match at "pos" is a whole word
+	auto is_word = [&](int64_t pos) {
+		const int64_t end = pos + matcher.length();
+		return (cignore_R || end == size || is_delimiter(string[end])) &&
+			   (cignore_L || pos == 0 || is_delimiter(string[pos - 1]));
+	};
+
+	// searches the places in [from, to), in the given order
+	auto scan = [&](int64_t from, int64_t to, Direction order) -> boost::optional<Search::Result> {
+		if (!matcher.usable()) {
+			return (order == Direction::Forward) ? scanForward(first + from, first + to, do_search_word) : scanBackward(first + from, first + to, do_search_word);
+		}
+
+		// the word boundaries are only looked at where the string matches
+		const int64_t pos = matcher.find(string, from, to, order, is_word);
+		if (pos == -1) {
+			return boost::none;
+		}
+
+		Search::Result result;
+		result.start    = pos;
+		result.end      = pos + matcher.length();
+		result.extentBW = result.start;
+		result.extentFW = result.end;
+		return result;
+	};
+
 	// If there is no language mode, we use the default list of delimiters
 	const QByteArray delimiterString = Preferences::GetPrefDelimiters().toLatin1();
 	if (!delimiters) {
 		delimiters = delimiterString.data();
 	}
 
-	if (safe_ctype<isspace>(searchString.front()) || ::strchr(delimiters, searchString.front())) {
+	if (is_delimiter(searchString.front())) {
 		cignore_L = true;
 	}
 
-	if (safe_ctype<isspace>(searchString.back()) || ::strchr(delimiters, searchString.back())) {
+	if (is_delimiter(searchString.back())) {
 		cignore_R = true;
 	}
 
-	if (caseSensitivity == Qt::CaseSensitive) {
-		ucString = searchString.to_string();
-		lcString = searchString.to_string();
-	} else {
+	// only needed when the matcher can't fold the case of the search string
+	if (!matcher.usable()) {
 		ucString = to_upper(searchString);
 		lcString = to_lower(searchString);
 	}
@@ -361,10 +652,8 @@ boost::optional<Search::Result> searchLiteralWord(view::string_view string, view
 	if (direction == Direction::Forward) {
 
 		// search from beginPos to end of string
-		for (auto it = mid; it != last; ++it) {
-			if (boost::optional<Search::Result> result = do_search_word(it)) {
-				return result;
-			}
+		if (boost::optional<Search::Result> result = scan(mid, size, Direction::Forward)) {
+			return result;
 		}
 
 		if (wrap == WrapMode::NoWrap) {
@@ -372,22 +661,15 @@ boost::optional<Search::Result> searchLiteralWord(view::string_view string, view
 		}
 
 		// search from start of file to beginPos
-		for (auto it = first; it != mid; ++it) {
-			if (boost::optional<Search::Result> result = do_search_word(it)) {
-				return result;
-			}
-		}
-		return boost::none;
+		return scan(0, mid, Direction::Forward);
 	} else {
 		// Direction::Backward
 		// search from beginPos to start of file. A negative begin pos
 		// says begin searching from the far end of the file
 
 		if (beginPos >= 0) {
-			for (auto it = mid; it >= first; --it) {
-				if (boost::optional<Search::Result> result = do_search_word(it)) {
-					return result;
-				}
+			if (boost::optional<Search::Result> result = scan(0, std::min(mid + 1, size), Direction::Backward)) {
+				return result;
 			}
 		}
 
@@ -396,13 +678,100 @@ boost::optional<Search::Result> searchLiteralWord(view::string_view string, view
 		}
 
 		// search from end of file to beginPos
-		for (auto it = last; it >= mid; --it) {
-			if (boost::optional<Search::Result> result = do_search_word(it)) {
+		return scan(mid, size, Direction::Backward);
+	}
+}
+
+/*
+** Literal search of "text" a block at a time, so that a long search can be
+** given up part way through. "progress" is told how much of the text has been
+** searched after each block, and returns false to give up, in which case
+** "gaveUp" is set, "searched" says how much of the text had been searched by
+** then and nothing is found. A search given up can be carried on by calling
+** again with the same arguments, and the blocks already searched are passed
+** over. Each block is searched along with enough of the text after it to
+** hold a match which begins in the block, so the result is the same as that
+** of searchLiteral.
+*/
+boost::optional<Search::Result> searchLiteralInBlocks(const text_segments<char> &text, view::string_view searchString, Direction direction, WrapMode wrap, int64_t beginPos, Qt::CaseSensitivity caseSensitivity, const Search::ProgressCallback &progress, int64_t *searched, bool *gaveUp) {
+
+	const auto size       = static_cast<int64_t>(text.size());
+	const auto overlap    = static_cast<int64_t>(searchString.size()) - 1;
+	const int64_t mid     = qBound<int64_t>(0, beginPos, size);
+	const int64_t skip    = *searched;
+	int64_t scanned       = 0;
+
+	// searches the matches which begin in [from, to), nearest to "from" or to "to" first
+	auto scan = [&](int64_t from, int64_t to, Direction order) -> boost::optional<Search::Result> {
+		for (int64_t done = 0; done < to - from; done += LiteralBlockSize) {
+
+			const int64_t blockSize = std::min(LiteralBlockSize, to - from - done);
+
+			// searched already, by the call which gave up
+			if (scanned < skip) {
+				scanned += blockSize;
+				continue;
+			}
+
+			if (!progress(scanned)) {
+				*searched = scanned;
+				*gaveUp   = true;
+				return boost::none;
+			}
+
+			const int64_t blockStart = (order == Direction::Forward) ? from + done : to - done - blockSize;
+			const int64_t sliceEnd   = std::min(size, blockStart + blockSize + overlap);
+			const int64_t slicePos   = (order == Direction::Forward) ? 0 : blockSize - 1;
+
+			if (boost::optional<Search::Result> result = searchLiteral(text.slice(blockStart, sliceEnd), searchString, order, WrapMode::NoWrap, slicePos, caseSensitivity)) {
+				result->start += blockStart;
+				result->end += blockStart;
+				result->extentBW += blockStart;
+				result->extentFW += blockStart;
 				return result;
 			}
+
+			scanned += blockSize;
 		}
+
+		return boost::none;
+	};
+
+	if (searchString.empty()) {
 		return boost::none;
 	}
+
+	if (direction == Direction::Forward) {
+
+		// search from beginPos to end of string
+		if (boost::optional<Search::Result> result = scan(mid, size, Direction::Forward)) {
+			return result;
+		}
+
+		if (wrap == WrapMode::NoWrap || *gaveUp) {
+			return boost::none;
+		}
+
+		// search from start of file to beginPos
+		return scan(0, mid, Direction::Forward);
+	} else {
+		// Direction::Backward
+		// search from beginPos to start of file. A negative begin pos
+		// says begin searching from the far end of the file
+
+		if (beginPos >= 0) {
+			if (boost::optional<Search::Result> result = scan(0, std::min(mid + 1, size), Direction::Backward)) {
+				return result;
+			}
+		}
+
+		if (wrap == WrapMode::NoWrap || *gaveUp) {
+			return boost::none;
+		}
+
+		// search from end of file to beginPos
+		return scan(mid, size, Direction::Backward);
+	}
 }
 
 /*
@@ -430,19 +799,170 @@ boost::optional<Search::Result> SearchStringEx(view::string_view string, view::s
 	Q_UNREACHABLE();
 }
 
+/*
+** Forward search of a document's text in place for "searchString", which
+** mustn't be a regular expression
+*/
+boost::optional<Search::Result> searchLiteralSegments(const text_segments<char> &text, view::string_view searchString, SearchType searchType, int64_t beginPos, const char *delimiters) {
+	switch (searchType) {
+	case SearchType::CaseSenseWord:
+		return searchLiteralWord(text, searchString, Direction::Forward, WrapMode::NoWrap, beginPos, delimiters, Qt::CaseSensitive);
+	case SearchType::LiteralWord:
+		return searchLiteralWord(text, searchString, Direction::Forward, WrapMode::NoWrap, beginPos, delimiters, Qt::CaseInsensitive);
+	case SearchType::CaseSense:
+		return searchLiteral(text, searchString, Direction::Forward, WrapMode::NoWrap, beginPos, Qt::CaseSensitive);
+	case SearchType::Literal:
+		return searchLiteral(text, searchString, Direction::Forward, WrapMode::NoWrap, beginPos, Qt::CaseInsensitive);
+	case SearchType::Regex:
+	case SearchType::RegexNoCase:
+		break;
+	}
+
+	Q_UNREACHABLE();
+}
+
+/*
+** How much of a text of the given length a literal search needs to see to
+** find every match of "searchString" which begins before "endPos", along with
+** the character after it, which a whole word search looks at
+*/
+int64_t literalSearchLimit(int64_t length, view::string_view searchString, int64_t endPos) {
+	const auto needed = static_cast<int64_t>(searchString.size()) + 1;
+	return (endPos >= length - needed) ? length : endPos + needed;
+}
+
+/*
+** Hands "func" the matches which "search" finds one after another in text of
+** the given length, from "beginPos" up to those which begin at "endPos"
+*/
+template <class SearchFunc>
+void forEachMatch(int64_t length, int64_t beginPos, int64_t endPos, SearchFunc search, const Search::MatchCallback &func) {
+
+	while (boost::optional<Search::Result> searchResult = search(beginPos)) {
+
+		if (searchResult->start >= endPos || !func(*searchResult)) {
+			break;
+		}
+
+		if (searchResult->end == length) {
+			break;
+		}
+
+		// start next after match unless match was empty, then endPos+1
+		beginPos = (searchResult->start == searchResult->end) ? searchResult->end + 1 : searchResult->end;
+	}
+}
+
+/*
+** Returns true if the regular expression "searchString" may contain a
+** look-behind construct, which needs to see text before the point where
+** the search starts
+*/
+bool mayLookBehind(view::string_view searchString) {
+	return searchString.find("(?<") != view::string_view::npos;
+}
+
+/*
+** Regular expression search directly in a text buffer. A forward search
+** only needs the text from "beginPos" onwards (plus the character before it)
+** unless the expression contains a look-behind. That text is usually
+** already contiguous, for example right after the user typed at the cursor
+** and then searched forward, so it can be searched without rearranging the
+** buffer. Everything else is done on a contiguous view of the whole buffer.
+*/
+boost::optional<Search::Result> searchRegexInBuffer(TextBuffer *buffer, view::string_view searchString, Direction direction, WrapMode wrap, int64_t beginPos, const char *delimiters, int defaultFlags) {
+
+	const int64_t length = buffer->length();
+
+	if (direction == Direction::Backward || beginPos <= 0 || beginPos > length || mayLookBehind(searchString)) {
+		return searchRegex(buffer->BufAsString(), searchString, direction, wrap, beginPos, delimiters, defaultFlags);
+	}
+
+	try {
+		RegexCache::Lease lease               = RegexCache::acquire(searchString, defaultFlags);
+		Regex &compiledRE                     = *lease;
+		const std::bitset<256> delimiterTable = makeDelimiterTable(delimiters);
+
+		// search from beginPos to end of buffer
+		view::string_view string = buffer->BufAsString(TextCursor(beginPos), buffer->BufEndOfBuffer());
+		const int prevChar       = buffer->BufGetCharacter(TextCursor(beginPos - 1));
+
+		if (compiledRE.execute(string, 0, string.size(), prevChar, -1, delimiterTable, lease.scratch(), false)) {
+
+			Search::Result result;
+			result.start    = compiledRE.startp[0] - &string[0] + beginPos;
+			result.end      = compiledRE.endp[0] - &string[0] + beginPos;
+			result.extentFW = compiledRE.extentpFW - &string[0] + beginPos;
+			result.extentBW = compiledRE.extentpBW - &string[0] + beginPos;
+			return result;
+		}
+
+		// if wrap turned off, we're done
+		if (wrap == WrapMode::NoWrap) {
+			return boost::none;
+		}
+
+		// search from the beginning of the buffer to beginPos
+		string = buffer->BufAsString();
+
+		if (compiledRE.execute(string, 0, static_cast<size_t>(beginPos), delimiterTable, lease.scratch(), false)) {
+
+			Search::Result result;
+			result.start    = compiledRE.startp[0] - &string[0];
+			result.end      = compiledRE.endp[0] - &string[0];
+			result.extentFW = compiledRE.extentpFW - &string[0];
+			result.extentBW = compiledRE.extentpBW - &string[0];
+			return result;
+		}
+
+		return boost::none;
+	} catch (const RegexError &e) {
+		Q_UNUSED(e)
+		/* Note that this does not process errors from compiling the expression.
+		 * It assumes that the expression was checked earlier.
+		 */
+		return boost::none;
+	}
+}
+
+/*
+** Search the text buffer "buffer" for "searchString", beginning at
+** "beginPos". Literal searches read the buffer in place, regular
+** expression searches try to avoid making the whole buffer contiguous.
+*/
+boost::optional<Search::Result> SearchBufferEx(TextBuffer *buffer, view::string_view searchString, Direction direction, SearchType searchType, WrapMode wrap, int64_t beginPos, const char *delimiters) {
+	switch (searchType) {
+	case SearchType::CaseSenseWord:
+		return searchLiteralWord(buffer->BufGetSegments(), searchString, direction, wrap, beginPos, delimiters, Qt::CaseSensitive);
+	case SearchType::LiteralWord:
+		return searchLiteralWord(buffer->BufGetSegments(), searchString, direction, wrap, beginPos, delimiters, Qt::CaseInsensitive);
+	case SearchType::CaseSense:
+		return searchLiteral(buffer->BufGetSegments(), searchString, direction, wrap, beginPos, Qt::CaseSensitive);
+	case SearchType::Literal:
+		return searchLiteral(buffer->BufGetSegments(), searchString, direction, wrap, beginPos, Qt::CaseInsensitive);
+	case SearchType::Regex:
+		return searchRegexInBuffer(buffer, searchString, direction, wrap, beginPos, delimiters, REDFLT_STANDARD);
+	case SearchType::RegexNoCase:
+		return searchRegexInBuffer(buffer, searchString, direction, wrap, beginPos, delimiters, REDFLT_CASE_INSENSITIVE);
+	}
+
+	Q_UNREACHABLE();
+}
+
 /*
 ** Substitutes a replace string for a string that was matched using a
 ** regular expression.  This was added later and is rather ineficient
 ** because instead of using the compiled regular expression that was used
-** to make the match in the first place, it re-compiles the expression
-** and redoes the search on the already-matched string.  This allows the
-** code to continue using strings to represent the search and replace
-** items.
+** to make the match in the first place, it looks the expression up again
+** (in the RegexCache, so it is usually not re-compiled) and redoes the
+** search on the already-matched string.  This allows the code to continue
+** using strings to represent the search and replace items.
 */
 bool replaceUsingRegex(view::string_view searchStr, view::string_view replaceStr, view::string_view sourceStr, int64_t beginPos, std::string &dest, int prevChar, const char *delimiters, int defaultFlags) {
 	try {
-		Regex compiledRE(searchStr, defaultFlags);
-		compiledRE.execute(sourceStr, static_cast<size_t>(beginPos), sourceStr.size(), prevChar, -1, delimiters, false);
+		RegexCache::Lease lease = RegexCache::acquire(searchStr, defaultFlags);
+		Regex &compiledRE       = *lease;
+		compiledRE.execute(sourceStr, static_cast<size_t>(beginPos), sourceStr.size(), prevChar, -1, makeDelimiterTable(delimiters), lease.scratch(), false);
 		return compiledRE.SubstituteRE(replaceStr, dest);
 	} catch (const RegexError &e) {
 		Q_UNUSED(e)
@@ -453,138 +973,138 @@ bool replaceUsingRegex(view::string_view searchStr, view::string_view replaceStr
 }
 
 /*
-** Replace all occurences of "searchString" in "inString" with "replaceString"
-** and return a string covering the range between the start of the
-** first replacement (returned in "copyStart", and the end of the last
-** replacement (returned in "copyEnd")
+** Find each occurence of "searchString" in "inString" which begins at or after
+** "beginPos" and before "endPos", in the order that a forward search starting
+** at "beginPos" would find them, and hand them to "func" one at a time. "func"
+** returns false to stop early.
 */
-boost::optional<std::string> Search::ReplaceAllInString(view::string_view inString, const QString &searchString, const QString &replaceString, SearchType searchType, int64_t *copyStart, int64_t *copyEnd, const QString &delimiters) {
-
-	Result searchResult;
-	int64_t lastEndPos;
+void Search::ForEachMatch(view::string_view inString, const QString &searchString, SearchType searchType, const QString &delimiters, int64_t beginPos, int64_t endPos, const MatchCallback &func) {
 
 	// reject empty string
 	if (searchString.isNull()) {
-		return boost::none;
+		return;
 	}
 
-	/* rehearse the search first to determine the size of the buffer needed
-	   to hold the substituted text.  No substitution done here yet */
-	bool found       = true;
-	int replaceLen   = replaceString.size();
-	int nFound       = 0;
-	int removeLen    = 0;
-	int addLen       = 0;
-	int64_t beginPos = 0;
-
-	*copyStart = -1;
-
-	while (found) {
-		found = SearchString(
-			inString,
-			searchString,
-			Direction::Forward,
-			searchType,
-			WrapMode::NoWrap,
-			beginPos,
-			&searchResult,
-			delimiters);
-
-		if (found) {
-			if (*copyStart < 0) {
-				*copyStart = searchResult.start;
-			}
+	const std::string search     = searchString.toStdString();
+	const QByteArray delimBytes  = delimiters.toLatin1();
+	const char *const delimChars = delimiters.isNull() ? nullptr : delimBytes.data();
 
-			*copyEnd = searchResult.end;
-			// start next after match unless match was empty, then endPos+1
-			beginPos = (searchResult.start == searchResult.end) ? searchResult.end + 1 : searchResult.end;
-			++nFound;
-			removeLen += searchResult.end - searchResult.start;
-			if (isRegexType(searchType)) {
-				std::string replaceResult;
-
-				replaceUsingRE(
-					searchString,
-					replaceString,
-					inString.substr(static_cast<size_t>(searchResult.extentBW)),
-					searchResult.start - searchResult.extentBW,
-					replaceResult,
-					searchResult.start == 0 ? -1 : inString[static_cast<size_t>(searchResult.start) - 1],
-					delimiters,
-					defaultRegexFlags(searchType));
-
-				addLen += replaceResult.size();
-			} else {
-				addLen += replaceLen;
-			}
+	const auto length = gsl::narrow<int64_t>(inString.size());
 
-			if (searchResult.end == gsl::narrow<int64_t>(inString.size())) {
-				break;
-			}
-		}
+	// only the text which a match beginning before "endPos" could cover is searched
+	if (isRegexType(searchType)) {
+		const int defaultFlags = defaultRegexFlags(searchType);
+		forEachMatch(length, beginPos, endPos, [&](int64_t pos) {
+			return forwardRegexSearchTo(inString, search, pos, endPos, delimChars, defaultFlags);
+		}, func);
+	} else {
+		const view::string_view string = inString.substr(0, static_cast<size_t>(literalSearchLimit(length, search, endPos)));
+		forEachMatch(length, beginPos, endPos, [&](int64_t pos) {
+			return SearchStringEx(string, search, Direction::Forward, searchType, WrapMode::NoWrap, pos, delimChars);
+		}, func);
 	}
+}
 
-	if (nFound == 0) {
-		return boost::none;
+/*
+** As above, but for text which may be split into segments. Literal searches
+** read the segments in place, a regular expression needs the text in one
+** piece, which costs a copy unless it is contiguous already.
+*/
+void Search::ForEachMatch(const text_segments<char> &text, const QString &searchString, SearchType searchType, const QString &delimiters, int64_t beginPos, int64_t endPos, const MatchCallback &func) {
+
+	if (isRegexType(searchType)) {
+		std::string storage;
+		ForEachMatch(text.to_view(&storage), searchString, searchType, delimiters, beginPos, endPos, func);
+		return;
 	}
 
-	const int64_t copyLen = *copyEnd - *copyStart;
+	// reject empty string
+	if (searchString.isNull()) {
+		return;
+	}
 
-	std::string outString;
-	outString.reserve(static_cast<size_t>(copyLen - removeLen + addLen));
-
-	/* Scan through the text buffer again, substituting the replace string
-	   and copying the part between replaced text to the new buffer  */
-	found      = true;
-	beginPos   = {};
-	lastEndPos = {};
-
-	while (found) {
-		found = SearchString(
-			inString,
-			searchString,
-			Direction::Forward,
-			searchType,
-			WrapMode::NoWrap,
-			beginPos,
-			&searchResult,
-			delimiters);
-
-		if (found) {
-			if (beginPos != 0) {
-				outString.append(
-					&inString[static_cast<size_t>(lastEndPos)],
-					&inString[static_cast<size_t>(lastEndPos + (searchResult.start - lastEndPos))]);
-			}
+	const std::string search     = searchString.toStdString();
+	const QByteArray delimBytes  = delimiters.toLatin1();
+	const char *const delimChars = delimiters.isNull() ? nullptr : delimBytes.data();
 
-			if (isRegexType(searchType)) {
-				std::string replaceResult;
+	// only the text which a match beginning before "endPos" could cover is searched
+	const text_segments<char> segments = text.slice(0, literalSearchLimit(text.size(), search, endPos));
 
-				replaceUsingRE(
-					searchString,
-					replaceString,
-					inString.substr(static_cast<size_t>(searchResult.extentBW)),
-					searchResult.start - searchResult.extentBW,
-					replaceResult,
-					searchResult.start == 0 ? -1 : inString[static_cast<size_t>(searchResult.start) - 1],
-					delimiters,
-					defaultRegexFlags(searchType));
+	forEachMatch(text.size(), beginPos, endPos, [&](int64_t pos) {
+		return searchLiteralSegments(segments, search, searchType, pos, delimChars);
+	}, func);
+}
 
-				outString.append(replaceResult);
-			} else {
-				outString.append(replaceString.toStdString());
-			}
+/*
+** Find each occurence of "searchString" in "inString", working out what it
+** is to be replaced with, and hand them to "func" in order, one at a time.
+** "func" returns false to stop early. Returns the number of matches given
+** to "func".
+*/
+int64_t Search::ForEachReplacement(view::string_view inString, const QString &searchString, const QString &replaceString, SearchType searchType, const QString &delimiters, const ReplacementCallback &func) {
+
+	const std::string search     = searchString.toStdString();
+	const std::string replace    = replaceString.toStdString();
+	const QByteArray delimBytes  = delimiters.toLatin1();
+	const char *const delimChars = delimiters.isNull() ? nullptr : delimBytes.data();
+	const bool isRegex           = isRegexType(searchType);
+	const int defaultFlags       = defaultRegexFlags(searchType);
+
+	int64_t nFound = 0;
+
+	ForEachMatch(inString, searchString, searchType, delimiters, 0, std::numeric_limits<int64_t>::max(), [&](const Result &searchResult) {
+		std::string replaceResult;
+		if (isRegex) {
+			replaceUsingRegex(
+				search,
+				replace,
+				inString.substr(static_cast<size_t>(searchResult.extentBW)),
+				searchResult.start - searchResult.extentBW,
+				replaceResult,
+				searchResult.start == 0 ? -1 : inString[static_cast<size_t>(searchResult.start) - 1],
+				delimChars,
+				defaultFlags);
+		} else {
+			replaceResult = replace;
+		}
 
-			lastEndPos = searchResult.end;
+		++nFound;
+		return func(searchResult, std::move(replaceResult));
+	});
 
-			// start next after match unless match was empty, then endPos+1
-			beginPos = (searchResult.start == searchResult.end) ? searchResult.end + 1 : searchResult.end;
-			if (searchResult.end == gsl::narrow<int64_t>(inString.size())) {
-				break;
-			}
+	return nFound;
+}
+
+/*
+** Replace all occurences of "searchString" in "inString" with "replaceString"
+** and return a string covering the range between the start of the
+** first replacement (returned in "copyStart", and the end of the last
+** replacement (returned in "copyEnd")
+*/
+boost::optional<std::string> Search::ReplaceAllInString(view::string_view inString, const QString &searchString, const QString &replaceString, SearchType searchType, int64_t *copyStart, int64_t *copyEnd, const QString &delimiters) {
+
+	std::string outString;
+	int64_t lastEndPos = -1;
+
+	/* copy the text between the replacements along with the substituted
+	   text, as the matches are found */
+	const int64_t nFound = ForEachReplacement(inString, searchString, replaceString, searchType, delimiters, [&](const Result &match, std::string &&replacement) {
+		if (lastEndPos < 0) {
+			*copyStart = match.start;
+		} else {
+			outString.append(&inString[static_cast<size_t>(lastEndPos)], static_cast<size_t>(match.start - lastEndPos));
 		}
+
+		outString.append(replacement);
+		lastEndPos = match.end;
+		return true;
+	});
+
+	if (nFound == 0) {
+		return boost::none;
 	}
 
+	*copyEnd = lastEndPos;
 	return outString;
 }
 
@@ -627,6 +1147,84 @@ bool Search::SearchString(view::string_view string, const QString &searchString,
 	return false;
 }
 
+/**
+ * @brief Search::SearchString
+ * @param buffer
+ * @param searchString
+ * @param direction
+ * @param searchType
+ * @param wrap
+ * @param beginPos
+ * @param delimiters
+ * @return
+ */
+boost::optional<Search::Result> Search::SearchString(TextBuffer *buffer, const QString &searchString, Direction direction, SearchType searchType, WrapMode wrap, int64_t beginPos, const QString &delimiters) {
+	return SearchBufferEx(buffer, searchString.toStdString(), direction, searchType, wrap, beginPos, delimiters.isNull() ? nullptr : delimiters.toLatin1().data());
+}
+
+/*
+** Search a snapshot of a document for "searchString", beginning at
+** "beginPos", in a way which can be given up part way through. "progress" is
+** told from time to time how much of the text has been searched, and returns
+** false to give up, in which case "gaveUp" is set and nothing is found.
+** "searched" says how much of the text an earlier call with the same
+** arguments got through before it gave up, so that the search carries on
+** from there, and is updated if this one gives up too.
+**
+** Literal searches read the snapshot in place, a block at a time. Anything
+** else needs the text in one piece, which costs a copy unless the snapshot
+** is contiguous already, and is searched in one go, so it can only be given
+** up before it starts.
+*/
+boost::optional<Search::Result> Search::SearchSnapshot(const text_snapshot<char> &text, const QString &searchString, Direction direction, SearchType searchType, WrapMode wrap, int64_t beginPos, const QString &delimiters, const ProgressCallback &progress, int64_t *searched, bool *gaveUp) {
+
+	*gaveUp = false;
+
+	const std::string search = searchString.toStdString();
+
+	switch (searchType) {
+	case SearchType::CaseSense:
+		return searchLiteralInBlocks(text.segments(), search, direction, wrap, beginPos, Qt::CaseSensitive, progress, searched, gaveUp);
+	case SearchType::Literal:
+		return searchLiteralInBlocks(text.segments(), search, direction, wrap, beginPos, Qt::CaseInsensitive, progress, searched, gaveUp);
+	default:
+		break;
+	}
+
+	if (!progress(0)) {
+		*gaveUp = true;
+		return boost::none;
+	}
+
+	std::string storage;
+	const view::string_view string = text.segments().to_view(&storage);
+	return SearchStringEx(string, search, direction, searchType, wrap, beginPos, delimiters.isNull() ? nullptr : delimiters.toLatin1().data());
+}
+
+/**
+ * @brief Search::SearchString
+ * @param buffer
+ * @param searchString
+ * @param direction
+ * @param searchType
+ * @param wrap
+ * @param beginPos
+ * @param result
+ * @param delimiters
+ * @return
+ */
+bool Search::SearchString(TextBuffer *buffer, const QString &searchString, Direction direction, SearchType searchType, WrapMode wrap, int64_t beginPos, Result *result, const QString &delimiters) {
+
+	assert(result);
+
+	if (boost::optional<Result> r = SearchString(buffer, searchString, direction, searchType, wrap, beginPos, delimiters)) {
+		*result = *r;
+		return true;
+	}
+
+	return false;
+}
+
 bool Search::replaceUsingRE(const QString &searchStr, const QString &replaceStr, view::string_view sourceStr, int64_t beginPos, std::string &dest, int prevChar, const QString &delimiters, int defaultFlags) {
 	return replaceUsingRegex(
 		searchStr.toStdString(),
@@ -4,12 +4,17 @@
 
 #include "Direction.h"
 #include "SearchType.h"
+#include "TextBufferFwd.h"
 #include "Util/string_view.h"
 #include "WrapMode.h"
+#include "text_snapshot.h"
 
 #include <QString>
 #include <boost/optional.hpp>
 
+#include <functional>
+#include <string>
+
 class DocumentWidget;
 class MainWindow;
 class TextArea;
@@ -30,11 +35,28 @@ struct Result {
 	int64_t extentFW = 0;
 };
 
+/* Given each match found by ForEachMatch, returns false to stop the search */
+using MatchCallback = std::function<bool(const Result &match)>;
+
+/* Given how much of the text a search has been through so far, returns false
+ * to give up */
+using ProgressCallback = std::function<bool(int64_t scanned)>;
+
+/* Given each match found by ForEachReplacement along with the text it is to be
+ * replaced with, returns false to stop the search */
+using ReplacementCallback = std::function<bool(const Result &match, std::string &&replacement)>;
+
 bool isRegexType(SearchType searchType);
 bool replaceUsingRE(const QString &searchStr, const QString &replaceStr, view::string_view sourceStr, int64_t beginPos, std::string &dest, int prevChar, const QString &delimiters, int defaultFlags);
 bool SearchString(view::string_view string, const QString &searchString, Direction direction, SearchType searchType, WrapMode wrap, int64_t beginPos, Result *result, const QString &delimiters);
 boost::optional<Result> SearchString(view::string_view string, const QString &searchString, Direction direction, SearchType searchType, WrapMode wrap, int64_t beginPos, const QString &delimiters);
+bool SearchString(TextBuffer *buffer, const QString &searchString, Direction direction, SearchType searchType, WrapMode wrap, int64_t beginPos, Result *result, const QString &delimiters);
+boost::optional<Result> SearchString(TextBuffer *buffer, const QString &searchString, Direction direction, SearchType searchType, WrapMode wrap, int64_t beginPos, const QString &delimiters);
+boost::optional<Result> SearchSnapshot(const text_snapshot<char> &text, const QString &searchString, Direction direction, SearchType searchType, WrapMode wrap, int64_t beginPos, const QString &delimiters, const ProgressCallback &progress, int64_t *searched, bool *gaveUp);
 int defaultRegexFlags(SearchType searchType);
+void ForEachMatch(view::string_view inString, const QString &searchString, SearchType searchType, const QString &delimiters, int64_t beginPos, int64_t endPos, const MatchCallback &func);
+void ForEachMatch(const text_segments<char> &text, const QString &searchString, SearchType searchType, const QString &delimiters, int64_t beginPos, int64_t endPos, const MatchCallback &func);
+int64_t ForEachReplacement(view::string_view inString, const QString &searchString, const QString &replaceString, SearchType searchType, const QString &delimiters, const ReplacementCallback &func);
 int historyIndex(int nCycles);
 boost::optional<std::string> ReplaceAllInString(view::string_view inString, const QString &searchString, const QString &replaceString, SearchType searchType, int64_t *copyStart, int64_t *copyEnd, const QString &delimiters);
 void saveSearchHistory(const QString &searchString, QString replaceString, SearchType searchType, bool isIncremental);
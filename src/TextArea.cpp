@@ -9,6 +9,7 @@
 #include "Highlight.h"
 #include "LanguageMode.h"
 #include "LineNumberArea.h"
+#include "MarkerScrollBar.h"
 #include "Preferences.h"
 #include "RangesetTable.h"
 #include "SmartIndentEvent.h"
@@ -484,6 +485,7 @@ constexpr InputHandler inputHandlers[] = {
 TextArea::TextArea(DocumentWidget *document, TextBuffer *buffer, const QFont &font)
 	: QAbstractScrollArea(document), document_(document), font_(font), buffer_(buffer) {
 
+	setVerticalScrollBar(new MarkerScrollBar(this));
 	setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOn);
 	setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOn);
 	setMouseTracking(true);
@@ -6035,7 +6037,7 @@ void TextArea::beginBlockDrag() {
 	dragOrigBuf_->BufSetTabDistance(buffer_->BufGetTabDistance(), true);
 	dragOrigBuf_->BufSetUseTabs(buffer_->BufGetUseTabs());
 
-	dragOrigBuf_->BufSetAll(buffer_->BufGetAll());
+	dragOrigBuf_->BufSetAll(buffer_->BufAsString());
 
 	if (sel.isRectangular()) {
 		dragOrigBuf_->BufRectSelect(sel.start(), sel.end(), sel.rectStart(), sel.rectEnd());
@@ -50,6 +50,7 @@ class TextArea final : public QAbstractScrollArea {
 
 private:
 	friend class LineNumberArea;
+	friend class MarkerScrollBar;
 
 public:
 	enum EventFlag {
@@ -5,3 +5,4 @@
 // Force full intantiation
 template class BasicTextBuffer<char>;
 template class gap_buffer<char>;
+template class piece_table<char>;
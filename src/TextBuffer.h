@@ -7,6 +7,10 @@
 #include "TextRange.h"
 #include "Util/string_view.h"
 #include "gap_buffer.h"
+#include "line_index.h"
+#include "piece_table.h"
+#include "text_segments.h"
+#include "text_snapshot.h"
 
 #include <gsl/gsl_util>
 
@@ -14,9 +18,22 @@
 #include <deque>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <boost/optional.hpp>
 
+/* The storage engine used for the text of every buffer. The piece table makes
+ * edits scattered across a large document cheaper, at the cost of slower
+ * random access. Selected at build time with NEDIT_PIECE_TABLE.
+ */
+#ifdef PIECE_TABLE
+template <class Ch, class Tr>
+using text_storage = piece_table<Ch, Tr>;
+#else
+template <class Ch, class Tr>
+using text_storage = gap_buffer<Ch, Tr>;
+#endif
+
 struct SelectionPos {
 	TextCursor start;
 	TextCursor end;
@@ -28,12 +45,15 @@ struct SelectionPos {
 template <class Ch, class Tr>
 class BasicTextBuffer : public std::enable_shared_from_this<BasicTextBuffer<Ch, Tr>> {
 public:
-	using string_type = std::basic_string<Ch, Tr>;
-	using view_type   = view::basic_string_view<Ch, Tr>;
+	using string_type   = std::basic_string<Ch, Tr>;
+	using view_type     = view::basic_string_view<Ch, Tr>;
+	using segments_type = text_segments<Ch, Tr>;
+	using snapshot_type = text_snapshot<Ch, Tr>;
 
 public:
 	using modify_callback_type     = void (*)(TextCursor pos, int64_t nInserted, int64_t nDeleted, int64_t nRestyled, view_type deletedText, void *user);
 	using pre_delete_callback_type = void (*)(TextCursor pos, int64_t nDeleted, void *user);
+	using fill_callback_type       = int64_t (*)(Ch *text, int64_t capacity, void *user);
 
 private:
 	/* Initial size for the buffer gap (empty space in the buffer where text
@@ -41,6 +61,12 @@ private:
 	 */
 	static constexpr int PreferredGapSize = 80;
 
+	/* Size of the first block of text examined by the single character
+	 * searches. Most lines are shorter than this, so the search for the end
+	 * of a line is usually over after one block.
+	 */
+	static constexpr int64_t SearchWindowSize = 256;
+
 public:
 	/* Maximum length in characters of a tab or control character expansion
 	 * of a single buffer character
@@ -82,6 +108,50 @@ public:
 		int64_t rectEnd_   = 0;     // Indent of right edge of rect. selection
 	};
 
+private:
+	/* Modify notifications held back by BufBeginBatch. All text changes made
+	 * during the batch are folded into a single replacement of the range
+	 * [start, end) (in current buffer coordinates) whose original contents
+	 * were "prefixText" (stored back to front, so that growing the range
+	 * towards the start of the buffer is cheap) followed by "deletedText".
+	 * Restyle only notifications are kept separately.
+	 */
+	struct ModifyBatch {
+		int depth            = 0;     // nesting level of BufBeginBatch calls
+		bool modified        = false; // true if text changed since the batch began
+		bool restyled        = false; // true if a range needs to be redisplayed
+		int64_t start        = 0;
+		int64_t end          = 0;
+		int64_t restyleStart = 0;
+		int64_t restyleEnd   = 0;
+		string_type prefixText;
+		string_type deletedText;
+	};
+
+	/* Display columns recorded every "spacing" characters along the line
+	 * beginning at "lineStart", so that column arithmetic on very long lines
+	 * only has to scan from the nearest checkpoint. columns[i] is the display
+	 * column of the character at lineStart + i * spacing. The checkpoints are
+	 * filled in lazily, "complete" is set once the scan has reached the end
+	 * of the line.
+	 */
+	struct ColumnCheckpoints {
+		TextCursor lineStart;
+		std::vector<int64_t> columns;
+		bool complete = false;
+	};
+
+	/* Number of lines for which column checkpoints are remembered, the most
+	 * recently used line is kept at the front
+	 */
+	static constexpr size_t ColumnCacheLines = 8;
+
+public:
+	/* Default distance in characters between column checkpoints. Lines
+	 * shorter than this are always just scanned.
+	 */
+	static constexpr int64_t DefaultColumnCheckpointSpacing = 4096;
+
 public:
 	BasicTextBuffer();
 	explicit BasicTextBuffer(int64_t size);
@@ -104,6 +174,7 @@ public:
 	boost::optional<SelectionPos> BufGetSelectionPos() const noexcept;
 	bool BufGetSyncXSelection() const;
 	bool BufGetUseTabs() const noexcept;
+	bool BufInBatch() const noexcept;
 	bool BufIsEmpty() const noexcept;
 	bool BufSetSyncXSelection(bool sync);
 	boost::optional<TextCursor> searchBackward(TextCursor startPos, view_type searchChars) const noexcept;
@@ -117,12 +188,17 @@ public:
 	int compare(TextCursor pos, view_type cmpText) const noexcept;
 	int BufGetExpandedChar(TextCursor pos, int64_t indent, Ch outStr[MAX_EXP_CHAR_LEN]) const noexcept;
 	int BufGetTabDistance() const noexcept;
+	int64_t BufGetColumnCheckpointSpacing() const noexcept;
 	string_type BufGetAll() const;
 	string_type BufGetRange(TextCursor start, TextCursor end) const;
 	string_type BufGetRange(TextRange range) const;
 	string_type BufGetSecSelectText() const;
 	string_type BufGetSelectionText() const;
 	string_type BufGetTextInRect(TextCursor start, TextCursor end, int64_t rectStart, int64_t rectEnd) const;
+	segments_type BufGetSegments() const;
+	segments_type BufGetSegments(TextCursor start, TextCursor end) const;
+	snapshot_type BufSnapshot() const;
+	uint64_t BufRevision() const noexcept;
 	TextCursor BufCountBackwardNLines(TextCursor startPos, int64_t nLines) const noexcept;
 	TextCursor BufCountForwardDispChars(TextCursor lineStartPos, int64_t nChars) const noexcept;
 	TextCursor BufCountForwardNLines(TextCursor startPos, int64_t nLines) const noexcept;
@@ -132,14 +208,17 @@ public:
 	TextCursor BufEndOfBuffer() const noexcept;
 	constexpr TextCursor BufStartOfBuffer() const noexcept { return {}; }
 	view_type BufAsString() noexcept;
+	view_type BufAsString(TextCursor start, TextCursor end) noexcept;
 	void BufAddHighPriorityModifyCB(modify_callback_type bufModifiedCB, void *user);
 	void BufAddModifyCB(modify_callback_type bufModifiedCB, void *user);
 	void BufAddPreDeleteCB(pre_delete_callback_type bufPreDeleteCB, void *user);
 	void BufAppend(Ch ch) noexcept;
 	void BufAppend(view_type text) noexcept;
+	void BufBeginBatch() noexcept;
 	void BufCheckDisplay(TextCursor start, TextCursor end) const noexcept;
 	void BufClearRect(TextCursor start, TextCursor end, int64_t rectStart, int64_t rectEnd) noexcept;
 	void BufCopyFromBuf(BasicTextBuffer *fromBuf, TextCursor fromStart, TextCursor fromEnd, TextCursor toPos) noexcept;
+	void BufEndBatch() noexcept;
 	void BufHighlight(TextCursor start, TextCursor end) noexcept;
 	void BufInsertCol(int64_t column, TextCursor startPos, view_type text, int64_t *charsInserted, int64_t *charsDeleted) noexcept;
 	void BufInsert(TextCursor pos, Ch ch) noexcept;
@@ -167,6 +246,8 @@ public:
 	void BufSelect(TextCursor start, TextCursor end) noexcept;
 	void BufSelect(std::pair<TextCursor, TextCursor> range) noexcept;
 	void BufSetAll(view_type text);
+	void BufSetColumnCheckpointSpacing(int64_t spacing) noexcept;
+	bool BufSetAll(int64_t capacity, fill_callback_type fill, void *user);
 	void BufSetTabDistance(int distance, bool notify) noexcept;
 	void BufSetUseTabs(bool useTabs) noexcept;
 	void BufUnhighlight() noexcept;
@@ -183,7 +264,11 @@ private:
 	string_type getSelectionText(const Selection *sel) const;
 	void callModifyCBs(TextCursor pos, int64_t nDeleted, int64_t nInserted, int64_t nRestyled, view_type deletedText) const noexcept;
 	void callPreDeleteCBs(TextCursor pos, int64_t nDeleted) const noexcept;
+	void batchModification(TextCursor pos, int64_t nDeleted, int64_t nInserted, int64_t nRestyled, view_type deletedText) const;
+	void flushBatch() const noexcept;
 	void deleteRange(TextCursor start, TextCursor end) noexcept;
+	const ColumnCheckpoints &columnCheckpoints(TextCursor lineStartPos, TextCursor limitPos, int64_t limitColumn) const;
+	void invalidateColumnCheckpoints(TextCursor pos) const noexcept;
 	void deleteRect(TextCursor start, TextCursor end, int64_t rectStart, int64_t rectEnd, int64_t *replaceLen, TextCursor *endPos);
 	void findRectSelBoundariesForCopy(TextCursor lineStartPos, int64_t rectStart, int64_t rectEnd, TextCursor *selStart, TextCursor *selEnd) const noexcept;
 	void insertCol(int64_t column, TextCursor startPos, view_type insText, int64_t *nDeleted, int64_t *nInserted, TextCursor *endPos);
@@ -219,11 +304,16 @@ private:
 	bool syncXSelection_      = true;
 
 private:
-	gap_buffer<Ch> buffer_;
+	text_storage<Ch, Tr> buffer_;
+	line_index<Ch, Tr> lines_;
 
 private:
 	std::deque<std::pair<pre_delete_callback_type, void *>> preDeleteProcs_; // procedures to call before text is deleted from the buffer; at most one is supported.
 	std::deque<std::pair<modify_callback_type, void *>> modifyProcs_;        // procedures to call when buffer is modified to redisplay contents
+	mutable ModifyBatch batch_;                                              // notifications held back while a batch is open
+	mutable std::vector<ColumnCheckpoints> columnCache_;                     // column checkpoints of recently measured lines
+	mutable uint64_t revision_ = 0;                                          // count of text changes, see BufRevision
+	int64_t columnCheckpointSpacing_ = DefaultColumnCheckpointSpacing;
 
 public:
 	Selection primary; // highlighted areas
@@ -233,5 +323,6 @@ public:
 
 extern template class BasicTextBuffer<char>;
 extern template class gap_buffer<char>;
+extern template class piece_table<char>;
 
 #endif
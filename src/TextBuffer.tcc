@@ -4,10 +4,13 @@
 
 #include "TextAreaMimeData.h"
 #include "TextBuffer.h"
+#include "Util/CharScan.h"
 #include "Util/algorithm.h"
 
 #include <algorithm>
 #include <cassert>
+#include <limits>
+#include <utility>
 
 #include <QApplication>
 #include <QClipboard>
@@ -61,6 +64,59 @@ auto BasicTextBuffer<Ch, Tr>::BufAsString() noexcept -> view_type {
 	return buffer_.to_view();
 }
 
+/*
+** Get the text between "start" and "end" as a read-only view of contiguous
+** characters. Unlike BufAsString(), the storage is only rearranged when the
+** requested range is not already contiguous, so this is cheap for ranges
+** which don't straddle the point of the last edit
+*/
+template <class Ch, class Tr>
+auto BasicTextBuffer<Ch, Tr>::BufAsString(TextCursor start, TextCursor end) noexcept -> view_type {
+
+	sanitizeRange(start, end);
+	return buffer_.to_view(to_integer(start), to_integer(end));
+}
+
+/*
+** Get the entire contents of a text buffer as a read-only sequence of
+** contiguous runs of characters. This never copies or rearranges the text
+*/
+template <class Ch, class Tr>
+auto BasicTextBuffer<Ch, Tr>::BufGetSegments() const -> segments_type {
+	return buffer_.segments(0, buffer_.size());
+}
+
+/*
+** Get the text between "start" and "end" as a read-only sequence of
+** contiguous runs of characters. This never copies or rearranges the text
+*/
+template <class Ch, class Tr>
+auto BasicTextBuffer<Ch, Tr>::BufGetSegments(TextCursor start, TextCursor end) const -> segments_type {
+
+	sanitizeRange(start, end);
+	return buffer_.segments(to_integer(start), to_integer(end));
+}
+
+/*
+** Get an immutable copy of the entire contents of the text buffer, which may
+** be read from other threads while this buffer goes on being modified. This
+** doesn't copy the text when the snapshot is taken, the storage is shared
+** until a modification would change something the snapshot can see.
+*/
+template <class Ch, class Tr>
+auto BasicTextBuffer<Ch, Tr>::BufSnapshot() const -> snapshot_type {
+	return buffer_.snapshot();
+}
+
+/*
+** Returns a number which changes whenever the text does, so that work done on
+** a snapshot can be checked to still apply to the buffer before being used.
+*/
+template <class Ch, class Tr>
+uint64_t BasicTextBuffer<Ch, Tr>::BufRevision() const noexcept {
+	return revision_;
+}
+
 /*
 ** Replace the entire contents of the text buffer
 */
@@ -76,12 +132,51 @@ void BasicTextBuffer<Ch, Tr>::BufSetAll(view_type text) {
 	const auto deleteLength       = static_cast<int64_t>(deletedText.size());
 
 	buffer_.assign(text);
+	lines_.assign(buffer_);
+	invalidateColumnCheckpoints(BufStartOfBuffer());
+
+	// Zero all of the existing selections
+	updateSelections(BufStartOfBuffer(), deleteLength, 0);
+
+	// Call the saved display routine(s) to update the screen
+	callModifyCBs(BufStartOfBuffer(), deleteLength, insertLength, 0, deletedText);
+}
+
+/*
+** Replace the entire contents of the text buffer with up to "capacity"
+** characters, which "fill" writes directly into the buffer's storage before
+** returning how many it wrote. Unlike the other version, the text never has
+** to exist anywhere else, which matters for very large files. If "fill"
+** returns a negative number, the buffer is left unchanged and false is
+** returned.
+*/
+template <class Ch, class Tr>
+bool BasicTextBuffer<Ch, Tr>::BufSetAll(int64_t capacity, fill_callback_type fill, void *user) {
+
+	// build the new text to one side, so nothing has to be undone if it fails
+	text_storage<Ch, Tr> text;
+	if (!text.assign(capacity, [fill, user](Ch *data, int64_t size) { return fill(data, size, user); })) {
+		return false;
+	}
+
+	const int64_t insertLength = text.size();
+
+	callPreDeleteCBs(BufStartOfBuffer(), buffer_.size());
+
+	// Save information for redisplay, and get rid of the old buffer
+	const string_type deletedText = BufGetAll();
+	const auto deleteLength       = static_cast<int64_t>(deletedText.size());
+
+	buffer_.swap(text);
+	lines_.assign(buffer_);
+	invalidateColumnCheckpoints(BufStartOfBuffer());
 
 	// Zero all of the existing selections
 	updateSelections(BufStartOfBuffer(), deleteLength, 0);
 
 	// Call the saved display routine(s) to update the screen
 	callModifyCBs(BufStartOfBuffer(), deleteLength, insertLength, 0, deletedText);
+	return true;
 }
 
 /*
@@ -233,6 +328,9 @@ void BasicTextBuffer<Ch, Tr>::BufCopyFromBuf(BasicTextBuffer<Ch, Tr> *fromBuf, T
 	const int64_t length = (fromEnd - fromStart);
 
 	buffer_.insert(to_integer(toPos), fromBuf->buffer_.to_view(to_integer(fromStart), to_integer(fromEnd)));
+	lines_.insert(buffer_, to_integer(toPos), length);
+	invalidateColumnCheckpoints(toPos);
+	++revision_;
 
 	updateSelections(toPos, 0, length);
 }
@@ -536,18 +634,29 @@ template <class Ch, class Tr>
 void BasicTextBuffer<Ch, Tr>::BufSetTabDistance(int distance, bool notify) noexcept {
 
 	if (notify) {
+		/* The displays have to measure the text with the old tab setting and
+		   then again with the new one, so this can't wait for an open batch
+		   to end. Deliver what the batch has collected so far and notify
+		   directly */
+		const int depth = std::exchange(batch_.depth, 0);
+		flushBatch();
+
 		/* First call the pre-delete callbacks with the previous tab setting
 		   still active. */
 		callPreDeleteCBs(BufStartOfBuffer(), buffer_.size());
 
 		// Change the tab setting
 		tabDist_ = distance;
+		columnCache_.clear();
 
 		// Force any display routines to redisplay everything
 		view_type deletedText = BufAsString();
 		callModifyCBs(BufStartOfBuffer(), buffer_.size(), buffer_.size(), 0, deletedText);
+
+		batch_.depth = depth;
 	} else {
 		tabDist_ = distance;
+		columnCache_.clear();
 	}
 }
 
@@ -557,6 +666,36 @@ void BasicTextBuffer<Ch, Tr>::BufCheckDisplay(TextCursor start, TextCursor end)
 	callModifyCBs(start, 0, 0, end - start, {});
 }
 
+/*
+** Hold back modify notifications until the matching BufEndBatch, and then
+** deliver everything that changed in between as a single replacement (plus a
+** single restyle, if needed). This lets a long run of small edits redisplay
+** and re-highlight once instead of once per edit. Batches nest, only the
+** outermost BufEndBatch notifies. Pre-delete callbacks are not called for
+** changes made while a batch is open.
+*/
+template <class Ch, class Tr>
+void BasicTextBuffer<Ch, Tr>::BufBeginBatch() noexcept {
+	++batch_.depth;
+}
+
+template <class Ch, class Tr>
+void BasicTextBuffer<Ch, Tr>::BufEndBatch() noexcept {
+
+	if (batch_.depth == 0) {
+		return;
+	}
+
+	if (--batch_.depth == 0) {
+		flushBatch();
+	}
+}
+
+template <class Ch, class Tr>
+bool BasicTextBuffer<Ch, Tr>::BufInBatch() const noexcept {
+	return batch_.depth != 0;
+}
+
 template <class Ch, class Tr>
 void BasicTextBuffer<Ch, Tr>::BufSelectAll() noexcept {
 	BufSelect(BufStartOfBuffer(), BufEndOfBuffer());
@@ -901,6 +1040,16 @@ int64_t BasicTextBuffer<Ch, Tr>::BufCountDispChars(TextCursor lineStartPos, Text
 	Ch expandedChar[MAX_EXP_CHAR_LEN];
 
 	TextCursor pos = lineStartPos;
+
+	// on long lines, start from the last checkpoint before the target
+	if (targetPos - lineStartPos >= columnCheckpointSpacing_) {
+		const ColumnCheckpoints &checkpoints = columnCheckpoints(lineStartPos, targetPos, std::numeric_limits<int64_t>::max());
+		const size_t index                   = std::min(static_cast<size_t>((targetPos - lineStartPos) / columnCheckpointSpacing_), checkpoints.columns.size() - 1);
+
+		pos       = lineStartPos + static_cast<int64_t>(index) * columnCheckpointSpacing_;
+		charCount = checkpoints.columns[index];
+	}
+
 	while (pos < targetPos && pos < BufEndOfBuffer()) {
 		charCount += BufGetExpandedChar(pos, charCount, expandedChar);
 		++pos;
@@ -922,6 +1071,16 @@ TextCursor BasicTextBuffer<Ch, Tr>::BufCountForwardDispChars(TextCursor lineStar
 	TextCursor pos = lineStartPos;
 	TextCursor end = BufEndOfBuffer();
 
+	// on long lines, start from the last checkpoint before the column
+	if (nChars >= columnCheckpointSpacing_) {
+		const ColumnCheckpoints &checkpoints = columnCheckpoints(lineStartPos, end, nChars);
+		const auto it                        = std::upper_bound(checkpoints.columns.begin(), checkpoints.columns.end(), nChars) - 1;
+		const auto index                     = std::distance(checkpoints.columns.begin(), it);
+
+		pos       = lineStartPos + index * columnCheckpointSpacing_;
+		charCount = *it;
+	}
+
 	while (charCount < nChars && pos < end) {
 		const Ch ch = BufGetCharacter(pos);
 		if (ch == Ch('\n')) {
@@ -935,6 +1094,86 @@ TextCursor BasicTextBuffer<Ch, Tr>::BufCountForwardDispChars(TextCursor lineStar
 	return pos;
 }
 
+/*
+** Return the column checkpoints of the line starting at "lineStartPos",
+** having first extended them far enough to cover "limitPos" or
+** "limitColumn", whichever comes first.
+*/
+template <class Ch, class Tr>
+auto BasicTextBuffer<Ch, Tr>::columnCheckpoints(TextCursor lineStartPos, TextCursor limitPos, int64_t limitColumn) const -> const ColumnCheckpoints & {
+
+	auto it = std::find_if(columnCache_.begin(), columnCache_.end(), [lineStartPos](const ColumnCheckpoints &entry) {
+		return entry.lineStart == lineStartPos;
+	});
+
+	if (it == columnCache_.end()) {
+		if (columnCache_.size() >= ColumnCacheLines) {
+			columnCache_.pop_back();
+		}
+
+		ColumnCheckpoints entry;
+		entry.lineStart = lineStartPos;
+		entry.columns.push_back(0);
+		columnCache_.insert(columnCache_.begin(), std::move(entry));
+	} else {
+		// keep the most recently used line at the front
+		std::rotate(columnCache_.begin(), it, it + 1);
+	}
+
+	ColumnCheckpoints &checkpoints = columnCache_.front();
+
+	const TextCursor end = BufEndOfBuffer();
+	TextCursor pos       = lineStartPos + static_cast<int64_t>(checkpoints.columns.size() - 1) * columnCheckpointSpacing_;
+	int64_t column       = checkpoints.columns.back();
+
+	while (!checkpoints.complete && pos + columnCheckpointSpacing_ <= limitPos && column < limitColumn) {
+
+		const TextCursor next = std::min(pos + columnCheckpointSpacing_, end);
+
+		buffer_.for_each_segment(to_integer(pos), to_integer(next), [&](const Ch *text, int64_t length) {
+			for (int64_t i = 0; i < length && !checkpoints.complete; ++i) {
+				if (text[i] == Ch('\n')) {
+					checkpoints.complete = true;
+				} else {
+					column += BufCharWidth(text[i], column, tabDist_);
+				}
+			}
+		});
+
+		if (checkpoints.complete || next == end) {
+			checkpoints.complete = true;
+			break;
+		}
+
+		pos = next;
+		checkpoints.columns.push_back(column);
+	}
+
+	return checkpoints;
+}
+
+/*
+** Forget every column checkpoint which depends on the text at or after
+** "pos". Must be called whenever the text of the buffer changes.
+*/
+template <class Ch, class Tr>
+void BasicTextBuffer<Ch, Tr>::invalidateColumnCheckpoints(TextCursor pos) const noexcept {
+
+	auto it = std::remove_if(columnCache_.begin(), columnCache_.end(), [pos](const ColumnCheckpoints &entry) {
+		return entry.lineStart > pos;
+	});
+
+	columnCache_.erase(it, columnCache_.end());
+
+	for (ColumnCheckpoints &checkpoints : columnCache_) {
+		const auto keep = static_cast<size_t>((pos - checkpoints.lineStart) / columnCheckpointSpacing_ + 1);
+		if (keep < checkpoints.columns.size()) {
+			checkpoints.columns.resize(keep);
+		}
+		checkpoints.complete = false;
+	}
+}
+
 /*
 ** Count the number of newlines between startPos and endPos in buffer "buf".
 ** The character at position "endPos" is not counted.
@@ -942,22 +1181,23 @@ TextCursor BasicTextBuffer<Ch, Tr>::BufCountForwardDispChars(TextCursor lineStar
 template <class Ch, class Tr>
 int64_t BasicTextBuffer<Ch, Tr>::BufCountLines(TextCursor startPos, TextCursor endPos) const noexcept {
 
-	int64_t lineCount = 0;
+	const TextCursor end = BufEndOfBuffer();
 
-	TextCursor pos = startPos;
-	TextCursor end = BufEndOfBuffer();
+	// an end position before the start means "count to the end of the buffer"
+	if (endPos < startPos || endPos > end) {
+		endPos = end;
+	}
 
-	while (pos < end) {
-		if (pos == endPos) {
-			return lineCount;
-		}
+	if (startPos >= endPos) {
+		return 0;
+	}
 
-		if (buffer_[to_integer(pos++)] == Ch('\n')) {
-			++lineCount;
-		}
+	// short ranges are cheaper to scan than to look up in the index
+	if (endPos - startPos <= line_index<Ch, Tr>::BlockSize) {
+		return line_index<Ch, Tr>::count_newlines(buffer_, to_integer(startPos), to_integer(endPos));
 	}
 
-	return lineCount;
+	return lines_.count(buffer_, to_integer(endPos)) - lines_.count(buffer_, to_integer(startPos));
 }
 
 /*
@@ -973,10 +1213,12 @@ TextCursor BasicTextBuffer<Ch, Tr>::BufCountForwardNLines(TextCursor startPos, i
 		return startPos;
 	}
 
-	TextCursor pos = startPos;
-	TextCursor end = BufEndOfBuffer();
+	// nearby lines are found faster by scanning than through the index
+	TextCursor pos   = startPos;
+	TextCursor end   = BufEndOfBuffer();
+	TextCursor limit = std::min(end, startPos + line_index<Ch, Tr>::BlockSize);
 
-	while (pos < end) {
+	while (pos < limit) {
 		if (buffer_[to_integer(pos++)] == Ch('\n')) {
 			++lineCount;
 			if (lineCount >= nLines) {
@@ -984,7 +1226,17 @@ TextCursor BasicTextBuffer<Ch, Tr>::BufCountForwardNLines(TextCursor startPos, i
 			}
 		}
 	}
-	return pos;
+
+	if (pos >= end) {
+		return end;
+	}
+
+	const int64_t newlinePos = lines_.find(buffer_, lines_.count(buffer_, to_integer(startPos)) + nLines - 1);
+	if (newlinePos == -1) {
+		return end;
+	}
+
+	return TextCursor(newlinePos + 1);
 }
 
 /*
@@ -1003,8 +1255,10 @@ TextCursor BasicTextBuffer<Ch, Tr>::BufCountBackwardNLines(TextCursor startPos,
 	}
 
 	TextCursor pos    = startPos - 1;
+	TextCursor limit  = std::max(start, startPos - line_index<Ch, Tr>::BlockSize);
 	int64_t lineCount = -1;
 
+	// nearby lines are found faster by scanning than through the index
 	while (true) {
 		if (buffer_[to_integer(pos)] == Ch('\n')) {
 			if (++lineCount >= nLines) {
@@ -1012,13 +1266,23 @@ TextCursor BasicTextBuffer<Ch, Tr>::BufCountBackwardNLines(TextCursor startPos,
 			}
 		}
 
-		if (pos == start) {
+		if (pos == limit) {
 			break;
 		}
 		--pos;
 	}
 
-	return start;
+	if (limit == start) {
+		return start;
+	}
+
+	// the newline we want is the "nLines + 1"th one before "startPos"
+	const int64_t index = lines_.count(buffer_, to_integer(startPos)) - nLines - 1;
+	if (index < 0) {
+		return start;
+	}
+
+	return TextCursor(lines_.find(buffer_, index) + 1);
 }
 
 /*
@@ -1114,6 +1378,8 @@ int64_t BasicTextBuffer<Ch, Tr>::insert(TextCursor pos, view_type text) noexcept
 	const auto length = static_cast<int64_t>(text.size());
 
 	buffer_.insert(to_integer(pos), text);
+	lines_.insert(buffer_, to_integer(pos), length);
+	invalidateColumnCheckpoints(pos);
 
 	updateSelections(pos, 0, length);
 
@@ -1126,6 +1392,8 @@ int64_t BasicTextBuffer<Ch, Tr>::insert(TextCursor pos, Ch ch) noexcept {
 	const int64_t length = 1;
 
 	buffer_.insert(to_integer(pos), ch);
+	lines_.insert(buffer_, to_integer(pos), length);
+	invalidateColumnCheckpoints(pos);
 
 	updateSelections(pos, 0, length);
 
@@ -1142,14 +1410,28 @@ int64_t BasicTextBuffer<Ch, Tr>::insert(TextCursor pos, Ch ch) noexcept {
 template <class Ch, class Tr>
 boost::optional<TextCursor> BasicTextBuffer<Ch, Tr>::searchForward(TextCursor startPos, Ch searchChar) const noexcept {
 
-	TextCursor pos = startPos;
-	TextCursor end = BufEndOfBuffer();
+	const int64_t end = buffer_.size();
 
-	while (pos < end) {
-		if (buffer_[to_integer(pos)] == searchChar) {
-			return pos;
+	// scan in growing windows, most searches end within the first one
+	int64_t window = SearchWindowSize;
+
+	for (int64_t pos = to_integer(startPos); pos < end; pos += window, window *= 2) {
+		int64_t found  = -1;
+		int64_t offset = pos;
+
+		buffer_.for_each_segment(pos, std::min(end, pos + window), [&](const Ch *text, int64_t length) {
+			if (found == -1) {
+				const Ch *it = find_char(text, text + length, searchChar);
+				if (it != text + length) {
+					found = offset + (it - text);
+				}
+			}
+			offset += length;
+		});
+
+		if (found != -1) {
+			return TextCursor(found);
 		}
-		++pos;
 	}
 
 	return boost::none;
@@ -1165,24 +1447,29 @@ boost::optional<TextCursor> BasicTextBuffer<Ch, Tr>::searchForward(TextCursor st
 template <class Ch, class Tr>
 boost::optional<TextCursor> BasicTextBuffer<Ch, Tr>::searchBackward(TextCursor startPos, Ch searchChar) const noexcept {
 
-	TextCursor start = BufStartOfBuffer();
+	// scan in growing windows, most searches end within the first one
+	int64_t window = SearchWindowSize;
 
-	if (startPos == start) {
-		return boost::none;
-	}
+	for (int64_t last = std::min<int64_t>(to_integer(startPos), buffer_.size()); last > 0; last -= window, window *= 2) {
+		const int64_t first = std::max<int64_t>(0, last - window);
+		int64_t found       = -1;
+		int64_t offset      = first;
 
-	TextCursor pos = startPos - 1;
-	while (true) {
-		if (buffer_[to_integer(pos)] == searchChar) {
-			return pos;
-		}
+		// the last match in the last segment which has one wins
+		buffer_.for_each_segment(first, last, [&](const Ch *text, int64_t length) {
+			const Ch *it = rfind_char(text, text + length, searchChar);
+			if (it != text + length) {
+				found = offset + (it - text);
+			}
+			offset += length;
+		});
 
-		if (pos == start) {
-			return boost::none;
+		if (found != -1) {
+			return TextCursor(found);
 		}
-
-		--pos;
 	}
+
+	return boost::none;
 }
 
 template <class Ch, class Tr>
@@ -1208,6 +1495,15 @@ auto BasicTextBuffer<Ch, Tr>::getSelectionText(const Selection *sel) const -> st
 template <class Ch, class Tr>
 void BasicTextBuffer<Ch, Tr>::callModifyCBs(TextCursor pos, int64_t nDeleted, int64_t nInserted, int64_t nRestyled, view_type deletedText) const noexcept {
 
+	if (nDeleted != 0 || nInserted != 0) {
+		++revision_;
+	}
+
+	if (batch_.depth != 0) {
+		batchModification(pos, nDeleted, nInserted, nRestyled, deletedText);
+		return;
+	}
+
 	for (const auto &pair : modifyProcs_) {
 		(pair.first)(pos, nInserted, nDeleted, nRestyled, deletedText, pair.second);
 	}
@@ -1220,11 +1516,129 @@ void BasicTextBuffer<Ch, Tr>::callModifyCBs(TextCursor pos, int64_t nDeleted, in
 template <class Ch, class Tr>
 void BasicTextBuffer<Ch, Tr>::callPreDeleteCBs(TextCursor pos, int64_t nDeleted) const noexcept {
 
+	if (batch_.depth != 0) {
+		return;
+	}
+
 	for (const auto &pair : preDeleteProcs_) {
 		(pair.first)(pos, nDeleted, pair.second);
 	}
 }
 
+/*
+** Fold a modification made while a batch is open into the pending
+** notification. "pos", "nDeleted" and "deletedText" describe the change in
+** terms of the buffer as it was just before it was made, which is also what
+** the pending range is expressed in.
+*/
+template <class Ch, class Tr>
+void BasicTextBuffer<Ch, Tr>::batchModification(TextCursor pos, int64_t nDeleted, int64_t nInserted, int64_t nRestyled, view_type deletedText) const {
+
+	const int64_t changeStart = to_integer(pos);
+	const int64_t changeEnd   = changeStart + nDeleted;
+	const int64_t delta       = nInserted - nDeleted;
+
+	if (nDeleted != 0 || nInserted != 0) {
+
+		// keep the pending restyle range pointing at the same text
+		if (batch_.restyled) {
+			if (batch_.restyleStart > changeStart) {
+				batch_.restyleStart = (batch_.restyleStart >= changeEnd) ? batch_.restyleStart + delta : changeStart;
+			}
+
+			if (batch_.restyleEnd > changeStart) {
+				batch_.restyleEnd = (batch_.restyleEnd >= changeEnd) ? batch_.restyleEnd + delta : changeStart + nInserted;
+			}
+		}
+
+		if (!batch_.modified) {
+			batch_.modified = true;
+			batch_.start    = changeStart;
+			batch_.end      = changeStart + nInserted;
+			batch_.deletedText.assign(deletedText.begin(), deletedText.end());
+		} else {
+
+			/* Text outside of the pending range hasn't been touched since the
+			   batch began, so the original contents of the combined range are
+			   the pending original text, extended on either side with what
+			   this change deleted and with any untouched text in between */
+			auto appendRange = [this](string_type *out, int64_t start, int64_t end) {
+				buffer_.for_each_segment(start, end, [out](const Ch *data, size_t size) {
+					out->append(data, size);
+				});
+			};
+
+			if (changeStart < batch_.start) {
+				string_type prefix(deletedText.begin(), deletedText.begin() + (std::min(changeEnd, batch_.start) - changeStart));
+				if (changeEnd < batch_.start) {
+					appendRange(&prefix, changeStart + nInserted, batch_.start + delta);
+				}
+
+				batch_.prefixText.append(prefix.rbegin(), prefix.rend());
+			}
+
+			if (changeEnd > batch_.end) {
+				if (changeStart > batch_.end) {
+					appendRange(&batch_.deletedText, batch_.end, changeStart);
+				}
+
+				const int64_t offset = std::max(changeStart, batch_.end) - changeStart;
+				batch_.deletedText.append(deletedText.begin() + offset, deletedText.end());
+			}
+
+			batch_.start = std::min(changeStart, batch_.start);
+			batch_.end   = std::max(changeEnd, batch_.end) + delta;
+		}
+	}
+
+	if (nRestyled != 0) {
+		if (!batch_.restyled) {
+			batch_.restyled     = true;
+			batch_.restyleStart = changeStart;
+			batch_.restyleEnd   = changeStart + nRestyled;
+		} else {
+			batch_.restyleStart = std::min(batch_.restyleStart, changeStart);
+			batch_.restyleEnd   = std::max(batch_.restyleEnd, changeStart + nRestyled);
+		}
+	}
+}
+
+/*
+** Deliver the notifications collected by the current batch
+*/
+template <class Ch, class Tr>
+void BasicTextBuffer<Ch, Tr>::flushBatch() const noexcept {
+
+	if (!batch_.modified && !batch_.restyled) {
+		return;
+	}
+
+	/* Reset the batch before calling anyone, the callbacks are free to
+	   modify the buffer themselves */
+	ModifyBatch batch = std::move(batch_);
+	batch_            = ModifyBatch();
+	batch_.depth      = batch.depth;
+
+	if (batch.modified) {
+		string_type deletedText(batch.prefixText.rbegin(), batch.prefixText.rend());
+		deletedText.append(batch.deletedText);
+
+		callModifyCBs(TextCursor(batch.start), static_cast<int64_t>(deletedText.size()), batch.end - batch.start, 0, deletedText);
+	}
+
+	if (batch.restyled) {
+		const int64_t start = qBound<int64_t>(0, batch.restyleStart, length());
+		const int64_t end   = qBound<int64_t>(start, batch.restyleEnd, length());
+
+		// the replacement above already redisplayed the changed text
+		const bool covered = batch.modified && start >= batch.start && end <= batch.end;
+
+		if (end > start && !covered) {
+			callModifyCBs(TextCursor(start), 0, 0, end - start, {});
+		}
+	}
+}
+
 /*
 ** Internal (non-redisplaying) version of BufRemove.  Removes the contents
 ** of the buffer between start and end (and moves the gap to the site of
@@ -1233,7 +1647,9 @@ void BasicTextBuffer<Ch, Tr>::callPreDeleteCBs(TextCursor pos, int64_t nDeleted)
 template <class Ch, class Tr>
 void BasicTextBuffer<Ch, Tr>::deleteRange(TextCursor start, TextCursor end) noexcept {
 
+	lines_.erase(buffer_, to_integer(start), to_integer(end));
 	buffer_.erase(to_integer(start), to_integer(end));
+	invalidateColumnCheckpoints(start);
 
 	// fix up any selections which might be affected by the change
 	updateSelections(start, end - start, 0);
@@ -1318,7 +1734,17 @@ void BasicTextBuffer<Ch, Tr>::findRectSelBoundariesForCopy(TextCursor lineStartP
 
 	TextCursor pos = lineStartPos;
 	TextCursor end = BufEndOfBuffer();
-	int indent     = 0;
+	int64_t indent = 0;
+
+	// on long lines, start from the last checkpoint before the selection
+	if (rectStart >= columnCheckpointSpacing_) {
+		const ColumnCheckpoints &checkpoints = columnCheckpoints(lineStartPos, end, rectStart);
+		const auto it                        = std::upper_bound(checkpoints.columns.begin(), checkpoints.columns.end(), rectStart) - 1;
+		const auto index                     = std::distance(checkpoints.columns.begin(), it);
+
+		pos    = lineStartPos + index * columnCheckpointSpacing_;
+		indent = *it;
+	}
 
 	// find the start of the selection
 	for (; pos < end; ++pos) {
@@ -1947,7 +2373,7 @@ auto BasicTextBuffer<Ch, Tr>::copyLine(Ran first, Ran last) -> string_type {
 */
 template <class Ch, class Tr>
 int64_t BasicTextBuffer<Ch, Tr>::countLines(view_type string) noexcept {
-	return std::count(string.begin(), string.end(), Ch('\n'));
+	return static_cast<int64_t>(count_char(string.data(), string.data() + string.size(), Ch('\n')));
 }
 
 /*
@@ -2116,6 +2542,22 @@ int BasicTextBuffer<Ch, Tr>::BufGetTabDistance() const noexcept {
 	return tabDist_;
 }
 
+/*
+** Set the distance in characters between the display column checkpoints
+** remembered for long lines. Smaller values make column calculations on
+** long lines faster at the cost of more memory.
+*/
+template <class Ch, class Tr>
+void BasicTextBuffer<Ch, Tr>::BufSetColumnCheckpointSpacing(int64_t spacing) noexcept {
+	columnCheckpointSpacing_ = std::max<int64_t>(spacing, 1);
+	columnCache_.clear();
+}
+
+template <class Ch, class Tr>
+int64_t BasicTextBuffer<Ch, Tr>::BufGetColumnCheckpointSpacing() const noexcept {
+	return columnCheckpointSpacing_;
+}
+
 template <class Ch, class Tr>
 bool BasicTextBuffer<Ch, Tr>::BufGetSyncXSelection() const {
 	return syncXSelection_;
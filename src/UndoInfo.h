@@ -4,6 +4,7 @@
 
 #include "TextCursor.h"
 #include <string>
+#include <vector>
 
 /* The accumulated list of undo operations can potentially consume huge
    amounts of memory.  These tuning parameters determine how much undo infor-
@@ -21,7 +22,16 @@ enum UndoTypes {
 	ONE_CHAR_DELETE,
 	BLOCK_INSERT,
 	BLOCK_REPLACE,
-	BLOCK_DELETE
+	BLOCK_DELETE,
+	MULTI_REPLACE
+};
+
+/* One of the replacements making up a MULTI_REPLACE operation: the "length"
+   characters at "startPos" are replaced with "text" */
+struct TextDelta {
+	TextCursor startPos;
+	int64_t length = 0;
+	std::string text;
 };
 
 /* Record on undo list */
@@ -36,6 +46,7 @@ public:
 
 public:
 	std::string oldText;
+	std::vector<TextDelta> deltas; // for MULTI_REPLACE, the replacements which undo it, in ascending order, instead of "oldText"
 	UndoTypes type;
 	TextCursor startPos;
 	TextCursor endPos;
@@ -5,9 +5,13 @@
 #include "Util/string_view.h"
 #include "gap_buffer_fwd.h"
 #include "gap_buffer_iterator.h"
+#include "text_segments.h"
+#include "text_snapshot.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <limits>
 #include <memory>
 #include <string>
 
@@ -78,6 +82,11 @@ public:
 	string_type to_string(size_type start, size_type end) const;
 	view_type to_view() noexcept;
 	view_type to_view(size_type start, size_type end) noexcept;
+	text_segments<Ch, Tr> segments(size_type start, size_type end) const;
+	text_snapshot<Ch, Tr> snapshot() const;
+
+	template <class Func>
+	void for_each_segment(size_type start, size_type end, Func func) const;
 
 public:
 	void append(view_type str);
@@ -90,16 +99,32 @@ public:
 	void assign(view_type str);
 	void clear() noexcept;
 
+	template <class Fill>
+	bool assign(size_type capacity, Fill fill);
+
 private:
 	void move_gap(size_type pos) noexcept;
 	void reallocate_buffer(size_type new_gap_start, size_type new_gap_size);
 	void delete_range(size_type start, size_type end) noexcept;
+	void prepare_write(size_type first, size_type last);
+
+private:
+	static std::shared_ptr<Ch> allocate(size_type size);
+
+private:
+	std::shared_ptr<Ch> storage_; // owns the internal buffer, shared with any snapshots of it
+	Ch *buf_;                     // points to the internal buffer
+	size_type gap_start_;         // points to the first character of the gap
+	size_type gap_end_;           // points to the first char after the gap
+	size_type size_;              // length of the text in the buffer (the length of the buffer itself must be calculated: gapEnd - gapStart + length)
 
 private:
-	std::unique_ptr<Ch[]> buf_; // points to the internal buffer
-	size_type gap_start_;       // points to the first character of the gap
-	size_type gap_end_;         // points to the first char after the gap
-	size_type size_;            // length of the text in the buffer (the length of the buffer itself must be calculated: gapEnd - gapStart + length)
+	/* While "storage_" is shared with a snapshot, only the characters in this
+	 * range of "buf_" may be overwritten in place. It is the part of the gap
+	 * which every snapshot taken since the last reallocation had in its gap
+	 * too, so no snapshot can see it */
+	mutable size_type shared_gap_start_ = 0;
+	mutable size_type shared_gap_end_   = std::numeric_limits<size_type>::max();
 };
 
 /**
@@ -117,7 +142,8 @@ template <class Ch, class Tr>
 gap_buffer<Ch, Tr>::gap_buffer(size_type reserve_size)
 	: gap_start_(0), gap_end_(PreferredGapSize), size_(0) {
 
-	buf_ = std::make_unique<Ch[]>(reserve_size + PreferredGapSize);
+	storage_ = allocate(reserve_size + PreferredGapSize);
+	buf_     = storage_.get();
 
 #ifdef PURIFY
 	std::fill(&buf_[gap_start_], &buf_[gap_end_], Ch('.'));
@@ -143,11 +169,9 @@ Ch gap_buffer<Ch, Tr>::operator[](size_type n) const noexcept {
 template <class Ch, class Tr>
 Ch &gap_buffer<Ch, Tr>::operator[](size_type n) noexcept {
 
-	if (n < gap_start_) {
-		return buf_[n];
-	}
-
-	return buf_[n + gap_size()];
+	const size_type index = (n < gap_start_) ? n : n + gap_size();
+	prepare_write(index, index + 1);
+	return buf_[index];
 }
 
 /**
@@ -177,11 +201,7 @@ Ch &gap_buffer<Ch, Tr>::at(size_type n) {
 		Raise<std::out_of_range>("gap_buffer::at");
 	}
 
-	if (n < gap_start_) {
-		return buf_[n];
-	}
-
-	return buf_[n + gap_size()];
+	return (*this)[n];
 }
 
 /**
@@ -309,20 +329,58 @@ auto gap_buffer<Ch, Tr>::to_view(size_type start, size_type end) noexcept -> vie
 	assert(end <= size() && end >= 0);
 	assert(start <= end);
 
-	const size_type bufLen   = size();
-	size_type leftLen        = gap_start_;
-	const size_type rightLen = bufLen - leftLen;
+	// the gap only has to move if it splits the requested range, and then
+	// only to whichever end of the range is closer
+	if (start < gap_start_ && gap_start_ < end) {
+		move_gap((gap_start_ - start < end - gap_start_) ? start : end);
+	}
 
-	// find where best to put the gap to minimise memory movement
-	if (leftLen != 0 && rightLen != 0) {
-		leftLen = (leftLen < rightLen) ? 0 : bufLen;
-		move_gap(leftLen);
+	if (end <= gap_start_) {
+		return view_type(&buf_[start], static_cast<size_t>(end - start));
 	}
 
-	// get the start position of the actual data
-	Ch *const text = &buf_[(leftLen == 0) ? gap_end_ : 0];
+	return view_type(&buf_[start + gap_size()], static_cast<size_t>(end - start));
+}
+
+/*
+** Returns the range [start, end) as (at most) the two runs of text either
+** side of the gap, without moving the gap
+*/
+template <class Ch, class Tr>
+auto gap_buffer<Ch, Tr>::segments(size_type start, size_type end) const -> text_segments<Ch, Tr> {
 
-	return view_type(text + start, static_cast<size_t>(end - start));
+	text_segments<Ch, Tr> result;
+	for_each_segment(start, end, [&result](const Ch *text, size_type length) {
+		result.append(view_type(text, static_cast<size_t>(length)));
+	});
+
+	return result;
+}
+
+/*
+** Calls "func(const Ch *text, size_type length)" for each of the (at most
+** two) contiguous runs of characters which make up the range [start, end)
+*/
+template <class Ch, class Tr>
+template <class Func>
+void gap_buffer<Ch, Tr>::for_each_segment(size_type start, size_type end, Func func) const {
+
+	assert(start <= size() && start >= 0);
+	assert(end <= size() && end >= 0);
+	assert(start <= end);
+
+	if (start == end) {
+		return;
+	}
+
+	if (end <= gap_start_) {
+		func(&buf_[start], end - start);
+	} else if (start >= gap_start_) {
+		func(&buf_[start + gap_size()], end - start);
+	} else {
+		func(&buf_[start], gap_start_ - start);
+		func(&buf_[gap_end_], end - gap_start_);
+	}
 }
 
 /**
@@ -363,6 +421,7 @@ void gap_buffer<Ch, Tr>::insert(size_type pos, view_type str) {
 	}
 
 	// Insert the new text (pos now corresponds to the start of the gap)
+	prepare_write(pos, pos + length);
 	std::copy(str.begin(), str.end(), &buf_[pos]);
 
 	gap_start_ += length;
@@ -391,6 +450,7 @@ void gap_buffer<Ch, Tr>::insert(size_type pos, Ch ch) {
 	}
 
 	// Insert the new text (pos now corresponds to the start of the gap)
+	prepare_write(pos, pos + length);
 	buf_[pos] = ch;
 
 	gap_start_ += length;
@@ -435,6 +495,45 @@ void gap_buffer<Ch, Tr>::assign(view_type str) {
 	replace(0, size(), str);
 }
 
+/*
+** Replaces the contents of the buffer with text written straight into new
+** storage by "fill(Ch *data, size_type capacity)", which may write up to
+** "capacity" characters and returns how many it did write. This lets large
+** texts, such as the contents of a file being loaded, be produced in place
+** rather than built somewhere else first and then copied in. If "fill"
+** returns a negative number, the buffer is left unchanged and false is
+** returned.
+*/
+template <class Ch, class Tr>
+template <class Fill>
+bool gap_buffer<Ch, Tr>::assign(size_type capacity, Fill fill) {
+
+	std::shared_ptr<Ch> new_storage = allocate(capacity + PreferredGapSize);
+	const size_type length          = fill(new_storage.get(), capacity);
+
+	if (length < 0) {
+		return false;
+	}
+
+	assert(length <= capacity);
+
+	// release the old text before anything else is done with the new one
+	storage_   = std::move(new_storage);
+	buf_       = storage_.get();
+	gap_start_ = length;
+	gap_end_   = capacity + PreferredGapSize;
+	size_      = length;
+
+	shared_gap_start_ = 0;
+	shared_gap_end_   = std::numeric_limits<size_type>::max();
+
+#ifdef PURIFY
+	std::fill(&buf_[gap_start_], &buf_[gap_end_], Ch('.'));
+#endif
+
+	return true;
+}
+
 /**
  *
  */
@@ -452,8 +551,10 @@ void gap_buffer<Ch, Tr>::move_gap(size_type pos) noexcept {
 	const size_type gap_length = gap_size();
 
 	if (pos > gap_start_) {
+		prepare_write(gap_start_, pos);
 		Tr::move(&buf_[gap_start_], &buf_[gap_end_], static_cast<size_t>(pos - gap_start_));
 	} else {
+		prepare_write(pos + gap_length, gap_end_);
 		Tr::move(&buf_[pos + gap_length], &buf_[pos], static_cast<size_t>(gap_start_ - pos));
 	}
 
@@ -468,7 +569,8 @@ void gap_buffer<Ch, Tr>::move_gap(size_type pos) noexcept {
 template <class Ch, class Tr>
 void gap_buffer<Ch, Tr>::reallocate_buffer(size_type new_gap_start, size_type new_gap_size) {
 
-	auto new_buffer = std::make_unique<Ch[]>(size() + new_gap_size);
+	std::shared_ptr<Ch> new_storage = allocate(size() + new_gap_size);
+	Ch *const new_buffer            = new_storage.get();
 
 	const size_type new_gap_end = new_gap_start + new_gap_size;
 
@@ -482,10 +584,15 @@ void gap_buffer<Ch, Tr>::reallocate_buffer(size_type new_gap_start, size_type ne
 		Tr::copy(&new_buffer[new_gap_end], &buf_[gap_end_ + new_gap_start - gap_start_], static_cast<size_t>(size() - new_gap_start));
 	}
 
-	buf_       = std::move(new_buffer);
+	storage_   = std::move(new_storage);
+	buf_       = new_buffer;
 	gap_start_ = new_gap_start;
 	gap_end_   = new_gap_end;
 
+	// nothing else can see the new buffer yet
+	shared_gap_start_ = 0;
+	shared_gap_end_   = std::numeric_limits<size_type>::max();
+
 #ifdef PURIFY
 	std::fill(&buf_[gap_start_], &buf_[gap_end_], Ch('.'));
 #endif
@@ -517,10 +624,67 @@ template <class Ch, class Tr>
 void gap_buffer<Ch, Tr>::swap(gap_buffer &other) noexcept {
 	using std::swap;
 
+	swap(storage_, other.storage_);
 	swap(buf_, other.buf_);
 	swap(gap_start_, other.gap_start_);
 	swap(gap_end_, other.gap_end_);
 	swap(size_, other.size_);
+	swap(shared_gap_start_, other.shared_gap_start_);
+	swap(shared_gap_end_, other.shared_gap_end_);
+}
+
+/*
+** Returns an immutable copy of the whole text. This doesn't copy anything up
+** front: the snapshot shares the current buffer, and the first modification
+** which would change characters it can see moves this gap_buffer to a copy
+** instead. Typing at the gap never needs that, and nor does anything done
+** after the last snapshot of the buffer has been destroyed.
+*/
+template <class Ch, class Tr>
+auto gap_buffer<Ch, Tr>::snapshot() const -> text_snapshot<Ch, Tr> {
+
+	if (storage_.use_count() > 1) {
+		// other snapshots of this buffer are still around, they can't see
+		// anything outside of both gaps
+		shared_gap_start_ = std::max(shared_gap_start_, gap_start_);
+		shared_gap_end_   = std::min(shared_gap_end_, gap_end_);
+	} else {
+		shared_gap_start_ = gap_start_;
+		shared_gap_end_   = gap_end_;
+	}
+
+	return text_snapshot<Ch, Tr>(segments(0, size()), {storage_});
+}
+
+/*
+** Called before characters [first, last) of "buf_" are overwritten, makes
+** sure that no snapshot can see them
+*/
+template <class Ch, class Tr>
+void gap_buffer<Ch, Tr>::prepare_write(size_type first, size_type last) {
+
+	if (first >= shared_gap_start_ && last <= shared_gap_end_) {
+		return;
+	}
+
+	if (storage_.use_count() > 1) {
+		// leave the snapshots with the old buffer, and carry on with a copy
+		reallocate_buffer(gap_start_, gap_size());
+	} else {
+		// the last snapshot is gone, make sure we see everything it did before reusing its memory
+		std::atomic_thread_fence(std::memory_order_acquire);
+		shared_gap_start_ = 0;
+		shared_gap_end_   = std::numeric_limits<size_type>::max();
+	}
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+std::shared_ptr<Ch> gap_buffer<Ch, Tr>::allocate(size_type size) {
+	// deliberately left uninitialized, every character is written before it is read
+	return std::shared_ptr<Ch>(new Ch[static_cast<size_t>(size)], std::default_delete<Ch[]>());
 }
 
 #endif
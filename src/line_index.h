@@ -0,0 +1,411 @@
+
+#ifndef LINE_INDEX_H_
+#define LINE_INDEX_H_
+
+#include "Util/CharScan.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+/*
+** Keeps track of where the newlines are in a text buffer so that line <-> offset
+** conversions don't have to scan the text from the beginning.
+**
+** The text is divided into consecutive blocks of roughly "BlockSize"
+** characters, and the length and number of newlines of each block are kept in
+** a pair of Fenwick trees. Locating the block containing a position (or a
+** given newline) is logarithmic in the number of blocks, after which at most one
+** block needs to be scanned. Block boundaries move along with edits, so the
+** index never has to be rebuilt for ordinary insertions and deletions.
+**
+** The index does not own the text, the buffer being indexed is passed to any
+** function which needs to look at characters.
+*/
+template <class Ch, class Tr = std::char_traits<Ch>>
+class line_index {
+public:
+	using size_type = int64_t;
+
+public:
+	static constexpr size_type BlockSize = 4096;
+
+public:
+	line_index();
+	line_index(const line_index &) = delete;
+	line_index &operator=(const line_index &) = delete;
+	line_index(line_index &&)                 = delete;
+	line_index &operator=(line_index &&) = delete;
+	~line_index()                        = default;
+
+public:
+	template <class Buffer>
+	void assign(const Buffer &buffer);
+
+	template <class Buffer>
+	void insert(const Buffer &buffer, size_type pos, size_type length);
+
+	template <class Buffer>
+	void erase(const Buffer &buffer, size_type start, size_type end);
+
+public:
+	template <class Buffer>
+	size_type count(const Buffer &buffer, size_type pos) const noexcept;
+
+	template <class Buffer>
+	size_type find(const Buffer &buffer, size_type n) const noexcept;
+
+	size_type size() const noexcept { return size_; }
+	size_type newlines() const noexcept { return newlines_; }
+
+public:
+	template <class Buffer>
+	static size_type count_newlines(const Buffer &buffer, size_type first, size_type last) noexcept;
+
+private:
+	std::pair<size_t, size_type> locate(const std::vector<size_type> &tree, const std::vector<size_type> &blocks, size_type value) const noexcept;
+	size_type prefix(const std::vector<size_type> &tree, size_t block) const noexcept;
+	static void add(std::vector<size_type> &tree, size_t block, size_type delta) noexcept;
+	void rebuild_trees();
+	void compact();
+
+	template <class Buffer>
+	void split(const Buffer &buffer, size_t block, size_type blockStart);
+
+private:
+	std::vector<size_type> blockLengths_;  // number of characters in each block
+	std::vector<size_type> blockNewlines_; // number of newlines in each block
+	std::vector<size_type> lengthTree_;    // Fenwick tree over "blockLengths_" (1-based)
+	std::vector<size_type> newlineTree_;   // Fenwick tree over "blockNewlines_" (1-based)
+	size_t topBit_      = 0;               // highest power of two <= the number of blocks, for tree descents
+	size_type size_     = 0;               // total number of characters indexed
+	size_type newlines_ = 0;               // total number of newlines indexed
+};
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+line_index<Ch, Tr>::line_index()
+	: blockLengths_(1, 0), blockNewlines_(1, 0) {
+	rebuild_trees();
+}
+
+/*
+** Count the newlines in the range [first, last) of "buffer"
+*/
+template <class Ch, class Tr>
+template <class Buffer>
+auto line_index<Ch, Tr>::count_newlines(const Buffer &buffer, size_type first, size_type last) noexcept -> size_type {
+	size_type count = 0;
+	buffer.for_each_segment(first, last, [&count](const Ch *text, size_type length) {
+		count += static_cast<size_type>(count_char(text, text + length, Ch('\n')));
+	});
+	return count;
+}
+
+/*
+** Discard the current index and rebuild it from the contents of "buffer"
+*/
+template <class Ch, class Tr>
+template <class Buffer>
+void line_index<Ch, Tr>::assign(const Buffer &buffer) {
+
+	const size_type length = buffer.size();
+	const size_t nBlocks   = std::max<size_t>(1, static_cast<size_t>((length + BlockSize - 1) / BlockSize));
+
+	blockLengths_.assign(nBlocks, 0);
+	blockNewlines_.assign(nBlocks, 0);
+
+	size_type newlines = 0;
+	for (size_t i = 0; i < nBlocks; ++i) {
+		const size_type first = static_cast<size_type>(i) * BlockSize;
+		const size_type last  = std::min(first + BlockSize, length);
+		if (first < last) {
+			blockLengths_[i]  = last - first;
+			blockNewlines_[i] = count_newlines(buffer, first, last);
+			newlines += blockNewlines_[i];
+		}
+	}
+
+	size_     = length;
+	newlines_ = newlines;
+	rebuild_trees();
+}
+
+/*
+** Account for "length" characters which were just inserted into "buffer"
+** at position "pos"
+*/
+template <class Ch, class Tr>
+template <class Buffer>
+void line_index<Ch, Tr>::insert(const Buffer &buffer, size_type pos, size_type length) {
+
+	assert(pos >= 0 && pos <= size_);
+
+	if (length <= 0) {
+		return;
+	}
+
+	size_t block;
+	size_type blockStart;
+	std::tie(block, blockStart) = locate(lengthTree_, blockLengths_, pos);
+
+	const size_type nl = count_newlines(buffer, pos, pos + length);
+
+	blockLengths_[block] += length;
+	blockNewlines_[block] += nl;
+	add(lengthTree_, block, length);
+	add(newlineTree_, block, nl);
+
+	size_ += length;
+	newlines_ += nl;
+
+	if (blockLengths_[block] > 2 * BlockSize) {
+		split(buffer, block, blockStart);
+	}
+}
+
+/*
+** Account for the characters in the range [start, end) of "buffer" which are
+** about to be removed. Must be called BEFORE the text is removed.
+*/
+template <class Ch, class Tr>
+template <class Buffer>
+void line_index<Ch, Tr>::erase(const Buffer &buffer, size_type start, size_type end) {
+
+	assert(start >= 0 && start <= end && end <= size_);
+
+	if (start == end) {
+		return;
+	}
+
+	size_t block;
+	size_type blockStart;
+	std::tie(block, blockStart) = locate(lengthTree_, blockLengths_, start);
+
+	while (block < blockLengths_.size() && blockStart < end) {
+		const size_type blockEnd = blockStart + blockLengths_[block];
+		const size_type first    = std::max(start, blockStart);
+		const size_type last     = std::min(end, blockEnd);
+
+		if (first < last) {
+			// whole blocks don't need to be scanned
+			const size_type nl = (first == blockStart && last == blockEnd) ? blockNewlines_[block] : count_newlines(buffer, first, last);
+
+			blockLengths_[block] -= (last - first);
+			blockNewlines_[block] -= nl;
+			add(lengthTree_, block, -(last - first));
+			add(newlineTree_, block, -nl);
+			newlines_ -= nl;
+		}
+
+		blockStart = blockEnd;
+		++block;
+	}
+
+	size_ -= (end - start);
+
+	// deletions leave behind empty or tiny blocks, merge them once they dominate
+	if (static_cast<size_type>(blockLengths_.size()) > 2 * (size_ / BlockSize) + 64) {
+		compact();
+	}
+}
+
+/*
+** Returns the number of newlines in the range [0, pos) of "buffer"
+*/
+template <class Ch, class Tr>
+template <class Buffer>
+auto line_index<Ch, Tr>::count(const Buffer &buffer, size_type pos) const noexcept -> size_type {
+
+	if (pos <= 0) {
+		return 0;
+	}
+
+	if (pos >= size_) {
+		return newlines_;
+	}
+
+	size_t block;
+	size_type blockStart;
+	std::tie(block, blockStart) = locate(lengthTree_, blockLengths_, pos);
+
+	return prefix(newlineTree_, block) + count_newlines(buffer, blockStart, pos);
+}
+
+/*
+** Returns the position of the newline with the zero-based index "n" in
+** "buffer", or -1 if the buffer has fewer newlines than that
+*/
+template <class Ch, class Tr>
+template <class Buffer>
+auto line_index<Ch, Tr>::find(const Buffer &buffer, size_type n) const noexcept -> size_type {
+
+	if (n < 0 || n >= newlines_) {
+		return -1;
+	}
+
+	size_t block;
+	size_type before;
+	std::tie(block, before) = locate(newlineTree_, blockNewlines_, n);
+
+	const size_type blockStart = prefix(lengthTree_, block);
+	const size_type blockEnd   = blockStart + blockLengths_[block];
+
+	size_type result = -1;
+	size_type offset = blockStart;
+
+	buffer.for_each_segment(blockStart, blockEnd, [&](const Ch *text, size_type length) {
+		const Ch *const last = text + length;
+		for (const Ch *it = text; result == -1 && (it = find_char(it, last, Ch('\n'))) != last; ++it) {
+			if (before++ == n) {
+				result = offset + (it - text);
+			}
+		}
+		offset += length;
+	});
+
+	assert(result != -1 && "line_index out of sync with buffer");
+	return result;
+}
+
+/*
+** Find the block in which the cumulative sum of "blocks" (stored in "tree")
+** exceeds "value".
+** Returns the block and the sum of all blocks before it. Values past the end
+** resolve to the last block.
+*/
+template <class Ch, class Tr>
+auto line_index<Ch, Tr>::locate(const std::vector<size_type> &tree, const std::vector<size_type> &blocks, size_type value) const noexcept -> std::pair<size_t, size_type> {
+
+	size_t pos       = 0;
+	size_type before = 0;
+
+	for (size_t step = topBit_; step != 0; step >>= 1) {
+		const size_t next = pos + step;
+		if (next < tree.size() && before + tree[next] <= value) {
+			pos = next;
+			before += tree[next];
+		}
+	}
+
+	if (pos >= blocks.size()) {
+		pos = blocks.size() - 1;
+		before -= blocks[pos];
+	}
+
+	return {pos, before};
+}
+
+/*
+** Returns the sum of the first "block" entries stored in "tree"
+*/
+template <class Ch, class Tr>
+auto line_index<Ch, Tr>::prefix(const std::vector<size_type> &tree, size_t block) const noexcept -> size_type {
+	size_type sum = 0;
+	for (size_t i = block; i != 0; i &= (i - 1)) {
+		sum += tree[i];
+	}
+	return sum;
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+void line_index<Ch, Tr>::add(std::vector<size_type> &tree, size_t block, size_type delta) noexcept {
+	for (size_t i = block + 1; i < tree.size(); i += (i & (~i + 1))) {
+		tree[i] += delta;
+	}
+}
+
+/*
+** Build both Fenwick trees from the per-block counts in linear time
+*/
+template <class Ch, class Tr>
+void line_index<Ch, Tr>::rebuild_trees() {
+
+	const size_t nBlocks = blockLengths_.size();
+
+	lengthTree_.assign(nBlocks + 1, 0);
+	newlineTree_.assign(nBlocks + 1, 0);
+
+	for (size_t i = 1; i <= nBlocks; ++i) {
+		lengthTree_[i] += blockLengths_[i - 1];
+		newlineTree_[i] += blockNewlines_[i - 1];
+
+		const size_t parent = i + (i & (~i + 1));
+		if (parent <= nBlocks) {
+			lengthTree_[parent] += lengthTree_[i];
+			newlineTree_[parent] += newlineTree_[i];
+		}
+	}
+
+	topBit_ = 1;
+	while (topBit_ * 2 <= nBlocks) {
+		topBit_ *= 2;
+	}
+}
+
+/*
+** Break an oversized block into pieces of "BlockSize" characters. This is the
+** only place (besides "assign") where the text itself has to be rescanned,
+** and only the text of the block being split is looked at.
+*/
+template <class Ch, class Tr>
+template <class Buffer>
+void line_index<Ch, Tr>::split(const Buffer &buffer, size_t block, size_type blockStart) {
+
+	const size_type length = blockLengths_[block];
+	const auto nPieces     = static_cast<size_t>((length + BlockSize - 1) / BlockSize);
+
+	std::vector<size_type> lengths(nPieces);
+	std::vector<size_type> newlines(nPieces);
+
+	for (size_t i = 0; i < nPieces; ++i) {
+		const size_type first = blockStart + static_cast<size_type>(i) * BlockSize;
+		const size_type last  = std::min(first + BlockSize, blockStart + length);
+		lengths[i]            = last - first;
+		newlines[i]           = count_newlines(buffer, first, last);
+	}
+
+	blockLengths_.erase(blockLengths_.begin() + static_cast<ptrdiff_t>(block));
+	blockNewlines_.erase(blockNewlines_.begin() + static_cast<ptrdiff_t>(block));
+	blockLengths_.insert(blockLengths_.begin() + static_cast<ptrdiff_t>(block), lengths.begin(), lengths.end());
+	blockNewlines_.insert(blockNewlines_.begin() + static_cast<ptrdiff_t>(block), newlines.begin(), newlines.end());
+
+	rebuild_trees();
+}
+
+/*
+** Merge runs of adjacent blocks which together fit in "BlockSize" characters.
+** Since the counts of a merged block are just the sums of its parts, this
+** doesn't require looking at the text.
+*/
+template <class Ch, class Tr>
+void line_index<Ch, Tr>::compact() {
+
+	size_t out = 0;
+	for (size_t i = 1; i < blockLengths_.size(); ++i) {
+		if (blockLengths_[out] + blockLengths_[i] <= BlockSize) {
+			blockLengths_[out] += blockLengths_[i];
+			blockNewlines_[out] += blockNewlines_[i];
+		} else {
+			++out;
+			blockLengths_[out]  = blockLengths_[i];
+			blockNewlines_[out] = blockNewlines_[i];
+		}
+	}
+
+	blockLengths_.resize(out + 1);
+	blockNewlines_.resize(out + 1);
+
+	rebuild_trees();
+}
+
+#endif
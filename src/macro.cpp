@@ -582,6 +582,21 @@ boost::optional<bool> toggle_or_bool(Arguments arguments, bool previous, std::er
 	}
 }
 
+/*
+** Runs a built-in which relies on the state of the text areas, or which may
+** let the event loop run, with the batches macros have open ended for the
+** time being. The text areas don't see the changes made in a batch until it
+** ends, so they would otherwise be out of date.
+*/
+template <LibraryRoutine Routine>
+std::error_code unbatched(DocumentWidget *document, Arguments arguments, DataValue *result) {
+
+	DocumentWidget::suspendMacroBatches();
+	auto _ = gsl::finally([] { DocumentWidget::resumeMacroBatches(); });
+
+	return Routine(document, arguments, result);
+}
+
 template <void (DocumentWidget::*Set)(bool), bool (DocumentWidget::*Get)() const>
 std::error_code menuToggleEvent(DocumentWidget *document, Arguments arguments, DataValue *result) {
 	document = MacroRunDocument();
@@ -1022,6 +1037,48 @@ std::error_code findSelectionMS(DocumentWidget *document, Arguments arguments, D
 	return MacroErrorCode::Success;
 }
 
+std::error_code findAllMS(DocumentWidget *document, Arguments arguments, DataValue *result) {
+
+	// find_all( search-string [, search-type] )
+
+	// ensure that we are dealing with the document which currently has the focus
+	document = MacroRunDocument();
+
+	if (arguments.size() > 2 || arguments.empty()) {
+		return MacroErrorCode::WrongNumberOfArguments;
+	}
+
+	QString string;
+	if (std::error_code ec = readArguments(arguments, 0, &string)) {
+		return ec;
+	}
+
+	SearchType type = searchType(arguments, 1);
+
+	if (auto window = MainWindow::fromDocument(document)) {
+		window->action_Find_All(document, string, type);
+	}
+
+	*result = make_value();
+	return MacroErrorCode::Success;
+}
+
+std::error_code findAllNextMS(DocumentWidget *document, Arguments arguments, DataValue *result) {
+
+	// ensure that we are dealing with the document which currently has the focus
+	document = MacroRunDocument();
+
+	Direction direction = searchDirection(arguments, 0);
+	WrapMode wrap       = searchWrap(arguments, 0);
+
+	if (auto window = MainWindow::fromDocument(document)) {
+		window->action_Find_All_Next(document, direction, wrap);
+	}
+
+	*result = make_value();
+	return MacroErrorCode::Success;
+}
+
 std::error_code replaceMS(DocumentWidget *document, Arguments arguments, DataValue *result) {
 
 	// ensure that we are dealing with the document which currently has the focus
@@ -1597,6 +1654,40 @@ std::error_code replaceRangeMS(DocumentWidget *document, Arguments arguments, Da
 	return MacroErrorCode::Success;
 }
 
+/*
+** Built-in macro subroutines for grouping edits to the current window's text
+** buffer, so that a long run of replace_range calls is redisplayed and
+** re-highlighted once, when the batch ends. Batches nest, and any left open
+** are ended when the macro finishes. They are also suspended whenever the
+** macro yields to the event loop or uses something which relies on the text
+** areas being up to date (see unbatched).
+*/
+std::error_code beginBatchMS(DocumentWidget *document, Arguments arguments, DataValue *result) {
+
+	document = MacroFocusDocument();
+
+	if (!arguments.empty()) {
+		return MacroErrorCode::WrongNumberOfArguments;
+	}
+
+	document->beginMacroBatch();
+	*result = make_value();
+	return MacroErrorCode::Success;
+}
+
+std::error_code endBatchMS(DocumentWidget *document, Arguments arguments, DataValue *result) {
+
+	document = MacroFocusDocument();
+
+	if (!arguments.empty()) {
+		return MacroErrorCode::WrongNumberOfArguments;
+	}
+
+	document->endMacroBatch();
+	*result = make_value();
+	return MacroErrorCode::Success;
+}
+
 /*
 ** Built-in macro subroutine for replacing the primary-selection selected
 ** text in the current window's text buffer
@@ -1905,43 +1996,31 @@ std::error_code appendFileMS(DocumentWidget *document, Arguments arguments, Data
 }
 
 /*
-** Built-in macro subroutine for searching a string.  Arguments are $1:
-** string to search in, $2: string to search for, $3: starting position.
-** Optional arguments may include the strings: "wrap" to make the search
-** wrap around the beginning or end of the string, "backward" or "forward"
-** to change the search direction ("forward" is the default), "literal",
-** "case" or "regex" to change the search type (default is "literal").
-**
-** Returns the starting position of the match, or -1 if nothing matched.
-** also returns the ending position of the match in $searchEndPos
+** Common part of the search() and search_string() macro subroutines.
+** "arguments" starts with the string to search for, and "text" is what to
+** search in, either a string or a document's text buffer, "length" long.
 */
-std::error_code searchStringMS(DocumentWidget *document, Arguments arguments, DataValue *result) {
+template <class Text>
+std::error_code searchTextMS(DocumentWidget *document, Text text, int64_t length, Arguments arguments, DataValue *result) {
 
 	int64_t beginPos = 0;
 	WrapMode wrap;
 	SearchType type;
 	QString searchStr;
 	Direction direction;
-	std::string string;
 
 	bool found      = false;
 	bool skipSearch = false;
 
-	// Validate arguments and convert to proper types
-	if (arguments.size() < 3) {
-		return MacroErrorCode::TooFewArguments;
-	}
-
-	if (std::error_code ec = readArguments(arguments, 0, &string, &searchStr, &beginPos)) {
+	if (std::error_code ec = readArguments(arguments, 0, &searchStr, &beginPos)) {
 		return ec;
 	}
 
-	if (std::error_code ec = readSearchArgs(arguments.subspan(3), &direction, &type, &wrap)) {
+	if (std::error_code ec = readSearchArgs(arguments.subspan(2), &direction, &type, &wrap)) {
 		return ec;
 	}
 
-	auto len = static_cast<int64_t>(to_string(arguments[0]).size());
-	if (beginPos > len) {
+	if (beginPos > length) {
 		if (direction == Direction::Forward) {
 			if (wrap == WrapMode::Wrap) {
 				beginPos = 0; // Wrap immediately
@@ -1950,12 +2029,12 @@ std::error_code searchStringMS(DocumentWidget *document, Arguments arguments, Da
 				skipSearch = true;
 			}
 		} else {
-			beginPos = len;
+			beginPos = length;
 		}
 	} else if (beginPos < 0) {
 		if (direction == Direction::Backward) {
 			if (wrap == WrapMode::Wrap) {
-				beginPos = len; // Wrap immediately
+				beginPos = length; // Wrap immediately
 			} else {
 				found      = false;
 				skipSearch = true;
@@ -1969,7 +2048,7 @@ std::error_code searchStringMS(DocumentWidget *document, Arguments arguments, Da
 
 	if (!skipSearch) {
 		found = Search::SearchString(
-			string,
+			text,
 			searchStr,
 			direction,
 			type,
@@ -1985,6 +2064,38 @@ std::error_code searchStringMS(DocumentWidget *document, Arguments arguments, Da
 	return MacroErrorCode::Success;
 }
 
+/*
+** Built-in macro subroutine for searching a string.  Arguments are $1:
+** string to search in, $2: string to search for, $3: starting position.
+** Optional arguments may include the strings: "wrap" to make the search
+** wrap around the beginning or end of the string, "backward" or "forward"
+** to change the search direction ("forward" is the default), "literal",
+** "case" or "regex" to change the search type (default is "literal").
+**
+** Returns the starting position of the match, or -1 if nothing matched.
+** also returns the ending position of the match in $searchEndPos
+*/
+std::error_code searchStringMS(DocumentWidget *document, Arguments arguments, DataValue *result) {
+
+	std::string string;
+
+	// Validate arguments and convert to proper types
+	if (arguments.size() < 3) {
+		return MacroErrorCode::TooFewArguments;
+	}
+
+	if (std::error_code ec = readArgument(arguments[0], &string)) {
+		return ec;
+	}
+
+	return searchTextMS<view::string_view>(
+		document,
+		string,
+		static_cast<int64_t>(string.size()),
+		arguments.subspan(1),
+		result);
+}
+
 /*
 ** Built-in macro subroutine for searching silently in a window without
 ** dialogs, beeps, or changes to the selection.  Arguments are: $1: string to
@@ -1998,26 +2109,23 @@ std::error_code searchStringMS(DocumentWidget *document, Arguments arguments, Da
 ** also returns the ending position of the match in $searchEndPos
 */
 std::error_code searchMS(DocumentWidget *document, Arguments arguments, DataValue *result) {
-	DataValue newArgList[9];
 
-	/* Use the search string routine, by adding the buffer contents as the
-	 * string argument */
-	if (arguments.size() > 8)
+	if (arguments.size() > 8) {
 		return MacroErrorCode::WrongNumberOfArguments;
+	}
 
-	// NOTE(eteran): the original version of this code was copy-free
-	// in the interest of making the macro code simpler
-	// we just make a copy here. If we duplicate the code in searchStringMS
-	// here and thus don't have to pass things in a DataValue, we can once again
-	// make it copy free
-	newArgList[0] = make_value(document->buffer()->BufAsString());
+	if (arguments.size() < 2) {
+		return MacroErrorCode::TooFewArguments;
+	}
 
-	// copy other arguments to the new argument list
-	std::copy(arguments.begin(), arguments.end(), &newArgList[1]);
+	// search the document's buffer in place, rather than a copy of its text
+	TextBuffer *buffer = document->buffer();
 
-	return searchStringMS(
+	return searchTextMS(
 		document,
-		Arguments(newArgList, arguments.size() + 1),
+		buffer,
+		buffer->length(),
+		arguments,
 		result);
 }
 
@@ -4439,53 +4547,53 @@ std::error_code getPatternAtPosMS(DocumentWidget *document, Arguments arguments,
 
 const SubRoutine TextAreaSubrNames[] = {
 	// Keyboard
-	{"backward_character", textEvent<&TextArea::backwardCharacter>},
-	{"backward_paragraph", textEvent<&TextArea::backwardParagraphAP>},
-	{"backward_word", textEvent<&TextArea::backwardWordAP>},
-	{"beginning_of_file", textEvent<&TextArea::beginningOfFileAP>},
-	{"beginning_of_line", textEvent<&TextArea::beginningOfLine>},
-	{"beginning_of_selection", textEvent<&TextArea::beginningOfSelectionAP>},
-	{"copy_clipboard", textEvent<&TextArea::copyClipboard>},
-	{"copy_primary", textEvent<&TextArea::copyPrimaryAP>},
-	{"cut_clipboard", textEvent<&TextArea::cutClipboard>},
-	{"cut_primary", textEvent<&TextArea::cutPrimaryAP>},
-	{"delete_selection", textEvent<&TextArea::deleteSelectionAP>},
-	{"delete_next_character", textEvent<&TextArea::deleteNextCharacter>},
-	{"delete_previous_character", textEvent<&TextArea::deletePreviousCharacter>},
-	{"delete_next_word", textEvent<&TextArea::deleteNextWordAP>},
-	{"delete_previous_word", textEvent<&TextArea::deletePreviousWord>},
-	{"delete_to_start_of_line", textEvent<&TextArea::deleteToStartOfLineAP>},
-	{"delete_to_end_of_line", textEvent<&TextArea::deleteToEndOfLineAP>},
-	{"deselect_all", textEvent<&TextArea::deselectAllAP>},
-	{"end_of_file", textEvent<&TextArea::endOfFileAP>},
-	{"end_of_line", textEvent<&TextArea::endOfLine>},
-	{"end_of_selection", textEvent<&TextArea::endOfSelectionAP>},
-	{"forward_character", textEvent<&TextArea::forwardCharacter>},
-	{"forward_paragraph", textEvent<&TextArea::forwardParagraphAP>},
-	{"forward_word", textEvent<&TextArea::forwardWordAP>},
-	{"insert_string", textEventArg<const QString &, &TextArea::insertStringAP>},
-	{"key_select", textEvent<&TextArea::keySelectAP>},
-	{"newline", textEvent<&TextArea::newline>},
-	{"newline_and_indent", textEvent<&TextArea::newlineAndIndentAP>},
-	{"newline_no_indent", textEvent<&TextArea::newlineNoIndentAP>},
-	{"next_page", textEvent<&TextArea::nextPageAP>},
-	{"page_left", textEvent<&TextArea::pageLeftAP>},
-	{"page_right", textEvent<&TextArea::pageRightAP>},
-	{"paste_clipboard", textEvent<&TextArea::pasteClipboard>},
-	{"previous_page", textEvent<&TextArea::previousPageAP>},
-	{"process_cancel", textEvent<&TextArea::processCancel>},
-	{"process_down", textEvent<&TextArea::processDown>},
-	{"process_return", textEvent<&TextArea::newline>},
-	{"process_shift_down", textEvent<&TextArea::processShiftDownAP>},
-	{"process_shift_up", textEvent<&TextArea::processShiftUpAP>},
-	{"process_tab", textEvent<&TextArea::processTabAP>},
-	{"process_up", textEvent<&TextArea::processUp>},
-	{"scroll_down", scrollDownMS},
-	{"scroll_left", textEventArg<int, &TextArea::scrollLeftAP>},
-	{"scroll_right", textEventArg<int, &TextArea::scrollRightAP>},
-	{"scroll_up", scrollUpMS},
-	{"scroll_to_line", textEventArg<int, &TextArea::scrollToLineAP>},
-	{"self_insert", textEventArg<const QString &, &TextArea::insertStringAP>},
+	{"backward_character", unbatched<textEvent<&TextArea::backwardCharacter>>},
+	{"backward_paragraph", unbatched<textEvent<&TextArea::backwardParagraphAP>>},
+	{"backward_word", unbatched<textEvent<&TextArea::backwardWordAP>>},
+	{"beginning_of_file", unbatched<textEvent<&TextArea::beginningOfFileAP>>},
+	{"beginning_of_line", unbatched<textEvent<&TextArea::beginningOfLine>>},
+	{"beginning_of_selection", unbatched<textEvent<&TextArea::beginningOfSelectionAP>>},
+	{"copy_clipboard", unbatched<textEvent<&TextArea::copyClipboard>>},
+	{"copy_primary", unbatched<textEvent<&TextArea::copyPrimaryAP>>},
+	{"cut_clipboard", unbatched<textEvent<&TextArea::cutClipboard>>},
+	{"cut_primary", unbatched<textEvent<&TextArea::cutPrimaryAP>>},
+	{"delete_selection", unbatched<textEvent<&TextArea::deleteSelectionAP>>},
+	{"delete_next_character", unbatched<textEvent<&TextArea::deleteNextCharacter>>},
+	{"delete_previous_character", unbatched<textEvent<&TextArea::deletePreviousCharacter>>},
+	{"delete_next_word", unbatched<textEvent<&TextArea::deleteNextWordAP>>},
+	{"delete_previous_word", unbatched<textEvent<&TextArea::deletePreviousWord>>},
+	{"delete_to_start_of_line", unbatched<textEvent<&TextArea::deleteToStartOfLineAP>>},
+	{"delete_to_end_of_line", unbatched<textEvent<&TextArea::deleteToEndOfLineAP>>},
+	{"deselect_all", unbatched<textEvent<&TextArea::deselectAllAP>>},
+	{"end_of_file", unbatched<textEvent<&TextArea::endOfFileAP>>},
+	{"end_of_line", unbatched<textEvent<&TextArea::endOfLine>>},
+	{"end_of_selection", unbatched<textEvent<&TextArea::endOfSelectionAP>>},
+	{"forward_character", unbatched<textEvent<&TextArea::forwardCharacter>>},
+	{"forward_paragraph", unbatched<textEvent<&TextArea::forwardParagraphAP>>},
+	{"forward_word", unbatched<textEvent<&TextArea::forwardWordAP>>},
+	{"insert_string", unbatched<textEventArg<const QString &, &TextArea::insertStringAP>>},
+	{"key_select", unbatched<textEvent<&TextArea::keySelectAP>>},
+	{"newline", unbatched<textEvent<&TextArea::newline>>},
+	{"newline_and_indent", unbatched<textEvent<&TextArea::newlineAndIndentAP>>},
+	{"newline_no_indent", unbatched<textEvent<&TextArea::newlineNoIndentAP>>},
+	{"next_page", unbatched<textEvent<&TextArea::nextPageAP>>},
+	{"page_left", unbatched<textEvent<&TextArea::pageLeftAP>>},
+	{"page_right", unbatched<textEvent<&TextArea::pageRightAP>>},
+	{"paste_clipboard", unbatched<textEvent<&TextArea::pasteClipboard>>},
+	{"previous_page", unbatched<textEvent<&TextArea::previousPageAP>>},
+	{"process_cancel", unbatched<textEvent<&TextArea::processCancel>>},
+	{"process_down", unbatched<textEvent<&TextArea::processDown>>},
+	{"process_return", unbatched<textEvent<&TextArea::newline>>},
+	{"process_shift_down", unbatched<textEvent<&TextArea::processShiftDownAP>>},
+	{"process_shift_up", unbatched<textEvent<&TextArea::processShiftUpAP>>},
+	{"process_tab", unbatched<textEvent<&TextArea::processTabAP>>},
+	{"process_up", unbatched<textEvent<&TextArea::processUp>>},
+	{"scroll_down", unbatched<scrollDownMS>},
+	{"scroll_left", unbatched<textEventArg<int, &TextArea::scrollLeftAP>>},
+	{"scroll_right", unbatched<textEventArg<int, &TextArea::scrollRightAP>>},
+	{"scroll_up", unbatched<scrollUpMS>},
+	{"scroll_to_line", unbatched<textEventArg<int, &TextArea::scrollToLineAP>>},
+	{"self_insert", unbatched<textEventArg<const QString &, &TextArea::insertStringAP>>},
 
 #if 0 // NOTE(eteran): do these make sense to support
 	{"focus_pane",                nullptr}, // NOTE(eteran): was from MainWindow in my code...
@@ -4520,102 +4628,105 @@ const SubRoutine TextAreaSubrNames[] = {
 
 const SubRoutine MenuMacroSubrNames[] = {
 	// File
-	{"new", newMS},
-	{"new_opposite", newOppositeMS},
-	{"open", menuEventSU<&MainWindow::action_Open>},
-	{"open_dialog", menuEventU<&MainWindow::action_Open>},
-	{"open_selected", menuEventU<&MainWindow::action_Open_Selected>},
-	{"close", closeMS},
-	{"save", menuEventU<&MainWindow::action_Save>},
-	{"save_as", saveAsMS},
-	{"save_as_dialog", menuEventU<&MainWindow::action_Save_As>},
-	{"revert_to_saved_dialog", menuEventU<&MainWindow::action_Revert_to_Saved>},
-	{"revert_to_saved", menuEventU<&MainWindow::action_Revert_to_Saved>},
-	{"include_file", menuEventSU<&MainWindow::action_Include_File>},
-	{"include_file_dialog", menuEventU<&MainWindow::action_Include_File>},
-	{"load_macro_file", menuEventSU<&MainWindow::action_Load_Macro_File>},
-	{"load_macro_file_dialog", menuEventU<&MainWindow::action_Load_Macro_File>},
-	{"load_tags_file", menuEventSU<&MainWindow::action_Load_Tags_File>},
-	{"load_tags_file_dialog", menuEventU<&MainWindow::action_Load_Tags_File>},
-	{"unload_tags_file", menuEventSU<&MainWindow::action_Unload_Tags_File>},
-	{"load_tips_file", menuEventSU<&MainWindow::action_Load_Tips_File>},
-	{"load_tips_file_dialog", menuEventU<&MainWindow::action_Load_Calltips_File>},
-	{"unload_tips_file", menuEventSU<&MainWindow::action_Unload_Tips_File>},
-	{"print", menuEventU<&MainWindow::action_Print>},
-	{"print_selection", menuEventU<&MainWindow::action_Print_Selection>},
-	{"exit", menuEventU<&MainWindow::action_Exit>},
+	{"new", unbatched<newMS>},
+	{"new_opposite", unbatched<newOppositeMS>},
+	{"open", unbatched<menuEventSU<&MainWindow::action_Open>>},
+	{"open_dialog", unbatched<menuEventU<&MainWindow::action_Open>>},
+	{"open_selected", unbatched<menuEventU<&MainWindow::action_Open_Selected>>},
+	{"close", unbatched<closeMS>},
+	{"save", unbatched<menuEventU<&MainWindow::action_Save>>},
+	{"save_as", unbatched<saveAsMS>},
+	{"save_as_dialog", unbatched<menuEventU<&MainWindow::action_Save_As>>},
+	{"revert_to_saved_dialog", unbatched<menuEventU<&MainWindow::action_Revert_to_Saved>>},
+	{"revert_to_saved", unbatched<menuEventU<&MainWindow::action_Revert_to_Saved>>},
+	{"include_file", unbatched<menuEventSU<&MainWindow::action_Include_File>>},
+	{"include_file_dialog", unbatched<menuEventU<&MainWindow::action_Include_File>>},
+	{"load_macro_file", unbatched<menuEventSU<&MainWindow::action_Load_Macro_File>>},
+	{"load_macro_file_dialog", unbatched<menuEventU<&MainWindow::action_Load_Macro_File>>},
+	{"load_tags_file", unbatched<menuEventSU<&MainWindow::action_Load_Tags_File>>},
+	{"load_tags_file_dialog", unbatched<menuEventU<&MainWindow::action_Load_Tags_File>>},
+	{"unload_tags_file", unbatched<menuEventSU<&MainWindow::action_Unload_Tags_File>>},
+	{"load_tips_file", unbatched<menuEventSU<&MainWindow::action_Load_Tips_File>>},
+	{"load_tips_file_dialog", unbatched<menuEventU<&MainWindow::action_Load_Calltips_File>>},
+	{"unload_tips_file", unbatched<menuEventSU<&MainWindow::action_Unload_Tips_File>>},
+	{"print", unbatched<menuEventU<&MainWindow::action_Print>>},
+	{"print_selection", unbatched<menuEventU<&MainWindow::action_Print_Selection>>},
+	{"exit", unbatched<menuEventU<&MainWindow::action_Exit>>},
 
 	// Edit
-	{"undo", menuEventU<&MainWindow::action_Undo>},
-	{"redo", menuEventU<&MainWindow::action_Redo>},
-	{"delete", menuEventU<&MainWindow::action_Delete>},
-	{"select_all", menuEventU<&MainWindow::action_Select_All>},
-	{"shift_left", menuEventU<&MainWindow::action_Shift_Left>},
-	{"shift_left_by_tab", menuEventU<&MainWindow::action_Shift_Left_Tabs>},
-	{"shift_right", menuEventU<&MainWindow::action_Shift_Right>},
-	{"shift_right_by_tab", menuEventU<&MainWindow::action_Shift_Right_Tabs>},
-	{"uppercase", menuEventU<&MainWindow::action_Upper_case>},
-	{"lowercase", menuEventU<&MainWindow::action_Lower_case>},
-	{"fill_paragraph", menuEventU<&MainWindow::action_Fill_Paragraph>},
-	{"control_code_dialog", menuEventU<&MainWindow::action_Insert_Ctrl_Code>},
+	{"undo", unbatched<menuEventU<&MainWindow::action_Undo>>},
+	{"redo", unbatched<menuEventU<&MainWindow::action_Redo>>},
+	{"delete", unbatched<menuEventU<&MainWindow::action_Delete>>},
+	{"select_all", unbatched<menuEventU<&MainWindow::action_Select_All>>},
+	{"shift_left", unbatched<menuEventU<&MainWindow::action_Shift_Left>>},
+	{"shift_left_by_tab", unbatched<menuEventU<&MainWindow::action_Shift_Left_Tabs>>},
+	{"shift_right", unbatched<menuEventU<&MainWindow::action_Shift_Right>>},
+	{"shift_right_by_tab", unbatched<menuEventU<&MainWindow::action_Shift_Right_Tabs>>},
+	{"uppercase", unbatched<menuEventU<&MainWindow::action_Upper_case>>},
+	{"lowercase", unbatched<menuEventU<&MainWindow::action_Lower_case>>},
+	{"fill_paragraph", unbatched<menuEventU<&MainWindow::action_Fill_Paragraph>>},
+	{"control_code_dialog", unbatched<menuEventU<&MainWindow::action_Insert_Ctrl_Code>>},
 
 	// Search
-	{"find", findMS},
-	{"find_dialog", findDialogMS},
-	{"find_again", findAgainMS},
-	{"find_selection", findSelectionMS},
-	{"replace", replaceMS},
-	{"replace_dialog", replaceDialogMS},
-	{"replace_all", replaceAllMS},
-	{"replace_in_selection", replaceAllInSelectionMS},
-	{"replace_again", replaceAgainMS},
-	{"goto_line_number", menuEventSU<&MainWindow::action_Goto_Line_Number>},
-	{"goto_line_number_dialog", menuEventU<&MainWindow::action_Goto_Line_Number>},
-	{"goto_selected", menuEventU<&MainWindow::action_Goto_Selected>},
-	{"mark", menuEventSU<&MainWindow::action_Mark>},
-	{"mark_dialog", menuEventU<&MainWindow::action_Mark>},
-	{"goto_mark", gotoMarkMS},
-	{"goto_mark_dialog", gotoMarkDialogMS},
-	{"goto_matching", menuEventU<&MainWindow::action_Goto_Matching>},
-	{"select_to_matching", menuEventU<&MainWindow::action_Shift_Goto_Matching>},
-	{"find_definition", findDefinitionMS},
-	{"show_tip", menuEventU<&MainWindow::action_Show_Calltip>},
+	{"find", unbatched<findMS>},
+	{"find_dialog", unbatched<findDialogMS>},
+	{"find_again", unbatched<findAgainMS>},
+	{"find_selection", unbatched<findSelectionMS>},
+	{"find_all", unbatched<findAllMS>},
+	{"find_all_next", unbatched<findAllNextMS>},
+	{"find_all_clear", unbatched<menuEventU<&MainWindow::action_Find_All_Clear>>},
+	{"replace", unbatched<replaceMS>},
+	{"replace_dialog", unbatched<replaceDialogMS>},
+	{"replace_all", unbatched<replaceAllMS>},
+	{"replace_in_selection", unbatched<replaceAllInSelectionMS>},
+	{"replace_again", unbatched<replaceAgainMS>},
+	{"goto_line_number", unbatched<menuEventSU<&MainWindow::action_Goto_Line_Number>>},
+	{"goto_line_number_dialog", unbatched<menuEventU<&MainWindow::action_Goto_Line_Number>>},
+	{"goto_selected", unbatched<menuEventU<&MainWindow::action_Goto_Selected>>},
+	{"mark", unbatched<menuEventSU<&MainWindow::action_Mark>>},
+	{"mark_dialog", unbatched<menuEventU<&MainWindow::action_Mark>>},
+	{"goto_mark", unbatched<gotoMarkMS>},
+	{"goto_mark_dialog", unbatched<gotoMarkDialogMS>},
+	{"goto_matching", unbatched<menuEventU<&MainWindow::action_Goto_Matching>>},
+	{"select_to_matching", unbatched<menuEventU<&MainWindow::action_Shift_Goto_Matching>>},
+	{"find_definition", unbatched<findDefinitionMS>},
+	{"show_tip", unbatched<menuEventU<&MainWindow::action_Show_Calltip>>},
 
 	// Shell
-	{"filter_selection_dialog", menuEventM<&MainWindow::action_Filter_Selection>},
-	{"filter_selection", menuEventSM<&MainWindow::action_Filter_Selection>},
-	{"execute_command", menuEventSU<&MainWindow::action_Execute_Command>},
-	{"execute_command_dialog", menuEventU<&MainWindow::action_Execute_Command>},
-	{"execute_command_line", menuEventU<&MainWindow::action_Execute_Command_Line>},
-	{"shell_menu_command", menuEventSU<&MainWindow::action_Shell_Menu_Command>},
+	{"filter_selection_dialog", unbatched<menuEventM<&MainWindow::action_Filter_Selection>>},
+	{"filter_selection", unbatched<menuEventSM<&MainWindow::action_Filter_Selection>>},
+	{"execute_command", unbatched<menuEventSU<&MainWindow::action_Execute_Command>>},
+	{"execute_command_dialog", unbatched<menuEventU<&MainWindow::action_Execute_Command>>},
+	{"execute_command_line", unbatched<menuEventU<&MainWindow::action_Execute_Command_Line>>},
+	{"shell_menu_command", unbatched<menuEventSU<&MainWindow::action_Shell_Menu_Command>>},
 
 	// Macro
-	{"macro_menu_command", menuEventSU<&MainWindow::action_Macro_Menu_Command>},
-	{"repeat_macro", repeatMacroMS},
-	{"repeat_dialog", menuEventU<&MainWindow::action_Repeat>},
+	{"macro_menu_command", unbatched<menuEventSU<&MainWindow::action_Macro_Menu_Command>>},
+	{"repeat_macro", unbatched<repeatMacroMS>},
+	{"repeat_dialog", unbatched<menuEventU<&MainWindow::action_Repeat>>},
 
 	// Windows
-	{"split_pane", menuEventU<&MainWindow::action_Split_Pane>},
-	{"close_pane", menuEventU<&MainWindow::action_Close_Pane>},
-	{"detach_document", menuEventU<&MainWindow::action_Detach_Document>},
-	{"detach_document_dialog", detachDocumentDialogMS},
-	{"move_document_dialog", menuEventU<&MainWindow::action_Move_Tab_To>},
+	{"split_pane", unbatched<menuEventU<&MainWindow::action_Split_Pane>>},
+	{"close_pane", unbatched<menuEventU<&MainWindow::action_Close_Pane>>},
+	{"detach_document", unbatched<menuEventU<&MainWindow::action_Detach_Document>>},
+	{"detach_document_dialog", unbatched<detachDocumentDialogMS>},
+	{"move_document_dialog", unbatched<menuEventU<&MainWindow::action_Move_Tab_To>>},
 
 	// Preferences
-	{"set_language_mode", setLanguageModeMS},
-	{"set_locked", menuToggleEvent<&DocumentWidget::setUserLocked, &DocumentWidget::userLocked>},
-	{"set_overtype_mode", menuToggleEvent<&DocumentWidget::setOverstrike, &DocumentWidget::overstrike>},
+	{"set_language_mode", unbatched<setLanguageModeMS>},
+	{"set_locked", unbatched<menuToggleEvent<&DocumentWidget::setUserLocked, &DocumentWidget::userLocked>>},
+	{"set_overtype_mode", unbatched<menuToggleEvent<&DocumentWidget::setOverstrike, &DocumentWidget::overstrike>>},
 
 	// These aren't mentioned in the documentation...
-	{"find_incremental", findIncrMS},
-	{"start_incremental_find", startIncrFindMS},
-	{"replace_find", replaceFindMS},
-	{"replace_find_same", replaceFindSameMS},
-	{"replace_find_again", replaceFindSameMS},
-	{"next_document", menuEvent<&MainWindow::action_Next_Document>},
-	{"previous_document", menuEvent<&MainWindow::action_Prev_Document>},
-	{"last_document", menuEvent<&MainWindow::action_Last_Document>},
-	{"bg_menu_command", backgroundMenuCommandMS},
+	{"find_incremental", unbatched<findIncrMS>},
+	{"start_incremental_find", unbatched<startIncrFindMS>},
+	{"replace_find", unbatched<replaceFindMS>},
+	{"replace_find_same", unbatched<replaceFindSameMS>},
+	{"replace_find_again", unbatched<replaceFindSameMS>},
+	{"next_document", unbatched<menuEvent<&MainWindow::action_Next_Document>>},
+	{"previous_document", unbatched<menuEvent<&MainWindow::action_Prev_Document>>},
+	{"last_document", unbatched<menuEvent<&MainWindow::action_Last_Document>>},
+	{"bg_menu_command", unbatched<backgroundMenuCommandMS>},
 #if 0 // NOTE(eteran): what are these for? are they needed?
 	{ "post_window_bg_menu",          nullptr },
 	{ "post_tab_context_menu",        nullptr },
@@ -4632,7 +4743,9 @@ const SubRoutine MacroSubrs[] = {
 	{"string_dialog", stringDialogMS},
 	{"replace_range", replaceRangeMS},
 	{"replace_selection", replaceSelectionMS},
-	{"set_cursor_pos", setCursorPosMS},
+	{"begin_batch", beginBatchMS},
+	{"end_batch", endBatchMS},
+	{"set_cursor_pos", unbatched<setCursorPosMS>},
 	{"get_character", getCharacterMS},
 	{"min", minMS},
 	{"max", maxMS},
@@ -4659,8 +4772,8 @@ const SubRoutine MacroSubrs[] = {
 	{"getenv", getenvMS},
 	{"string_compare", stringCompareMS},
 	{"split", splitMS},
-	{"calltip", calltipMS},
-	{"kill_calltip", killCalltipMS},
+	{"calltip", unbatched<calltipMS>},
+	{"kill_calltip", unbatched<killCalltipMS>},
 #if defined(ENABLE_BACKLIGHT_STRING)
 	{"set_backlight_string", setBacklightStringMS},
 #endif
@@ -4671,7 +4784,7 @@ const SubRoutine MacroSubrs[] = {
 	{"rangeset_invert", rangesetInvertMS},
 	{"rangeset_info", rangesetInfoMS},
 	{"rangeset_range", rangesetRangeMS},
-	{"rangeset_includes", rangesetIncludesPosMS},
+	{"rangeset_includes", unbatched<rangesetIncludesPosMS>},
 	{"rangeset_set_color", rangesetSetColorMS},
 	{"rangeset_set_name", rangesetSetNameMS},
 	{"rangeset_set_mode", rangesetSetModeMS},
@@ -4680,13 +4793,13 @@ const SubRoutine MacroSubrs[] = {
 	{"get_pattern_at_pos", getPatternAtPosMS},
 	{"get_style_by_name", getStyleByNameMS},
 	{"get_style_at_pos", getStyleAtPosMS},
-	{"filename_dialog", filenameDialogMS},
+	{"filename_dialog", unbatched<filenameDialogMS>},
 };
 
 const SubRoutine SpecialVars[] = {
-	{"$cursor", cursorMV},
-	{"$line", lineMV},
-	{"$column", columnMV},
+	{"$cursor", unbatched<cursorMV>},
+	{"$line", unbatched<lineMV>},
+	{"$column", unbatched<columnMV>},
 	{"$file_name", fileNameMV},
 	{"$file_path", filePathMV},
 	{"$text_length", lengthMV},
@@ -4721,9 +4834,9 @@ const SubRoutine SpecialVars[] = {
 	{"$sub_sep", subscriptSepMV},
 	{"$min_font_width", minFontWidthMV},
 	{"$max_font_width", maxFontWidthMV},
-	{"$top_line", topLineMV},
-	{"$n_display_lines", numDisplayLinesMV},
-	{"$display_width", displayWidthMV},
+	{"$top_line", unbatched<topLineMV>},
+	{"$n_display_lines", unbatched<numDisplayLinesMV>},
+	{"$display_width", unbatched<displayWidthMV>},
 	{"$active_pane", activePaneMV},
 	{"$n_panes", nPanesMV},
 	{"$empty_array", emptyArrayMV},
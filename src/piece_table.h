@@ -0,0 +1,775 @@
+
+#ifndef PIECE_TABLE_H_
+#define PIECE_TABLE_H_
+
+#include "Util/Raise.h"
+#include "Util/string_view.h"
+#include "piece_table_fwd.h"
+#include "text_segments.h"
+#include "text_snapshot.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+** An alternative to gap_buffer which stores the document as a sequence of
+** "pieces", each referring to a run of characters in one of the blocks of
+** text it owns: one holding the text the table was last assigned, and as
+** many as are needed for everything inserted since. Blocks are only ever
+** appended to, so text which a piece refers to never changes or moves, which
+** makes snapshots as cheap as copying the list of pieces.
+**
+** The pieces are kept in an implicit treap (a randomized balanced binary tree
+** keyed by character position), so inserting or erasing anywhere in the
+** document costs O(log n) in the number of pieces, no matter how far the edit
+** is from the previous one. Nothing is ever moved in memory during an edit.
+**
+** The interface mirrors the parts of gap_buffer which BasicTextBuffer uses.
+** Sequential character access through operator[] is amortized O(1) thanks to
+** a cache of the most recently visited piece, which means that even const
+** member functions may update internal state. Like gap_buffer, a piece_table
+** must not be accessed concurrently from multiple threads, other threads
+** should read from a snapshot instead.
+*/
+template <class Ch, class Tr>
+class piece_table {
+public:
+	using string_type = std::basic_string<Ch, Tr>;
+	using view_type   = view::basic_string_view<Ch, Tr>;
+
+public:
+	using value_type      = Ch;
+	using size_type       = int64_t;
+	using difference_type = int64_t;
+
+private:
+	using node_index  = int32_t;
+	using block_index = int32_t;
+
+	static constexpr node_index NoNode   = -1;
+	static constexpr block_index NoBlock = -1;
+
+	// size of the blocks that inserted text is collected in
+	static constexpr size_type BlockSize = 65536;
+
+	struct piece {
+		size_type start;   // offset of the first character in the block
+		size_type length;  // number of characters in this piece
+		size_type total;   // number of characters in the subtree rooted here
+		uint32_t priority; // heap key, keeps the tree balanced
+		node_index left;   // pieces before this one
+		node_index right;  // pieces after this one
+		block_index block; // which block holds the text
+	};
+
+	struct block {
+		explicit block(size_type capacity)
+			: text(new Ch[static_cast<size_t>(capacity)]), capacity(capacity) {
+		}
+
+		std::unique_ptr<Ch[]> text;
+		size_type size = 0;
+		size_type capacity;
+	};
+
+public:
+	piece_table();
+	explicit piece_table(size_type reserve_size);
+	piece_table(const piece_table &) = delete;
+	piece_table &operator=(const piece_table &) = delete;
+	piece_table(piece_table &&)                 = delete;
+	piece_table &operator=(piece_table &&) = delete;
+	~piece_table()                         = default;
+
+public:
+	size_type size() const noexcept { return total(root_); }
+	bool empty() const noexcept { return size() == 0; }
+	size_type piece_count() const noexcept { return static_cast<size_type>(nodes_.size() - free_.size()); }
+	void swap(piece_table &other) noexcept;
+
+public:
+	Ch operator[](size_type n) const noexcept;
+	Ch at(size_type n) const;
+
+public:
+	int compare(size_type pos, view_type str) const noexcept;
+	int compare(size_type pos, Ch ch) const noexcept;
+
+public:
+	string_type to_string() const;
+	string_type to_string(size_type start, size_type end) const;
+	view_type to_view() noexcept;
+	view_type to_view(size_type start, size_type end) noexcept;
+	text_segments<Ch, Tr> segments(size_type start, size_type end) const;
+	text_snapshot<Ch, Tr> snapshot() const;
+
+public:
+	void append(view_type str);
+	void append(Ch ch);
+	void insert(size_type pos, view_type str);
+	void insert(size_type pos, Ch ch);
+	size_type erase(size_type start, size_type end) noexcept;
+	void replace(size_type start, size_type end, view_type str);
+	void replace(size_type start, size_type end, Ch ch);
+	void assign(view_type str);
+	void clear() noexcept;
+
+	template <class Fill>
+	bool assign(size_type capacity, Fill fill);
+
+public:
+	template <class Func>
+	void for_each_segment(size_type start, size_type end, Func func) const;
+
+private:
+	size_type total(node_index n) const noexcept { return n == NoNode ? 0 : nodes_[static_cast<size_t>(n)].total; }
+	piece &node(node_index n) noexcept { return nodes_[static_cast<size_t>(n)]; }
+	const piece &node(node_index n) const noexcept { return nodes_[static_cast<size_t>(n)]; }
+	const Ch *data(const piece &p) const noexcept { return blocks_[static_cast<size_t>(p.block)]->text.get() + p.start; }
+
+private:
+	node_index make_node(size_type start, size_type length, block_index block);
+	std::pair<block_index, size_type> store(view_type str);
+	void free_tree(node_index n) noexcept;
+	void update(node_index n) noexcept;
+	node_index merge(node_index lhs, node_index rhs) noexcept;
+	std::pair<node_index, node_index> split(node_index n, size_type pos);
+	void flatten();
+	uint32_t next_priority() noexcept;
+
+	template <class Func>
+	void visit(node_index n, size_type offset, size_type start, size_type end, Func &func) const;
+
+private:
+	std::vector<std::shared_ptr<block>> blocks_; // the text the pieces refer to, shared with snapshots
+	block_index addBlock_ = NoBlock;             // the block inserted text is appended to
+	std::vector<piece> nodes_;                   // node storage, linked by index
+	std::vector<node_index> free_; // unused entries in "nodes_"
+	node_index root_ = NoNode;
+	uint32_t seed_   = 0x9e3779b9;
+
+private:
+	// cache of the most recently accessed piece, for sequential access
+	mutable const Ch *cacheData_  = nullptr;
+	mutable size_type cacheStart_ = 0;
+	mutable size_type cacheEnd_   = 0;
+};
+
+template <class Ch, class Tr>
+constexpr typename piece_table<Ch, Tr>::node_index piece_table<Ch, Tr>::NoNode;
+
+template <class Ch, class Tr>
+constexpr typename piece_table<Ch, Tr>::block_index piece_table<Ch, Tr>::NoBlock;
+
+template <class Ch, class Tr>
+constexpr typename piece_table<Ch, Tr>::size_type piece_table<Ch, Tr>::BlockSize;
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+piece_table<Ch, Tr>::piece_table()
+	: piece_table(0) {
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+piece_table<Ch, Tr>::piece_table(size_type reserve_size) {
+	if (reserve_size > 0) {
+		blocks_.push_back(std::make_shared<block>(reserve_size));
+		addBlock_ = 0;
+	}
+}
+
+/*
+** Simple xorshift generator for the treap priorities, the quality of the
+** randomness doesn't matter much here.
+*/
+template <class Ch, class Tr>
+uint32_t piece_table<Ch, Tr>::next_priority() noexcept {
+	seed_ ^= seed_ << 13;
+	seed_ ^= seed_ >> 17;
+	seed_ ^= seed_ << 5;
+	return seed_;
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+auto piece_table<Ch, Tr>::make_node(size_type start, size_type length, block_index block) -> node_index {
+
+	const piece p = {start, length, length, next_priority(), NoNode, NoNode, block};
+
+	if (!free_.empty()) {
+		const node_index n = free_.back();
+		free_.pop_back();
+		node(n) = p;
+		return n;
+	}
+
+	nodes_.push_back(p);
+	return static_cast<node_index>(nodes_.size() - 1);
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+void piece_table<Ch, Tr>::free_tree(node_index n) noexcept {
+	if (n == NoNode) {
+		return;
+	}
+
+	free_tree(node(n).left);
+	free_tree(node(n).right);
+	free_.push_back(n);
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+void piece_table<Ch, Tr>::update(node_index n) noexcept {
+	piece &p = node(n);
+	p.total  = total(p.left) + p.length + total(p.right);
+}
+
+/*
+** Concatenate two trees, every piece in "lhs" comes before every piece in "rhs"
+*/
+template <class Ch, class Tr>
+auto piece_table<Ch, Tr>::merge(node_index lhs, node_index rhs) noexcept -> node_index {
+
+	if (lhs == NoNode) {
+		return rhs;
+	}
+
+	if (rhs == NoNode) {
+		return lhs;
+	}
+
+	if (node(lhs).priority > node(rhs).priority) {
+		node(lhs).right = merge(node(lhs).right, rhs);
+		update(lhs);
+		return lhs;
+	}
+
+	node(rhs).left = merge(lhs, node(rhs).left);
+	update(rhs);
+	return rhs;
+}
+
+/*
+** Split a tree into one holding the first "pos" characters and one holding the
+** rest. A piece straddling "pos" is cut in two.
+*/
+template <class Ch, class Tr>
+auto piece_table<Ch, Tr>::split(node_index n, size_type pos) -> std::pair<node_index, node_index> {
+
+	if (n == NoNode) {
+		return {NoNode, NoNode};
+	}
+
+	const size_type leftTotal = total(node(n).left);
+
+	if (pos <= leftTotal) {
+		const std::pair<node_index, node_index> parts = split(node(n).left, pos);
+		node(n).left                                  = parts.second;
+		update(n);
+		return {parts.first, n};
+	}
+
+	if (pos >= leftTotal + node(n).length) {
+		const std::pair<node_index, node_index> parts = split(node(n).right, pos - leftTotal - node(n).length);
+		node(n).right                                 = parts.first;
+		update(n);
+		return {n, parts.second};
+	}
+
+	// the split point is inside this piece
+	const size_type offset = pos - leftTotal;
+	const node_index tail  = make_node(node(n).start + offset, node(n).length - offset, node(n).block);
+
+	// inheriting the priority keeps the heap property intact
+	node(tail).priority = node(n).priority;
+	node(tail).right    = node(n).right;
+	update(tail);
+
+	node(n).length = offset;
+	node(n).right  = NoNode;
+	update(n);
+
+	return {n, tail};
+}
+
+/*
+** Collapse the whole table into a single piece, so that the text becomes
+** contiguous in memory. This is O(n) and is only done when a caller asks for
+** a contiguous view of the text.
+*/
+template <class Ch, class Tr>
+void piece_table<Ch, Tr>::flatten() {
+
+	if (root_ == NoNode || (node(root_).left == NoNode && node(root_).right == NoNode)) {
+		return;
+	}
+
+	string_type text = to_string();
+	assign(text);
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+Ch piece_table<Ch, Tr>::operator[](size_type n) const noexcept {
+
+	if (n >= cacheStart_ && n < cacheEnd_) {
+		return cacheData_[n - cacheStart_];
+	}
+
+	node_index current = root_;
+	size_type offset   = 0;
+
+	while (current != NoNode) {
+		const piece &p            = node(current);
+		const size_type leftTotal = total(p.left);
+
+		if (n < offset + leftTotal) {
+			current = p.left;
+		} else if (n < offset + leftTotal + p.length) {
+			cacheData_  = data(p);
+			cacheStart_ = offset + leftTotal;
+			cacheEnd_   = cacheStart_ + p.length;
+			return cacheData_[n - cacheStart_];
+		} else {
+			offset += leftTotal + p.length;
+			current = p.right;
+		}
+	}
+
+	return Ch();
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+Ch piece_table<Ch, Tr>::at(size_type n) const {
+
+	if (n >= size() || n < 0) {
+		Raise<std::out_of_range>("piece_table::at");
+	}
+
+	return (*this)[n];
+}
+
+/*
+** In-order traversal of the pieces overlapping [start, end), calling
+** "func(const Ch *text, size_type length)" for each run of characters
+*/
+template <class Ch, class Tr>
+template <class Func>
+void piece_table<Ch, Tr>::visit(node_index n, size_type offset, size_type start, size_type end, Func &func) const {
+
+	while (n != NoNode) {
+		const piece &p             = node(n);
+		const size_type leftTotal  = total(p.left);
+		const size_type pieceStart = offset + leftTotal;
+		const size_type pieceEnd   = pieceStart + p.length;
+
+		if (start < pieceStart) {
+			visit(p.left, offset, start, end, func);
+		}
+
+		if (start < pieceEnd && end > pieceStart) {
+			const size_type first = std::max(start, pieceStart);
+			const size_type last  = std::min(end, pieceEnd);
+			func(data(p) + (first - pieceStart), last - first);
+		}
+
+		if (end <= pieceEnd) {
+			return;
+		}
+
+		// tail iteration for the right subtree
+		offset = pieceEnd;
+		n      = p.right;
+	}
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+template <class Func>
+void piece_table<Ch, Tr>::for_each_segment(size_type start, size_type end, Func func) const {
+	if (start < end) {
+		visit(root_, 0, start, end, func);
+	}
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+int piece_table<Ch, Tr>::compare(size_type pos, view_type str) const noexcept {
+
+	auto posEnd = pos + static_cast<size_type>(str.size());
+	if (posEnd > size()) {
+		return 1;
+	}
+
+	if (pos < 0) {
+		return -1;
+	}
+
+	int result    = 0;
+	size_t offset = 0;
+
+	for_each_segment(pos, posEnd, [&](const Ch *text, size_type length) {
+		if (result == 0) {
+			result = Tr::compare(text, str.data() + offset, static_cast<size_t>(length));
+			offset += static_cast<size_t>(length);
+		}
+	});
+
+	return result;
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+int piece_table<Ch, Tr>::compare(size_type pos, Ch ch) const noexcept {
+	if (pos >= size()) {
+		return 1;
+	}
+
+	if (pos < 0) {
+		return -1;
+	}
+
+	const Ch buffer_char = (*this)[pos];
+	return Tr::compare(&buffer_char, &ch, 1);
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+auto piece_table<Ch, Tr>::to_string() const -> string_type {
+	return to_string(0, size());
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+auto piece_table<Ch, Tr>::to_string(size_type start, size_type end) const -> string_type {
+
+	assert(start <= size() && start >= 0);
+	assert(end <= size() && end >= 0);
+	assert(start <= end);
+
+	string_type text;
+	text.reserve(static_cast<size_t>(end - start));
+
+	for_each_segment(start, end, [&text](const Ch *str, size_type length) {
+		text.append(str, static_cast<size_t>(length));
+	});
+
+	return text;
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+auto piece_table<Ch, Tr>::to_view() noexcept -> view_type {
+	return to_view(0, size());
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+auto piece_table<Ch, Tr>::to_view(size_type start, size_type end) noexcept -> view_type {
+
+	assert(start <= size() && start >= 0);
+	assert(end <= size() && end >= 0);
+	assert(start <= end);
+
+	if (start == end) {
+		return view_type();
+	}
+
+	// if the range is within a single piece, there is nothing to do
+	(*this)[start];
+	if (end <= cacheEnd_) {
+		return view_type(cacheData_ + (start - cacheStart_), static_cast<size_t>(end - start));
+	}
+
+	flatten();
+	return view_type(data(node(root_)) + start, static_cast<size_t>(end - start));
+}
+
+/*
+** Returns the range [start, end) as the runs of text of the pieces which
+** overlap it, without flattening the table
+*/
+template <class Ch, class Tr>
+auto piece_table<Ch, Tr>::segments(size_type start, size_type end) const -> text_segments<Ch, Tr> {
+
+	assert(start <= size() && start >= 0);
+	assert(end <= size() && end >= 0);
+	assert(start <= end);
+
+	text_segments<Ch, Tr> result;
+	for_each_segment(start, end, [&result](const Ch *text, size_type length) {
+		result.append(view_type(text, static_cast<size_t>(length)));
+	});
+
+	return result;
+}
+
+/*
+** Returns an immutable copy of the whole text, sharing the blocks rather than
+** copying them. Blocks are only ever appended to, past the end of anything a
+** snapshot can see, so nothing needs to happen when the table is modified
+** later on.
+*/
+template <class Ch, class Tr>
+auto piece_table<Ch, Tr>::snapshot() const -> text_snapshot<Ch, Tr> {
+	std::vector<std::shared_ptr<const void>> owners(blocks_.begin(), blocks_.end());
+	return text_snapshot<Ch, Tr>(segments(0, size()), std::move(owners));
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+void piece_table<Ch, Tr>::append(view_type str) {
+	insert(size(), str);
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+void piece_table<Ch, Tr>::append(Ch ch) {
+	insert(size(), ch);
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+void piece_table<Ch, Tr>::insert(size_type pos, view_type str) {
+
+	assert(pos <= size() && pos >= 0);
+
+	if (str.empty()) {
+		return;
+	}
+
+	cacheStart_ = 0;
+	cacheEnd_   = 0;
+
+	const auto length                                 = static_cast<size_type>(str.size());
+	const std::pair<block_index, size_type> location = store(str);
+
+	std::pair<node_index, node_index> parts = split(root_, pos);
+
+	/* If the text ends up right after the piece which was last appended to,
+	   just grow that piece. This keeps sequential typing from creating a new
+	   piece per keystroke. Every node on the right spine of the left part
+	   includes that piece in its total. */
+	node_index last = parts.first;
+	while (last != NoNode && node(last).right != NoNode) {
+		last = node(last).right;
+	}
+
+	if (last != NoNode && node(last).block == location.first && node(last).start + node(last).length == location.second) {
+		node(last).length += length;
+		for (node_index n = parts.first; n != NoNode; n = node(n).right) {
+			node(n).total += length;
+		}
+
+		root_ = merge(parts.first, parts.second);
+		return;
+	}
+
+	const node_index n = make_node(location.second, length, location.first);
+	root_              = merge(merge(parts.first, n), parts.second);
+}
+
+/*
+** Copy "str" into the block being appended to, starting a new one when it
+** doesn't fit. Returns where the text was put.
+*/
+template <class Ch, class Tr>
+auto piece_table<Ch, Tr>::store(view_type str) -> std::pair<block_index, size_type> {
+
+	const auto length = static_cast<size_type>(str.size());
+
+	if (addBlock_ == NoBlock || blocks_[static_cast<size_t>(addBlock_)]->capacity - blocks_[static_cast<size_t>(addBlock_)]->size < length) {
+		blocks_.push_back(std::make_shared<block>(std::max(BlockSize, length)));
+		addBlock_ = static_cast<block_index>(blocks_.size() - 1);
+	}
+
+	block &b              = *blocks_[static_cast<size_t>(addBlock_)];
+	const size_type start = b.size;
+
+	Tr::copy(b.text.get() + start, str.data(), str.size());
+	b.size += length;
+
+	return {addBlock_, start};
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+void piece_table<Ch, Tr>::insert(size_type pos, Ch ch) {
+	insert(pos, view_type(&ch, 1));
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+auto piece_table<Ch, Tr>::erase(size_type start, size_type end) noexcept -> size_type {
+
+	assert(start <= size() && start >= 0);
+	assert(end <= size() && end >= 0);
+	assert(start <= end);
+
+	if (start == end) {
+		return start;
+	}
+
+	cacheStart_ = 0;
+	cacheEnd_   = 0;
+
+	const std::pair<node_index, node_index> head = split(root_, start);
+	const std::pair<node_index, node_index> tail = split(head.second, end - start);
+
+	free_tree(tail.first);
+	root_ = merge(head.first, tail.second);
+	return start;
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+void piece_table<Ch, Tr>::replace(size_type start, size_type end, view_type str) {
+	insert(erase(start, end), str);
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+void piece_table<Ch, Tr>::replace(size_type start, size_type end, Ch ch) {
+	insert(erase(start, end), ch);
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+void piece_table<Ch, Tr>::assign(view_type str) {
+
+	cacheStart_ = 0;
+	cacheEnd_   = 0;
+
+	// any snapshots keep their own references to the old blocks
+	blocks_.clear();
+	addBlock_ = NoBlock;
+	nodes_.clear();
+	free_.clear();
+	root_ = NoNode;
+
+	if (!str.empty()) {
+		auto original = std::make_shared<block>(static_cast<size_type>(str.size()));
+		Tr::copy(original->text.get(), str.data(), str.size());
+		original->size = original->capacity;
+
+		blocks_.push_back(std::move(original));
+		root_ = make_node(0, static_cast<size_type>(str.size()), 0);
+	}
+}
+
+/*
+** Replaces the contents of the table with text written straight into a new
+** block by "fill(Ch *data, size_type capacity)", which may write up to
+** "capacity" characters and returns how many it did write. Whatever is left of
+** the block afterwards is used for text inserted later on. If "fill" returns
+** a negative number, the table is left unchanged and false is returned.
+*/
+template <class Ch, class Tr>
+template <class Fill>
+bool piece_table<Ch, Tr>::assign(size_type capacity, Fill fill) {
+
+	auto original          = std::make_shared<block>(capacity);
+	const size_type length = fill(original->text.get(), capacity);
+
+	if (length < 0) {
+		return false;
+	}
+
+	assert(length <= capacity);
+
+	original->size = length;
+
+	assign(view_type());
+	blocks_.push_back(std::move(original));
+	addBlock_ = 0;
+
+	if (length != 0) {
+		root_ = make_node(0, length, 0);
+	}
+
+	return true;
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+void piece_table<Ch, Tr>::clear() noexcept {
+	assign(view_type());
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+void piece_table<Ch, Tr>::swap(piece_table &other) noexcept {
+	using std::swap;
+
+	swap(blocks_, other.blocks_);
+	swap(addBlock_, other.addBlock_);
+	swap(nodes_, other.nodes_);
+	swap(free_, other.free_);
+	swap(root_, other.root_);
+	swap(seed_, other.seed_);
+
+	cacheStart_       = 0;
+	cacheEnd_         = 0;
+	other.cacheStart_ = 0;
+	other.cacheEnd_   = 0;
+}
+
+#endif
@@ -0,0 +1,10 @@
+
+#ifndef PIECE_TABLE_FWD_H_
+#define PIECE_TABLE_FWD_H_
+
+#include <string>
+
+template <class Ch = char, class Tr = std::char_traits<Ch>>
+class piece_table;
+
+#endif
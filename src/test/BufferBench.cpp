@@ -0,0 +1,111 @@
+
+#include "gap_buffer.h"
+#include "piece_table.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+/*
+** Compares the two TextBuffer storage engines on a few typical editing
+** patterns. Usage: nedit-buffer-bench [size in MB]
+*/
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int EditCount = 10000;
+
+std::string makeDocument(size_t size) {
+	static const char line[] = "the quick brown fox jumps over the lazy dog, 0123456789 ... \n";
+
+	std::string text;
+	text.reserve(size);
+	while (text.size() + sizeof(line) - 1 <= size) {
+		text.append(line);
+	}
+	return text;
+}
+
+template <class F>
+double measure(F &&func) {
+	const auto start = Clock::now();
+	func();
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+template <class Buffer>
+void runBenchmark(const char *name, const std::string &document) {
+
+	Buffer buffer;
+	int64_t checksum = 0;
+
+	const double assignTime = measure([&]() {
+		buffer.assign(document);
+	});
+
+	// typing a few characters at a time in one spot
+	const double typingTime = measure([&]() {
+		int64_t pos = buffer.size() / 2;
+		for (int i = 0; i < EditCount; ++i) {
+			buffer.insert(pos++, 'x');
+		}
+	});
+
+	// edits spread out over the whole document, like a replace-all or a
+	// macro run over every line
+	std::mt19937 rng(1234);
+	const double scatteredTime = measure([&]() {
+		for (int i = 0; i < EditCount; ++i) {
+			const int64_t pos = static_cast<int64_t>(rng() % static_cast<uint64_t>(buffer.size() - 16));
+			if (i & 1) {
+				buffer.erase(pos, pos + 8);
+			} else {
+				buffer.insert(pos, "replacement");
+			}
+		}
+	});
+
+	// a full sequential pass over the text, as line counting would do
+	const double scanTime = measure([&]() {
+		const int64_t size = buffer.size();
+		for (int64_t i = 0; i < size; ++i) {
+			checksum += (buffer[i] == '\n');
+		}
+	});
+
+	// character lookups at random positions
+	const double randomTime = measure([&]() {
+		for (int i = 0; i < EditCount * 10; ++i) {
+			checksum += buffer[static_cast<int64_t>(rng() % static_cast<uint64_t>(buffer.size()))];
+		}
+	});
+
+	// copying the whole document out, as saving does
+	const double copyTime = measure([&]() {
+		checksum += static_cast<int64_t>(buffer.to_string().size());
+	});
+
+	printf("%-12s %10.2f %10.2f %10.2f %10.2f %10.2f %10.2f   (%lld)\n", name, assignTime, typingTime, scatteredTime, scanTime, randomTime, copyTime, static_cast<long long>(checksum));
+}
+
+}
+
+int main(int argc, char *argv[]) {
+
+	size_t megabytes = 16;
+	if (argc > 1) {
+		megabytes = static_cast<size_t>(std::strtoul(argv[1], nullptr, 10));
+	}
+
+	const std::string document = makeDocument(megabytes * 1024 * 1024);
+
+	printf("document: %zu MB, %d edits per test, times in ms\n\n", megabytes, EditCount);
+	printf("%-12s %10s %10s %10s %10s %10s %10s\n", "engine", "assign", "typing", "scattered", "scan", "random", "copy");
+
+	runBenchmark<gap_buffer<char>>("gap_buffer", document);
+	runBenchmark<piece_table<char>>("piece_table", document);
+}
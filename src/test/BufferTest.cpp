@@ -0,0 +1,421 @@
+
+#include "ChunkedSearch.h"
+#include "TextBuffer.h"
+#include "Util/FileFormats.h"
+#include "Util/FileSystem.h"
+
+#include <QBuffer>
+#include <QByteArray>
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Notification {
+	TextCursor pos;
+	int64_t nInserted;
+	int64_t nDeleted;
+	std::string deletedText;
+};
+
+void modifiedCallback(TextCursor pos, int64_t nInserted, int64_t nDeleted, int64_t, view::string_view deletedText, void *user) {
+	if (nInserted != 0 || nDeleted != 0) {
+		static_cast<std::vector<Notification> *>(user)->push_back({pos, nInserted, nDeleted, deletedText.to_string()});
+	}
+}
+
+/**
+ * @brief test_batched_replacements
+ * @return 0 if replacements made while a batch is open are reported once, as
+ * a single change which undoes all of them, when the batch ends. This is what
+ * a Replace All inside a macro's begin_batch()/end_batch() relies on to be
+ * recorded for undo once and only once. -1 otherwise
+ */
+int test_batched_replacements() {
+
+	std::string original;
+	for (int i = 0; i < 1000; ++i) {
+		original.append("one two three\n");
+	}
+
+	auto buffer = std::make_shared<TextBuffer>();
+	buffer->BufSetAll(original);
+
+	std::vector<Notification> notifications;
+	buffer->BufAddModifyCB(modifiedCallback, &notifications);
+
+	buffer->BufBeginBatch();
+	buffer->BufBeginBatch();
+
+	if (!buffer->BufInBatch()) {
+		std::cerr << "ERROR    : batch not open after BufBeginBatch" << std::endl;
+		return -1;
+	}
+
+	/* replace every "two" with "2", a chunk of a few lines at a time, like
+	   replaceTextDeltas. The lines before the chunk are already shorter */
+	for (int64_t line = 0; line < 1000; line += 7) {
+		const int64_t lines = std::min<int64_t>(7, 1000 - line);
+		const auto start    = TextCursor(line * 12);
+
+		std::string chunk;
+		for (int64_t i = 0; i < lines; ++i) {
+			chunk.append("one 2 three\n");
+		}
+
+		buffer->BufReplace(start, start + lines * 14, chunk);
+	}
+
+	buffer->BufEndBatch();
+
+	if (!notifications.empty()) {
+		std::cerr << "ERROR    : notified before the outermost batch ended" << std::endl;
+		return -1;
+	}
+
+	buffer->BufEndBatch();
+
+	if (buffer->BufInBatch()) {
+		std::cerr << "ERROR    : batch still open after BufEndBatch" << std::endl;
+		return -1;
+	}
+
+	if (notifications.size() != 1) {
+		std::cerr << "ERROR    : expected 1 notification, got " << notifications.size() << std::endl;
+		return -1;
+	}
+
+	std::string expected;
+	for (int i = 0; i < 1000; ++i) {
+		expected.append("one 2 three\n");
+	}
+
+	if (buffer->BufGetAll() != expected) {
+		std::cerr << "ERROR    : the replacements weren't made" << std::endl;
+		return -1;
+	}
+
+	// undo the change the way saveUndoInformation's record would
+	const Notification &change = notifications.front();
+	buffer->BufRemoveModifyCB(modifiedCallback, &notifications);
+	buffer->BufReplace(change.pos, change.pos + change.nInserted, change.deletedText);
+
+	if (buffer->BufGetAll() != original) {
+		std::cerr << "ERROR    : undoing the batched change didn't restore the text" << std::endl;
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief readTextFile
+ * @param data
+ * @param format
+ * @return "data" read the way a file is loaded, one block at a time
+ */
+std::string readTextFile(const std::string &data, FileFormats *format) {
+
+	QByteArray bytes(data.data(), static_cast<int>(data.size()));
+	QBuffer device(&bytes);
+	device.open(QIODevice::ReadOnly);
+
+	std::string text(data.size(), '\0');
+	const int64_t length = ReadTextFile(&device, &text[0], static_cast<int64_t>(text.size()), format);
+	if (length < 0) {
+		return std::string();
+	}
+
+	text.resize(static_cast<size_t>(length));
+	return text;
+}
+
+/**
+ * @brief test_read_line_endings_across_blocks
+ * @return 0 if converting the line endings of a file as it is read gives the
+ * same text as converting it all at once, with a DOS line ending split
+ * between two of the blocks it is read in. -1 otherwise
+ */
+int test_read_line_endings_across_blocks() {
+
+	// the size of the blocks ReadTextFile reads
+	constexpr size_t BlockSize = 1024 * 1024;
+
+	// lines of 64 characters, so every block ends at the same point in a line
+	const std::string line = std::string(62, 'x') + "\r\n";
+
+	/* shifted so that the block boundaries fall just after the '\n', right
+	   between the '\r' and the '\n', and just before the '\r' */
+	for (size_t shift = 0; shift < 3; ++shift) {
+
+		std::string data(shift, 'x');
+		while (data.size() < 3 * BlockSize) {
+			data.append(line);
+		}
+
+		// with a '\r' left over at the very end
+		data.push_back('\r');
+
+		if (data[BlockSize - 1] != (shift == 0 ? '\n' : (shift == 1 ? '\r' : 'x'))) {
+			std::cerr << "ERROR    : the test data isn't split where it should be" << std::endl;
+			return -1;
+		}
+
+		std::string expected = data;
+		ConvertFromDos(expected);
+
+		FileFormats format;
+		if (readTextFile(data, &format) != expected || format != FileFormats::Dos) {
+			std::cerr << "ERROR    : reading a DOS file shifted by " << shift << " gave the wrong text" << std::endl;
+			return -1;
+		}
+
+		// the same again as a Macintosh file, where each '\r' stands alone
+		std::replace(data.begin(), data.end(), '\n', 'x');
+
+		expected = data;
+		ConvertFromMac(expected);
+
+		if (readTextFile(data, &format) != expected || format != FileFormats::Mac) {
+			std::cerr << "ERROR    : reading a Macintosh file shifted by " << shift << " gave the wrong text" << std::endl;
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * @brief countDispChars
+ * @return the display columns of the characters of "text" in [lineStart, target), measured without the buffer's help
+ */
+int64_t countDispChars(const std::string &text, int64_t lineStart, int64_t target, int tabDist) {
+	int64_t column = 0;
+	for (int64_t pos = lineStart; pos < std::min(target, static_cast<int64_t>(text.size())); ++pos) {
+		column += TextBuffer::BufCharWidth(text[static_cast<size_t>(pos)], column, tabDist);
+	}
+
+	return column;
+}
+
+/**
+ * @brief countForwardDispChars
+ * @return the position "nChars" display columns after "lineStart", or the end of the line, measured without the buffer's help
+ */
+int64_t countForwardDispChars(const std::string &text, int64_t lineStart, int64_t nChars, int tabDist) {
+	int64_t column = 0;
+	int64_t pos    = lineStart;
+	while (column < nChars && pos < static_cast<int64_t>(text.size()) && text[static_cast<size_t>(pos)] != '\n') {
+		column += TextBuffer::BufCharWidth(text[static_cast<size_t>(pos)], column, tabDist);
+		++pos;
+	}
+
+	return pos;
+}
+
+/**
+ * @brief test_column_checkpoints
+ * @return 0 if column arithmetic on long lines, which goes through the
+ * buffer's cached column checkpoints, gives the same answers as measuring
+ * from the start of the line, while the text and the tab distance are
+ * edited at random. -1 otherwise
+ */
+int test_column_checkpoints() {
+
+	std::mt19937 random(1234);
+
+	auto uniform = [&random](int64_t min, int64_t max) {
+		return std::uniform_int_distribution<int64_t>(min, max)(random);
+	};
+
+	auto buffer = std::make_shared<TextBuffer>();
+	buffer->BufSetColumnCheckpointSpacing(16);
+
+	// tabs and letters, with the odd newline, so that the lines grow long
+	const char characters[] = "ab\t\t\t  cd";
+
+	for (int edit = 0; edit < 2000; ++edit) {
+
+		const int64_t length = buffer->length();
+		const auto pos       = TextCursor(uniform(0, length));
+
+		switch (uniform(0, 9)) {
+		case 0:
+		case 1:
+			buffer->BufRemove(pos, std::min(buffer->BufEndOfBuffer(), pos + uniform(1, 40)));
+			break;
+		case 2:
+			buffer->BufSetTabDistance(static_cast<int>(uniform(1, 12)), false);
+			break;
+		default: {
+			std::string text;
+			for (int64_t i = uniform(1, 60); i > 0; --i) {
+				text.push_back(uniform(0, 199) == 0 ? '\n' : characters[uniform(0, sizeof(characters) - 2)]);
+			}
+
+			if (uniform(0, 1) == 0) {
+				buffer->BufInsert(pos, text);
+			} else {
+				buffer->BufReplace(pos, std::min(buffer->BufEndOfBuffer(), pos + uniform(1, 20)), text);
+			}
+			break;
+		}
+		}
+
+		const std::string text = buffer->BufGetAll();
+		const int tabDist      = buffer->BufGetTabDistance();
+
+		for (int query = 0; query < 20; ++query) {
+			const TextCursor lineStart = buffer->BufStartOfLine(TextCursor(uniform(0, buffer->length())));
+			const TextCursor lineEnd   = buffer->BufEndOfLine(lineStart);
+			const TextCursor target    = TextCursor(uniform(to_integer(lineStart), to_integer(lineEnd)));
+
+			const int64_t columns = buffer->BufCountDispChars(lineStart, target);
+			if (columns != countDispChars(text, to_integer(lineStart), to_integer(target), tabDist)) {
+				std::cerr << "ERROR    : BufCountDispChars is wrong after edit " << edit << std::endl;
+				return -1;
+			}
+
+			const int64_t nChars = uniform(0, columns + 40);
+			if (to_integer(buffer->BufCountForwardDispChars(lineStart, nChars)) != countForwardDispChars(text, to_integer(lineStart), nChars, tabDist)) {
+				std::cerr << "ERROR    : BufCountForwardDispChars is wrong after edit " << edit << std::endl;
+				return -1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+/* The leftmost match in "text" which begins at or after "pos", if any */
+using Matcher = std::function<bool(const std::string &text, int64_t pos, TextRange *match)>;
+
+/**
+ * @brief findAllSequentially
+ * @return every match in "text", found by a single search from the start
+ */
+std::vector<TextRange> findAllSequentially(const std::string &text, const Matcher &matcher) {
+
+	const auto length = static_cast<int64_t>(text.size());
+
+	std::vector<TextRange> matches;
+	TextRange match;
+	int64_t pos = 0;
+
+	while (pos <= length && matcher(text, pos, &match)) {
+		matches.push_back(match);
+
+		if (match.end == length) {
+			break;
+		}
+
+		pos = (match.start == match.end) ? to_integer(match.end) + 1 : to_integer(match.end);
+	}
+
+	return matches;
+}
+
+/**
+ * @brief test_chunked_find_all
+ * @return 0 if finding every match of a search chunk by chunk gives the same
+ * matches as a single search from the start of the text, for matches which
+ * overlap the chunk and block boundaries and empty matches. -1 otherwise
+ */
+int test_chunked_find_all() {
+
+	// the string "aa", where a run of a's can be split up in more than one way
+	const Matcher pair = [](const std::string &text, int64_t pos, TextRange *match) {
+		const size_t start = text.find("aa", static_cast<size_t>(pos));
+		if (start == std::string::npos) {
+			return false;
+		}
+
+		*match = {TextCursor(static_cast<int64_t>(start)), TextCursor(static_cast<int64_t>(start + 2))};
+		return true;
+	};
+
+	// like the regular expression "a*", which matches everywhere, if only an empty string
+	const Matcher run = [](const std::string &text, int64_t pos, TextRange *match) {
+		int64_t end = pos;
+		while (end < static_cast<int64_t>(text.size()) && text[static_cast<size_t>(end)] == 'a') {
+			++end;
+		}
+
+		*match = {TextCursor(pos), TextCursor(end)};
+		return true;
+	};
+
+	// like the regular expression "ba*", which has few matches
+	const Matcher rare = [&run](const std::string &text, int64_t pos, TextRange *match) {
+		const size_t start = text.find('b', static_cast<size_t>(pos));
+		if (start == std::string::npos || !run(text, static_cast<int64_t>(start) + 1, match)) {
+			return false;
+		}
+
+		match->start = TextCursor(static_cast<int64_t>(start));
+		return true;
+	};
+
+	std::mt19937 random(5678);
+	const std::atomic<bool> canceled{false};
+
+	for (int i = 0; i < 200; ++i) {
+
+		// long runs of a's, which the chunk boundaries cut through
+		std::string text;
+		for (int64_t length = std::uniform_int_distribution<int64_t>(0, 3000)(random); length > 0; --length) {
+			text.push_back(std::uniform_int_distribution<int>(0, 40)(random) == 0 ? 'b' : 'a');
+		}
+
+		const auto length       = static_cast<int64_t>(text.size());
+		const int64_t nChunks   = std::uniform_int_distribution<int64_t>(1, 9)(random);
+		const int64_t blockSize = std::uniform_int_distribution<int64_t>(1, 100)(random);
+
+		for (const Matcher &matcher : {pair, run, rare}) {
+
+			// a search which only looks for matches beginning before "to"
+			auto search = [&](int64_t from, int64_t to, const ChunkedSearch::MatchCallback &func) {
+				TextRange match;
+				while (from <= length && matcher(text, from, &match) && match.start < to && func(match) && match.end != length) {
+					from = (match.start == match.end) ? to_integer(match.end) + 1 : to_integer(match.end);
+				}
+			};
+
+			if (ChunkedSearch::FindAll(length, nChunks, blockSize, search, &canceled) != findAllSequentially(text, matcher)) {
+				std::cerr << "ERROR    : searching " << nChunks << " chunks in blocks of " << blockSize << " found different matches" << std::endl;
+				return -1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+}
+
+int main() {
+
+	if (test_batched_replacements() != 0) {
+		return -1;
+	}
+
+	if (test_read_line_endings_across_blocks() != 0) {
+		return -1;
+	}
+
+	if (test_column_checkpoints() != 0) {
+		return -1;
+	}
+
+	if (test_chunked_find_all() != 0) {
+		return -1;
+	}
+
+	std::cout << "SUCCESS\n";
+}
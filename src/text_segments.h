@@ -0,0 +1,126 @@
+
+#ifndef TEXT_SEGMENTS_H_
+#define TEXT_SEGMENTS_H_
+
+#include "Util/string_view.h"
+#include "text_segments_iterator.h"
+
+#include <algorithm>
+#include <cassert>
+#include <string>
+#include <vector>
+
+/*
+** A read-only view of a range of text which is stored as a sequence of
+** contiguous runs, for example the two halves either side of a gap buffer's
+** gap. It lets callers read a buffer in place, without first forcing the
+** storage to become contiguous. Like any view, it is invalidated by the
+** next modification of the buffer it was taken from.
+*/
+template <class Ch, class Tr = std::char_traits<Ch>>
+class text_segments {
+public:
+	using view_type      = view::basic_string_view<Ch, Tr>;
+	using string_type    = std::basic_string<Ch, Tr>;
+	using size_type      = int64_t;
+	using value_type     = Ch;
+	using const_iterator = text_segments_iterator<Ch, Tr>;
+	using iterator       = const_iterator;
+
+public:
+	text_segments()                      = default;
+	text_segments(const text_segments &) = default;
+	text_segments &operator=(const text_segments &) = default;
+	text_segments(text_segments &&)                 = default;
+	text_segments &operator=(text_segments &&) = default;
+	~text_segments()                           = default;
+
+public:
+	const_iterator begin() const { return const_iterator(this, 0); }
+	const_iterator end() const { return const_iterator(this, size_); }
+	const_iterator cbegin() const { return begin(); }
+	const_iterator cend() const { return end(); }
+
+public:
+	size_type size() const noexcept { return size_; }
+	bool empty() const noexcept { return size_ == 0; }
+	bool contiguous() const noexcept { return segments_.size() <= 1; }
+
+public:
+	Ch operator[](size_type n) const noexcept {
+		assert(n >= 0 && n < size_);
+		const size_t index = segment_index(n);
+		return segments_[index][static_cast<size_t>(n - offsets_[index])];
+	}
+
+public:
+	size_t segment_count() const noexcept { return segments_.size(); }
+	view_type segment(size_t index) const noexcept { return segments_[index]; }
+	size_type segment_start(size_t index) const noexcept { return offsets_[index]; }
+	const std::vector<view_type> &segments() const noexcept { return segments_; }
+
+	/* Index of the segment containing position "pos". The end position
+	 * belongs to the last segment */
+	size_t segment_index(size_type pos) const noexcept {
+		auto it = std::upper_bound(offsets_.begin(), offsets_.end(), pos);
+		return (it == offsets_.begin()) ? 0 : static_cast<size_t>(it - offsets_.begin() - 1);
+	}
+
+public:
+	void append(view_type segment) {
+		if (!segment.empty()) {
+			segments_.push_back(segment);
+			offsets_.push_back(size_);
+			size_ += static_cast<size_type>(segment.size());
+		}
+	}
+
+	/* The sub-range [start, end) of the text, sharing the same storage */
+	text_segments slice(size_type start, size_type end) const {
+		assert(start >= 0 && start <= end && end <= size_);
+
+		text_segments result;
+		if (start == end) {
+			return result;
+		}
+
+		for (size_t index = segment_index(start); index < segments_.size() && offsets_[index] < end; ++index) {
+			const size_type first = std::max(start, offsets_[index]) - offsets_[index];
+			const size_type last  = std::min(end - offsets_[index], static_cast<size_type>(segments_[index].size()));
+			result.append(segments_[index].substr(static_cast<size_t>(first), static_cast<size_t>(last - first)));
+		}
+
+		return result;
+	}
+
+	string_type to_string() const {
+		string_type text;
+		text.reserve(static_cast<size_t>(size_));
+		for (view_type segment : segments_) {
+			text.append(segment.data(), segment.size());
+		}
+		return text;
+	}
+
+	/* Returns the text as a single view. This only copies (into "storage")
+	 * when the text is split over more than one segment */
+	view_type to_view(string_type *storage) const {
+		if (segments_.empty()) {
+			return view_type();
+		}
+
+		if (contiguous()) {
+			return segments_.front();
+		}
+
+		*storage = to_string();
+		return view_type(*storage);
+	}
+
+private:
+	std::vector<view_type> segments_;
+	std::vector<size_type> offsets_;
+	size_type size_ = 0;
+};
+
+#endif
@@ -0,0 +1,134 @@
+
+#ifndef TEXT_SEGMENTS_ITERATOR_H_
+#define TEXT_SEGMENTS_ITERATOR_H_
+
+#include <cassert>
+#include <cstdint>
+#include <iterator>
+#include <string>
+
+template <class Ch, class Tr>
+class text_segments;
+
+/*
+** Read-only iterator over the characters of a text_segments. Moving one
+** character at a time only changes segment when it crosses a boundary, so
+** sequential scans cost the same as scanning a plain array.
+*/
+template <class Ch, class Tr>
+class text_segments_iterator {
+	using traits_type   = typename std::iterator<std::random_access_iterator_tag, Ch>;
+	using segments_type = text_segments<Ch, Tr>;
+	using size_type     = int64_t;
+
+public:
+	using difference_type   = typename traits_type::difference_type;
+	using iterator_category = typename traits_type::iterator_category;
+	using pointer           = const Ch *;
+	using reference         = const Ch &;
+	using value_type        = typename traits_type::value_type;
+
+public:
+	text_segments_iterator() = default;
+	text_segments_iterator(const segments_type *segments, size_type pos)
+		: segments_(segments) {
+		seek(pos);
+	}
+
+public:
+	text_segments_iterator(const text_segments_iterator &rhs) = default;
+	text_segments_iterator &operator=(const text_segments_iterator &) = default;
+
+public:
+	text_segments_iterator &operator+=(difference_type rhs) {
+		seek(pos_ + rhs);
+		return *this;
+	}
+	text_segments_iterator &operator-=(difference_type rhs) {
+		seek(pos_ - rhs);
+		return *this;
+	}
+
+public:
+	text_segments_iterator &operator++() {
+		++pos_;
+		if (pos_ == segmentEnd_ && index_ + 1 < segments_->segment_count()) {
+			load(index_ + 1);
+		}
+		return *this;
+	}
+	text_segments_iterator &operator--() {
+		if (pos_ == segmentStart_ && index_ > 0) {
+			load(index_ - 1);
+		}
+		--pos_;
+		return *this;
+	}
+	text_segments_iterator operator++(int) {
+		text_segments_iterator tmp(*this);
+		++*this;
+		return tmp;
+	}
+	text_segments_iterator operator--(int) {
+		text_segments_iterator tmp(*this);
+		--*this;
+		return tmp;
+	}
+
+public:
+	text_segments_iterator operator+(difference_type rhs) const { return text_segments_iterator(segments_, pos_ + rhs); }
+	text_segments_iterator operator-(difference_type rhs) const { return text_segments_iterator(segments_, pos_ - rhs); }
+
+public:
+	difference_type operator-(const text_segments_iterator &rhs) const {
+		assert(segments_ == rhs.segments_);
+		return pos_ - rhs.pos_;
+	}
+
+public:
+	reference operator*() const { return data_[pos_ - segmentStart_]; }
+	Ch operator[](difference_type offset) const { return *(*this + offset); }
+	pointer operator->() const { return &data_[pos_ - segmentStart_]; }
+
+public:
+	bool operator==(const text_segments_iterator &rhs) const { return pos_ == rhs.pos_; }
+	bool operator!=(const text_segments_iterator &rhs) const { return pos_ != rhs.pos_; }
+	bool operator>(const text_segments_iterator &rhs) const { return pos_ > rhs.pos_; }
+	bool operator<(const text_segments_iterator &rhs) const { return pos_ < rhs.pos_; }
+	bool operator>=(const text_segments_iterator &rhs) const { return pos_ >= rhs.pos_; }
+	bool operator<=(const text_segments_iterator &rhs) const { return pos_ <= rhs.pos_; }
+
+public:
+	// position relative to the start of the segmented range
+	size_type position() const { return pos_; }
+
+private:
+	void seek(size_type pos) {
+		pos_ = pos;
+		if (segments_->segment_count() == 0) {
+			return;
+		}
+
+		const size_t index = segments_->segment_index(pos);
+		if (index != index_ || data_ == nullptr) {
+			load(index);
+		}
+	}
+
+	void load(size_t index) {
+		index_        = index;
+		data_         = segments_->segment(index).data();
+		segmentStart_ = segments_->segment_start(index);
+		segmentEnd_   = segmentStart_ + static_cast<size_type>(segments_->segment(index).size());
+	}
+
+private:
+	const segments_type *segments_ = nullptr;
+	const Ch *data_                = nullptr;
+	size_t index_                  = 0;
+	size_type pos_                 = 0;
+	size_type segmentStart_        = 0;
+	size_type segmentEnd_          = 0;
+};
+
+#endif
@@ -0,0 +1,76 @@
+
+#ifndef TEXT_SNAPSHOT_H_
+#define TEXT_SNAPSHOT_H_
+
+#include "Util/string_view.h"
+#include "text_segments.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+** An immutable copy of the contents of a buffer as it was at one point in
+** time. Rather than copying the text, it shares the storage of the buffer it
+** was taken from, and the storage engines promise not to change anything a
+** snapshot can see for as long as it exists. This makes snapshots cheap to
+** take, and since nothing in them ever changes, they may be read from any
+** thread while the buffer goes on being edited. Snapshots must be taken on
+** the thread which owns the buffer. Copies share the same data.
+*/
+template <class Ch, class Tr = std::char_traits<Ch>>
+class text_snapshot {
+public:
+	using view_type      = view::basic_string_view<Ch, Tr>;
+	using string_type    = std::basic_string<Ch, Tr>;
+	using segments_type  = text_segments<Ch, Tr>;
+	using size_type      = int64_t;
+	using value_type     = Ch;
+	using const_iterator = typename segments_type::const_iterator;
+	using iterator       = const_iterator;
+
+public:
+	text_snapshot() = default;
+	text_snapshot(segments_type segments, std::vector<std::shared_ptr<const void>> owners)
+		: segments_(std::move(segments)), owners_(std::move(owners)) {
+	}
+
+	text_snapshot(const text_snapshot &) = default;
+	text_snapshot &operator=(const text_snapshot &) = default;
+	text_snapshot(text_snapshot &&)                 = default;
+	text_snapshot &operator=(text_snapshot &&) = default;
+	~text_snapshot()                           = default;
+
+public:
+	const_iterator begin() const { return segments_.begin(); }
+	const_iterator end() const { return segments_.end(); }
+	const_iterator cbegin() const { return begin(); }
+	const_iterator cend() const { return end(); }
+
+public:
+	size_type size() const noexcept { return segments_.size(); }
+	bool empty() const noexcept { return segments_.empty(); }
+	Ch operator[](size_type n) const noexcept { return segments_[n]; }
+
+public:
+	const segments_type &segments() const noexcept { return segments_; }
+	segments_type segments(size_type start, size_type end) const { return segments_.slice(start, end); }
+	string_type to_string() const { return segments_.to_string(); }
+	string_type to_string(size_type start, size_type end) const { return segments_.slice(start, end).to_string(); }
+
+	/* Calls "func(const Ch *text, size_type length)" for each contiguous run
+	 * of characters in [start, end) */
+	template <class Func>
+	void for_each_segment(size_type start, size_type end, Func func) const {
+		const segments_type range = segments_.slice(start, end);
+		for (view_type segment : range.segments()) {
+			func(segment.data(), static_cast<size_type>(segment.size()));
+		}
+	}
+
+private:
+	segments_type segments_;
+	std::vector<std::shared_ptr<const void>> owners_; // keeps the storage which "segments_" refers to alive
+};
+
+#endif